@@ -0,0 +1,351 @@
+/*!
+	\file Barrier.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the Barrier class
+*/
+
+#ifndef BARRIER_CPP_INCLUDED
+#define BARRIER_CPP_INCLUDED
+
+#include <hydrazine/interface/Barrier.h>
+#include <hydrazine/interface/debug.h>
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	const unsigned int Barrier::FanIn;
+	const unsigned int Barrier::Spins;
+	const unsigned int Barrier::Pending;
+	const unsigned int Barrier::Root;
+
+	Barrier::Node::Node() : arrived( 0 ), expected( 0 ), parent( Root )
+	{
+
+	}
+
+	void Barrier::_build()
+	{
+		NodeVector nodes;
+		unsigned int children = _members.size();
+
+		if( children > 0 )
+		{
+			unsigned int total = 0;
+			for( unsigned int width = children; total == 0 || width > 1; )
+			{
+				width = ( width + FanIn - 1 ) / FanIn;
+				total += width;
+			}
+
+			NodeVector levels( total );
+			nodes.swap( levels );
+		}
+
+		// Leaves come first so that a member arrives at rank / FanIn, then
+		//  each level above them up to the root
+		for( unsigned int begin = 0; begin < nodes.size(); )
+		{
+			unsigned int width = ( children + FanIn - 1 ) / FanIn;
+
+			for( unsigned int i = 0; i < width; ++i )
+			{
+				Node& node = nodes[ begin + i ];
+				node.expected = std::min( FanIn, children - i * FanIn );
+				node.parent = width > 1 ? begin + width + i / FanIn : Root;
+			}
+
+			begin += width;
+			children = width;
+		}
+
+		report( "Built a tree of " << nodes.size() << " nodes for "
+			<< _members.size() << " members." );
+
+		_nodes.swap( nodes );
+	}
+
+	bool Barrier::_idle() const
+	{
+		bool sense = _sense.load();
+
+		for( MemberVector::const_iterator member = _members.begin();
+			member != _members.end(); ++member )
+		{
+			if( ( *member )->_sense.load() != sense )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool Barrier::_arrive( unsigned int rank )
+	{
+		unsigned int index = rank / FanIn;
+
+		while( true )
+		{
+			// Read the node before arriving, once the last member arrives
+			//  at the root the tree may be rebuilt
+			Node& node = _nodes[ index ];
+			unsigned int expected = node.expected;
+			unsigned int parent = node.parent;
+
+			if( node.arrived.fetch_add( 1, std::memory_order_acq_rel ) + 1
+				!= expected )
+			{
+				return false;
+			}
+
+			node.arrived.store( 0, std::memory_order_relaxed );
+
+			if( parent == Root )
+			{
+				return true;
+			}
+
+			index = parent;
+		}
+	}
+
+	void Barrier::_release()
+	{
+		bool sense = !_sense.load( std::memory_order_relaxed );
+		bool changed = _leaving || !_joining.empty();
+
+		// Every member has arrived, so nobody is in the tree
+		if( _leaving )
+		{
+			for( unsigned int rank = 0; rank < _members.size(); )
+			{
+				if( _members[ rank ]->_leaving )
+				{
+					_remove( _members[ rank ] );
+				}
+				else
+				{
+					++rank;
+				}
+			}
+
+			_leaving = false;
+		}
+
+		unsigned int joined = _members.size();
+
+		for( MemberVector::iterator member = _joining.begin();
+			member != _joining.end(); ++member )
+		{
+			( *member )->_sense.store( sense, std::memory_order_relaxed );
+			_members.push_back( *member );
+		}
+
+		_joining.clear();
+
+		if( changed )
+		{
+			_build();
+		}
+
+		// A joining member may arrive as soon as it sees its rank, so
+		//  publish it after the tree is built
+		for( unsigned int rank = joined; rank < _members.size(); ++rank )
+		{
+			_members[ rank ]->_rank.store( rank, std::memory_order_release );
+		}
+
+		_sense.store( sense, std::memory_order_release );
+
+		if( _sleepers > 0 )
+		{
+			_condition.notify_all();
+		}
+	}
+
+	void Barrier::_remove( Member* member )
+	{
+		unsigned int rank = member->_rank.load( std::memory_order_relaxed );
+
+		assert( _members[ rank ] == member );
+
+		_members[ rank ] = _members.back();
+		_members[ rank ]->_rank.store( rank, std::memory_order_relaxed );
+		_members.pop_back();
+
+		delete member;
+	}
+
+	Barrier::Barrier() : _leaving( false ), _sense( false ),
+		_changing( false ), _sleepers( 0 )
+	{
+
+	}
+
+	Barrier::~Barrier()
+	{
+		assert( _sleepers == 0 );
+
+		for( MemberVector::iterator member = _members.begin();
+			member != _members.end(); ++member )
+		{
+			delete *member;
+		}
+
+		for( MemberVector::iterator member = _joining.begin();
+			member != _joining.end(); ++member )
+		{
+			delete *member;
+		}
+	}
+
+	Barrier::Member* Barrier::join()
+	{
+		Member* member = new Member;
+		member->_leaving = false;
+
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		// A member that starts to wait after this sees the flag and waits
+		//  for the lock, one that started before is seen by _idle
+		_changing.store( true );
+
+		if( _idle() )
+		{
+			member->_sense.store( _sense.load() );
+			member->_rank.store( _members.size() );
+			_members.push_back( member );
+			_build();
+		}
+		else
+		{
+			report( "Member joining during an episode, it is pending." );
+			member->_rank.store( Pending );
+			_joining.push_back( member );
+		}
+
+		_changing.store( false, std::memory_order_release );
+
+		return member;
+	}
+
+	void Barrier::leave( Member* member )
+	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		if( member->_rank.load() == Pending )
+		{
+			_joining.erase( std::find( _joining.begin(),
+				_joining.end(), member ) );
+			delete member;
+			return;
+		}
+
+		_changing.store( true );
+
+		if( _idle() )
+		{
+			_remove( member );
+			_build();
+		}
+		else
+		{
+			report( "Member leaving during an episode, it counts as "
+				"arrived." );
+			member->_leaving = true;
+			_leaving = true;
+
+			bool sense = _sense.load( std::memory_order_relaxed );
+
+			if( member->_sense.compare_exchange_strong( sense, !sense )
+				&& _arrive( member->_rank.load() ) )
+			{
+				_release();
+			}
+		}
+
+		_changing.store( false, std::memory_order_release );
+	}
+
+	void Barrier::wait( Member* member )
+	{
+		if( member->_rank.load( std::memory_order_acquire ) == Pending )
+		{
+			boost::unique_lock< boost::mutex > lock( _mutex );
+
+			++_sleepers;
+			while( member->_rank.load( std::memory_order_relaxed )
+				== Pending )
+			{
+				_condition.wait( lock );
+			}
+			--_sleepers;
+		}
+
+		// Once the member has arrived it may be removed, so keep the
+		//  sense it waits for here
+		bool sense = member->_sense.load( std::memory_order_relaxed );
+
+		if( member->_sense.compare_exchange_strong( sense, !sense ) )
+		{
+			sense = !sense;
+
+			if( _changing.load() )
+			{
+				// Arrive after the change, it may move this member
+				boost::unique_lock< boost::mutex > lock( _mutex );
+
+				if( _arrive( member->_rank.load() ) )
+				{
+					_release();
+					return;
+				}
+			}
+			else if( _arrive( member->_rank.load(
+				std::memory_order_relaxed ) ) )
+			{
+				boost::unique_lock< boost::mutex > lock( _mutex );
+				_release();
+				return;
+			}
+		}
+
+		for( unsigned int i = 0; i < Spins; ++i )
+		{
+			if( _sense.load( std::memory_order_acquire ) == sense )
+			{
+				return;
+			}
+		}
+
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		++_sleepers;
+		while( _sense.load( std::memory_order_acquire ) != sense )
+		{
+			_condition.wait( lock );
+		}
+		--_sleepers;
+	}
+
+	unsigned int Barrier::size()
+	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		return _members.size();
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,523 @@
+/*!
+	\file MmapPolicy.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the MmapPolicy class
+*/
+
+#ifndef MMAP_POLICY_CPP_INCLUDED
+#define MMAP_POLICY_CPP_INCLUDED
+
+#include <hydrazine/interface/MmapPolicy.h>
+#include <hydrazine/interface/debug.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <new>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+// Older headers do not name these, the values are fixed by the kernel ABI
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+namespace hydrazine
+{
+
+	/*! \brief Memory policy modes and flags from linux/mempolicy.h */
+	static const int PolicyBind = 2;
+	static const int PolicyInterleave = 3;
+	static const int PolicyNodeOf = 1 | 2;
+
+	static const unsigned int BitsPerWord = 8 * sizeof( unsigned long );
+
+	static size_t smallPageSize()
+	{
+		static const size_t size = sysconf( _SC_PAGESIZE );
+		return size;
+	}
+
+	static size_t roundUp( size_t bytes, size_t multiple )
+	{
+		return ( bytes + multiple - 1 ) / multiple * multiple;
+	}
+
+	/*! \brief Parse a list of nodes like "0-3,6" into a mask */
+	static std::vector< unsigned long > parseNodes( const std::string& list )
+	{
+		std::vector< unsigned long > mask;
+		std::stringstream stream( list );
+		std::string range;
+
+		while( std::getline( stream, range, ',' ) )
+		{
+			if( range.empty() || range[ 0 ] < '0' || range[ 0 ] > '9' )
+			{
+				continue;
+			}
+
+			char* end = 0;
+			unsigned long first = std::strtoul( range.c_str(), &end, 10 );
+			unsigned long last = first;
+			if( *end == '-' )
+			{
+				last = std::strtoul( end + 1, 0, 10 );
+			}
+
+			for( unsigned long node = first; node <= last; ++node )
+			{
+				if( node / BitsPerWord >= mask.size() )
+				{
+					mask.resize( node / BitsPerWord + 1, 0 );
+				}
+				mask[ node / BitsPerWord ] |= 1UL << ( node % BitsPerWord );
+			}
+		}
+
+		return mask;
+	}
+
+	static std::vector< unsigned long > readOnlineNodes()
+	{
+		std::ifstream file( "/sys/devices/system/node/online" );
+		std::string list;
+		std::getline( file, list );
+		return parseNodes( list );
+	}
+
+	/*! \brief The mask of online nodes, empty if it is not known */
+	static const std::vector< unsigned long >& onlineNodes()
+	{
+		static const std::vector< unsigned long > mask = readOnlineNodes();
+		return mask;
+	}
+
+	static size_t readHugePageSize()
+	{
+		std::ifstream file( "/proc/meminfo" );
+		std::string line;
+
+		while( std::getline( file, line ) )
+		{
+			if( line.compare( 0, 13, "Hugepagesize:" ) == 0 )
+			{
+				return size_t( std::strtoul( line.c_str() + 13, 0, 10 ) )
+					* 1024;
+			}
+		}
+
+		return size_t( 2 << 20 );
+	}
+
+	/*! \brief The node of the calling thread, -1 if it is not known */
+	static int currentNode()
+	{
+		#ifdef SYS_getcpu
+		unsigned int cpu = 0;
+		unsigned int node = 0;
+		if( syscall( SYS_getcpu, &cpu, &node, 0 ) == 0 )
+		{
+			return node;
+		}
+		#endif
+		return -1;
+	}
+
+	MmapPolicy::Report::Report() : mappings( 0 ), bytes( 0 ),
+		hugePages( 0 ), hugePageFallbacks( 0 ), advised( 0 ),
+		adviceFallbacks( 0 ), populated( 0 ), placed( 0 ),
+		placementFallbacks( 0 )
+	{
+
+	}
+
+	std::string MmapPolicy::Report::toString() const
+	{
+		std::stringstream stream;
+
+		stream << mappings << " mappings of " << bytes << " bytes";
+		if( hugePages != 0 || hugePageFallbacks != 0 )
+		{
+			stream << ", " << hugePages << " with huge pages, "
+				<< hugePageFallbacks << " fell back";
+		}
+		if( advised != 0 || adviceFallbacks != 0 )
+		{
+			stream << ", " << advised << " advised to use huge pages, "
+				<< adviceFallbacks << " refused";
+		}
+		if( placed != 0 || placementFallbacks != 0 )
+		{
+			stream << ", " << placed << " placed on nodes, "
+				<< placementFallbacks << " not placed";
+		}
+		if( populated != 0 )
+		{
+			stream << ", " << populated << " populated";
+		}
+
+		return stream.str();
+	}
+
+	void* MmapPolicy::_hugePages( size_t bytes, size_t alignment )
+	{
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+		if( _populate && _placement == DefaultPlacement )
+		{
+			flags |= MAP_POPULATE;
+		}
+
+		void* pointer = mmap( 0, bytes, PROT_READ | PROT_WRITE | PROT_EXEC,
+			flags, -1, 0 );
+
+		if( pointer == MAP_FAILED )
+		{
+			report( "No huge pages for a mapping of " << bytes
+				<< " bytes, falling back to small pages." );
+			return 0;
+		}
+
+		// Huge pages are aligned to their size, larger alignments are
+		//  left to the fallback
+		if( alignment != 0 && reinterpret_cast< uintptr_t >( pointer )
+			% alignment != 0 )
+		{
+			munmap( pointer, bytes );
+			return 0;
+		}
+
+		return pointer;
+	}
+
+	void* MmapPolicy::_smallPages( size_t bytes, size_t alignment )
+	{
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+		if( _populate && _pageSize == SmallPages
+			&& _placement == DefaultPlacement
+			&& alignment <= smallPageSize() )
+		{
+			flags |= MAP_POPULATE;
+		}
+
+		if( alignment <= smallPageSize() )
+		{
+			void* pointer = mmap( 0, bytes,
+				PROT_READ | PROT_WRITE | PROT_EXEC, flags, -1, 0 );
+
+			if( pointer == MAP_FAILED )
+			{
+				throw std::bad_alloc();
+			}
+
+			return pointer;
+		}
+
+		// Map enough to hold an aligned block and trim off the rest
+		size_t length = roundUp( bytes, smallPageSize() );
+		char* mapping = static_cast< char* >( mmap( 0, length + alignment,
+			PROT_READ | PROT_WRITE | PROT_EXEC, flags, -1, 0 ) );
+
+		if( mapping == MAP_FAILED )
+		{
+			throw std::bad_alloc();
+		}
+
+		uintptr_t address = reinterpret_cast< uintptr_t >( mapping );
+		char* start = reinterpret_cast< char* >(
+			( address + alignment - 1 ) & ~uintptr_t( alignment - 1 ) );
+
+		if( start != mapping )
+		{
+			munmap( mapping, start - mapping );
+		}
+		munmap( start + length, mapping + alignment - start );
+
+		return start;
+	}
+
+	void MmapPolicy::_advise( void* pointer, size_t bytes )
+	{
+		bool advised = madvise( pointer, bytes, MADV_HUGEPAGE ) == 0;
+
+		boost::unique_lock< boost::mutex > lock( _mutex );
+		if( advised )
+		{
+			++_report.advised;
+		}
+		else
+		{
+			++_report.adviceFallbacks;
+		}
+	}
+
+	void MmapPolicy::_place( void* pointer, size_t bytes )
+	{
+		bool placed = false;
+
+		#ifdef SYS_mbind
+		std::vector< unsigned long > mask = onlineNodes();
+
+		if( nodes() > 1 )
+		{
+			int mode = PolicyInterleave;
+
+			if( _placement == LocalNode )
+			{
+				int node = currentNode();
+				mode = PolicyBind;
+				mask.assign( node < 0 ? 0 : node / BitsPerWord + 1, 0 );
+				if( node >= 0 )
+				{
+					mask[ node / BitsPerWord ] =
+						1UL << ( node % BitsPerWord );
+				}
+			}
+
+			// The kernel reads one bit less than maxnode
+			placed = !mask.empty() && syscall( SYS_mbind, pointer,
+				roundUp( bytes, smallPageSize() ), mode, &mask[ 0 ],
+				mask.size() * BitsPerWord + 1, 0 ) == 0;
+		}
+		#endif
+
+		report( ( placed ? "Placed " : "Could not place " ) << bytes
+			<< " bytes at " << pointer );
+
+		boost::unique_lock< boost::mutex > lock( _mutex );
+		if( placed )
+		{
+			++_report.placed;
+		}
+		else
+		{
+			++_report.placementFallbacks;
+		}
+	}
+
+	void MmapPolicy::_fault( void* pointer, size_t bytes )
+	{
+		// Memory is already zero, writing a zero only faults it in
+		volatile char* begin = static_cast< char* >( pointer );
+		for( size_t offset = 0; offset < bytes; offset += smallPageSize() )
+		{
+			begin[ offset ] = 0;
+		}
+	}
+
+	MmapPolicy::MmapPolicy( PageSize s, Placement p, bool f ) :
+		_pageSize( s ), _placement( p ), _populate( f )
+	{
+
+	}
+
+	MmapPolicy::MmapPolicy( const MmapPolicy& policy ) :
+		_pageSize( policy._pageSize ), _placement( policy._placement ),
+		_populate( policy._populate )
+	{
+
+	}
+
+	void* MmapPolicy::map( size_t bytes, size_t alignment )
+	{
+		size_t length = mappedSize( bytes );
+
+		if( _pageSize == TransparentHugePages && length >= hugePageSize()
+			&& alignment < hugePageSize() )
+		{
+			alignment = hugePageSize();
+		}
+
+		void* pointer = 0;
+		bool huge = false;
+
+		if( _pageSize == HugePages )
+		{
+			pointer = _hugePages( length, alignment );
+			huge = pointer != 0;
+		}
+
+		if( pointer == 0 )
+		{
+			pointer = _smallPages( length, alignment );
+		}
+
+		if( _pageSize == TransparentHugePages )
+		{
+			_advise( pointer, length );
+		}
+
+		if( _placement != DefaultPlacement )
+		{
+			_place( pointer, length );
+		}
+
+		// MAP_POPULATE was used unless something had to come first
+		bool populated = _populate && _placement == DefaultPlacement
+			&& ( huge || ( _pageSize == SmallPages
+			&& alignment <= smallPageSize() ) );
+
+		if( _populate && !populated )
+		{
+			_fault( pointer, length );
+		}
+
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		++_report.mappings;
+		_report.bytes += length;
+
+		if( _pageSize == HugePages )
+		{
+			if( huge )
+			{
+				++_report.hugePages;
+			}
+			else
+			{
+				++_report.hugePageFallbacks;
+			}
+		}
+
+		if( _populate )
+		{
+			++_report.populated;
+		}
+
+		return pointer;
+	}
+
+	void MmapPolicy::unmap( void* pointer, size_t bytes )
+	{
+		munmap( pointer, mappedSize( bytes ) );
+	}
+
+	size_t MmapPolicy::mappedSize( size_t bytes ) const
+	{
+		if( _pageSize == HugePages )
+		{
+			return roundUp( bytes, hugePageSize() );
+		}
+
+		return bytes;
+	}
+
+	MmapPolicy::PageSize MmapPolicy::pageSize() const
+	{
+		return _pageSize;
+	}
+
+	MmapPolicy::Placement MmapPolicy::placement() const
+	{
+		return _placement;
+	}
+
+	bool MmapPolicy::populate() const
+	{
+		return _populate;
+	}
+
+	MmapPolicy::Report MmapPolicy::obtained()
+	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
+		return _report;
+	}
+
+	size_t MmapPolicy::hugePageSize()
+	{
+		static const size_t size = readHugePageSize();
+		return size;
+	}
+
+	unsigned int MmapPolicy::nodes()
+	{
+		const std::vector< unsigned long >& mask = onlineNodes();
+		unsigned int count = 0;
+
+		for( std::vector< unsigned long >::const_iterator
+			word = mask.begin(); word != mask.end(); ++word )
+		{
+			for( unsigned long bits = *word; bits != 0; bits &= bits - 1 )
+			{
+				++count;
+			}
+		}
+
+		return count == 0 ? 1 : count;
+	}
+
+	int MmapPolicy::nodeOf( const void* address )
+	{
+		#ifdef SYS_get_mempolicy
+		int node = -1;
+		if( syscall( SYS_get_mempolicy, &node, 0, 0, address,
+			PolicyNodeOf ) == 0 )
+		{
+			return node;
+		}
+		#endif
+		return -1;
+	}
+
+	size_t MmapPolicy::hugePageBytes( const void* address, size_t bytes )
+	{
+		uintptr_t begin = reinterpret_cast< uintptr_t >( address );
+		uintptr_t end = begin + bytes;
+
+		std::ifstream file( "/proc/self/smaps" );
+		std::string line;
+		bool overlaps = false;
+		size_t total = 0;
+
+		while( std::getline( file, line ) )
+		{
+			std::string::size_type dash = line.find( '-' );
+			std::string::size_type colon = line.find( ':' );
+
+			// A mapping starts with its range, fields name themselves
+			if( dash != std::string::npos
+				&& ( colon == std::string::npos || dash < colon ) )
+			{
+				char* next = 0;
+				uintptr_t first = std::strtoull( line.c_str(), &next, 16 );
+				uintptr_t last = std::strtoull( next + 1, 0, 16 );
+				overlaps = first < end && begin < last;
+				continue;
+			}
+
+			if( !overlaps || colon == std::string::npos )
+			{
+				continue;
+			}
+
+			std::string field = line.substr( 0, colon );
+			if( field == "AnonHugePages" || field == "Private_Hugetlb"
+				|| field == "Shared_Hugetlb" )
+			{
+				total += size_t( std::strtoul( line.c_str() + colon + 1,
+					0, 10 ) ) * 1024;
+			}
+		}
+
+		return total;
+	}
+
+}
+
+#endif
+
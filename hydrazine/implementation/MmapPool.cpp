@@ -0,0 +1,329 @@
+/*!
+	\file MmapPool.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the MmapPool class
+*/
+
+#ifndef MMAP_POOL_CPP_INCLUDED
+#define MMAP_POOL_CPP_INCLUDED
+
+#include <hydrazine/interface/MmapPool.h>
+#include <hydrazine/interface/debug.h>
+
+#include <stdint.h>
+
+#include <cassert>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	/*! \brief Lock a pool only if it is shared */
+	class MmapPoolLock
+	{
+		private:
+			boost::mutex& _mutex;
+			bool _locked;
+
+		public:
+			MmapPoolLock( boost::mutex& mutex, bool locked ) :
+				_mutex( mutex ), _locked( locked )
+			{
+				if( _locked )
+				{
+					_mutex.lock();
+				}
+			}
+
+			~MmapPoolLock()
+			{
+				if( _locked )
+				{
+					_mutex.unlock();
+				}
+			}
+	};
+
+	const size_t MmapPool::RegionSize;
+	const size_t MmapPool::MaxBlockSize;
+	const size_t MmapPool::Alignment;
+	const unsigned int MmapPool::Classes;
+
+	/*! \brief Classes below this are Alignment bytes apart */
+	static const size_t LinearLimit = 1024;
+	static const unsigned int LinearClasses = LinearLimit
+		/ MmapPool::Alignment;
+	/*! \brief log2( LinearLimit ) */
+	static const unsigned int LinearShift = 10;
+	/*! \brief Classes per power of two above LinearLimit */
+	static const unsigned int Steps = 4;
+
+	unsigned int MmapPool::_classOf( size_t bytes )
+	{
+		if( bytes <= LinearLimit )
+		{
+			return bytes == 0 ? 0 : ( bytes + Alignment - 1 ) / Alignment - 1;
+		}
+
+		unsigned int shift = 0;
+		for( size_t rest = ( bytes - 1 ) >> 1; rest != 0; rest >>= 1 )
+		{
+			++shift;
+		}
+
+		size_t base = size_t( 1 ) << shift;
+		return LinearClasses + ( shift - LinearShift ) * Steps
+			+ ( bytes - 1 - base ) / ( base / Steps );
+	}
+
+	size_t MmapPool::_classSize( unsigned int index )
+	{
+		if( index < LinearClasses )
+		{
+			return ( index + 1 ) * Alignment;
+		}
+
+		unsigned int step = index - LinearClasses;
+		size_t base = size_t( 1 ) << ( LinearShift + step / Steps );
+		return base + ( step % Steps + 1 ) * ( base / Steps );
+	}
+
+	size_t MmapPool::_headerSize()
+	{
+		// Keep the first block off of the cache line of the header
+		return ( sizeof( Region ) + 63 ) & ~size_t( 63 );
+	}
+
+	MmapPool::Region* MmapPool::_mapRegion( unsigned int sizeClass )
+	{
+		char* start = static_cast< char* >(
+			_policy.map( RegionSize, RegionSize ) );
+
+		report( "Mapped a region at " << ( void* ) start
+			<< " for size class " << _classes[ sizeClass ].size );
+
+		Region* region = reinterpret_cast< Region* >( start );
+		size_t size = _classes[ sizeClass ].size;
+
+		region->previous = 0;
+		region->next = _regions;
+		if( _regions != 0 )
+		{
+			_regions->previous = region;
+		}
+		_regions = region;
+
+		region->free = 0;
+		region->untouched = start + _headerSize();
+		region->end = region->untouched
+			+ ( RegionSize - _headerSize() ) / size * size;
+		region->live = 0;
+		region->sizeClass = sizeClass;
+		region->partial = false;
+
+		++_regionCount;
+
+		_linkPartial( region );
+
+		return region;
+	}
+
+	void MmapPool::_unmapRegion( Region* region )
+	{
+		report( "Unmapping the region at " << ( void* ) region );
+
+		if( region->partial )
+		{
+			_unlinkPartial( region );
+		}
+
+		if( region->previous != 0 )
+		{
+			region->previous->next = region->next;
+		}
+		else
+		{
+			_regions = region->next;
+		}
+		if( region->next != 0 )
+		{
+			region->next->previous = region->previous;
+		}
+
+		--_regionCount;
+
+		_policy.unmap( region, RegionSize );
+	}
+
+	void MmapPool::_linkPartial( Region* region )
+	{
+		SizeClass& sizeClass = _classes[ region->sizeClass ];
+
+		region->previousPartial = 0;
+		region->nextPartial = sizeClass.partial;
+		if( sizeClass.partial != 0 )
+		{
+			sizeClass.partial->previousPartial = region;
+		}
+		sizeClass.partial = region;
+		region->partial = true;
+	}
+
+	void MmapPool::_unlinkPartial( Region* region )
+	{
+		SizeClass& sizeClass = _classes[ region->sizeClass ];
+
+		if( region->previousPartial != 0 )
+		{
+			region->previousPartial->nextPartial = region->nextPartial;
+		}
+		else
+		{
+			sizeClass.partial = region->nextPartial;
+		}
+		if( region->nextPartial != 0 )
+		{
+			region->nextPartial->previousPartial = region->previousPartial;
+		}
+		region->partial = false;
+	}
+
+	MmapPool::MmapPool( bool s, const MmapPolicy& p ) : _regions( 0 ),
+		_regionCount( 0 ), _live( 0 ), _synchronized( s ), _policy( p )
+	{
+		for( unsigned int i = 0; i < Classes; ++i )
+		{
+			_classes[ i ].size = _classSize( i );
+			_classes[ i ].partial = 0;
+		}
+
+		assert( _classes[ Classes - 1 ].size == MaxBlockSize );
+	}
+
+	MmapPool::~MmapPool()
+	{
+		while( _regions != 0 )
+		{
+			Region* region = _regions;
+			_regions = region->next;
+			_policy.unmap( region, RegionSize );
+		}
+	}
+
+	void* MmapPool::allocate( size_t bytes )
+	{
+		if( bytes > MaxBlockSize )
+		{
+			return _policy.map( bytes );
+		}
+
+		unsigned int index = _classOf( bytes );
+
+		MmapPoolLock lock( _mutex, _synchronized );
+
+		Region* region = _classes[ index ].partial;
+		if( region == 0 )
+		{
+			region = _mapRegion( index );
+		}
+
+		void* block = 0;
+		if( region->free != 0 )
+		{
+			block = region->free;
+			region->free = region->free->next;
+		}
+		else
+		{
+			block = region->untouched;
+			region->untouched += _classes[ index ].size;
+		}
+
+		++region->live;
+		++_live;
+
+		if( region->free == 0 && region->untouched == region->end )
+		{
+			_unlinkPartial( region );
+		}
+
+		return block;
+	}
+
+	void MmapPool::deallocate( void* pointer, size_t bytes )
+	{
+		if( bytes > MaxBlockSize )
+		{
+			_policy.unmap( pointer, bytes );
+			return;
+		}
+
+		Region* region = reinterpret_cast< Region* >(
+			reinterpret_cast< uintptr_t >( pointer )
+			& ~uintptr_t( RegionSize - 1 ) );
+
+		MmapPoolLock lock( _mutex, _synchronized );
+
+		FreeBlock* block = static_cast< FreeBlock* >( pointer );
+		block->next = region->free;
+		region->free = block;
+
+		--region->live;
+		--_live;
+
+		if( !region->partial )
+		{
+			_linkPartial( region );
+		}
+
+		// Keep the last region with free space to avoid mapping and
+		//  unmapping one over and over at the edge
+		if( region->live == 0 && ( region->nextPartial != 0
+			|| region->previousPartial != 0 ) )
+		{
+			_unmapRegion( region );
+		}
+	}
+
+	size_t MmapPool::blockSize( size_t bytes )
+	{
+		if( bytes > MaxBlockSize )
+		{
+			return bytes;
+		}
+
+		return _classSize( _classOf( bytes ) );
+	}
+
+	size_t MmapPool::regions()
+	{
+		MmapPoolLock lock( _mutex, _synchronized );
+		return _regionCount;
+	}
+
+	size_t MmapPool::live()
+	{
+		MmapPoolLock lock( _mutex, _synchronized );
+		return _live;
+	}
+
+	bool MmapPool::synchronized() const
+	{
+		return _synchronized;
+	}
+
+	MmapPolicy& MmapPool::policy()
+	{
+		return _policy;
+	}
+
+}
+
+#endif
+
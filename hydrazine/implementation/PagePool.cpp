@@ -0,0 +1,257 @@
+/*!
+	\file PagePool.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the PagePool class
+*/
+
+#ifndef PAGE_POOL_CPP_INCLUDED
+#define PAGE_POOL_CPP_INCLUDED
+
+#include <hydrazine/interface/PagePool.h>
+#include <hydrazine/interface/debug.h>
+
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <cassert>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	/*! \brief Lock an arena only if the pool is shared */
+	class ArenaLock
+	{
+		private:
+			boost::mutex& _mutex;
+			bool _locked;
+
+		public:
+			ArenaLock( boost::mutex& mutex, bool locked ) :
+				_mutex( mutex ), _locked( locked )
+			{
+				if( _locked )
+				{
+					_mutex.lock();
+				}
+			}
+
+			~ArenaLock()
+			{
+				if( _locked )
+				{
+					_mutex.unlock();
+				}
+			}
+	};
+
+	const unsigned int PagePool::Arenas;
+	const size_t PagePool::MinChunkSize;
+	const size_t PagePool::MinChunkBlocks;
+	const size_t PagePool::Alignment;
+
+	static std::atomic< unsigned int > nextArena( 0 );
+	static thread_local unsigned int threadArena = nextArena++;
+
+	PagePool::SizeClass::SizeClass( size_t s ) : size( s ), free( 0 ),
+		next( 0 ), end( 0 ), live( 0 )
+	{
+
+	}
+
+	PagePool::Arena& PagePool::_arena()
+	{
+		if( !_synchronized )
+		{
+			return _arenas[ 0 ];
+		}
+		return _arenas[ threadArena % Arenas ];
+	}
+
+	size_t PagePool::_round( size_t bytes )
+	{
+		bytes = std::max( bytes, sizeof( FreeBlock ) );
+		return ( bytes + Alignment - 1 ) & ~( Alignment - 1 );
+	}
+
+	PagePool::SizeClass& PagePool::_class( Arena& arena, size_t size )
+	{
+		for( SizeClassVector::iterator sizeClass = arena.classes.begin();
+			sizeClass != arena.classes.end(); ++sizeClass )
+		{
+			if( sizeClass->size == size )
+			{
+				return *sizeClass;
+			}
+		}
+
+		report( "Adding size class " << size );
+		arena.classes.push_back( SizeClass( size ) );
+		return arena.classes.back();
+	}
+
+	void* PagePool::_allocate( SizeClass& sizeClass )
+	{
+		++sizeClass.live;
+
+		if( sizeClass.free != 0 )
+		{
+			FreeBlock* block = sizeClass.free;
+			sizeClass.free = block->next;
+			return block;
+		}
+
+		if( sizeClass.next == sizeClass.end )
+		{
+			size_t blocks = std::max( MinChunkBlocks,
+				MinChunkSize / sizeClass.size );
+			size_t bytes = blocks * sizeClass.size;
+
+			report( "Allocating a " << bytes << " byte chunk for size class "
+				<< sizeClass.size );
+
+			char* chunk = static_cast< char* >( ::operator new( bytes ) );
+			sizeClass.chunks.push_back( chunk );
+			sizeClass.next = chunk;
+			sizeClass.end = chunk + bytes;
+		}
+
+		void* block = sizeClass.next;
+		sizeClass.next += sizeClass.size;
+		return block;
+	}
+
+	void PagePool::_release( SizeClass& sizeClass )
+	{
+		for( std::vector< char* >::iterator chunk = sizeClass.chunks.begin();
+			chunk != sizeClass.chunks.end(); ++chunk )
+		{
+			::operator delete( *chunk );
+		}
+
+		sizeClass.chunks.clear();
+		sizeClass.free = 0;
+		sizeClass.next = 0;
+		sizeClass.end = 0;
+		sizeClass.live = 0;
+	}
+
+	PagePool::PagePool( bool s ) : _synchronized( s )
+	{
+
+	}
+
+	PagePool::~PagePool()
+	{
+		for( unsigned int i = 0; i < Arenas; ++i )
+		{
+			for( SizeClassVector::iterator
+				sizeClass = _arenas[ i ].classes.begin();
+				sizeClass != _arenas[ i ].classes.end(); ++sizeClass )
+			{
+				_release( *sizeClass );
+			}
+		}
+	}
+
+	void* PagePool::allocate( size_t bytes )
+	{
+		Arena& arena = _arena();
+		ArenaLock lock( arena.mutex, _synchronized );
+		return _allocate( _class( arena, _round( bytes ) ) );
+	}
+
+	void PagePool::deallocate( void* pointer, size_t bytes )
+	{
+		Arena& arena = _arena();
+		ArenaLock lock( arena.mutex, _synchronized );
+
+		SizeClass& sizeClass = _class( arena, _round( bytes ) );
+
+		// Blocks freed by another thread migrate to its arena, so the
+		// count of one arena may wrap below zero, only the sum
+		// over every arena is meaningful
+		--sizeClass.live;
+
+		FreeBlock* block = static_cast< FreeBlock* >( pointer );
+		block->next = sizeClass.free;
+		sizeClass.free = block;
+	}
+
+	void PagePool::release( size_t bytes )
+	{
+		size_t size = _round( bytes );
+
+		for( unsigned int i = 0; i < Arenas; ++i )
+		{
+			ArenaLock lock( _arenas[ i ].mutex, _synchronized );
+
+			for( SizeClassVector::iterator
+				sizeClass = _arenas[ i ].classes.begin();
+				sizeClass != _arenas[ i ].classes.end(); ++sizeClass )
+			{
+				if( sizeClass->size == size )
+				{
+					_release( *sizeClass );
+				}
+			}
+		}
+	}
+
+	size_t PagePool::live( size_t bytes )
+	{
+		size_t size = _round( bytes );
+		size_t count = 0;
+
+		for( unsigned int i = 0; i < Arenas; ++i )
+		{
+			ArenaLock lock( _arenas[ i ].mutex, _synchronized );
+
+			for( SizeClassVector::iterator
+				sizeClass = _arenas[ i ].classes.begin();
+				sizeClass != _arenas[ i ].classes.end(); ++sizeClass )
+			{
+				if( sizeClass->size == size )
+				{
+					count += sizeClass->live;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	size_t PagePool::chunks()
+	{
+		size_t count = 0;
+
+		for( unsigned int i = 0; i < Arenas; ++i )
+		{
+			ArenaLock lock( _arenas[ i ].mutex, _synchronized );
+
+			for( SizeClassVector::iterator
+				sizeClass = _arenas[ i ].classes.begin();
+				sizeClass != _arenas[ i ].classes.end(); ++sizeClass )
+			{
+				count += sizeClass->chunks.size();
+			}
+		}
+
+		return count;
+	}
+
+	bool PagePool::synchronized() const
+	{
+		return _synchronized;
+	}
+
+}
+
+#endif
+
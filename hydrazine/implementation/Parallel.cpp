@@ -0,0 +1,25 @@
+/*!
+	\file Parallel.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the parallel algorithms
+*/
+
+#ifndef PARALLEL_CPP_INCLUDED
+#define PARALLEL_CPP_INCLUDED
+
+#include <hydrazine/interface/Parallel.h>
+
+namespace hydrazine
+{
+
+	ThreadPool& parallelPool()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+}
+
+#endif
+
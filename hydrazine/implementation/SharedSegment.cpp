@@ -0,0 +1,403 @@
+/*!
+	\file SharedSegment.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the SharedSegment class
+*/
+
+#ifndef SHARED_SEGMENT_CPP_INCLUDED
+#define SHARED_SEGMENT_CPP_INCLUDED
+
+#include <hydrazine/interface/SharedSegment.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/interface/debug.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <new>
+#include <sstream>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	/*! \brief "HYDRSHMS" read as a little endian word */
+	static const uint64_t Magic = 0x534d485352445948ULL;
+	static const uint64_t FormatVersion = 1;
+
+	const SharedSegment::Offset SharedSegment::Null;
+	const unsigned int SharedSegment::Roots;
+	const size_t SharedSegment::Alignment;
+	const unsigned int SharedSegment::Classes;
+
+	static size_t pageSize()
+	{
+		static const size_t size = sysconf( _SC_PAGESIZE );
+		return size;
+	}
+
+	static size_t roundUp( size_t bytes, size_t multiple )
+	{
+		return ( bytes + multiple - 1 ) / multiple * multiple;
+	}
+
+	void SharedSegment::_fail( const std::string& message ) const
+	{
+		throw Exception( message + " shared segment '" + _path + "': "
+			+ std::strerror( errno ) );
+	}
+
+	void SharedSegment::_invalid( const std::string& message ) const
+	{
+		throw Exception( "Shared segment '" + _path + "' " + message );
+	}
+
+	void SharedSegment::_attach( size_t bytes )
+	{
+		struct stat status;
+		if( fstat( _file, &status ) != 0 )
+		{
+			_fail( "Could not stat" );
+		}
+
+		bool create = status.st_size == 0;
+		Header header;
+
+		if( create )
+		{
+			bytes = roundUp( std::max( bytes, sizeof( Header ) ),
+				pageSize() );
+
+			if( ftruncate( _file, bytes ) != 0 )
+			{
+				_fail( "Could not size" );
+			}
+
+			header.base = 0;
+			header.size = bytes;
+		}
+		else
+		{
+			if( size_t( status.st_size ) < sizeof( Header ) || pread( _file,
+				&header, sizeof( Header ), 0 ) != sizeof( Header ) )
+			{
+				_invalid( "is truncated" );
+			}
+			if( header.magic != Magic )
+			{
+				_invalid( "is not a shared segment" );
+			}
+			if( header.version != FormatVersion )
+			{
+				_invalid( "has an unsupported format version" );
+			}
+			if( header.size > size_t( status.st_size ) )
+			{
+				_invalid( "is truncated" );
+			}
+		}
+
+		if( header.size > _capacity )
+		{
+			_invalid( "does not fit in the reserved address space" );
+		}
+
+		// Reserve the whole capacity so that growing never moves blocks,
+		//  asking for the address the segment was created at
+		void* reserved = mmap( reinterpret_cast< void* >( header.base ),
+			_capacity, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+		if( reserved == MAP_FAILED )
+		{
+			_fail( "Could not reserve address space for" );
+		}
+
+		_base = static_cast< char* >( reserved );
+		_mapped = 0;
+
+		if( mmap( _base, header.size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, _file, 0 ) == MAP_FAILED )
+		{
+			_fail( "Could not map" );
+		}
+
+		_mapped = header.size;
+
+		if( create )
+		{
+			Header& created = _header();
+			created.magic = Magic;
+			created.version = FormatVersion;
+			created.base = reinterpret_cast< uintptr_t >( _base );
+			created.size = _mapped;
+			created.top = roundUp( sizeof( Header ), 64 );
+			std::memset( created.free, 0, sizeof( created.free ) );
+			std::memset( created.roots, 0, sizeof( created.roots ) );
+		}
+
+		_relocated = _header().base != reinterpret_cast< uintptr_t >( _base );
+
+		report( ( create ? "Created " : "Attached " ) << _path << " with "
+			<< _mapped << " bytes at " << ( void* ) _base
+			<< ( _relocated ? ", relocated" : "" ) );
+	}
+
+	void SharedSegment::_grow( Offset bytes )
+	{
+		Header& header = _header();
+		Offset size = header.size;
+
+		while( size < bytes )
+		{
+			size *= 2;
+		}
+
+		if( size > _capacity )
+		{
+			throw std::bad_alloc();
+		}
+
+		report( "Growing " << _path << " to " << size << " bytes" );
+
+		if( ftruncate( _file, size ) != 0 )
+		{
+			_fail( "Could not grow" );
+		}
+
+		header.size = size;
+		remap();
+	}
+
+	SharedSegment::Header& SharedSegment::_header() const
+	{
+		return *reinterpret_cast< Header* >( _base );
+	}
+
+	unsigned int SharedSegment::_classOf( size_t bytes )
+	{
+		unsigned int index = 4;
+		while( ( size_t( 1 ) << index ) < bytes )
+		{
+			++index;
+		}
+		return index;
+	}
+
+	SharedSegment::SharedSegment( const std::string& path, size_t bytes,
+		size_t capacity ) : _path( path ), _file( -1 ), _base( 0 ),
+		_mapped( 0 ), _capacity( roundUp( capacity, pageSize() ) ),
+		_relocated( false )
+	{
+		_file = ::open( _path.c_str(), O_RDWR | O_CREAT, 0644 );
+
+		if( _file < 0 )
+		{
+			_fail( "Could not open" );
+		}
+
+		try
+		{
+			_attach( bytes );
+		}
+		catch( ... )
+		{
+			_close();
+			throw;
+		}
+	}
+
+	SharedSegment::SharedSegment( size_t bytes, size_t capacity ) :
+		_path( "anonymous" ), _file( -1 ), _base( 0 ), _mapped( 0 ),
+		_capacity( roundUp( capacity, pageSize() ) ), _relocated( false )
+	{
+		#ifdef SYS_memfd_create
+		_file = syscall( SYS_memfd_create, "hydrazine", 0 );
+		#endif
+
+		// Without memory files use a temporary file that has no name
+		if( _file < 0 )
+		{
+			char name[] = "/tmp/hydrazine-segment-XXXXXX";
+			_file = mkstemp( name );
+			if( _file >= 0 )
+			{
+				unlink( name );
+			}
+		}
+
+		if( _file < 0 )
+		{
+			_fail( "Could not create" );
+		}
+
+		try
+		{
+			_attach( bytes );
+		}
+		catch( ... )
+		{
+			_close();
+			throw;
+		}
+	}
+
+	SharedSegment::~SharedSegment()
+	{
+		_close();
+	}
+
+	void SharedSegment::_close()
+	{
+		if( _base != 0 )
+		{
+			munmap( _base, _capacity );
+			_base = 0;
+		}
+		if( _file >= 0 )
+		{
+			::close( _file );
+			_file = -1;
+		}
+	}
+
+	void* SharedSegment::allocate( size_t bytes )
+	{
+		remap();
+
+		Header& header = _header();
+		unsigned int index = _classOf( bytes );
+
+		if( index >= Classes )
+		{
+			throw std::bad_alloc();
+		}
+
+		Offset block = header.free[ index ];
+
+		if( block != Null )
+		{
+			header.free[ index ] = *static_cast< Offset* >(
+				address( block ) );
+			return address( block );
+		}
+
+		Offset size = Offset( 1 ) << index;
+
+		if( header.top + size > header.size )
+		{
+			_grow( header.top + size );
+		}
+
+		block = header.top;
+		header.top += size;
+
+		return address( block );
+	}
+
+	void SharedSegment::deallocate( void* block, size_t bytes )
+	{
+		Header& header = _header();
+		unsigned int index = _classOf( bytes );
+
+		*static_cast< Offset* >( block ) = header.free[ index ];
+		header.free[ index ] = offset( block );
+	}
+
+	void SharedSegment::flush()
+	{
+		if( msync( _base, _mapped, MS_SYNC ) != 0 )
+		{
+			_fail( "Could not flush" );
+		}
+	}
+
+	void SharedSegment::remap()
+	{
+		Offset size = _header().size;
+
+		if( size <= _mapped )
+		{
+			return;
+		}
+
+		if( size > _capacity )
+		{
+			_invalid( "grew past the reserved address space" );
+		}
+
+		if( mmap( _base + _mapped, size - _mapped, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, _file, _mapped ) == MAP_FAILED )
+		{
+			_fail( "Could not extend the mapping of" );
+		}
+
+		_mapped = size;
+	}
+
+	SharedSegment::Offset SharedSegment::offset( const void* a ) const
+	{
+		return a == 0 ? Null : static_cast< const char* >( a ) - _base;
+	}
+
+	void* SharedSegment::address( Offset o ) const
+	{
+		return o == Null ? 0 : _base + o;
+	}
+
+	SharedSegment::Offset& SharedSegment::root( unsigned int index )
+	{
+		assert( index < Roots );
+		return _header().roots[ index ];
+	}
+
+	void* SharedSegment::base() const
+	{
+		return _base;
+	}
+
+	size_t SharedSegment::size() const
+	{
+		return _header().size;
+	}
+
+	size_t SharedSegment::used() const
+	{
+		return _header().top;
+	}
+
+	bool SharedSegment::relocated() const
+	{
+		return _relocated;
+	}
+
+	const std::string& SharedSegment::path() const
+	{
+		return _path;
+	}
+
+	std::string SharedSegment::descriptorPath() const
+	{
+		std::stringstream stream;
+		stream << "/proc/" << getpid() << "/fd/" << _file;
+		return stream.str();
+	}
+
+}
+
+#endif
+
@@ -13,6 +13,9 @@
 
 #include <configure.h>
 
+#include <vector>
+#include <algorithm>
+
 #ifdef _WIN32
 	#include <windows.h>
 #elif __APPLE__
@@ -89,6 +92,115 @@ namespace hydrazine
 		#endif
 	}
 	
+	unsigned int getCacheLineSize()
+	{
+		#ifdef _WIN32
+			DWORD bytes = 0;
+			GetLogicalProcessorInformation(0, &bytes);
+			std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> information(
+				bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+			if(information.empty() || 
+				!GetLogicalProcessorInformation(&information[0], &bytes))
+			{
+				return 0;
+			}
+			for(unsigned int i = 0; i < information.size(); ++i)
+			{
+				if(information[i].Relationship == RelationCache
+					&& information[i].Cache.Level == 1)
+				{
+					return information[i].Cache.LineSize;
+				}
+			}
+			return 0;
+		#elif __APPLE__
+			int64_t size = 0;
+			size_t length = sizeof(size);
+			if(sysctlbyname("hw.cachelinesize", &size, &length, NULL, 0)
+				!= 0)
+			{
+				return 0;
+			}
+			return size;
+		#elif __GNUC__
+			long size = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+			return size > 0 ? size : 0;
+		#endif
+	}
+
+	long long unsigned int getDataCacheSize(unsigned int level)
+	{
+		#ifdef _WIN32
+			DWORD bytes = 0;
+			GetLogicalProcessorInformation(0, &bytes);
+			std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> information(
+				bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+			if(information.empty() || 
+				!GetLogicalProcessorInformation(&information[0], &bytes))
+			{
+				return 0;
+			}
+			for(unsigned int i = 0; i < information.size(); ++i)
+			{
+				if(information[i].Relationship == RelationCache
+					&& information[i].Cache.Level == level
+					&& information[i].Cache.Type != CacheInstruction)
+				{
+					return information[i].Cache.Size;
+				}
+			}
+			return 0;
+		#elif __APPLE__
+			const char* names[] = {"hw.l1dcachesize", "hw.l2cachesize",
+				"hw.l3cachesize"};
+			if(level < 1 || level > 3)
+			{
+				return 0;
+			}
+			int64_t size = 0;
+			size_t length = sizeof(size);
+			if(sysctlbyname(names[level - 1], &size, &length, NULL, 0) != 0)
+			{
+				return 0;
+			}
+			return size;
+		#elif __GNUC__
+			const int names[] = {_SC_LEVEL1_DCACHE_SIZE, 
+				_SC_LEVEL2_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE};
+			if(level < 1 || level > 3)
+			{
+				return 0;
+			}
+			long size = sysconf(names[level - 1]);
+			return size > 0 ? size : 0;
+		#endif
+	}
+	
+	unsigned int getBTreePageSize()
+	{
+		long long unsigned int line = getCacheLineSize();
+		long long unsigned int l1 = getDataCacheSize(1);
+		long long unsigned int l2 = getDataCacheSize(2);
+		
+		if(line == 0) line = 64;
+		if(l1 == 0) l1 = 32768;
+		if(l2 == 0) l2 = 8 * l1;
+		
+		// A lookup touches one page per level.  Leave room in L1 for the 
+		//  pages near the root of a few trees, but span enough cache lines
+		//  that the prefetcher streams in most of a page after the first
+		//  miss.  Pages that are a large fraction of L2 would evict each 
+		//  other during a scan.
+		long long unsigned int limit = std::min(l1 / 32, l2 / 256);
+		long long unsigned int size = 8 * line;
+		while(2 * size <= limit)
+		{
+			size *= 2;
+		}
+		
+		return size;
+	}
+	
 	bool isAnOpenGLContextAvailable()
 	{
 		#ifdef _WIN32
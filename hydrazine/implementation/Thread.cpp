@@ -29,91 +29,318 @@
 namespace hydrazine
 {
 
-	Thread::Queue::Queue()
+	const size_t Thread::Queue::Capacity;
+	const size_t Thread::Queue::Nil;
+
+	Thread::Queue::Mailbox::Mailbox() : head( Nil ), tail( Nil )
 	{
 	
 	}
+
+	Thread::Queue::Queue() : _ring( new Cell[ Capacity ] ), _enqueue( 0 ),
+		_dequeue( 0 ), _spilled( false ), _free( Nil ), _oldest( Nil ),
+		_newest( Nil ), _sleeping( false )
+	{
+		for( size_t i = 0; i < Capacity; ++i )
+		{
+			_ring[ i ].sequence.store( i, std::memory_order_relaxed );
+		}
+		
+		// A receiver that falls a ring behind should not allocate yet
+		_overflow.reserve( Capacity );
+		_spills.reserve( Capacity );
+		_slots.reserve( 2 * Capacity );
+	}
 	
 	Thread::Queue::~Queue()
 	{
-		assert( _queue.empty() );	
-	
+		assert( !_ready() );
+		assert( _oldest == Nil );
+
+		delete[] _ring;
 	}
-	
-	void Thread::Queue::push( const Message& message )
+
+	bool Thread::Queue::_ready() const
 	{
-		_mutex.lock();
-		
-		_queue.push_back( message );
+		return _ring[ _dequeue & ( Capacity - 1 ) ].sequence.load(
+			std::memory_order_acquire ) == _dequeue + 1
+			|| _spilled.load( std::memory_order_relaxed );
+	}
+
+	void Thread::Queue::_drain()
+	{
+		while( true )
+		{
+			while( _ring[ _dequeue & ( Capacity - 1 ) ].sequence.load(
+				std::memory_order_acquire ) == _dequeue + 1 )
+			{
+				Cell& cell = _ring[ _dequeue & ( Capacity - 1 ) ];
+				_store( cell.message );
+				cell.sequence.store( _dequeue + Capacity,
+					std::memory_order_release );
+				++_dequeue;
+			}
+
+			// Spills were sent after the messages of their source in the
+			//  ring, so they wait for every claimed cell to be drained, and
+			//  senders use the ring again only once they are taken
+			if( _dequeue != _enqueue.load( std::memory_order_acquire ) )
+			{
+				break;
+			}
+
+			if( !_spilled.load( std::memory_order_acquire ) )
+			{
+				break;
+			}
+
+			// Both lists keep their capacity, so the swap does not
+			//  allocate, and senders only wait for it
+			{
+				boost::unique_lock< boost::mutex > lock( _overflowMutex );
+				_overflow.swap( _spills );
+				_spilled.store( false, std::memory_order_relaxed );
+			}
+
+			for( MessageVector::const_iterator message = _spills.begin();
+				message != _spills.end(); ++message )
+			{
+				_store( *message );
+			}
+
+			_spills.clear();
+		}
+	}
+
+	void Thread::Queue::_spill( const Message& message )
+	{
+		boost::unique_lock< boost::mutex > lock( _overflowMutex );
+		_overflow.push_back( message );
+		_spilled.store( true, std::memory_order_release );
+	}
+
+	void Thread::Queue::_store( const Message& message )
+	{
+		assert( message.type != Message::Invalid );
+		assert( message.source != THREAD_ANY_ID );
+
+		size_t index = _free;
 		
-		_condition.notify_all();
-		_mutex.unlock();
+		if( index == Nil )
+		{
+			index = _slots.size();
+			_slots.push_back( Slot() );
+		}
+		else
+		{
+			_free = _slots[ index ].next;
+		}
+
+		Slot& slot = _slots[ index ];
+		slot.message = message;
+		slot.next = Nil;
+		slot.older = _newest;
+		slot.newer = Nil;
+
+		if( _newest != Nil )
+		{
+			_slots[ _newest ].newer = index;
+		}
+		else
+		{
+			_oldest = index;
+		}
+		_newest = index;
+
+		// Mailboxes are nodes of the map, so pointers to them stay valid,
+		//  and they are never erased, so only the first message from a
+		//  source inserts one
+		Mailbox& mailbox = _mailboxes[ message.source ];
+		slot.mailbox = &mailbox;
+
+		if( mailbox.tail != Nil )
+		{
+			_slots[ mailbox.tail ].next = index;
+		}
+		else
+		{
+			mailbox.head = index;
+		}
+		mailbox.tail = index;
+	}
+
+	size_t Thread::Queue::_find( Id id ) const
+	{
+		if( id == THREAD_ANY_ID )
+		{
+			return _oldest;
+		}
+
+		MailboxMap::const_iterator mailbox = _mailboxes.find( id );
+
+		if( mailbox == _mailboxes.end() )
+		{
+			return Nil;
+		}
+
+		return mailbox->second.head;
+	}
+
+	Thread::Message Thread::Queue::_take( size_t index )
+	{
+		Slot& slot = _slots[ index ];
+		Mailbox& mailbox = *slot.mailbox;
+
+		// The oldest message overall is also the oldest from its source
+		assert( mailbox.head == index );
+
+		mailbox.head = slot.next;
+		if( mailbox.head == Nil )
+		{
+			mailbox.tail = Nil;
+		}
+
+		if( slot.older != Nil )
+		{
+			_slots[ slot.older ].newer = slot.newer;
+		}
+		else
+		{
+			_oldest = slot.newer;
+		}
+
+		if( slot.newer != Nil )
+		{
+			_slots[ slot.newer ].older = slot.older;
+		}
+		else
+		{
+			_newest = slot.older;
+		}
+
+		slot.next = _free;
+		_free = index;
+
+		return slot.message;
+	}
+
+	void Thread::Queue::_sleep()
+	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		// A sender that misses the flag published its message before the
+		//  check below, one that sees it waits for the lock to notify
+		_sleeping.store( true );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		while( !_ready() )
+		{
+			_condition.wait( lock );
+		}
+
+		_sleeping.store( false, std::memory_order_relaxed );
 	}
 	
-	Thread::Message Thread::Queue::pull( Id id )
+	void Thread::Queue::push( const Message& message )
 	{
-		Message result;
-		result.type = Message::Invalid;
-		
-		// lock is implied
-		boost::unique_lock<boost::mutex> lock(_mutex);
-		
-		while( result.type == Message::Invalid )
+		size_t position = _enqueue.load( std::memory_order_relaxed );
+		Cell* cell = 0;
+
+		while( true )
 		{
-			for( MessageQueue::iterator message = _queue.begin(); 
-				message != _queue.end(); ++message )
+			// Once anything spilled, keep spilling until the receiver
+			//  empties it, so later messages can not pass earlier ones
+			if( _spilled.load( std::memory_order_acquire ) )
 			{
-				if( _compare( message->source, id ) )
+				cell = 0;
+				break;
+			}
+
+			cell = &_ring[ position & ( Capacity - 1 ) ];
+			size_t sequence = cell->sequence.load(
+				std::memory_order_acquire );
+			
+			if( sequence == position )
+			{
+				if( _enqueue.compare_exchange_weak( position, position + 1,
+					std::memory_order_relaxed ) )
 				{
-					assert( message->type != Message::Invalid );
-					result = *message;
-					_queue.erase( message );
 					break;
 				}
 			}
-			
-			if( result.type == Message::Invalid )
+			else if( sequence < position )
 			{
-				_condition.wait( lock );
+				// Full, the receiver is not receiving
+				cell = 0;
+				break;
+			}
+			else
+			{
+				position = _enqueue.load( std::memory_order_relaxed );
 			}
 		}
+
+		if( cell != 0 )
+		{
+			cell->message = message;
+			cell->sequence.store( position + 1, std::memory_order_release );
+		}
+		else
+		{
+			_spill( message );
+		}
+
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		if( _sleeping.load( std::memory_order_relaxed ) )
+		{
+			boost::unique_lock< boost::mutex > lock( _mutex );
+			_condition.notify_one();
+		}
+	}
+	
+	Thread::Message Thread::Queue::pull( Id id )
+	{
+		boost::unique_lock< boost::mutex > lock( _receiver );
+
+		while( true )
+		{
+			_drain();
 			
-		lock.unlock();
-		
-		return result;
+			size_t index = _find( id );
+			
+			if( index != Nil )
+			{
+				return _take( index );
+			}
+			
+			_sleep();
+		}
 	}
 
 	bool Thread::Queue::test( Id& id, bool block )
 	{
-		bool found = false;
-	
-		// lock is implied
-		boost::unique_lock<boost::mutex> lock( _mutex );
+		boost::unique_lock< boost::mutex > lock( _receiver );
 		
-		do
+		while( true )
 		{
-			for( MessageQueue::iterator message = _queue.begin(); 
-					message != _queue.end(); ++message )
+			_drain();
+			
+			size_t index = _find( id );
+			
+			if( index != Nil )
 			{
-				if( _compare( message->source, id ) )
-				{
-					assert( message->type != Message::Invalid );
-					id = message->source;
-					found = true;
-					break;
-				}
+				id = _slots[ index ].message.source;
+				return true;
 			}
 			
-			if( block && !found )
+			if( !block )
 			{
-				_condition.wait( lock );
+				return false;
 			}
+			
+			_sleep();
 		}
-		while( block && !found );
-		
-		lock.unlock();
-		
-		return found;
 	}
 
 	Thread::Group::Group()
@@ -133,6 +360,7 @@ namespace hydrazine
 		assert( _threads.count( thread->id() ) == 0 );
 	
 		_threads.insert( std::make_pair( thread->id(), thread ) );
+		thread->_member = _barrier.join();
 	
 		_mutex.unlock();
 	}
@@ -144,6 +372,8 @@ namespace hydrazine
 		assert( _threads.count( thread->id() ) != 0 );
 	
 		_threads.erase( thread->id() );
+		_barrier.leave( thread->_member );
+		thread->_member = 0;
 	
 		_mutex.unlock();
 	}
@@ -198,13 +428,20 @@ namespace hydrazine
 		return _controllerQueue.test( source, block );	
 	}
 
+	void Thread::Group::barrier( Thread* thread )
+	{
+		_barrier.wait( thread->_member );
+	}
+
 	bool Thread::Group::empty() const
 	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
 		return _threads.empty();
 	}
 
 	unsigned int Thread::Group::size() const
 	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
 		return _threads.size();
 	}
 
@@ -228,6 +465,12 @@ namespace hydrazine
 		return _threadQueue.test( id, null );
 	}
 
+	void Thread::barrier()
+	{
+		report( "Thread " << _id << " waiting at the barrier." );
+		_group->barrier( this );
+	}
+
 	void Thread::threadSend( MessageData data, Thread::Id id )
 	{
 
@@ -351,6 +594,7 @@ namespace hydrazine
 		
 			_group->remove( this );
 			_group = new Group;
+			_group->add( this );
 		}
 	}
 
@@ -0,0 +1,466 @@
+/*!
+	\file ThreadPool.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the ThreadPool class
+*/
+
+#ifndef THREAD_POOL_CPP_INCLUDED
+#define THREAD_POOL_CPP_INCLUDED
+
+#include <hydrazine/interface/ThreadPool.h>
+#include <hydrazine/interface/SystemCompatibility.h>
+#include <hydrazine/interface/debug.h>
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	/*! \brief The tasks a deque holds before it grows */
+	static const int64_t InitialDequeSize = 256;
+
+	const unsigned int ThreadPool::Spins;
+
+	thread_local ThreadPool::Worker* ThreadPool::_current = 0;
+
+	ThreadPool::Task::Task( ThreadPool* p ) : pool( p ), references( 1 ),
+		done( false ), waiting( false )
+	{
+
+	}
+
+	ThreadPool::Task::~Task()
+	{
+
+	}
+
+	ThreadPool::Array::Array( int64_t size ) : mask( size - 1 ),
+		tasks( new std::atomic< Task* >[ size ] )
+	{
+		assert( ( size & mask ) == 0 );
+	}
+
+	ThreadPool::Array::~Array()
+	{
+		delete[] tasks;
+	}
+
+	ThreadPool::Task* ThreadPool::Array::get( int64_t index ) const
+	{
+		return tasks[ index & mask ].load( std::memory_order_relaxed );
+	}
+
+	void ThreadPool::Array::put( int64_t index, Task* task )
+	{
+		tasks[ index & mask ].store( task, std::memory_order_relaxed );
+	}
+
+	ThreadPool::Array* ThreadPool::Deque::_grow( Array* array,
+		int64_t bottom, int64_t top )
+	{
+		Array* bigger = new Array( 2 * ( array->mask + 1 ) );
+
+		for( int64_t i = top; i < bottom; ++i )
+		{
+			bigger->put( i, array->get( i ) );
+		}
+
+		report( "Growing a deque to " << ( bigger->mask + 1 ) << " tasks." );
+
+		_retired.push_back( array );
+		_array.store( bigger, std::memory_order_release );
+
+		return bigger;
+	}
+
+	ThreadPool::Deque::Deque() : _top( 0 ), _bottom( 0 ),
+		_array( new Array( InitialDequeSize ) )
+	{
+
+	}
+
+	ThreadPool::Deque::~Deque()
+	{
+		delete _array.load();
+
+		for( std::vector< Array* >::iterator array = _retired.begin();
+			array != _retired.end(); ++array )
+		{
+			delete *array;
+		}
+	}
+
+	void ThreadPool::Deque::push( Task* task )
+	{
+		int64_t bottom = _bottom.load( std::memory_order_relaxed );
+		int64_t top = _top.load( std::memory_order_acquire );
+		Array* array = _array.load( std::memory_order_relaxed );
+
+		if( bottom - top > array->mask )
+		{
+			array = _grow( array, bottom, top );
+		}
+
+		array->put( bottom, task );
+		_bottom.store( bottom + 1, std::memory_order_release );
+	}
+
+	ThreadPool::Task* ThreadPool::Deque::take()
+	{
+		int64_t bottom = _bottom.load( std::memory_order_relaxed ) - 1;
+		Array* array = _array.load( std::memory_order_relaxed );
+
+		// Claim the bottom before looking at the top, a thief does the
+		//  opposite, so they cannot both miss each other
+		_bottom.store( bottom, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		int64_t top = _top.load( std::memory_order_relaxed );
+
+		Task* task = 0;
+
+		if( top <= bottom )
+		{
+			task = array->get( bottom );
+
+			if( top == bottom )
+			{
+				// The last task, thieves may be after it too
+				if( !_top.compare_exchange_strong( top, top + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed ) )
+				{
+					task = 0;
+				}
+
+				_bottom.store( bottom + 1, std::memory_order_relaxed );
+			}
+		}
+		else
+		{
+			_bottom.store( bottom + 1, std::memory_order_relaxed );
+		}
+
+		return task;
+	}
+
+	ThreadPool::Task* ThreadPool::Deque::steal()
+	{
+		int64_t top = _top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		int64_t bottom = _bottom.load( std::memory_order_acquire );
+
+		if( top >= bottom )
+		{
+			return 0;
+		}
+
+		Array* array = _array.load( std::memory_order_acquire );
+		Task* task = array->get( top );
+
+		if( !_top.compare_exchange_strong( top, top + 1,
+			std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			return 0;
+		}
+
+		return task;
+	}
+
+	bool ThreadPool::Deque::empty() const
+	{
+		int64_t top = _top.load( std::memory_order_acquire );
+		int64_t bottom = _bottom.load( std::memory_order_acquire );
+
+		return top >= bottom;
+	}
+
+	void ThreadPool::Worker::execute()
+	{
+		_current = this;
+
+		unsigned int idle = 0;
+
+		while( true )
+		{
+			Task* task = pool->_find( this );
+
+			if( task != 0 )
+			{
+				pool->_run( task );
+				idle = 0;
+				continue;
+			}
+
+			if( ++idle < Spins )
+			{
+				boost::this_thread::yield();
+				continue;
+			}
+
+			idle = 0;
+
+			if( !pool->_sleep( this ) )
+			{
+				break;
+			}
+		}
+
+		_current = 0;
+	}
+
+	void ThreadPool::_release( Task* task )
+	{
+		if( task->references.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+		{
+			delete task;
+		}
+	}
+
+	void ThreadPool::_push( Task* task )
+	{
+		if( inPool() )
+		{
+			_current->deque.push( task );
+		}
+		else
+		{
+			boost::unique_lock< boost::mutex > lock( _submittedMutex );
+
+			_submitted.push_back( task );
+			_hasSubmitted.store( true, std::memory_order_relaxed );
+		}
+
+		// A worker going to sleep counts itself before it looks for work
+		//  one last time, so one of the two sees the other
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		if( _sleeping.load( std::memory_order_relaxed ) > 0 )
+		{
+			boost::unique_lock< boost::mutex > lock( _mutex );
+			_idle.notify_one();
+		}
+	}
+
+	ThreadPool::Task* ThreadPool::_find( Worker* worker )
+	{
+		Task* task = 0;
+
+		if( worker != 0 )
+		{
+			task = worker->deque.take();
+
+			if( task != 0 )
+			{
+				return task;
+			}
+		}
+
+		if( _hasSubmitted.load( std::memory_order_acquire ) )
+		{
+			boost::unique_lock< boost::mutex > lock( _submittedMutex );
+
+			if( !_submitted.empty() )
+			{
+				task = _submitted.front();
+				_submitted.pop_front();
+			}
+
+			if( _submitted.empty() )
+			{
+				_hasSubmitted.store( false, std::memory_order_relaxed );
+			}
+
+			if( task != 0 )
+			{
+				return task;
+			}
+		}
+
+		unsigned int start = 0;
+
+		if( worker != 0 )
+		{
+			worker->seed ^= worker->seed << 13;
+			worker->seed ^= worker->seed >> 17;
+			worker->seed ^= worker->seed << 5;
+			start = worker->seed;
+		}
+
+		for( unsigned int i = 0; i < _workers.size(); ++i )
+		{
+			Worker* victim = _workers[ ( start + i ) % _workers.size() ];
+
+			if( victim == worker )
+			{
+				continue;
+			}
+
+			task = victim->deque.steal();
+
+			if( task != 0 )
+			{
+				return task;
+			}
+		}
+
+		return 0;
+	}
+
+	void ThreadPool::_run( Task* task )
+	{
+		task->run();
+
+		task->done.store( true, std::memory_order_release );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		if( task->waiting.load( std::memory_order_relaxed ) )
+		{
+			boost::unique_lock< boost::mutex > lock( _mutex );
+			_finished.notify_all();
+		}
+
+		_release( task );
+	}
+
+	void ThreadPool::_wait( Task* task )
+	{
+		Worker* worker = inPool() ? _current : 0;
+		unsigned int idle = 0;
+
+		while( !task->done.load( std::memory_order_acquire ) )
+		{
+			Task* other = _find( worker );
+
+			if( other != 0 )
+			{
+				_run( other );
+				idle = 0;
+				continue;
+			}
+
+			if( ++idle < Spins )
+			{
+				boost::this_thread::yield();
+				continue;
+			}
+
+			idle = 0;
+
+			// The task is running somewhere, sleep until it finishes and
+			//  then look for more work
+			boost::unique_lock< boost::mutex > lock( _mutex );
+
+			task->waiting.store( true );
+
+			if( !task->done.load() )
+			{
+				_finished.wait( lock );
+			}
+		}
+	}
+
+	bool ThreadPool::_sleep( Worker* worker )
+	{
+		boost::unique_lock< boost::mutex > lock( _mutex );
+
+		_sleeping.fetch_add( 1 );
+
+		bool work = false;
+
+		while( !work )
+		{
+			work = _hasSubmitted.load();
+
+			for( WorkerVector::iterator victim = _workers.begin();
+				victim != _workers.end() && !work; ++victim )
+			{
+				work = !( *victim )->deque.empty();
+			}
+
+			if( work || _stopping.load() )
+			{
+				break;
+			}
+
+			report( "Worker " << worker->id() << " going to sleep." );
+			_idle.wait( lock );
+		}
+
+		_sleeping.fetch_sub( 1 );
+
+		return work;
+	}
+
+	ThreadPool::ThreadPool( unsigned int threads ) : _hasSubmitted( false ),
+		_sleeping( 0 ), _stopping( false )
+	{
+		if( threads == 0 )
+		{
+			threads = std::max( getHardwareThreadCount(), 1u );
+		}
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			Worker* worker = new Worker;
+
+			worker->pool = this;
+			worker->seed = i + 1;
+
+			_workers.push_back( worker );
+		}
+
+		report( "Starting a pool of " << threads << " workers." );
+
+		for( WorkerVector::iterator worker = _workers.begin();
+			worker != _workers.end(); ++worker )
+		{
+			( *worker )->start();
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			boost::unique_lock< boost::mutex > lock( _mutex );
+
+			_stopping.store( true );
+			_idle.notify_all();
+		}
+
+		for( WorkerVector::iterator worker = _workers.begin();
+			worker != _workers.end(); ++worker )
+		{
+			( *worker )->join();
+		}
+
+		// Workers steal from each other until the last one stops
+		for( WorkerVector::iterator worker = _workers.begin();
+			worker != _workers.end(); ++worker )
+		{
+			delete *worker;
+		}
+
+		assert( _submitted.empty() );
+	}
+
+	unsigned int ThreadPool::size() const
+	{
+		return _workers.size();
+	}
+
+	bool ThreadPool::inPool() const
+	{
+		return _current != 0 && _current->pool == this;
+	}
+
+}
+
+#endif
+
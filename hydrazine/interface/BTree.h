@@ -11,6 +11,11 @@
 #include <hydrazine/interface/debug.h>
 #include <hydrazine/interface/macros.h>
 #include <hydrazine/interface/ValueCompare.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <hydrazine/interface/LeafLayout.h>
+#include <hydrazine/interface/BodyKeys.h>
+#include <hydrazine/interface/PoolAllocator.h>
+#include <hydrazine/interface/OrderStatistics.h>
 
 #ifdef REPORT_BASE
 #undef REPORT_BASE
@@ -19,23 +24,72 @@
 #define REPORT_BASE 1
 
 #include <stack>
+#include <vector>
 #include <cstring>
 #include <utility>
+#include <iterator>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <type_traits>
 
 namespace hydrazine
 {
 
+	/*!
+		\brief A tag promising that a range is sorted and has no duplicate
+			keys, which lets a BTree be built bottom up.
+	*/
+	struct sorted_unique_t {};
+	static const sorted_unique_t sorted_unique = sorted_unique_t();
+
+	/*!
+		\brief The ways that BTree::combine() can put two trees together.
+	*/
+	enum SetOperation
+	{
+		/*! \brief Keys in either tree, with values from the left one */
+		SetUnion,
+		/*! \brief Keys in both trees, with values from the left one */
+		SetIntersection,
+		/*! \brief Keys in the left tree but not the right one */
+		SetDifference,
+		/*! \brief Keys in either tree, with values from the right one */
+		SetMerge
+	};
+
 	/*!
 		\brief A Btree data structure providing the STL map interface.
+		
+		The Layout policy decides how the entries of a leaf are stored, see
+		LeafLayout.h.  The Statistics policy decides whether bodies count
+		the elements below each child, which nth(), rank(), and distance()
+		need, see OrderStatistics.h.
+
+		Pages are reference counted so that snapshot() can share them.  A
+		modification copies every shared page on the path that it changes.
+		Mutable iterators can change values too, so while a snapshot is
+		alive the non-const lookups copy the shared pages on the path to
+		the leaf they land in and to the one after it, begin() and rbegin()
+		copy the path to the first or last leaf, and a mutable iterator
+		copies the path to each shared leaf that it steps into.  end()
+		copies nothing until it is stepped back from.  Iterators into a
+		page that was copied no longer compare equal to ones taken
+		afterwards, use a const reference to the tree to walk it without
+		copying.  Mutable iterators taken before a snapshot must not be
+		written through after it.
 	*/
 	template< typename Key, typename Value, typename Compare = std::less<Key>, 
 		typename _Allocator = std::allocator< std::pair< const Key, 
-		Value > >, size_t PageSize = 1024 >
+		Value > >, size_t PageSize = 1024, 
+		typename Layout = PairedLeafLayout, 
+		typename Statistics = NoOrderStatistics >
 	class BTree
 	{
-		template< typename K, typename V, typename C, typename A, size_t P > 
+		template< typename K, typename V, typename C, typename A, size_t P,
+			typename L, typename S > 
 			friend std::ostream& operator<<( std::ostream&, 
-			const BTree< K, V, C, A, P >& );
+			const BTree< K, V, C, A, P, L, S >& );
 		public:
 			class Iterator;
 			class ConstIterator;
@@ -49,24 +103,37 @@ namespace hydrazine
 			typedef typename _Allocator::template rebind< value_type >::other
 				Allocator;
 
+		private:
+			typedef typename Layout::template Storage< key_type, mapped_type,
+				PageSize > LeafStorage;
+
 		public:
 			typedef BTree type;	
 			typedef Compare key_compare;
 			typedef Allocator allocator_type;
-			typedef typename Allocator::reference reference;
-			typedef typename Allocator::const_reference const_reference;
+			typedef typename LeafStorage::reference reference;
+			typedef typename LeafStorage::const_reference const_reference;
 			typedef Iterator iterator;
 			typedef ConstIterator const_iterator;
 			typedef typename Allocator::size_type size_type;
 			typedef typename Allocator::difference_type difference_type;
-			typedef typename Allocator::pointer pointer;
-			typedef typename Allocator::const_pointer const_pointer;
+			typedef typename LeafStorage::pointer pointer;
+			typedef typename LeafStorage::const_pointer const_pointer;
 			typedef std::reverse_iterator< iterator > reverse_iterator;
 			typedef std::reverse_iterator< const_iterator > 
 				const_reverse_iterator;
 			typedef std::pair< iterator, bool > insertion;
 			typedef ValueCompare< Compare, type > value_compare;
 
+		private:
+			/*! \brief The result of a lookup by a K that is not a key,
+				only defined if Compare is transparent */
+			template< typename K, typename Result >
+			class Lookup : public std::enable_if< 
+				IsTransparent< Compare, K >::value, Result >
+			{
+			};
+
 		private:
 			Allocator _allocator;
 			value_compare _compare;
@@ -78,16 +145,32 @@ namespace hydrazine
 			class Leaf;
 			
 		private:
-			typedef std::pair< Node*, size_type > StackElement;
-			typedef std::stack< StackElement > Stack;
+			typedef NodeSearch< key_type, key_compare > Search;
+			typedef BodyKeys< key_type, key_compare > KeyLayout;
 		
 		private:
 			static const size_type MaxNodes = MAX( 8, 
-				PageSize / ( sizeof( key_type ) + sizeof( mapped_type ) ) );
-			static const size_type MaxLeafs = MAX( 8, 
-				PageSize / ( sizeof( key_type ) + sizeof( Node* ) ) );
-			static const size_type MinNodes = MaxNodes / 2;
+				PageSize / ( KeyLayout::SlotSize + sizeof( Node* ) ) );
+			static const size_type MaxLeafs = LeafStorage::Capacity;
+			/*! \brief A body splits when it reaches MaxNodes keys and one
+				key moves up, so each half is left with at least this many */
+			static const size_type MinNodes = ( MaxNodes - 1 ) / 2;
 			static const size_type MinLeafs = MaxLeafs / 2;
+			/*! \brief Every node below the root has at least four children
+				or entries, so the height is bounded by log4 of the largest
+				size plus the root and the leaves */
+			static const size_type MaxHeight = 4 * sizeof( size_type ) + 2;
+			/*! \brief Can nodes be dropped without destroying their
+				contents? */
+			static const bool TriviallyDestructible
+				= std::is_trivially_destructible< key_type >::value
+				&& std::is_trivially_destructible< mapped_type >::value;
+
+		private:
+			typedef typename Statistics::template Storage< size_type,
+				MaxNodes + 1 > CountStorage;
+			typedef typename KeyLayout::template Storage< MaxNodes >
+				KeyStorage;
 	
 		private:
 			typedef typename _Allocator::template rebind< Body >::other
@@ -108,82 +191,474 @@ namespace hydrazine
 				public:
 					size_type level;
 					size_type size;
+					/*! \brief The trees and snapshots that hold this node */
+					std::atomic< unsigned int > references;
 					
 				public:
 					inline void construct( size_type l )
 					{
 						 level = l;
 						 size = 0;
+						 references.store( 1, std::memory_order_relaxed );
 					}
 					
 					inline bool leaf() const
 					{
 						return level == 0;
 					}
+
+					/*! \brief Is anything other than the writer holding this
+						node? Only the writer adds references. */
+					inline bool shared() const
+					{
+						return references.load(
+							std::memory_order_acquire ) > 1;
+					}
+
+					inline void reference()
+					{
+						references.fetch_add( 1, std::memory_order_relaxed );
+					}
+
+					/*! \brief Drop a reference, true if it was the last one */
+					inline bool release()
+					{
+						return references.fetch_sub( 1,
+							std::memory_order_acq_rel ) == 1;
+					}
 			};
 
 			/*!
 				\brief Body Node
 			*/
-			class Body : public Node
+			class Body : public Node, public CountStorage, public KeyStorage
 			{
 				public:
-					key_type keys[ MaxNodes ];
 					Node* children[ MaxNodes + 1 ];
 										
 				public:
 					inline void construct( const size_type level )
 					{
 						Node::construct( level );
+						this->constructKeys();
+					}
+
+					inline void destroy()
+					{
+						this->destroyKeys();
 					}
 					
 					inline bool full() const
 					{
-						return size == MaxNodes;
+						return this->size == MaxNodes;
 					}
 					
 					inline bool deficient() const
 					{
-						return size < MinNodes;
+						return this->size < MinNodes;
 					}
 					
 					inline bool borderline() const
 					{
-						return size <= MinNodes;
+						return this->size <= MinNodes;
 					}
 			};
 			
 			/*!
 				\brief A leaf node
 			*/
-			class Leaf : public Node
+			class Leaf : public Node, public LeafStorage
 			{
 				public:
 					Leaf* previous;
 					Leaf* next;
-					value_type data[ MaxLeafs ];
 				
 				public:
 					inline void construct()
 					{
 						Node::construct( 0 );
+						this->constructEntries();
 						previous = 0;
 						next = 0;
 					}
+
+					inline void destroy()
+					{
+						this->destroyEntries();
+					}
 					
 					inline bool full() const
 					{
-						return size == MaxLeafs;
+						return this->size == MaxLeafs;
 					}
 					
 					inline bool deficient() const
 					{
-						return size < MinLeafs;
+						return this->size < MinLeafs;
 					}
 					
 					inline bool borderline() const
 					{
-						return size <= MaxLeafs;
+						return this->size <= MinLeafs;
+					}
+			};
+
+			/*!
+				\brief A node along a path and the index of the child that the
+					path took to reach it.
+			*/
+			class StackElement
+			{
+				public:
+					Node* first;
+					size_type second;
+			};
+
+			/*!
+				\brief The path from the root down to a leaf.
+
+				It lives on the stack of the caller, so walking down the tree
+				never touches the heap.
+			*/
+			class Stack
+			{
+				private:
+					StackElement _elements[ MaxHeight ];
+					size_type _size;
+
+				public:
+					inline Stack() : _size( 0 ) {}
+
+					inline void push( Node* node, size_type position )
+					{
+						assert( _size < MaxHeight );
+						_elements[ _size ].first = node;
+						_elements[ _size ].second = position;
+						++_size;
+					}
+
+					inline void pop()
+					{
+						assert( _size > 0 );
+						--_size;
+					}
+
+					inline void clear()
+					{
+						_size = 0;
+					}
+
+					inline StackElement& top()
+					{
+						assert( _size > 0 );
+						return _elements[ _size - 1 ];
+					}
+
+					inline StackElement& operator[]( size_type i )
+					{
+						assert( i < _size );
+						return _elements[ i ];
+					}
+
+					inline size_type size() const
+					{
+						return _size;
+					}
+
+					inline bool empty() const
+					{
+						return _size == 0;
+					}
+			};
+
+			/*!
+				\brief The keys that bound a node on a path, every key below
+					the node is not less than key lowerIndex of lower and
+					less than key upperIndex of upper.  A null bound is open.
+			*/
+			class Fence
+			{
+				public:
+					const Body* lower;
+					size_type lowerIndex;
+					const Body* upper;
+					size_type upperIndex;
+			};
+
+			/*!
+				\brief Builds a tree bottom up from entries that arrive in
+					order.
+
+				Entries come one at a time, as runs copied or moved out of
+				other leaves, or as whole leaves that are spliced in.
+			*/
+			class Builder
+			{
+				private:
+					typedef std::vector< Node* > NodeVector;
+					typedef std::vector< key_type > KeyVector;
+
+				private:
+					BTree& _tree;
+					double _fill;
+					size_type _perLeaf;
+					Leaf* _leaf;
+					NodeVector _nodes;
+
+				public:
+					inline Builder( BTree& tree, double fill ) : 
+						_tree( tree ), _fill( fill ), 
+						_perLeaf( MAX( MinLeafs, MIN( MaxLeafs - 1,
+						( size_type )( fill * ( MaxLeafs - 1 ) ) ) ) ),
+						_leaf( 0 )
+					{
+						assert( _tree._root == 0 );
+						assert( fill > 0.0 && fill <= 1.0 );
+					}
+
+					template< typename Pair >
+					inline void push( Pair&& pair )
+					{
+						_open();
+						_leaf->set( _leaf->size++, std::forward< Pair >( 
+							pair ) );
+					}
+
+					/*! \brief Add [begin, end) of a leaf, moving rather
+						than copying if move is set */
+					inline void append( Leaf& source, size_type begin,
+						size_type end, bool move )
+					{
+						while( begin != end )
+						{
+							_open();
+							size_type count = MIN( end - begin, 
+								_perLeaf - _leaf->size );
+							if( move )
+							{
+								_leaf->move( source, begin, begin + count,
+									_leaf->size );
+							}
+							else
+							{
+								_leaf->copy( source, begin, begin + count,
+									_leaf->size );
+							}
+							_leaf->size += count;
+							begin += count;
+						}
+					}
+
+					/*! \brief Splice in a whole leaf that nothing else
+						holds */
+					inline void adopt( Leaf* leaf )
+					{
+						++_tree._stats.leafs;
+
+						// the open leaf may be short, fold it into the
+						// new one or even them out
+						if( _leaf != 0 && _leaf->deficient() )
+						{
+							size_type total = _leaf->size + leaf->size;
+							if( total < MaxLeafs )
+							{
+								leaf->moveBackward( *leaf, 0, leaf->size, 
+									total );
+								leaf->move( *_leaf, 0, _leaf->size, 0 );
+								leaf->size = total;
+								Leaf* previous = _leaf->previous;
+								_tree._free( _leaf );
+								_nodes.pop_back();
+								_leaf = previous;
+							}
+							else
+							{
+								size_type moved = total / 2 - _leaf->size;
+								_leaf->move( *leaf, 0, moved, _leaf->size );
+								leaf->move( *leaf, moved, leaf->size, 0 );
+								_leaf->size += moved;
+								leaf->size -= moved;
+							}
+						}
+
+						_link( leaf );
+					}
+
+					/*! \brief Even out the last leaf and build the bodies
+						on top of the leaves */
+					inline void finish()
+					{
+						if( _leaf == 0 )
+						{
+							return;
+						}
+
+						Leaf* leaf = _leaf;
+						_tree._end = leaf;
+
+						// the last leaf may be short, even it out with its
+						// neighbor
+						if( leaf->previous != 0 && leaf->deficient() )
+						{
+							Leaf* previous = leaf->previous;
+							if( previous->size + leaf->size < MaxLeafs )
+							{
+								previous->move( *leaf, 0, leaf->size,
+									previous->size );
+								previous->size += leaf->size;
+								previous->next = 0;
+								_tree._end = previous;
+								_nodes.pop_back();
+								_tree._free( leaf );
+							}
+							else
+							{
+								size_type size 
+									= ( previous->size + leaf->size ) / 2;
+								size_type moved = previous->size - size;
+								leaf->moveBackward( *leaf, 0, leaf->size,
+									leaf->size + moved );
+								leaf->move( *previous, size, previous->size,
+									0 );
+								previous->size = size;
+								leaf->size += moved;
+							}
+						}
+
+						KeyVector keys;
+						keys.reserve( _nodes.size() );
+						for( typename NodeVector::iterator 
+							node = _nodes.begin(); node != _nodes.end(); 
+							++node )
+						{
+							Leaf* leaf = static_cast< Leaf* >( *node );
+							keys.push_back( leaf->key( 0 ) );
+							_tree._stats.elements += leaf->size;
+						}
+
+						size_type perBody = MAX( MinNodes + 1, MIN( MaxNodes,
+							( size_type )( _fill * MaxNodes ) ) );
+
+						for( size_type level = 1; _nodes.size() > 1; ++level )
+						{
+							size_type children = _nodes.size();
+							size_type bodies = MIN( CEIL_DIV( children, 
+								perBody ), MAX( 1, children 
+								/ ( MinNodes + 1 ) ) );
+
+							report( " Building " << bodies 
+								<< " bodies at level " << level );
+
+							NodeVector parents;
+							KeyVector parentKeys;
+							parents.reserve( bodies );
+							parentKeys.reserve( bodies );
+
+							size_type begin = 0;
+							for( size_type b = 0; b < bodies; ++b )
+							{
+								size_type end = begin + children / bodies
+									+ ( b < children % bodies ? 1 : 0 );
+								assert( end - begin <= MaxNodes );
+								Body* body = _tree._allocateBody( level );
+								body->size = end - begin - 1;
+								body->assignKeys( keys.begin() + begin + 1,
+									keys.begin() + end );
+								std::copy( _nodes.begin() + begin,
+									_nodes.begin() + end, body->children );
+								_tree._recount( body );
+								parents.push_back( body );
+								parentKeys.push_back( keys[ begin ] );
+								begin = end;
+							}
+
+							_nodes.swap( parents );
+							keys.swap( parentKeys );
+						}
+
+						_tree._root = _nodes[ 0 ];
+					}
+
+				private:
+					/*! \brief Make sure that the last leaf has room */
+					inline void _open()
+					{
+						if( _leaf == 0 || _leaf->size >= _perLeaf )
+						{
+							_link( _tree._allocateLeaf() );
+						}
+					}
+
+					inline void _link( Leaf* leaf )
+					{
+						leaf->previous = _leaf;
+						leaf->next = 0;
+						if( _leaf == 0 )
+						{
+							_tree._begin = leaf;
+						}
+						else
+						{
+							_leaf->next = leaf;
+						}
+						_leaf = leaf;
+						_nodes.push_back( leaf );
+					}
+			};
+
+			/*!
+				\brief A position in the leaves of a tree that is being
+					combined with another one.
+			*/
+			class Cursor
+			{
+				public:
+					/*! \brief A leaf, and whether this walk may take it or
+						its entries, which it may not if another tree or a
+						snapshot holds it */
+					typedef std::pair< Leaf*, bool > LeafEntry;
+					typedef std::vector< LeafEntry > LeafVector;
+					typedef std::vector< Leaf* > LeafPointerVector;
+
+				public:
+					/*! \brief Every leaf in order */
+					LeafVector leaves;
+					/*! \brief The leaves spliced into the result, in order */
+					LeafPointerVector adopted;
+					size_type leaf;
+					size_type index;
+
+				public:
+					inline Cursor() : leaf( 0 ), index( 0 ) {}
+
+					inline bool done() const
+					{
+						return leaf == leaves.size();
+					}
+
+					inline Leaf* current() const
+					{
+						return leaves[ leaf ].first;
+					}
+
+					inline bool owned() const
+					{
+						return leaves[ leaf ].second;
+					}
+
+					inline const key_type& key() const
+					{
+						return current()->key( index );
+					}
+
+					inline void skip( size_type count )
+					{
+						index += count;
+						if( index == current()->size )
+						{
+							++leaf;
+							index = 0;
+						}
 					}
 			};
 
@@ -192,6 +667,7 @@ namespace hydrazine
 			class Iterator
 			{
 				friend class BTree;
+				friend class ConstIterator;
 				friend class Node;
 				friend class Leaf;
 				public:
@@ -203,20 +679,44 @@ namespace hydrazine
 					typedef BTree::difference_type difference_type;
 
 				private:
+					/*! \brief The tree, which copies the leaves that a
+						snapshot shares as they are stepped into */
+					BTree* _tree;
 					Leaf* _leaf;
 					size_type _current;
 
 				private:
-					inline Iterator( Leaf* l, size_type c ) : 
-						_leaf( l ), _current( c )
+					inline Iterator( BTree* t, Leaf* l, size_type c ) : 
+						_tree( t ), _leaf( l ), _current( c )
 					{}
+
+					/*! \brief Step forward without copying the leaf that
+						it steps into, for lookups that own it already or
+						do not write through the result */
+					inline void _increment()
+					{
+						if( _current + 1 < _leaf->size )
+						{
+							++_current;
+						}
+						else if( 0 != _leaf->next )
+						{
+							_current = 0;
+							_leaf = _leaf->next;
+						}
+						else
+						{
+							_current = _leaf->size;
+						}
+					}
 					
 				public:
 					inline Iterator( ) {}
-					inline Iterator( const Iterator& i ) : _leaf( i._leaf ), 
-						_current( i._current ) {}
+					inline Iterator( const Iterator& i ) : _tree( i._tree ),
+						_leaf( i._leaf ), _current( i._current ) {}
 					inline Iterator& operator=( const Iterator& i )
 					{
+						_tree = i._tree;
 						_leaf = i._leaf;
 						_current = i._current;
 						return *this;
@@ -225,49 +725,47 @@ namespace hydrazine
 					inline reference operator*() const
 					{
 						assert( _current < _leaf->size );
-						return _leaf->data[ _current ];
+						return _leaf->at( _current );
 					}
 					
 					inline pointer operator->() const
 					{
 						assert( _current < _leaf->size );
-						return &_leaf->data[ _current ];
+						return _leaf->address( _current );
 					}
 					
 					inline Iterator& operator++()
 					{
-						if( _current + 1 < _leaf->size )
-						{
-							++_current;
-						}
-						else if( 0 != _leaf->next )
-						{
-							_current = 0;
-							_leaf = _leaf->next;
-						}
-						else
+						_increment();
+						if( _current == 0 )
 						{
-							_current = _leaf->size;
+							_leaf = _tree->_ownLeaf( _leaf );
 						}
 						return *this;
 					}
 					
 					inline Iterator operator++( int )
 					{
-						Iterator next( *this );
-						++next;
-						return std::move( next );	
+						Iterator previous( *this );
+						++*this;
+						return previous;
 					}
 					
 					inline Iterator& operator--()
 					{
+						if( _current == _leaf->size )
+						{
+							// end() did not copy the last leaf
+							_leaf = _tree->_ownLeaf( _leaf );
+						}
+						
 						if( _current != 0 )
 						{
 							--_current;
 						}
 						else if( _leaf->previous != 0 )
 						{
-							_leaf = _leaf->previous;
+							_leaf = _tree->_ownLeaf( _leaf->previous );
 							_current = _leaf->size - 1;		
 						}
 						else
@@ -279,18 +777,18 @@ namespace hydrazine
 					
 					inline Iterator operator--( int )
 					{
-						Iterator previous( *this );
-						--previous;
-						return std::move( previous );	
+						Iterator next( *this );
+						--*this;
+						return next;
 					}
 					
 				public:
-					bool operator==( const ConstIterator& i )
+					bool operator==( const ConstIterator& i ) const
 					{
 						return _leaf == i._leaf && _current == i._current;
 					}
 
-					bool operator!=( const ConstIterator& i )
+					bool operator!=( const ConstIterator& i ) const
 					{
 						return _leaf != i._leaf || _current != i._current;
 					}
@@ -302,6 +800,7 @@ namespace hydrazine
 			class ConstIterator
 			{
 				friend class BTree;
+				friend class Iterator;
 				friend class Node;
 				friend class Leaf;
 				public:
@@ -337,13 +836,15 @@ namespace hydrazine
 					inline reference operator*() const
 					{
 						assert( _current < _leaf->size );
-						return _leaf->data[ _current ];
+						return static_cast< const Leaf* >( _leaf )->at(
+							_current );
 					}
 					
 					inline pointer operator->() const
 					{
 						assert( _current < _leaf->size );
-						return &_leaf->data[ _current ];
+						return static_cast< const Leaf* >( _leaf )->address(
+							_current );
 					}
 					
 					inline ConstIterator& operator++()
@@ -366,9 +867,9 @@ namespace hydrazine
 					
 					inline ConstIterator operator++( int )
 					{
-						Iterator next( *this );
-						++next;
-						return std::move( next );	
+						ConstIterator previous( *this );
+						++*this;
+						return previous;
 					}
 					
 					inline ConstIterator& operator--()
@@ -391,23 +892,18 @@ namespace hydrazine
 					
 					inline ConstIterator operator--( int )
 					{
-						Iterator previous( *this );
-						--previous;
-						return std::move( previous );	
-					}
-					
-					const pointer& base() const
-					{
-						return _current;
+						ConstIterator next( *this );
+						--*this;
+						return next;
 					}
 				
 				public:
-					bool operator==( const ConstIterator& i )
+					bool operator==( const ConstIterator& i ) const
 					{
 						return _leaf == i._leaf && _current == i._current;
 					}
 
-					bool operator!=( const ConstIterator& i )
+					bool operator!=( const ConstIterator& i ) const
 					{
 						return _leaf != i._leaf || _current != i._current;
 					}
@@ -415,53 +911,446 @@ namespace hydrazine
 			};
 		
 		private:
-			class Stats
+			/*!
+				\brief Counts the snapshots of a tree that are alive.
+
+				Snapshots can outlive the tree and be released by another
+				thread, so the tree holds a reference too and whichever
+				lets go last frees it.
+			*/
+			class SnapshotCount
 			{
+				private:
+					std::atomic< unsigned int > _references;
+
 				public:
-					size_type elements;
-					size_type leafs;
-					size_type bodies;
-				
-				public:
-					inline Stats() : elements( 0 ), leafs( 0 ), bodies( 0 ) {}
-					inline size_type nodes() const { return leafs + bodies; }
+					inline SnapshotCount() : _references( 1 ) {}
+
+					inline void reference()
+					{
+						_references.fetch_add( 1, std::memory_order_relaxed );
+					}
+
+					inline void release()
+					{
+						if( _references.fetch_sub( 1,
+							std::memory_order_acq_rel ) == 1 )
+						{
+							delete this;
+						}
+					}
+
+					/*! \brief Does a snapshot besides the tree hold it? */
+					inline bool live() const
+					{
+						return _references.load( 
+							std::memory_order_acquire ) > 1;
+					}
 			};
-			
-			/*!
-				\brief Internal Data
-			*/
-		private:
-			Node* _root;
-			Leaf* _begin;
-			Leaf* _end;
-			Stats _stats;
 
+		public:
 			/*!
-				\brief Copy/Construct/Destroy
+				\brief An immutable, point in time view of a BTree.
+
+				A snapshot holds a reference to the root of the tree that it
+				was taken from and shares every page with it.  The tree
+				copies the pages along the paths that it modifies, so the
+				snapshot never sees a change.  Copies share the same pages.
+				
+				Readers walk down from the root rather than following leaf
+				links, which belong to the tree.  A snapshot can be read and
+				released by another thread than the writer, as long as the
+				allocator is safe to call from both.
 			*/
-		public:
-			explicit BTree( const Compare& comp = Compare(), 
-				const Allocator& alloc = Allocator() ) : 
-				_allocator( alloc ), _compare( comp ),
-				_root( 0 ), _begin( 0 ), _end( 0 ) 
+			class Snapshot
 			{
-			}
+				friend class BTree;
 
-			template < typename InputIterator >			
-			BTree( InputIterator first, InputIterator last, 
-				const Compare& comp = Compare(), 
-				const Allocator& alloc = Allocator() ) : 
-				_allocator( alloc ), _compare( comp ),
-				_root( 0 ), _begin( 0 ), _end( 0 ) 
-			{
-				insert( first, last );
-			}
+				public:
+					/*! \brief A forward iterator that keeps the path from
+						the root to its leaf */
+					class Iterator
+					{
+						friend class Snapshot;
+						public:
+							typedef std::forward_iterator_tag 
+								iterator_category;
+							typedef BTree::value_type value_type;
+							typedef BTree::const_pointer pointer;
+							typedef BTree::const_reference reference;
+							typedef BTree::difference_type difference_type;
+
+						private:
+							const Node* _nodes[ MaxHeight ];
+							size_type _positions[ MaxHeight ];
+							/*! \brief The length of the path, 0 is the end */
+							size_type _depth;
+
+						private:
+							inline const Leaf* _leaf() const
+							{
+								return static_cast< const Leaf* >(
+									_nodes[ _depth - 1 ] );
+							}
+
+							/*! \brief Follow the first child down from the
+								child taken at the bottom of the path */
+							inline void _descend( const Node* node )
+							{
+								while( true )
+								{
+									_nodes[ _depth ] = node;
+									_positions[ _depth ] = 0;
+									++_depth;
+									if( node->leaf() )
+									{
+										break;
+									}
+									node = static_cast< const Body* >( 
+										node )->children[ 0 ];
+								}
+							}
+
+						public:
+							inline Iterator() : _depth( 0 ) {}
+
+							inline reference operator*() const
+							{
+								assert( _depth > 0 );
+								return _leaf()->at( _positions[ _depth - 1 ] );
+							}
+
+							inline pointer operator->() const
+							{
+								assert( _depth > 0 );
+								return _leaf()->address( 
+									_positions[ _depth - 1 ] );
+							}
+
+							inline Iterator& operator++()
+							{
+								assert( _depth > 0 );
+								if( ++_positions[ _depth - 1 ] 
+									< _nodes[ _depth - 1 ]->size )
+								{
+									return *this;
+								}
+
+								// climb to the first body with a child to
+								// the right of the path
+								--_depth;
+								while( _depth > 0 && _positions[ _depth - 1 ]
+									== _nodes[ _depth - 1 ]->size )
+								{
+									--_depth;
+								}
+
+								if( _depth > 0 )
+								{
+									size_type position 
+										= ++_positions[ _depth - 1 ];
+									_descend( static_cast< const Body* >( 
+										_nodes[ _depth - 1 ] )->children[
+										position ] );
+								}
+								return *this;
+							}
+
+							inline Iterator operator++( int )
+							{
+								Iterator previous( *this );
+								++*this;
+								return previous;
+							}
+
+						public:
+							bool operator==( const Iterator& i ) const
+							{
+								if( _depth == 0 || i._depth == 0 )
+								{
+									return _depth == i._depth;
+								}
+								return _leaf() == i._leaf() 
+									&& _positions[ _depth - 1 ] 
+									== i._positions[ i._depth - 1 ];
+							}
+
+							bool operator!=( const Iterator& i ) const
+							{
+								return !( *this == i );
+							}
+					};
+
+					typedef Iterator const_iterator;
+
+				private:
+					Node* _root;
+					size_type _size;
+					key_compare _keyCompare;
+					BodyAllocator _bodyAllocator;
+					LeafAllocator _leafAllocator;
+					SnapshotCount* _count;
+
+				private:
+					inline Snapshot( Node* root, size_type size, 
+						const key_compare& compare, 
+						const BodyAllocator& bodyAllocator, 
+						const LeafAllocator& leafAllocator,
+						SnapshotCount* count ) :
+						_root( root ), _size( size ), _keyCompare( compare ),
+						_bodyAllocator( bodyAllocator ), 
+						_leafAllocator( leafAllocator ), _count( count )
+					{
+						if( _root != 0 )
+						{
+							_root->reference();
+							_count->reference();
+						}
+					}
+
+					/*! \brief Walk down to the leaf that holds key, 
+						using the leaf search bound */
+					template< bool Upper, typename K >
+					inline const_iterator _bound( const K& key ) const
+					{
+						const_iterator result;
+						if( _root == 0 )
+						{
+							return result;
+						}
+
+						const Node* node = _root;
+						while( !node->leaf() )
+						{
+							const Body* body = static_cast< const Body* >( 
+								node );
+							size_type position = body->upperBound( 0,
+								body->size, key, _keyCompare );
+							result._nodes[ result._depth ] = node;
+							result._positions[ result._depth ] = position;
+							++result._depth;
+							node = body->children[ position ];
+						}
+
+						const Leaf* leaf = static_cast< const Leaf* >( node );
+						size_type position = Upper 
+							? Search::upperBound( leaf->entries(), 
+								leaf->size, key, _keyCompare )
+							: Search::lowerBound( leaf->entries(), 
+								leaf->size, key, _keyCompare );
+						result._nodes[ result._depth ] = node;
+						result._positions[ result._depth ] = position;
+						++result._depth;
+
+						// the bound is the first entry of the next leaf
+						if( position == leaf->size )
+						{
+							result._positions[ result._depth - 1 ] 
+								= position - 1;
+							++result;
+						}
+						return result;
+					}
+
+				public:
+					inline Snapshot() : _root( 0 ), _size( 0 ), _count( 0 ) {}
+
+					inline Snapshot( const Snapshot& snapshot ) : 
+						_root( snapshot._root ), _size( snapshot._size ),
+						_keyCompare( snapshot._keyCompare ),
+						_bodyAllocator( snapshot._bodyAllocator ),
+						_leafAllocator( snapshot._leafAllocator ),
+						_count( snapshot._count )
+					{
+						if( _root != 0 )
+						{
+							_root->reference();
+							_count->reference();
+						}
+					}
+
+					inline ~Snapshot()
+					{
+						if( _root != 0 )
+						{
+							_unreference( _root, _bodyAllocator, 
+								_leafAllocator );
+							_count->release();
+						}
+					}
+
+					inline Snapshot& operator=( const Snapshot& snapshot )
+					{
+						Snapshot copy( snapshot );
+						std::swap( _root, copy._root );
+						std::swap( _size, copy._size );
+						std::swap( _keyCompare, copy._keyCompare );
+						std::swap( _bodyAllocator, copy._bodyAllocator );
+						std::swap( _leafAllocator, copy._leafAllocator );
+						std::swap( _count, copy._count );
+						return *this;
+					}
+
+				public:
+					inline const_iterator begin() const
+					{
+						const_iterator result;
+						if( _root != 0 )
+						{
+							result._descend( _root );
+						}
+						return result;
+					}
+
+					inline const_iterator end() const
+					{
+						return const_iterator();
+					}
+
+					inline size_type size() const
+					{
+						return _size;
+					}
+
+					inline bool empty() const
+					{
+						return _size == 0;
+					}
+
+				public:
+					inline const_iterator find( const key_type& key ) const
+					{
+						return _find( key );
+					}
+
+					inline size_type count( const key_type& key ) const
+					{
+						return find( key ) != end();
+					}
+
+					inline const_iterator lower_bound( 
+						const key_type& key ) const
+					{
+						return _bound< false >( key );
+					}
+
+					inline const_iterator upper_bound( 
+						const key_type& key ) const
+					{
+						return _bound< true >( key );
+					}
+
+				public:
+					/*! \brief Lookups by any K, if Compare is transparent */
+					template< typename K >
+					inline typename Lookup< K, const_iterator >::type find( 
+						const K& key ) const
+					{
+						return _find( key );
+					}
+
+					template< typename K >
+					inline typename Lookup< K, size_type >::type count( 
+						const K& key ) const
+					{
+						return _find( key ) != end();
+					}
+
+					template< typename K >
+					inline typename Lookup< K, const_iterator >::type 
+						lower_bound( const K& key ) const
+					{
+						return _bound< false >( key );
+					}
+
+					template< typename K >
+					inline typename Lookup< K, const_iterator >::type 
+						upper_bound( const K& key ) const
+					{
+						return _bound< true >( key );
+					}
+
+				private:
+					template< typename K >
+					inline const_iterator _find( const K& key ) const
+					{
+						const_iterator result = _bound< false >( key );
+						if( result != end() 
+							&& _keyCompare( key, result->first ) )
+						{
+							return end();
+						}
+						return result;
+					}
+			};
+		
+		private:
+			class Stats
+			{
+				public:
+					size_type elements;
+					size_type leafs;
+					size_type bodies;
+				
+				public:
+					inline Stats() : elements( 0 ), leafs( 0 ), bodies( 0 ) {}
+					inline size_type nodes() const { return leafs + bodies; }
+			};
 			
-			BTree( const BTree& tree ) : 
+			/*!
+				\brief Internal Data
+			*/
+		private:
+			Node* _root;
+			Leaf* _begin;
+			Leaf* _end;
+			Stats _stats;
+			/*! \brief The snapshots that may hold pages of the tree, 0
+				if none were taken since it was last cleared */
+			SnapshotCount* _snapshots;
+
+			/*!
+				\brief Copy/Construct/Destroy
+			*/
+		public:
+			explicit BTree( const Compare& comp = Compare(), 
+				const Allocator& alloc = Allocator() ) : 
+				_allocator( alloc ), _compare( comp ), _keyCompare( comp ),
+				_bodyAllocator( alloc ), _leafAllocator( alloc ),
+				_root( 0 ), _begin( 0 ), _end( 0 ), _snapshots( 0 )
+			{
+			}
+
+			template < typename InputIterator >			
+			BTree( InputIterator first, InputIterator last, 
+				const Compare& comp = Compare(), 
+				const Allocator& alloc = Allocator() ) : 
+				_allocator( alloc ), _compare( comp ), _keyCompare( comp ),
+				_bodyAllocator( alloc ), _leafAllocator( alloc ),
+				_root( 0 ), _begin( 0 ), _end( 0 ), _snapshots( 0 )
+			{
+				insert( first, last );
+			}
+
+			template < typename InputIterator >
+			BTree( sorted_unique_t, InputIterator first, InputIterator last,
+				const Compare& comp = Compare(),
+				const Allocator& alloc = Allocator() ) :
+				_allocator( alloc ), _compare( comp ), _keyCompare( comp ),
+				_bodyAllocator( alloc ), _leafAllocator( alloc ),
+				_root( 0 ), _begin( 0 ), _end( 0 ), _snapshots( 0 )
+			{
+				_bulkLoad( first, last, 1.0 );
+			}
+
+			BTree( const BTree& tree ) :
 				_allocator( tree._allocator ), _compare( tree._compare ),
-				_root( 0 ), _begin( 0 ), _end( 0 ) 
+				_keyCompare( tree._keyCompare ),
+				_bodyAllocator( tree._allocator ),
+				_leafAllocator( tree._allocator ),
+				_root( 0 ), _begin( 0 ), _end( 0 ), _snapshots( 0 )
 			{
-				insert( tree.begin(), tree.end() );
+				_copy( tree );
 			}
 			
 			~BTree()
@@ -471,8 +1360,11 @@ namespace hydrazine
 			
 			BTree& operator=( const BTree& tree )
 			{
-				clear();
-				insert( tree.begin(), tree.end() );
+				if( this != &tree )
+				{
+					clear();
+					_copy( tree );
+				}
 				return *this;
 			}
 			
@@ -482,7 +1374,8 @@ namespace hydrazine
 		public:
 			inline iterator begin()
 			{
-				return iterator( _begin, 0 );
+				_ownEdge< false >();
+				return _beginIterator();
 			}
 			
 			inline const_iterator begin() const
@@ -492,7 +1385,7 @@ namespace hydrazine
 			
 			inline iterator end()
 			{
-				return iterator( _end, _end != 0 ? _end->size : 0 );
+				return _endIterator();
 			}
 			
 			inline const_iterator end() const
@@ -502,7 +1395,8 @@ namespace hydrazine
 			
 			inline reverse_iterator rbegin()
 			{
-				return reverse_iterator( end() );
+				_ownEdge< true >();
+				return reverse_iterator( _endIterator() );
 			}
 			
 			inline const_reverse_iterator rbegin() const
@@ -512,7 +1406,7 @@ namespace hydrazine
 			
 			inline reverse_iterator rend()
 			{
-				return reverse_iterator( begin() );
+				return reverse_iterator( _beginIterator() );
 			}
 			
 			inline const_reverse_iterator rend() const
@@ -543,86 +1437,244 @@ namespace hydrazine
 				\brief Element access
 			*/
 		public:
-			inline reference operator[]( const key_type& key )
+			inline mapped_type& operator[]( const key_type& key )
 			{
-				iterator fi = lower_bound( key );
-				
-				if( fi == end() )
-				{
-					fi = _root->insert( fi, 
-						std::make_pair( key, mapped_type() ) );					
-				}
-				else
-				{
-					if( _compare( *fi, key ) || _compare( key, *fi ) )
-					{
-						fi = _root->insert( fi, 
-							std::make_pair( key, mapped_type() ) );
-					}
-				}
-				
-				return fi->second;
+				return try_emplace( key ).first->second;
 			}
 		
 			/*!
 				\brief Modifiers
 			*/
 		public:
-			inline insertion insert( const_reference x )
+			inline insertion insert( const value_type& x )
 			{
-				report( "Inserting " << x.first << "," << x.second );
-				if( _root != 0 )
-				{
-					Stack stack;
-					stack.push( StackElement( _root, 0 ) );
-					
-					_findInsertLeaf( stack, x );					
-					insertion result( _insertLeaf( stack.top().first, x ) );
+				return _insert( x.first, x );
+			}
 
-					if( result.first._leaf->full() )
-					{
-						assert( result.second );
-						report( " Insert caused a split." );
-						_split( stack, result.first );
-					}
-					
-					return result;
+			inline insertion insert( value_type&& x )
+			{
+				return _insert( x.first, std::move( x ) );
+			}
+
+			/*! \brief Build a value in place, it is dropped if the key is
+				already in the tree */
+			template < typename... Args >
+			inline insertion emplace( Args&&... args )
+			{
+				value_type x( std::forward< Args >( args )... );
+				return _insert( x.first, std::move( x ) );
+			}
+
+			/*! \brief Insert a value built from args only if the key is not
+				already in the tree, args are left alone otherwise */
+			template < typename... Args >
+			inline insertion try_emplace( const key_type& key, 
+				Args&&... args )
+			{
+				Stack stack;
+				insertion result = _open( stack, key );
+				if( result.second )
+				{
+					_fill( stack, result, value_type( 
+						std::piecewise_construct, std::forward_as_tuple( key ),
+						std::forward_as_tuple( 
+						std::forward< Args >( args )... ) ) );
+					_close( stack, result );
 				}
-				else
+				return result;
+			}
+
+			template < typename... Args >
+			inline insertion try_emplace( key_type&& key, Args&&... args )
+			{
+				Stack stack;
+				insertion result = _open( stack, key );
+				if( result.second )
 				{
-					report( " Creating the root node." );
-					_createRoot();
-					assert( _root->leaf() );
-					Leaf* leaf = static_cast< Leaf* >( _root );
-					leaf->data[ 0 ] = x;
-					leaf->size = 1;
-					return insertion( begin(), true );
+					_fill( stack, result, value_type( 
+						std::piecewise_construct, std::forward_as_tuple( std::move( key ) ),
+						std::forward_as_tuple( 
+						std::forward< Args >( args )... ) ) );
+					_close( stack, result );
 				}
+				return result;
 			}
 
-			inline iterator insert( iterator position, const_reference x )
+			inline iterator insert( iterator position, const value_type& x )
 			{
 				return insert( x ).first;
 			}
 
+			/*!
+				\brief Insert a range, an empty tree is built bottom up
+					when the range is sorted and has no duplicates.
+			*/
 			template < typename InputIterator >
 			inline void insert( InputIterator first, InputIterator last )
 			{
+				if( empty() && _sorted( first, last, typename
+					std::iterator_traits< InputIterator >::iterator_category() ) )
+				{
+					_bulkLoad( first, last, 1.0 );
+					return;
+				}
+
 				for( InputIterator fi = first; fi != last; ++fi )
 				{
 					insert( *fi );
 				}
 			}
+
+			/*!
+				\brief Replace the contents of the tree with a range that is
+					sorted and has no duplicate keys.
+
+				The leaves are packed in a single pass and the body levels
+				are built on top of them, so the cost is linear in the size
+				of the range.
+
+				\param fill The fraction of each page to fill, lower values
+					leave room for later inserts without splitting.
+			*/
+			template < typename InputIterator >
+			inline void bulk_load( sorted_unique_t, InputIterator first,
+				InputIterator last, double fill = 1.0 )
+			{
+				clear();
+				_bulkLoad( first, last, fill );
+			}
+
+			/*!
+				\brief Replace the contents of the tree with a combination
+					of two other trees, see SetOperation.
+
+				The leaves of both trees are walked at once and runs of
+				entries that the operation keeps are copied into packed
+				leaves, then the body levels are built on top, so the cost
+				is linear in the size of both trees rather than a search
+				per element.  Either tree may be this one.
+			*/
+			inline void combine( SetOperation operation, const BTree& left,
+				const BTree& right )
+			{
+				report( "Combining " << left.size() << " and " 
+					<< right.size() << " elements." );
+
+				Cursor first;
+				Cursor second;
+				_leaves( left._root, true, first.leaves );
+				_leaves( right._root, true, second.leaves );
+
+				BTree result( key_comp(), get_allocator() );
+				Builder builder( result, 1.0 );
+				result._combine( operation, first, second, builder, false );
+				builder.finish();
+
+				swap( result );
+			}
+
+			/*!
+				\brief Move every element of source into this tree, source
+					is left empty.  Values from source replace the values
+					of equal keys in this tree.
+
+				Both trees are walked at once and rebuilt bottom up in
+				linear time, like combine().  Whole leaves that fall
+				between two keys of the other tree are spliced into the
+				result as they are, so only leaves where the keys of the
+				two trees interleave are copied, along with the bodies.
+				Leaves that a snapshot holds are copied and left to it.
+			*/
+			inline void merge( BTree& source )
+			{
+				if( this == &source || source.empty() )
+				{
+					return;
+				}
+
+				report( "Merging " << source.size() << " elements into " 
+					<< size() << " elements." );
+
+				Cursor mine;
+				Cursor theirs;
+				_leaves( _root, false, mine.leaves );
+				source._leaves( source._root, 
+					_leafAllocator != source._leafAllocator, theirs.leaves );
+
+				Node* root = _root;
+				Stats stats = _stats;
+				_root = 0;
+				_begin = 0;
+				_end = 0;
+				_stats = Stats();
+
+				Builder builder( *this, 1.0 );
+				_combine( SetMerge, mine, theirs, builder, true );
+				builder.finish();
+
+				// the old nodes are still counted until they are freed
+				_stats.leafs += stats.leafs;
+				_stats.bodies += stats.bodies;
+
+				size_type next = 0;
+				if( root != 0 )
+				{
+					_dismantle( root, mine.adopted, next );
+				}
+				next = 0;
+				source._dismantle( source._root, theirs.adopted, next );
+
+				source._root = 0;
+				source._begin = 0;
+				source._end = 0;
+				source._stats = Stats();
+			}
+
+			/*!
+				\brief Insert a batch of values in a single pass over the tree.
+
+				The batch is sorted first unless it already is.  Each value
+				then starts from the path to the one before it and only
+				climbs until it reaches a node whose key range holds the
+				value, so values that land in the same leaf share one
+				descent.  Of several values with the same key the first one
+				wins, as with repeated calls to insert.
+
+				\return The number of values that were inserted
+			*/
+			template < typename InputIterator >
+			inline size_type insert_batch( InputIterator first,
+				InputIterator last )
+			{
+				if( _sorted( first, last, typename
+					std::iterator_traits< InputIterator >::iterator_category() ) )
+				{
+					if( empty() )
+					{
+						_bulkLoad( first, last, 1.0 );
+						return size();
+					}
+					return _insertBatch( first, last );
+				}
+
+				std::vector< value_type > batch( first, last );
+				std::stable_sort( batch.begin(), batch.end(), _compare );
+				return _insertBatch( std::make_move_iterator( batch.begin() ),
+					std::make_move_iterator( batch.end() ) );
+			}
 			
 			inline void erase( iterator position )
 			{
-				assert( "Erase not implemented." == 0 );
+				assert( position != _endIterator() );
+				iterator next( position );
+				++next;
+				erase( position, next );
 			}
 			
 			inline size_type erase( const key_type& x )
 			{
 				iterator position = find( x );
-				if( x != end() )
+				if( position != _endIterator() )
 				{
 					erase( position );
 					return 1;
@@ -630,25 +1682,75 @@ namespace hydrazine
 				return 0;
 			}
 			
+			/*!
+				\brief Erase the range [first, last)
+
+				Subtrees that fall entirely inside of the range are released
+				as a whole, only the nodes along the two boundary paths are
+				trimmed and rebalanced.
+			*/
 			inline void erase( iterator first, iterator last )
 			{
-				assert( "Erase not implemented." == 0 );
-			}
-			
-			inline void swap( BTree& tree )
-			{
-				std::swap( _stats, tree._stats );
-				std::swap( _begin, tree._begin );
-				std::swap( _end, tree._end );
-				std::swap( _root, tree._root );
-			}
+				if( first == last )
+				{
+					return;
+				}
 
-			inline void clear()
-			{
-				if( _root != 0 )
+				if( first == _beginIterator() && last == _endIterator() )
 				{
-					_clear( _root );
-					_free( _root );
+					clear();
+					return;
+				}
+
+				report( "Erasing from " << first->first );
+
+				key_type lower = first->first;
+
+				// copying a shared root moves end(), compare first
+				if( last == _endIterator() )
+				{
+					_root = _own( _root );
+					_stats.elements -= _erase( _root, lower, 0 );
+				}
+				else
+				{
+					key_type upper = last->first;
+					_root = _own( _root );
+					_stats.elements -= _erase( _root, lower, &upper );
+				}
+
+				_collapseRoot();
+			}
+			
+			inline void swap( BTree& tree )
+			{
+				std::swap( _stats, tree._stats );
+				std::swap( _begin, tree._begin );
+				std::swap( _end, tree._end );
+				std::swap( _root, tree._root );
+				std::swap( _snapshots, tree._snapshots );
+				std::swap( _bodyAllocator, tree._bodyAllocator );
+				std::swap( _leafAllocator, tree._leafAllocator );
+			}
+
+			inline void clear()
+			{
+				if( _root != 0 )
+				{
+					// Pools can drop every node at once instead of walking,
+					// unless a snapshot holds some of them or nodes own
+					// memory of their own
+					if( !_root->shared() && TriviallyDestructible
+						&& ownsAll( _bodyAllocator, _stats.bodies )
+						&& ownsAll( _leafAllocator, _stats.leafs ) )
+					{
+						releaseAll( _bodyAllocator );
+						releaseAll( _leafAllocator );
+					}
+					else
+					{
+						_drop( _root );
+					}
 					
 					_root = 0;
 					_begin = 0;
@@ -656,51 +1758,266 @@ namespace hydrazine
 					
 					_stats = Stats();
 				}
+
+				// live snapshots no longer share anything with the tree
+				if( _snapshots != 0 )
+				{
+					_snapshots->release();
+					_snapshots = 0;
+				}
+			}
+
+			/*!
+				\brief Take an immutable view of the current contents in
+					constant time, see Snapshot.
+			*/
+			inline Snapshot snapshot()
+			{
+				if( _root != 0 && _snapshots == 0 )
+				{
+					_snapshots = new SnapshotCount;
+				}
+				return Snapshot( _root, size(), _keyCompare, 
+					_bodyAllocator, _leafAllocator, _snapshots );
 			}
 		
 		private:
 			inline void _createRoot()
 			{
 				assert( _root == 0 );
-				Leaf* leaf = _leafAllocator.allocate( 1 );
-				leaf->construct();
+				Leaf* leaf = _allocateLeaf();
 				_root = leaf;
+				_begin = leaf;
+				_end = leaf;
 			}
 			
-			inline void _findInsertLeaf( Stack& stack, const_reference value )
+			/*! \brief Insert a value whose key is key, key must stay valid
+				until the value is moved into the tree */
+			template < typename Pair >
+			inline insertion _insert( const key_type& key, Pair&& x )
+			{
+				Stack stack;
+				insertion result = _open( stack, key );
+				if( result.second )
+				{
+					_fill( stack, result, std::forward< Pair >( x ) );
+					_close( stack, result );
+				}
+				return result;
+			}
+
+			/*! \brief Insert a sorted batch, reusing the path between
+				values */
+			template < typename InputIterator >
+			inline size_type _insertBatch( InputIterator first,
+				InputIterator last )
+			{
+				Stack stack;
+				Fence fences[ MaxHeight ];
+				size_type inserted = 0;
+
+				for( ; first != last; ++first )
+				{
+					const key_type& key = ( *first ).first;
+
+					while( !stack.empty() 
+						&& !_contains( fences[ stack.size() - 1 ], key ) )
+					{
+						stack.pop();
+					}
+
+					if( stack.empty() )
+					{
+						if( _root == 0 )
+						{
+							_insert( key, *first );
+							++inserted;
+							continue;
+						}
+						_root = _own( _root );
+						stack.push( _root, 0 );
+						fences[ 0 ].lower = 0;
+						fences[ 0 ].upper = 0;
+					}
+
+					_descend( stack, fences, key );
+
+					insertion result = _insertPosition( stack.top().first, 
+						key );
+					if( !result.second )
+					{
+						continue;
+					}
+
+					_fill( stack, result, *first );
+					++inserted;
+
+					if( result.first._leaf->full() )
+					{
+						_close( stack, result );
+						stack.clear();
+					}
+					else
+					{
+						_close( stack, result );
+					}
+				}
+
+				return inserted;
+			}
+
+			/*!
+				\brief Walk down from the top of a path to the leaf that key
+					belongs in, recording the key range of each node
+			*/
+			inline void _descend( Stack& stack, Fence* fences,
+				const key_type& key )
+			{
+				while( !stack.top().first->leaf() )
+				{
+					Body* body = static_cast< Body* >( stack.top().first );
+					const Fence& fence = fences[ stack.size() - 1 ];
+					size_type position = body->upperBound( 0, body->size,
+						key, _keyCompare );
+					body->children[ position ] = _own( 
+						body->children[ position ] );
+
+					Fence& child = fences[ stack.size() ];
+					child.lower = position > 0 ? body : fence.lower;
+					child.lowerIndex = position > 0 
+						? position - 1 : fence.lowerIndex;
+					child.upper = position < body->size ? body : fence.upper;
+					child.upperIndex = position < body->size 
+						? position : fence.upperIndex;
+
+					stack.push( body->children[ position ], position );
+
+					if( stack.top().first->leaf() )
+					{
+						_prefetch( static_cast< Leaf* >(
+							stack.top().first )->next );
+					}
+				}
+			}
+
+			inline bool _contains( const Fence& fence,
+				const key_type& key ) const
+			{
+				return ( fence.lower == 0 || !fence.lower->before( key,
+					fence.lowerIndex, _keyCompare ) )
+					&& ( fence.upper == 0 || fence.upper->before( key,
+					fence.upperIndex, _keyCompare ) );
+			}
+
+			static inline void _prefetch( const void* address )
+			{
+				#ifdef __GNUC__
+				__builtin_prefetch( address );
+				#endif
+			}
+
+			/*!
+				\brief Find the leaf and the position in it that key belongs
+					at, owning the path to it.
+
+				Nothing is moved, so a value can be built after the key is
+				known to be missing and before the tree changes.  It is
+				then put in place by _fill() and the leaf is split if
+				needed by _close().  The stack is left empty if the tree
+				is.
+			*/
+			inline insertion _open( Stack& stack, const key_type& key )
+			{
+				report( "Inserting " << key );
+				if( _root == 0 )
+				{
+					return insertion( _endIterator(), true );
+				}
+
+				_root = _own( _root );
+				stack.push( _root, 0 );
+				_findInsertLeaf( stack, key );
+				return _insertPosition( stack.top().first, key );
+			}
+
+			/*! \brief Open a hole at the position found by _open() and
+				put x in it, if that throws the hole is closed again */
+			template< typename Pair >
+			inline void _fill( Stack& stack, insertion& result, Pair&& x )
+			{
+				if( stack.empty() )
+				{
+					report( " Creating the root node." );
+					_createRoot();
+					stack.push( _root, 0 );
+					result.first = iterator( this, 
+						static_cast< Leaf* >( _root ), 0 );
+				}
+
+				Leaf* leaf = result.first._leaf;
+				size_type position = result.first._current;
+				
+				leaf->moveBackward( *leaf, position, leaf->size, 
+					leaf->size + 1 );
+				++leaf->size;
+
+				try
+				{
+					leaf->set( position, std::forward< Pair >( x ) );
+				}
+				catch( ... )
+				{
+					leaf->move( *leaf, position + 1, leaf->size, position );
+					--leaf->size;
+					if( leaf->size == 0 )
+					{
+						clear();
+					}
+					throw;
+				}
+			}
+
+			inline void _close( Stack& stack, insertion& result )
+			{
+				++_stats.elements;
+				_count( stack );
+				if( result.first._leaf->full() )
+				{
+					report( " Insert caused a split." );
+					_split( stack, result.first );
+				}
+			}
+
+			inline void _findInsertLeaf( Stack& stack, const key_type& key )
 			{
 				for( size_type level = _root->level; level > 0; --level )
 				{
 					assert( stack.top().first->level == level );
 					Body* body = static_cast< Body* >( stack.top().first );
-					Key* key = std::lower_bound( body->keys, 
-						body->keys + body->size, value, _compare );
-					size_type position = key - body->keys;
-					stack.push( StackElement( body->children[ position ], 
-						position ) );
+					size_type position = body->upperBound( 0, body->size,
+						key, _keyCompare );
+					body->children[ position ] = _own( 
+						body->children[ position ] );
+					stack.push( body->children[ position ], position );
 				}
 				assert( stack.top().first->leaf() );
 			}
 			
-			inline insertion _insertLeaf( Node* node, const_reference value )
+			inline insertion _insertPosition( Node* node, 
+				const key_type& key )
 			{
 				Leaf* leaf = static_cast< Leaf* >( node );
-				pointer position = std::lower_bound( leaf->data, 
-					leaf->data + leaf->size, value, _compare );
-				if( position != leaf->data + leaf->size )
+				size_type position = Search::lowerBound( leaf->entries(),
+					leaf->size, key, _keyCompare );
+				if( position != leaf->size )
 				{
-					if( !_compare( value, *position ) )
+					if( !_keyCompare( key, leaf->key( position ) ) )
 					{
-						return insertion( iterator( leaf, 
-							position - leaf->data ), false );
+						return insertion( iterator( this, leaf, position ), 
+							false );
 					}
 				}
-				std::copy_backward( position, leaf->data + leaf->size, 
-					leaf->data + leaf->size + 1 );
-				*position = value;
-				++leaf->size;
-				return insertion( iterator( leaf, position - leaf->data ), 
-					true );
+				return insertion( iterator( this, leaf, position ), true );
 			} 
 			
 			inline void _split( Stack& stack, iterator& fi )
@@ -739,7 +2056,7 @@ namespace hydrazine
 					{
 						return;
 					}
-					size_type splitKey;
+					key_type splitKey;
 					Body* right = _splitBody( body, splitKey );
 					Body* parent = static_cast< Body* >( stack.top().first );
 					_propagate( parent, body, right, position, splitKey );
@@ -754,7 +2071,7 @@ namespace hydrazine
 					return;
 				}
 				report( "  Splitting the root." );
-				size_type splitKey;
+				key_type splitKey;
 				Body* rightBody = _splitBody( body, splitKey );
 				_bumpRoot( body, rightBody, splitKey );		
 			}
@@ -765,9 +2082,16 @@ namespace hydrazine
 				Leaf* right = _allocateLeaf();
 				size_type median = leaf->size / 2;
 				right->size = leaf->size - median;
-				std::copy( leaf->data + median, leaf->data + leaf->size, 
-					right->data );
+				right->move( *leaf, median, leaf->size, 0 );
 				leaf->size = median;
+
+				right->previous = leaf;
+				right->next = leaf->next;
+				if( leaf->next != 0 )
+				{
+					leaf->next->previous = right;
+				}
+				leaf->next = right;
 				
 				if( fi._current >= median )
 				{
@@ -783,7 +2107,7 @@ namespace hydrazine
 				return right;
 			}
 			
-			inline Body* _splitBody( Body* body, size_type& key )
+			inline Body* _splitBody( Body* body, key_type& key )
 			{
 				assert( body->full() );
 				report( "   Splitting body node." );
@@ -791,92 +2115,1099 @@ namespace hydrazine
 				size_type median = body->size / 2;
 				report( "    median index is " << median );
 				right->size = body->size - median - 1;
-				std::copy( body->keys + median + 1, body->keys + body->size, 
-					right->keys );
+				right->insertKeys( 0, 0, *body, median + 1, body->size );
 				std::copy( body->children + median + 1, 
 					body->children + body->size + 1, right->children );
+				right->copyCounts( *body, median + 1, body->size + 1, 0 );
+				key = body->key( median );
+				body->eraseKeys( median, body->size, body->size );
 				body->size = median;
-				key = body->keys[ median ];
 				report( "    right size is " << right->size );
 				report( "    left size is " << body->size );
 				report( "    split on key " << key );
 				return right;
 			}
-			
-			inline void _bumpRoot( Body* left, Body* right, size_type key )
+			
+			inline void _bumpRoot( Body* left, Body* right,
+				const key_type& key )
+			{
+				assert( left == _root );
+				report( "   Bumped to level " << (left->level + 1) 
+					<< " on key " << key );
+				Body* root = _allocateBody( left->level + 1 );
+				root->insertKey( 0, 0, key );
+				root->size = 1;
+				root->children[0] = left;
+				root->children[1] = right;
+				root->setCount( 0, _total( left ) );
+				root->setCount( 1, _total( right ) );
+				report( "    left is below " << left->key( left->size - 1 ) );	
+				report( "    right is above " << key );	
+				_root = root;	
+			}
+			
+			inline void _bumpRoot( Leaf* left, Leaf* right )
+			{
+				assert( left == _root );
+				report( "    Bumped to level 1" );
+				Body* root = _allocateBody( 1 );
+				root->insertSeparator( 0, 0, left->key( left->size - 1 ),
+					right->key( 0 ) );
+				root->size = 1;
+				root->children[0] = left;	
+				root->children[1] = right;
+				root->setCount( 0, left->size );
+				root->setCount( 1, right->size );
+				_root = root;	
+			}
+		
+			inline void _propagate( Body* parent, Leaf* left, 
+				Leaf* right, size_type position )
+			{
+				assert( position <= parent->size );
+				assert( parent->children[ position ] == left );
+				report( "  Propagating the split up the tree at index " 
+					<< position << "." );
+				parent->insertSeparator( position, parent->size,
+					left->key( left->size - 1 ), right->key( 0 ) );
+				std::copy_backward( parent->children + position + 1, 
+					parent->children + parent->size + 1, 
+					parent->children + parent->size + 2 );
+				parent->copyCountsBackward( *parent, position + 1,
+					parent->size + 1, parent->size + 2 );
+				++parent->size;
+				parent->children[ position + 1 ] = right;
+				parent->setCount( position, left->size );
+				parent->setCount( position + 1, right->size );
+			}
+			
+			inline void _propagate( Body* parent, Body* left, 
+				Body* right, size_type position, const key_type& key )
+			{
+				assert( position <= parent->size );
+				assert( parent->children[ position ] == left );
+				report( "  Propagating the split up the tree at index " 
+					<< position << "." );
+				parent->insertKey( position, parent->size, key );
+				std::copy_backward( parent->children + position + 1, 
+					parent->children + parent->size + 1, 
+					parent->children + parent->size + 2 );
+				parent->copyCountsBackward( *parent, position + 1,
+					parent->size + 1, parent->size + 2 );
+				++parent->size;
+				parent->children[ position + 1 ] = right;
+				parent->setCount( position, _total( left ) );
+				parent->setCount( position + 1, _total( right ) );
+			}
+		
+		private:
+			template < typename InputIterator >
+			inline bool _sorted( InputIterator first, InputIterator last,
+				std::input_iterator_tag ) const
+			{
+				return false;
+			}
+
+			template < typename ForwardIterator >
+			inline bool _sorted( ForwardIterator first, ForwardIterator last,
+				std::forward_iterator_tag ) const
+			{
+				if( first == last )
+				{
+					return false;
+				}
+
+				for( ForwardIterator previous = first++; first != last;
+					previous = first++ )
+				{
+					if( !_keyCompare( ( *previous ).first, ( *first ).first ) )
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			/*!
+				\brief Build an empty tree from a sorted range of unique keys
+			*/
+			template < typename InputIterator >
+			inline void _bulkLoad( InputIterator first, InputIterator last,
+				double fill )
+			{
+				assert( _root == 0 );
+				assert( fill > 0.0 && fill <= 1.0 );
+
+				if( first == last )
+				{
+					return;
+				}
+
+				report( "Bulk loading with fill factor " << fill );
+
+				Builder builder( *this, fill );
+				for( ; first != last; ++first )
+				{
+					builder.push( *first );
+				}
+				builder.finish();
+			}
+
+			/*!
+				\brief Collect the leaves below a node in order
+
+				\param shared Does anything besides this tree hold the
+					node, directly or through one of its parents?
+			*/
+			inline void _leaves( Node* n, bool shared, 
+				typename Cursor::LeafVector& leaves )
+			{
+				if( n == 0 )
+				{
+					return;
+				}
+
+				shared = shared || n->shared();
+
+				if( n->leaf() )
+				{
+					leaves.push_back( typename Cursor::LeafEntry( 
+						static_cast< Leaf* >( n ), !shared ) );
+					return;
+				}
+
+				Body* body = static_cast< Body* >( n );
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					_leaves( body->children[ i ], shared, leaves );
+				}
+			}
+
+			/*!
+				\brief Walk the leaves of two trees at once, handing the
+					entries that an operation keeps to a builder
+
+				\param adopt Splice whole leaves that the walk owns into
+					the result rather than copying them
+			*/
+			inline void _combine( SetOperation operation, Cursor& left,
+				Cursor& right, Builder& builder, bool adopt )
+			{
+				bool keepLeft = operation != SetIntersection;
+				bool keepRight = operation == SetUnion 
+					|| operation == SetMerge;
+				bool keepBoth = operation != SetDifference;
+
+				while( !left.done() && !right.done() )
+				{
+					if( _take( left, right, keepLeft, builder, adopt ) )
+					{
+						continue;
+					}
+
+					if( _take( right, left, keepRight, builder, adopt ) )
+					{
+						continue;
+					}
+
+					// both sides are at the same key
+					if( keepBoth )
+					{
+						Cursor& kept = operation == SetMerge ? right : left;
+						builder.append( *kept.current(), kept.index, 
+							kept.index + 1, kept.owned() );
+					}
+
+					left.skip( 1 );
+					right.skip( 1 );
+				}
+
+				while( !left.done() )
+				{
+					_take( left, right, keepLeft, builder, adopt );
+				}
+
+				while( !right.done() )
+				{
+					_take( right, left, keepRight, builder, adopt );
+				}
+			}
+
+			/*!
+				\brief Move a cursor past the entries of its leaf that come
+					before the key of another cursor, keeping them if keep
+					is set
+
+				\return False if there were none
+			*/
+			inline bool _take( Cursor& cursor, const Cursor& other, 
+				bool keep, Builder& builder, bool adopt )
+			{
+				Leaf* leaf = cursor.current();
+				size_type end = leaf->size;
+				if( !other.done() )
+				{
+					end = cursor.index + Search::lowerBound( leaf->entries() 
+						+ cursor.index, leaf->size - cursor.index, 
+						other.key(), _keyCompare );
+				}
+
+				size_type begin = cursor.index;
+				if( end == begin )
+				{
+					return false;
+				}
+
+				// splicing the leaf in may change its size, move on first
+				bool owned = cursor.owned();
+				cursor.skip( end - begin );
+
+				if( keep )
+				{
+					// a short leaf could be folded into a neighbor and
+					// freed, so it is copied instead
+					if( adopt && owned && begin == 0 && end == leaf->size
+						&& !leaf->deficient() )
+					{
+						report( "  Splicing leaf " << leaf );
+						builder.adopt( leaf );
+						cursor.adopted.push_back( leaf );
+					}
+					else
+					{
+						builder.append( *leaf, begin, end, owned );
+					}
+				}
+
+				return true;
+			}
+
+			/*!
+				\brief Free the nodes below n that merge() did not splice
+					into the result, they are visited in the same order
+					that _leaves() collected them
+			*/
+			inline void _dismantle( Node* n, 
+				const typename Cursor::LeafPointerVector& adopted, 
+				size_type& next )
+			{
+				if( n->shared() )
+				{
+					_drop( n );
+					return;
+				}
+
+				if( n->leaf() )
+				{
+					if( next < adopted.size() && adopted[ next ] == n )
+					{
+						// now counted by the tree that it was spliced into
+						++next;
+						--_stats.leafs;
+					}
+					else
+					{
+						_free( n );
+					}
+					return;
+				}
+
+				Body* body = static_cast< Body* >( n );
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					_dismantle( body->children[ i ], adopted, next );
+				}
+				_free( body );
+			}
+
+			/*!
+				\brief Make this empty tree a structural copy of another
+			*/
+			inline void _copy( const BTree& tree )
+			{
+				assert( _root == 0 );
+				if( tree._root == 0 )
+				{
+					return;
+				}
+
+				Leaf* previous = 0;
+				_root = _clone( tree._root, previous );
+				_end = previous;
+				_stats.elements = tree._stats.elements;
+			}
+
+			inline Node* _clone( const Node* n, Leaf*& previous )
+			{
+				if( n->leaf() )
+				{
+					const Leaf* leaf = static_cast< const Leaf* >( n );
+					Leaf* copy = _allocateLeaf();
+					copy->copy( *leaf, 0, leaf->size, 0 );
+					copy->size = leaf->size;
+					copy->previous = previous;
+					if( previous == 0 )
+					{
+						_begin = copy;
+					}
+					else
+					{
+						previous->next = copy;
+					}
+					previous = copy;
+					return copy;
+				}
+
+				const Body* body = static_cast< const Body* >( n );
+				Body* copy = _allocateBody( body->level );
+				copy->size = body->size;
+				copy->copyKeys( *body, body->size );
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					copy->children[ i ] = _clone( body->children[ i ],
+						previous );
+				}
+				copy->copyCounts( *body, 0, body->size + 1, 0 );
+				return copy;
+			}
+
+		private:
+			/*!
+				\brief Remove all keys in [lower, upper) from the subtree
+					rooted at n.  A null upper bound extends to the end.
+
+				Children that are completely covered are freed without
+				being visited element by element.  On return every node
+				below n satisfies the fill invariants except possibly the
+				only child of a body left with no keys, which is repaired
+				when that body is merged into a sibling.
+
+				\return The number of elements removed
+			*/
+			inline size_type _erase( Node* n, const key_type& lower,
+				const key_type* upper )
+			{
+				if( n->leaf() )
+				{
+					Leaf* leaf = static_cast< Leaf* >( n );
+					size_type begin = Search::lowerBound( leaf->entries(),
+						leaf->size, lower, _keyCompare );
+					size_type end = leaf->size;
+					if( upper != 0 )
+					{
+						end = begin + Search::lowerBound( leaf->entries()
+							+ begin, end - begin, *upper, _keyCompare );
+					}
+					size_type erased = end - begin;
+					if( erased != 0 )
+					{
+						// moving a key onto itself may empty it
+						leaf->move( *leaf, end, leaf->size, begin );
+						leaf->size -= erased;
+						// like std::map, release what the erased values hold
+						leaf->clear( leaf->size, leaf->size + erased );
+					}
+					report( "  Erased " << erased << " from leaf " << leaf );
+					return erased;
+				}
+
+				Body* body = static_cast< Body* >( n );
+				size_type first = body->upperBound( 0, body->size, lower,
+					_keyCompare );
+				size_type last = body->size;
+				if( upper != 0 )
+				{
+					last = body->upperBound( first, body->size, *upper,
+						_keyCompare );
+				}
+
+				size_type erased = 0;
+
+				if( first + 1 < last )
+				{
+					Leaf* left = _rightmost( body->children[ first ] );
+					Leaf* right = _leftmost( body->children[ last ] );
+					left->next = right;
+					right->previous = left;
+				}
+
+				for( size_type i = first + 1; i < last; ++i )
+				{
+					report( "  Releasing subtree " << body->children[ i ] );
+					erased += _drop( body->children[ i ] );
+				}
+
+				body->children[ first ] = _own( body->children[ first ] );
+				erased += _erase( body->children[ first ], lower, upper );
+
+				if( first != last )
+				{
+					body->children[ last ] = _own( body->children[ last ] );
+					erased += _erase( body->children[ last ], lower, upper );
+					body->eraseKeys( first, last - 1, body->size );
+					std::copy( body->children + last,
+						body->children + body->size + 1,
+						body->children + first + 1 );
+					body->size -= last - first - 1;
+				}
+
+				_fixChildren( body );
+
+				return erased;
+			}
+
+			/*!
+				\brief Drop empty levels from the top of the tree
+			*/
+			inline void _collapseRoot()
+			{
+				while( !_root->leaf() && _root->size == 0 )
+				{
+					report( "  Collapsing the root." );
+					Body* body = static_cast< Body* >( _root );
+					_root = body->children[ 0 ];
+					_free( body );
+				}
+
+				if( _root->size == 0 )
+				{
+					assert( _root->leaf() );
+					_free( _root );
+					_root = 0;
+					_begin = 0;
+					_end = 0;
+				}
+			}
+
+			inline Leaf* _leftmost( Node* n ) const
+			{
+				while( !n->leaf() )
+				{
+					n = static_cast< Body* >( n )->children[ 0 ];
+				}
+				return static_cast< Leaf* >( n );
+			}
+
+			inline Leaf* _rightmost( Node* n ) const
+			{
+				while( !n->leaf() )
+				{
+					Body* body = static_cast< Body* >( n );
+					n = body->children[ body->size ];
+				}
+				return static_cast< Leaf* >( n );
+			}
+
+			/*! \brief The leaf that key belongs in, the tree must not be
+				empty */
+			template< typename K >
+			inline Leaf* _findLeaf( const K& key ) const
+			{
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					node = body->children[ body->upperBound( 0, body->size,
+						key, _keyCompare ) ];
+				}
+				return static_cast< Leaf* >( node );
+			}
+
+			/*! \brief find_batch(), owning the path to each key first if
+				the iterators are mutable */
+			template < bool Own, typename InputIterator, 
+				typename OutputIterator >
+			inline OutputIterator _findBatch( InputIterator first,
+				InputIterator last, OutputIterator out )
+			{
+				Leaf* leaf = 0;
+				for( ; first != last; ++first, ++out )
+				{
+					if( Own && _shared() )
+					{
+						_ownPath( *first );
+						leaf = 0;
+					}
+					*out = _findNear( leaf, *first );
+				}
+				return out;
+			}
+
+			/*!
+				\brief Find a key starting from the leaf of an earlier
+					search, then its neighbor, and then the root
+
+				\param leaf The leaf of the earlier search, set to the leaf
+					that holds key or would hold it
+			*/
+			inline iterator _findNear( Leaf*& leaf, const key_type& key )
+			{
+				if( _root == 0 )
+				{
+					return _endIterator();
+				}
+
+				if( leaf != 0 && leaf->size != 0 
+					&& !_keyCompare( key, leaf->key( 0 ) ) )
+				{
+					if( _keyCompare( leaf->key( leaf->size - 1 ), key ) )
+					{
+						Leaf* next = leaf->next;
+						if( next == 0 || _keyCompare( key, next->key( 0 ) ) )
+						{
+							// The key falls between two neighboring leaves
+							return _endIterator();
+						}
+						leaf = _keyCompare( next->key( next->size - 1 ), key )
+							? _findLeaf( key ) : next;
+						_prefetch( leaf->next );
+					}
+				}
+				else
+				{
+					leaf = _findLeaf( key );
+				}
+
+				size_type index = Search::lowerBound( leaf->entries(),
+					leaf->size, key, _keyCompare );
+				if( index == leaf->size 
+					|| _keyCompare( key, leaf->key( index ) ) )
+				{
+					return _endIterator();
+				}
+				return iterator( this, leaf, index );
+			}
+
+			inline bool _deficient( const Node* n ) const
+			{
+				if( n->leaf() )
+				{
+					return static_cast< const Leaf* >( n )->deficient();
+				}
+				return static_cast< const Body* >( n )->deficient();
+			}
+
+			/*!
+				\brief Can the child at index and its right sibling be
+					merged into a single node?
+			*/
+			inline bool _fits( const Body* parent, size_type index ) const
+			{
+				const Node* left = parent->children[ index ];
+				const Node* right = parent->children[ index + 1 ];
+				if( left->leaf() )
+				{
+					return left->size + right->size < MaxLeafs;
+				}
+				return left->size + right->size + 1 < MaxNodes;
+			}
+
+			/*!
+				\brief Repair every deficient child of a body
+			*/
+			inline void _fixChildren( Body* body )
+			{
+				for( size_type i = 0; i <= body->size && body->size > 0; )
+				{
+					if( _deficient( body->children[ i ] ) )
+					{
+						_fixChild( body, i );
+						i = 0;
+					}
+					else
+					{
+						++i;
+					}
+				}
+				_recount( body );
+			}
+
+			/*!
+				\brief Repair a deficient child by merging it with a sibling,
+					or by borrowing from one when both will not fit in a
+					single node.
+			*/
+			inline void _fixChild( Body* parent, size_type index )
+			{
+				while( parent->size > 0
+					&& _deficient( parent->children[ index ] ) )
+				{
+					size_type left = index > 0 ? index - 1 : index;
+					if( _fits( parent, left ) )
+					{
+						_merge( parent, left );
+						index = left;
+					}
+					else
+					{
+						_redistribute( parent, left );
+						break;
+					}
+				}
+			}
+
+			/*!
+				\brief Merge the child at index with its right sibling
+			*/
+			inline void _merge( Body* parent, size_type index )
+			{
+				report( "  Merging children " << index << " and "
+					<< ( index + 1 ) << " of " << parent );
+				_ownChildren( parent, index );
+				Node* right = parent->children[ index + 1 ];
+
+				if( right->leaf() )
+				{
+					Leaf* l = static_cast< Leaf* >( parent->children[ index ] );
+					Leaf* r = static_cast< Leaf* >( right );
+					l->move( *r, 0, r->size, l->size );
+					l->size += r->size;
+					l->next = r->next;
+					if( r->next != 0 )
+					{
+						r->next->previous = l;
+					}
+					if( _end == r )
+					{
+						_end = l;
+					}
+				}
+				else
+				{
+					Body* l = static_cast< Body* >( parent->children[ index ] );
+					Body* r = static_cast< Body* >( right );
+					l->insertKey( l->size, l->size, parent->key( index ) );
+					l->insertKeys( l->size + 1, l->size + 1, *r, 0, r->size );
+					std::copy( r->children, r->children + r->size + 1,
+						l->children + l->size + 1 );
+					l->size += r->size + 1;
+				}
+
+				parent->eraseKeys( index, index + 1, parent->size );
+				std::copy( parent->children + index + 2,
+					parent->children + parent->size + 1,
+					parent->children + index + 1 );
+				--parent->size;
+
+				_free( right );
+
+				if( !parent->children[ index ]->leaf() )
+				{
+					_fixChildren( static_cast< Body* >(
+						parent->children[ index ] ) );
+				}
+			}
+
+			/*!
+				\brief Even out the child at index and its right sibling
+			*/
+			inline void _redistribute( Body* parent, size_type index )
+			{
+				report( "  Redistributing children " << index << " and "
+					<< ( index + 1 ) << " of " << parent );
+				_ownChildren( parent, index );
+				if( parent->children[ index ]->leaf() )
+				{
+					Leaf* l = static_cast< Leaf* >( parent->children[ index ] );
+					Leaf* r = static_cast< Leaf* >(
+						parent->children[ index + 1 ] );
+					size_type size = ( l->size + r->size ) / 2;
+
+					if( l->size > size )
+					{
+						size_type moved = l->size - size;
+						r->moveBackward( *r, 0, r->size, r->size + moved );
+						r->move( *l, size, l->size, 0 );
+						l->size = size;
+						r->size += moved;
+					}
+					else
+					{
+						size_type moved = size - l->size;
+						l->move( *r, 0, moved, l->size );
+						r->move( *r, moved, r->size, 0 );
+						l->size = size;
+						r->size -= moved;
+					}
+
+					parent->setSeparator( index, parent->size,
+						l->key( l->size - 1 ), r->key( 0 ) );
+				}
+				else
+				{
+					Body* l = static_cast< Body* >( parent->children[ index ] );
+					Body* r = static_cast< Body* >(
+						parent->children[ index + 1 ] );
+					size_type size = ( l->size + r->size ) / 2;
+
+					if( l->size > size )
+					{
+						size_type moved = l->size - size;
+						r->insertKey( 0, r->size, parent->key( index ) );
+						r->insertKeys( 0, r->size + 1, *l, size + 1, 
+							l->size );
+						std::copy_backward( r->children,
+							r->children + r->size + 1,
+							r->children + r->size + 1 + moved );
+						std::copy( l->children + size + 1,
+							l->children + l->size + 1, r->children );
+						parent->setKey( index, parent->size, l->key( size ) );
+						l->eraseKeys( size, l->size, l->size );
+						l->size = size;
+						r->size += moved;
+					}
+					else
+					{
+						size_type moved = size - l->size;
+						l->insertKey( l->size, l->size, parent->key( index ) );
+						l->insertKeys( l->size + 1, l->size + 1, *r, 0, 
+							moved - 1 );
+						std::copy( r->children, r->children + moved,
+							l->children + l->size + 1 );
+						parent->setKey( index, parent->size, 
+							r->key( moved - 1 ) );
+						r->eraseKeys( 0, moved, r->size );
+						std::copy( r->children + moved,
+							r->children + r->size + 1, r->children );
+						l->size = size;
+						r->size -= moved;
+					}
+
+					_fixChildren( l );
+					_fixChildren( r );
+				}
+			}
+
+		private:
+			/*! \brief Find the leaf holding the element at position k,
+				leaving the position within that leaf in k */
+			inline Leaf* _nth( size_type& k ) const
+			{
+				static_assert( Statistics::Enabled, 
+					"nth() needs the OrderStatistics policy" );
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					const Body* body = static_cast< const Body* >( node );
+					size_type i = 0;
+					for( ; k >= body->count( i ); ++i )
+					{
+						k -= body->count( i );
+					}
+					node = body->children[ i ];
+				}
+				return static_cast< Leaf* >( node );
+			}
+
+			/*! \brief The number of elements below n */
+			inline size_type _total( const Node* n ) const
+			{
+				if( n->leaf() )
+				{
+					return n->size;
+				}
+
+				size_type total = 0;
+				if( Statistics::Enabled )
+				{
+					const Body* body = static_cast< const Body* >( n );
+					for( size_type i = 0; i <= body->size; ++i )
+					{
+						total += body->count( i );
+					}
+				}
+				return total;
+			}
+
+			/*! \brief Recompute the counts of a body from its children */
+			inline void _recount( Body* body )
+			{
+				if( Statistics::Enabled )
+				{
+					for( size_type i = 0; i <= body->size; ++i )
+					{
+						body->setCount( i, _total( body->children[ i ] ) );
+					}
+				}
+			}
+
+			/*! \brief Count a new element on every body along a path */
+			inline void _count( Stack& stack )
+			{
+				if( Statistics::Enabled )
+				{
+					for( size_type i = 1; i < stack.size(); ++i )
+					{
+						static_cast< Body* >( stack[ i - 1 ].first )->addCount(
+							stack[ i ].second, 1 );
+					}
+				}
+			}
+
+		private:
+			/*!
+				\brief Drop the subtree rooted at n from the tree, freeing
+					every node that is not held by a snapshot.
+
+				\return The number of elements that were stored below n
+			*/
+			inline size_type _drop( Node* n )
+			{
+				if( n->shared() )
+				{
+					size_type elements = _forget( n );
+					_unreference( n, _bodyAllocator, _leafAllocator );
+					return elements;
+				}
+
+				size_type elements = 0;
+				if( n->leaf() )
+				{
+					elements = n->size;
+				}
+				else
+				{
+					Body* body = static_cast< Body* >( n );
+					for( size_type i = 0; i <= n->size; ++i )
+					{
+						elements += _drop( body->children[ i ] );
+					}
+				}
+				_free( n );
+				return elements;
+			}
+
+			/*!
+				\brief Stop counting the nodes below n, they are still held
+					by a snapshot.
+
+				\return The number of elements that were stored below n
+			*/
+			inline size_type _forget( const Node* n )
+			{
+				if( n->leaf() )
+				{
+					--_stats.leafs;
+					return n->size;
+				}
+
+				size_type elements = 0;
+				const Body* body = static_cast< const Body* >( n );
+				for( size_type i = 0; i <= n->size; ++i )
+				{
+					elements += _forget( body->children[ i ] );
+				}
+				--_stats.bodies;
+				return elements;
+			}
+
+			/*!
+				\brief Drop a reference to n, freeing it and dropping its
+					children if it was the last one.
+			*/
+			static inline void _unreference( Node* n, 
+				BodyAllocator& bodyAllocator, LeafAllocator& leafAllocator )
+			{
+				if( !n->release() )
+				{
+					return;
+				}
+
+				if( n->leaf() )
+				{
+					static_cast< Leaf* >( n )->destroy();
+					leafAllocator.deallocate( static_cast< Leaf* >( n ), 1 );
+					return;
+				}
+				
+				Body* body = static_cast< Body* >( n );
+				for( size_type i = 0; i <= n->size; ++i )
+				{
+					_unreference( body->children[ i ], bodyAllocator, 
+						leafAllocator );
+				}
+				body->destroy();
+				bodyAllocator.deallocate( body, 1 );
+			}
+
+			/*!
+				\brief Get a version of n that only this tree holds, copying
+					it if a snapshot shares it.
+
+				The caller replaces its pointer to n with the result.
+			*/
+			inline Node* _own( Node* n )
+			{
+				if( !n->shared() )
+				{
+					return n;
+				}
+
+				report( "  Copying shared node " << n );
+
+				Node* result = 0;
+
+				if( n->leaf() )
+				{
+					Leaf* leaf = static_cast< Leaf* >( n );
+					Leaf* copy = _allocateLeaf();
+					copy->copy( *leaf, 0, leaf->size, 0 );
+					copy->size = leaf->size;
+					copy->previous = leaf->previous;
+					copy->next = leaf->next;
+					if( leaf->previous != 0 )
+					{
+						leaf->previous->next = copy;
+					}
+					if( leaf->next != 0 )
+					{
+						leaf->next->previous = copy;
+					}
+					if( _begin == leaf )
+					{
+						_begin = copy;
+					}
+					if( _end == leaf )
+					{
+						_end = copy;
+					}
+					--_stats.leafs;
+					result = copy;
+				}
+				else
+				{
+					Body* body = static_cast< Body* >( n );
+					Body* copy = _allocateBody( body->level );
+					copy->size = body->size;
+					copy->copyKeys( *body, body->size );
+					std::copy( body->children, 
+						body->children + body->size + 1, copy->children );
+					copy->copyCounts( *body, 0, body->size + 1, 0 );
+					for( size_type i = 0; i <= body->size; ++i )
+					{
+						copy->children[ i ]->reference();
+					}
+					--_stats.bodies;
+					result = copy;
+				}
+
+				_unreference( n, _bodyAllocator, _leafAllocator );
+				return result;
+			}
+
+			/*! \brief begin() and end() without owning shared pages */
+			inline iterator _beginIterator()
 			{
-				assert( left == _root );
-				report( "   Bumped to level " << (left->level + 1) 
-					<< " on key " << key );
-				Body* root = _allocateBody( left->level + 1 );
-				root->size = 1;
-				root->keys[0] = key;
-				root->children[0] = left;
-				root->children[1] = right;
-				report( "    left is below " << left->keys[ left->size - 1 ] );	
-				report( "    right is above " << key );	
-				_root = root;	
+				return iterator( this, _begin, 0 );
 			}
-			
-			inline void _bumpRoot( Leaf* left, Leaf* right )
+
+			inline iterator _endIterator()
 			{
-				assert( left == _root );
-				report( "    Bumped to level 1" );
-				Body* root = _allocateBody( 1 );
-				root->size = 1;
-				root->keys[0] = right->data[0].first;
-				root->children[0] = left;	
-				root->children[1] = right;
-				_root = root;	
+				return iterator( this, _end, _end != 0 ? _end->size : 0 );
 			}
-		
-			inline void _propagate( Body* parent, Leaf* left, 
-				Leaf* right, size_type position )
+
+			/*! \brief Own the pages on the path to the leaf that key
+				belongs in, and on the path to the leaf after it, which
+				is as far as a lookup for key can land */
+			template< typename K >
+			inline void _ownPath( const K& key )
 			{
-				assert( position <= parent->size );
-				assert( parent->children[ position ] == left );
-				report( "  Propagating the split up the tree at index " 
-					<< position << "." );
-				std::copy_backward( parent->keys + position, 
-					parent->keys + parent->size, 
-					parent->keys + parent->size + 1 );
-				std::copy_backward( parent->children + position + 1, 
-					parent->children + parent->size + 1, 
-					parent->children + parent->size + 2 );
-				++parent->size;
-				parent->keys[ position ] = right->data[0].first;
-				parent->children[ position + 1 ] = right;
+				if( _root == 0 || !_shared() )
+				{
+					return;
+				}
+
+				Stack stack;
+				_root = _own( _root );
+				stack.push( _root, 0 );
+				while( !stack.top().first->leaf() )
+				{
+					Body* body = static_cast< Body* >( stack.top().first );
+					size_type position = body->upperBound( 0, body->size,
+						key, _keyCompare );
+					body->children[ position ] = _own( 
+						body->children[ position ] );
+					stack.push( body->children[ position ], position );
+				}
+
+				// the next leaf is the leftmost one below the right sibling
+				//  of the deepest node on the path that has one
+				while( stack.size() > 1 && stack.top().second 
+					== stack[ stack.size() - 2 ].first->size )
+				{
+					stack.pop();
+				}
+
+				if( stack.size() == 1 )
+				{
+					return;
+				}
+
+				size_type position = stack.top().second + 1;
+				stack.pop();
+				Body* body = static_cast< Body* >( stack.top().first );
+				body->children[ position ] = _own( body->children[ position ] );
+
+				Node* node = body->children[ position ];
+				while( !node->leaf() )
+				{
+					body = static_cast< Body* >( node );
+					body->children[ 0 ] = _own( body->children[ 0 ] );
+					node = body->children[ 0 ];
+				}
 			}
-			
-			inline void _propagate( Body* parent, Body* left, 
-				Body* right, size_type position, size_type& key )
+
+			/*! \brief Own the pages on the path to the first leaf, or to
+				the last one if Last is set */
+			template< bool Last >
+			inline void _ownEdge()
 			{
-				assert( position <= parent->size );
-				assert( parent->children[ position ] == left );
-				report( "  Propagating the split up the tree at index " 
-					<< position << "." );
-				std::copy_backward( parent->keys + position, 
-					parent->keys + parent->size, 
-					parent->keys + parent->size + 1 );
-				std::copy_backward( parent->children + position + 1, 
-					parent->children + parent->size + 1, 
-					parent->children + parent->size + 2 );
-				++parent->size;
-				parent->keys[ position ] = key;
-				parent->children[ position + 1 ] = right;
+				if( _root == 0 || !_shared() )
+				{
+					return;
+				}
+
+				_root = _own( _root );
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					size_type position = Last ? body->size : 0;
+					body->children[ position ] = _own( 
+						body->children[ position ] );
+					node = body->children[ position ];
+				}
 			}
-		
-			inline void _clear( Node* n )
+
+			/*! \brief The version of a leaf of the tree that only the tree
+				holds, copying the pages on the path to it if a snapshot
+				shares them */
+			inline Leaf* _ownLeaf( Leaf* leaf )
 			{
-				if( !n->leaf() )
+				if( !_shared() )
 				{
-					Body* body = static_cast< Body* >( n );
-					for( size_type i = 0; i < n->size; ++i )
-					{
-						_clear( body->children[ i ] );
-						_free( body->children[ i ] );
-					}
+					return leaf;
 				}
+
+				// the leaf may be left to the snapshot, keep its key
+				key_type key = leaf->key( 0 );
+				_ownPath( key );
+				return _findLeaf( key );
+			}
+
+			/*! \brief May a live snapshot hold pages of the tree? */
+			inline bool _shared() const
+			{
+				return _snapshots != 0 && _snapshots->live();
+			}
+
+			/*! \brief Own the child at index and its right sibling */
+			inline void _ownChildren( Body* parent, size_type index )
+			{
+				parent->children[ index ] = _own( parent->children[ index ] );
+				parent->children[ index + 1 ] = _own( 
+					parent->children[ index + 1 ] );
 			}
 		
 			inline Body* _allocateBody( size_type level )
@@ -899,34 +3230,36 @@ namespace hydrazine
 			{
 				if( n->leaf() )
 				{
+					static_cast< Leaf* >( n )->destroy();
 					_leafAllocator.deallocate( static_cast< Leaf* >( n ), 1 );
 					--_stats.leafs;
 				}
 				else
 				{
+					static_cast< Body* >( n )->destroy();
 					_bodyAllocator.deallocate( static_cast< Body* >( n ), 1 );				
 					--_stats.bodies;
 				}
 			}
 			
-			inline void _insert( iterator position, const_reference val )
-			{
-				assert( "_insert not implemented." == 0 );
-			}
-			
 			/*!
 				\brief Observers
 			*/
 		public:
 			inline key_compare key_comp() const
 			{
-				return _compare.compare;
+				return _keyCompare;
 			}
 			
 			inline value_compare value_comp() const
 			{
 				return _compare;
 			}
+
+			inline allocator_type get_allocator() const
+			{
+				return _allocator;
+			}
 			
 			/*!
 				\brief Map Operations
@@ -934,135 +3267,306 @@ namespace hydrazine
 		public:
 			inline iterator find( const key_type& x )
 			{
-				iterator result = lower_bound( x );
 				report( "Finding key " << x );
-				if( result != end() )
-				{
-					if( !_keyCompare( x, result->first ) )
-					{
-						report( " Found value " 
-							<< result->second );
-						return result;
-					}
-				}
-				reportE( result == end(), " Could not find value for key." );
-				return end();
+				_ownPath( x );
+				return _find( x );
 			}
 			
 			inline const_iterator find( const key_type& x ) const
 			{
-				const_iterator result = lower_bound( x );
 				report( "Finding key " << x );
-				if( result != end() )
-				{
-					if( !_compareKey( x, result->first ) )
-					{
-						report( " Found value " 
-							<< result->second );
-						return result;
-					}
-				}
-				reportE( result == end(), " Could not find value for key." );
-				return end();
+				return const_cast< BTree* >( this )->_find( x );
 			}
 			
 			inline size_type count( const key_type& x ) const
 			{
 				return find( x ) != end();
 			}
-			
-			inline iterator lower_bound( const key_type& x )
+
+			/*!
+				\brief Heterogeneous lookup.
+
+				If Compare defines is_transparent, find, count, lower_bound,
+				upper_bound, and equal_range also take any K that Compare
+				can order against keys, so looking up a std::string key by
+				a const char* does not need to build a temporary string.
+			*/
+			template< typename K >
+			inline typename Lookup< K, iterator >::type find( const K& x )
 			{
-				if ( _root == 0 ) return end();
-				Node* node = _root;
-				
-				while( !node->leaf() )
+				_ownPath( x );
+				return _find( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, const_iterator >::type find( 
+				const K& x ) const
+			{
+				return const_cast< BTree* >( this )->_find( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, size_type >::type count( 
+				const K& x ) const
+			{
+				return find( x ) != end();
+			}
+
+			template< typename K >
+			inline typename Lookup< K, iterator >::type lower_bound( 
+				const K& x )
+			{
+				_ownPath( x );
+				return _lowerBound( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, const_iterator >::type lower_bound( 
+				const K& x ) const
+			{
+				return const_cast< BTree* >( this )->_lowerBound( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, iterator >::type upper_bound( 
+				const K& x )
+			{
+				_ownPath( x );
+				return _upperBound( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, const_iterator >::type upper_bound( 
+				const K& x ) const
+			{
+				return const_cast< BTree* >( this )->_upperBound( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, std::pair< iterator, iterator > >::type
+				equal_range( const K& x )
+			{
+				_ownPath( x );
+				return _equalRange( x );
+			}
+
+			template< typename K >
+			inline typename Lookup< K, 
+				std::pair< const_iterator, const_iterator > >::type
+				equal_range( const K& x ) const
+			{
+				return const_cast< BTree* >( this )->_equalRange( x );
+			}
+
+			/*!
+				\brief Look up a batch of keys, writing an iterator for each
+					one to out in the order of the keys, end() if it is
+					missing.
+
+				Each key is first looked for in the leaf that held the key
+				before it and then in the next leaf, so keys that arrive in
+				nearly sorted order mostly skip the descent from the root.
+			*/
+			template < typename InputIterator, typename OutputIterator >
+			inline OutputIterator find_batch( InputIterator first,
+				InputIterator last, OutputIterator out )
+			{
+				return _findBatch< true >( first, last, out );
+			}
+
+			template < typename InputIterator, typename OutputIterator >
+			inline OutputIterator find_batch( InputIterator first,
+				InputIterator last, OutputIterator out ) const
+			{
+				return const_cast< BTree* >( this )->template 
+					_findBatch< false >( first, last, out );
+			}
+
+			/*!
+				\brief Order Statistics, these need the OrderStatistics policy
+			*/
+		public:
+			/*! \brief The element at position k in order, end() if there
+				are not that many elements */
+			inline iterator nth( size_type k )
+			{
+				if( k >= size() )
 				{
-					Body* body = static_cast< Body* >( node );
-					Key* key = std::lower_bound( body->keys, 
-						body->keys + body->size, x, _keyCompare );
-					node = body->children[ key - body->keys ];
+					return _endIterator();
 				}
-				
-				Leaf* leaf = static_cast< Leaf* >( node );
-				value_type* fi = std::lower_bound( leaf->data, 
-					leaf->data + leaf->size, x, _compare );
-				size_type index = fi - leaf->data;
-				if( index == leaf->size )
+				Leaf* leaf = _nth( k );
+				if( _shared() )
+				{
+					_ownPath( leaf->key( k ) );
+					return _lowerBound( leaf->key( k ) );
+				}
+				return iterator( this, leaf, k );
+			}
+
+			inline const_iterator nth( size_type k ) const
+			{
+				if( k >= size() )
 				{
 					return end();
 				}
-				return iterator( leaf, index );
+				Leaf* leaf = _nth( k );
+				return const_iterator( leaf, k );
+			}
+
+			/*! \brief The number of elements with keys less than x */
+			inline size_type rank( const key_type& x ) const
+			{
+				static_assert( Statistics::Enabled, 
+					"rank() needs the OrderStatistics policy" );
+				if( _root == 0 )
+				{
+					return 0;
+				}
+				size_type result = 0;
+				const Node* node = _root;
+				while( !node->leaf() )
+				{
+					const Body* body = static_cast< const Body* >( node );
+					size_type position = body->upperBound( 0, body->size,
+						x, _keyCompare );
+					for( size_type i = 0; i < position; ++i )
+					{
+						result += body->count( i );
+					}
+					node = body->children[ position ];
+				}
+				const Leaf* leaf = static_cast< const Leaf* >( node );
+				return result + Search::lowerBound( leaf->entries(),
+					leaf->size, x, _keyCompare );
+			}
+
+			/*! \brief The position of an iterator in order */
+			inline size_type rank( const_iterator position ) const
+			{
+				if( position == end() )
+				{
+					return size();
+				}
+				return rank( position->first );
+			}
+
+			/*! \brief The number of elements in [first, last), the same
+				as std::distance but logarithmic rather than linear */
+			inline difference_type distance( const_iterator first, 
+				const_iterator last ) const
+			{
+				return difference_type( rank( last ) ) 
+					- difference_type( rank( first ) );
+			}
+			
+			inline iterator lower_bound( const key_type& x )
+			{
+				_ownPath( x );
+				return _lowerBound( x );
 			}
 			
 			inline const_iterator lower_bound( const key_type& x ) const
 			{
-				return lower_bound( x );
+				return const_cast< BTree* >( this )->_lowerBound( x );
 			}
 			
 			inline iterator upper_bound( const key_type& x )
 			{
-				iterator result = lower_bound( x );
-				if( result != end() )
+				_ownPath( x );
+				return _upperBound( x );
+			}
+
+			inline const_iterator upper_bound( const key_type& x ) const
+			{
+				return const_cast< BTree* >( this )->_upperBound( x );
+			}
+
+			inline std::pair< iterator, iterator > equal_range( const key_type& x )
+			{
+				_ownPath( x );
+				return _equalRange( x );
+			}
+			
+			inline std::pair< const_iterator, const_iterator > equal_range( 
+				const key_type& x ) const
+			{
+				return const_cast< BTree* >( this )->_equalRange( x );
+			}
+
+		private:
+			template< typename K >
+			inline iterator _find( const K& x )
+			{
+				iterator result = _lowerBound( x );
+				if( result != _endIterator() )
 				{
-					if( !_compare( x, *result ) )
+					if( !_keyCompare( x, result->first ) )
 					{
-						++result;
+						report( " Found value " 
+							<< result->second );
+						return result;
 					}
 				}
-				return result;
+				reportE( result == _endIterator(), " Could not find value for key." );
+				return _endIterator();
 			}
 
-			inline const_iterator upper_bound( const key_type& x ) const
+			template< typename K >
+			inline iterator _lowerBound( const K& x )
 			{
-				const_iterator result = lower_bound( x );
-				if( result != end() )
+				if ( _root == 0 ) return _endIterator();
+				Leaf* leaf = _findLeaf( x );
+				size_type index = Search::lowerBound( leaf->entries(),
+					leaf->size, x, _keyCompare );
+				if( index == leaf->size )
 				{
-					if( !_compare( x, *result ) )
+					if( leaf->next == 0 )
 					{
-						++result;
+						return _endIterator();
 					}
+					return iterator( this, leaf->next, 0 );
 				}
-				return result;
+				return iterator( this, leaf, index );
 			}
 
-			inline std::pair< iterator, iterator > equal_range( const key_type& x )
+			template< typename K >
+			inline iterator _upperBound( const K& x )
 			{
-				std::pair< iterator, iterator > result;
-				result.first = lower_bound( x );
-				result.second = result.first;
-				if( result.second != end() )
+				iterator result = _lowerBound( x );
+				if( result != _endIterator() )
 				{
-					if( !_compare( x, *result.second ) )
+					if( !_compare( x, *result ) )
 					{
-						++result.second;
+						result._increment();
 					}
 				}
 				return result;
 			}
-			
-			inline std::pair< const_iterator, const_iterator > equal_range( 
-				const key_type& x ) const
+
+			template< typename K >
+			inline std::pair< iterator, iterator > _equalRange( const K& x )
 			{
 				std::pair< iterator, iterator > result;
-				result.first = lower_bound( x );
+				result.first = _lowerBound( x );
 				result.second = result.first;
-				if( result.second != end() )
+				if( result.second != _endIterator() )
 				{
 					if( !_compare( x, *result.second ) )
 					{
-						++result.second;
+						result.second._increment();
 					}
 				}
-				return result;			
+				return result;
 			}
 
 	};
 	
-	template <typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize>
-	bool operator==(const BTree< Key, T, Compare, Allocator, PageSize>& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y)
+	template < typename Key, typename T, typename Compare, typename Allocator, 
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator==(const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y)
 	{
 		if( x.size() != y.size() )
 		{
@@ -1072,61 +3576,142 @@ namespace hydrazine
 	}
 
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	bool operator< (const BTree< Key, T, Compare, Allocator, PageSize >& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y)
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator< (const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y)
 	{
 		return std::lexicographical_compare( x.begin(), x.end(), y.begin(), 
 			y.end(), x.value_comp() );
 	}
 
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	bool operator!=(const BTree< Key, T, Compare, Allocator, PageSize >& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y)
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator!=(const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y)
 	{
 		return !( x == y );
 	}
 	
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	bool operator> (const BTree< Key, T, Compare, Allocator, PageSize >& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y)
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator> (const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y)
 	{
 		return y < x;
 	}
 	
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	bool operator>=(const BTree< Key, T, Compare, Allocator, PageSize >& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y)
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator>=(const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y)
 	{
 		return !( x < y );
 	}
 	
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	bool operator<=(const BTree< Key, T, Compare, Allocator, PageSize >& x,
-		const BTree< Key, T, Compare, Allocator, PageSize >& y )
+		size_t PageSize, typename Layout, typename Statistics >
+	bool operator<=(const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y )
 	{
 		return !( x > y );
 	}
 	
+	/*!
+		\brief The elements of either tree, with values from left for keys
+			in both, see BTree::combine().
+	*/
+	template < typename Key, typename T, typename Compare, typename Allocator, 
+		size_t PageSize, typename Layout, typename Statistics >
+	BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+		set_union( const BTree< Key, T, Compare, Allocator, PageSize, 
+		Layout, Statistics >& left, const BTree< Key, T, Compare, 
+		Allocator, PageSize, Layout, Statistics >& right )
+	{
+		BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+			result( left.key_comp(), left.get_allocator() );
+		result.combine( SetUnion, left, right );
+		return result;
+	}
+
+	/*!
+		\brief The elements of left whose keys are in right as well
+	*/
+	template < typename Key, typename T, typename Compare, typename Allocator, 
+		size_t PageSize, typename Layout, typename Statistics >
+	BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+		set_intersection( const BTree< Key, T, Compare, Allocator, PageSize, 
+		Layout, Statistics >& left, const BTree< Key, T, Compare, 
+		Allocator, PageSize, Layout, Statistics >& right )
+	{
+		BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+			result( left.key_comp(), left.get_allocator() );
+		result.combine( SetIntersection, left, right );
+		return result;
+	}
+
+	/*!
+		\brief The elements of left whose keys are not in right
+	*/
+	template < typename Key, typename T, typename Compare, typename Allocator, 
+		size_t PageSize, typename Layout, typename Statistics >
+	BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+		set_difference( const BTree< Key, T, Compare, Allocator, PageSize, 
+		Layout, Statistics >& left, const BTree< Key, T, Compare, 
+		Allocator, PageSize, Layout, Statistics >& right )
+	{
+		BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+			result( left.key_comp(), left.get_allocator() );
+		result.combine( SetDifference, left, right );
+		return result;
+	}
+
+	/*!
+		\brief Apply the changes in delta to base, the elements of either
+			tree with values from delta for keys in both.  Neither tree is
+			changed, see BTree::merge() to move delta into base instead.
+	*/
+	template < typename Key, typename T, typename Compare, typename Allocator, 
+		size_t PageSize, typename Layout, typename Statistics >
+	BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+		merge( const BTree< Key, T, Compare, Allocator, PageSize, 
+		Layout, Statistics >& base, const BTree< Key, T, Compare, 
+		Allocator, PageSize, Layout, Statistics >& delta )
+	{
+		BTree< Key, T, Compare, Allocator, PageSize, Layout, Statistics > 
+			result( base.key_comp(), base.get_allocator() );
+		result.combine( SetMerge, base, delta );
+		return result;
+	}
+
 	// specialized algorithms:
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
-	void swap( BTree< Key, T, Compare, Allocator, PageSize >& x,
-		BTree< Key, T, Compare, Allocator, PageSize >& y )
+		size_t PageSize, typename Layout, typename Statistics >
+	void swap( BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& x,
+		BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& y )
 	{
 		x.swap( y );
 	}
 	
 	template < typename Key, typename T, typename Compare, typename Allocator, 
-		size_t PageSize >
+		size_t PageSize, typename Layout, typename Statistics >
 	std::ostream& operator<<( std::ostream& out, 
-		const BTree< Key, T, Compare, Allocator, PageSize >& tree )
+		const BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics >& tree )
 	{
-		typedef BTree< Key, T, Compare, Allocator, PageSize > BTree;
+		typedef BTree< Key, T, Compare, Allocator, PageSize, Layout,
+		Statistics > BTree;
 		typedef std::stack< const typename BTree::Node* > NodeStack;
 
 		if( tree._root == 0 )
@@ -1158,18 +3743,17 @@ namespace hydrazine
 			{
 				const typename BTree::Leaf* leaf 
 					= static_cast< const typename BTree::Leaf* >( node );
-				out << "<head> leaf_" << leaf->data->first 
+				out << "<head> leaf_" << leaf->key( 0 ) 
 					<< " (" << leaf->size << ")" << " | { { ";
-				for( typename BTree::const_pointer fi = leaf->data; 
-					fi != leaf->data + leaf->size; ++fi )
+				for( typename BTree::size_type i = 0; i != leaf->size; ++i )
 				{
-					if( fi != leaf->data )
+					if( i != 0 )
 					{
 						out << "| { ";
 					}
-					out << "<key_" << ( fi - leaf->data ) 
-						<< "> " << fi->first << " | " 
-						<< fi->second << " } ";
+					out << "<key_" << i 
+						<< "> " << leaf->at( i ).first << " | " 
+						<< leaf->at( i ).second << " } ";
 				}
 				out << "} }\"];\n";
 			}
@@ -1177,16 +3761,15 @@ namespace hydrazine
 			{
 				const typename BTree::Body* body 
 					= static_cast< const typename BTree::Body* >( node );
-				out << "<head> node_" << *body->keys << " (" 
+				out << "<head> node_" << body->key( 0 ) << " (" 
 					<< body->size << ")" << "(level_" << body->level 
 					<< ")" << " | { {";
 				out << "<key_0> previous } ";
-				for( const typename BTree::key_type* ki = body->keys;
-					ki != body->keys + body->size; ++ki )
+				for( typename BTree::size_type i = 0; i != body->size; ++i )
 				{
 					out << "| { ";
-					out << "<key_" << ( ki - body->keys + 1) 
-						<< "> " << *ki << " } ";
+					out << "<key_" << ( i + 1 ) 
+						<< "> " << body->key( i ) << " } ";
 				}
 				out << "} }\"];\n";
 
@@ -1209,4 +3792,3 @@ namespace hydrazine
 }
 
 #endif
-
@@ -0,0 +1,611 @@
+/*!
+	\file BTreeImage.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BTreeImage class
+*/
+
+#ifndef BTREE_IMAGE_H_INCLUDED
+#define BTREE_IMAGE_H_INCLUDED
+
+#include <hydrazine/interface/debug.h>
+#include <hydrazine/interface/macros.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <hydrazine/interface/Exception.h>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A read only view of a sorted map that is stored in a flat
+			image, usually a file that is mapped into memory.
+
+		The image starts with a header, followed by every element in order
+		in one array, followed by a static index over that array.  The
+		array is cut into leaf blocks of a page each.  The index is a stack
+		of levels of bodies, each one holding the first keys of all but the
+		first of its children, and the children of body i are bodies (or
+		blocks) i * Fanout through i * Fanout + Fanout - 1 of the level
+		below.  So the image holds no pointers at all, only offsets from
+		its start in the header, and it can be mapped anywhere.
+
+		write() builds an image from any sorted range, such as a BTree, and
+		opening one only maps it and checks the header.  Lookups read the
+		mapped pages directly, and processes that map the same image share
+		its physical pages.  Iterators are pointers into the element array.
+
+		Keys and values are stored as raw bytes, so both must be trivially
+		copyable, and an image must be read by a program built with the
+		same key, value, and page size as the one that wrote it.
+	*/
+	template< typename Key, typename Value, typename Compare = std::less<Key>,
+		size_t PageSize = 4096 >
+	class BTreeImage
+	{
+		public:
+			typedef Key key_type;
+			typedef Value mapped_type;
+			typedef std::pair< key_type, mapped_type > value_type;
+			typedef BTreeImage type;
+			typedef Compare key_compare;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+			typedef const value_type& reference;
+			typedef const value_type& const_reference;
+			typedef const value_type* pointer;
+			typedef const value_type* const_pointer;
+			typedef const_pointer iterator;
+			typedef const_pointer const_iterator;
+			typedef std::reverse_iterator< const_iterator > reverse_iterator;
+			typedef std::reverse_iterator< const_iterator >
+				const_reverse_iterator;
+			/*! \brief A position in the image */
+			typedef unsigned long long Offset;
+
+		private:
+			class Body;
+			class Header;
+
+			typedef NodeSearch< key_type, key_compare > Search;
+			typedef std::vector< key_type > KeyVector;
+
+		private:
+			static const size_type MaxNodes = ( PageSize - sizeof( Offset ) )
+				/ sizeof( key_type );
+			static const size_type Fanout = MaxNodes + 1;
+			static const size_type MaxLeafs = MAX( 1,
+				PageSize / sizeof( value_type ) );
+			static const size_type MaxHeight = 64;
+
+			/*! \brief "HYDRBIMG" */
+			static const Offset Magic = 0x474d494252445948ULL;
+			/*! \brief Bumped whenever the image format changes */
+			static const Offset FormatVersion = 1;
+
+		private:
+			/*!
+				\brief Body Node, size counts the keys
+			*/
+			class Body
+			{
+				public:
+					Offset size;
+					key_type keys[ MaxNodes ];
+			};
+
+			/*!
+				\brief The start of the image
+			*/
+			class Header
+			{
+				public:
+					Offset magic;
+					Offset version;
+					Offset pageSize;
+					Offset keySize;
+					Offset valueSize;
+					/*! \brief The bytes in the whole image */
+					Offset bytes;
+					Offset elements;
+					/*! \brief The element array */
+					Offset values;
+					/*! \brief The number of levels of bodies */
+					Offset height;
+					/*! \brief The bodies of each level, the root first */
+					Offset levels[ MaxHeight ];
+			};
+
+		private:
+			std::string _path;
+			/*! \brief The mapping, or 0 for an image in memory */
+			void* _mapping;
+			const char* _base;
+			size_type _bytes;
+			const Header* _header;
+			const value_type* _values;
+			key_compare _keyCompare;
+
+		private:
+			BTreeImage( const BTreeImage& );
+			BTreeImage& operator=( const BTreeImage& );
+
+		public:
+			/*!
+				\brief Map the image in a file
+			*/
+			explicit BTreeImage( const std::string& path,
+				const Compare& comp = Compare() ) : _path( path ),
+				_mapping( 0 ), _base( 0 ), _bytes( 0 ), _header( 0 ),
+				_values( 0 ), _keyCompare( comp )
+			{
+				_check();
+
+				int file = ::open( _path.c_str(), O_RDONLY );
+
+				if( file < 0 )
+				{
+					_fail( "Could not open" );
+				}
+
+				struct stat status;
+				if( fstat( file, &status ) != 0 )
+				{
+					::close( file );
+					_fail( "Could not stat" );
+				}
+
+				_bytes = status.st_size;
+
+				if( _bytes < sizeof( Header ) )
+				{
+					::close( file );
+					_invalid( "is too small" );
+				}
+
+				_mapping = mmap( 0, _bytes, PROT_READ, MAP_SHARED, file, 0 );
+				::close( file );
+
+				if( _mapping == MAP_FAILED )
+				{
+					_mapping = 0;
+					_fail( "Could not map" );
+				}
+
+				_base = static_cast< const char* >( _mapping );
+
+				try
+				{
+					_load();
+				}
+				catch( ... )
+				{
+					_close();
+					throw;
+				}
+			}
+
+			/*!
+				\brief View an image that is already in memory.  It must be
+					aligned for keys and values and outlive the view.
+			*/
+			BTreeImage( const void* image, size_type bytes,
+				const Compare& comp = Compare() ) : _path( "in memory" ),
+				_mapping( 0 ), _base( static_cast< const char* >( image ) ),
+				_bytes( bytes ), _header( 0 ), _values( 0 ),
+				_keyCompare( comp )
+			{
+				_check();
+
+				if( _bytes < sizeof( Header ) )
+				{
+					_invalid( "is too small" );
+				}
+
+				_load();
+			}
+
+			/*!
+				\brief Unmap the image
+			*/
+			~BTreeImage()
+			{
+				_close();
+			}
+
+		public:
+			/*!
+				\brief Write the sorted, unique range [begin, end) as an
+					image
+
+				The image is written next to path and then renamed over it,
+				so programs that have the old image mapped keep seeing it.
+			*/
+			template< typename ForwardIterator >
+			static void write( const std::string& path, ForwardIterator begin,
+				ForwardIterator end )
+			{
+				_check();
+
+				std::string temporary = path + ".tmp";
+				std::ofstream out( temporary.c_str(),
+					std::ios::binary | std::ios::trunc );
+
+				if( !out.is_open() )
+				{
+					throw Exception( "Could not create btree image '"
+						+ temporary + "': " + std::strerror( errno ) );
+				}
+
+				Header header;
+				std::memset( &header, 0, sizeof( Header ) );
+				header.magic = Magic;
+				header.version = FormatVersion;
+				header.pageSize = PageSize;
+				header.keySize = sizeof( key_type );
+				header.valueSize = sizeof( mapped_type );
+				header.elements = std::distance( begin, end );
+				header.values = _align( sizeof( Header ) );
+
+				// Write the elements, keeping the first key of each block
+				out.seekp( header.values );
+
+				KeyVector firsts;
+				Offset written = 0;
+				for( ; begin != end; ++begin, ++written )
+				{
+					value_type value( begin->first, begin->second );
+					if( written % MaxLeafs == 0 )
+					{
+						firsts.push_back( value.first );
+					}
+					out.write( reinterpret_cast< const char* >( &value ),
+						sizeof( value_type ) );
+				}
+
+				// Build the levels bottom up, then write them root first
+				std::vector< std::vector< Body > > levels;
+				while( firsts.size() > 1 )
+				{
+					levels.push_back( std::vector< Body >() );
+					std::vector< Body >& level = levels.back();
+
+					KeyVector parents;
+					for( size_type child = 0; child < firsts.size();
+						child += Fanout )
+					{
+						Body body;
+						std::memset( &body, 0, sizeof( Body ) );
+						size_type last = MIN( child + Fanout, firsts.size() );
+						body.size = last - child - 1;
+						std::copy( firsts.begin() + child + 1,
+							firsts.begin() + last, body.keys );
+						level.push_back( body );
+						parents.push_back( firsts[ child ] );
+					}
+
+					firsts.swap( parents );
+				}
+
+				if( levels.size() > MaxHeight )
+				{
+					throw Exception( "Btree image '" + path
+						+ "' would be too tall" );
+				}
+
+				header.height = levels.size();
+				Offset position = _align( header.values
+					+ header.elements * sizeof( value_type ) );
+
+				for( size_type level = 0; level < levels.size(); ++level )
+				{
+					const std::vector< Body >& bodies =
+						levels[ levels.size() - level - 1 ];
+
+					header.levels[ level ] = position;
+					out.seekp( position );
+					out.write( reinterpret_cast< const char* >(
+						&bodies[ 0 ] ), bodies.size() * sizeof( Body ) );
+					position += bodies.size() * sizeof( Body );
+				}
+
+				header.bytes = position;
+				out.seekp( 0 );
+				out.write( reinterpret_cast< const char* >( &header ),
+					sizeof( Header ) );
+
+				// Pad out to the end, the last write may have been a seek
+				out.seekp( 0, std::ios::end );
+				if( Offset( out.tellp() ) < header.bytes )
+				{
+					out.seekp( header.bytes - 1 );
+					out.put( 0 );
+				}
+
+				out.close();
+
+				if( out.fail() )
+				{
+					std::remove( temporary.c_str() );
+					throw Exception( "Could not write btree image '"
+						+ temporary + "'" );
+				}
+
+				if( std::rename( temporary.c_str(), path.c_str() ) != 0 )
+				{
+					std::remove( temporary.c_str() );
+					throw Exception( "Could not rename btree image '"
+						+ temporary + "' to '" + path + "': "
+						+ std::strerror( errno ) );
+				}
+
+				report( "Wrote " << header.elements << " elements to " << path
+					<< " with " << header.height << " levels in "
+					<< header.bytes << " bytes" );
+			}
+
+			/*!
+				\brief Write every element of a map, such as a BTree
+			*/
+			template< typename Map >
+			static void write( const std::string& path, const Map& map )
+			{
+				write( path, map.begin(), map.end() );
+			}
+
+		public:
+			inline const_iterator begin() const
+			{
+				return _values;
+			}
+
+			inline const_iterator end() const
+			{
+				return _values + size();
+			}
+
+			inline const_reverse_iterator rbegin() const
+			{
+				return const_reverse_iterator( end() );
+			}
+
+			inline const_reverse_iterator rend() const
+			{
+				return const_reverse_iterator( begin() );
+			}
+
+		public:
+			inline size_type size() const
+			{
+				return _header->elements;
+			}
+
+			inline bool empty() const
+			{
+				return size() == 0;
+			}
+
+			inline key_compare key_comp() const
+			{
+				return _keyCompare;
+			}
+
+			/*! \brief The file holding the image */
+			inline const std::string& path() const
+			{
+				return _path;
+			}
+
+			/*! \brief The bytes in the image */
+			inline size_type bytes() const
+			{
+				return _bytes;
+			}
+
+		public:
+			inline const_iterator find( const key_type& key ) const
+			{
+				const_iterator element = lower_bound( key );
+				if( element == end() || _keyCompare( key, element->first ) )
+				{
+					return end();
+				}
+				return element;
+			}
+
+			inline size_type count( const key_type& key ) const
+			{
+				return find( key ) != end();
+			}
+
+			inline const_iterator lower_bound( const key_type& key ) const
+			{
+				size_type block = _findBlock( key );
+				const_iterator first = _values + block * MaxLeafs;
+				return first + Search::lowerBound( first,
+					_blockSize( block ), key, _keyCompare );
+			}
+
+			inline const_iterator upper_bound( const key_type& key ) const
+			{
+				size_type block = _findBlock( key );
+				const_iterator first = _values + block * MaxLeafs;
+				return first + Search::upperBound( first,
+					_blockSize( block ), key, _keyCompare );
+			}
+
+			inline std::pair< const_iterator, const_iterator > equal_range(
+				const key_type& key ) const
+			{
+				const_iterator first = lower_bound( key );
+				const_iterator last = first;
+				if( last != end() && !_keyCompare( key, last->first ) )
+				{
+					++last;
+				}
+				return std::make_pair( first, last );
+			}
+
+			inline const mapped_type& at( const key_type& key ) const
+			{
+				const_iterator element = find( key );
+				if( element == end() )
+				{
+					throw Exception( "Key is not in btree image '"
+						+ _path + "'" );
+				}
+				return element->second;
+			}
+
+		private:
+			static void _check()
+			{
+				static_assert( std::is_trivially_copyable< Key >::value
+					&& std::is_trivially_copyable< Value >::value,
+					"Images store elements as raw bytes" );
+				static_assert( sizeof( Body ) <= PageSize
+					&& MaxNodes >= 1, "A body must fit in a page" );
+			}
+
+			static Offset _align( Offset offset )
+			{
+				return ( offset + PageSize - 1 ) / PageSize * PageSize;
+			}
+
+			/*! \brief The number of bodies or blocks in each level, the
+				blocks last */
+			static size_type _width( Offset elements, size_type height,
+				size_type level )
+			{
+				size_type width = ( elements + MaxLeafs - 1 ) / MaxLeafs;
+				for( size_type i = height; i > level; --i )
+				{
+					width = ( width + Fanout - 1 ) / Fanout;
+				}
+				return width;
+			}
+
+			void _fail( const std::string& message ) const
+			{
+				throw Exception( message + " btree image '" + _path
+					+ "': " + std::strerror( errno ) );
+			}
+
+			void _invalid( const std::string& message ) const
+			{
+				throw Exception( "Btree image '" + _path + "' " + message );
+			}
+
+			void _close()
+			{
+				if( _mapping != 0 )
+				{
+					munmap( _mapping, _bytes );
+					_mapping = 0;
+				}
+				_base = 0;
+			}
+
+			/*! \brief Check the header and that every level is in bounds */
+			void _load()
+			{
+				_header = reinterpret_cast< const Header* >( _base );
+
+				if( _header->magic != Magic )
+				{
+					_invalid( "is not a btree image" );
+				}
+				if( _header->version != FormatVersion )
+				{
+					_invalid( "has an unsupported format version" );
+				}
+				if( _header->pageSize != PageSize
+					|| _header->keySize != sizeof( key_type )
+					|| _header->valueSize != sizeof( mapped_type ) )
+				{
+					_invalid( "was written with a different page, key, or "
+						"value size" );
+				}
+				if( _header->bytes > _bytes || _header->height > MaxHeight
+					|| _header->values > _bytes || _header->elements
+					> ( _bytes - _header->values ) / sizeof( value_type ) )
+				{
+					_invalid( "is truncated" );
+				}
+
+				size_type blocks = _width( _header->elements,
+					_header->height, _header->height );
+				if( _header->height != 0
+					&& _width( _header->elements, _header->height, 0 ) != 1 )
+				{
+					_invalid( "has the wrong height" );
+				}
+				if( _header->height == 0 && blocks > 1 )
+				{
+					_invalid( "has the wrong height" );
+				}
+
+				for( size_type level = 0; level < _header->height; ++level )
+				{
+					Offset offset = _header->levels[ level ];
+					if( offset > _bytes || _width( _header->elements,
+						_header->height, level ) > ( _bytes - offset )
+						/ sizeof( Body ) )
+					{
+						_invalid( "is truncated" );
+					}
+				}
+
+				_values = reinterpret_cast< const value_type* >(
+					_base + _header->values );
+
+				report( "Opened " << _path << " with " << _header->elements
+					<< " elements and " << _header->height << " levels" );
+			}
+
+			/*! \brief The elements in a block */
+			inline size_type _blockSize( size_type block ) const
+			{
+				return MIN( MaxLeafs, size() - block * MaxLeafs );
+			}
+
+			/*! \brief The block that key belongs in */
+			inline size_type _findBlock( const key_type& key ) const
+			{
+				size_type index = 0;
+				for( size_type level = 0; level < _header->height; ++level )
+				{
+					const Body* body = reinterpret_cast< const Body* >(
+						_base + _header->levels[ level ] ) + index;
+					index = index * Fanout + Search::upperBound( body->keys,
+						body->size, key, _keyCompare );
+				}
+				return index;
+			}
+	};
+
+}
+
+#endif
+
@@ -0,0 +1,130 @@
+/*!
+	\file Barrier.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the Barrier class
+*/
+
+#ifndef BARRIER_H_INCLUDED
+#define BARRIER_H_INCLUDED
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <atomic>
+#include <vector>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A reusable barrier for a group of threads that may change.
+
+		Members arrive at the leaves of a combining tree with a fan in of
+		FanIn, the last to arrive at a node goes on to its parent, and the
+		last to arrive at the root releases everyone by flipping a global
+		sense.  Groups of up to FanIn members have a single node, which is
+		a plain sense reversing barrier.  Waiting members spin on the
+		sense for a while and then block.
+
+		An episode of the barrier is made up of the members when it
+		started.  A member that leaves during an episode counts as
+		arrived.  A member that joins during an episode takes part from
+		the next one, and if it waits before then it is held until that
+		episode starts.  Membership changes while nobody is waiting take
+		effect at once.  A member must not leave from another thread at
+		the same time as it starts to wait.
+	*/
+	class Barrier
+	{
+		public:
+			/*! \brief Members arriving at one node of the tree */
+			static const unsigned int FanIn = 4;
+			/*! \brief Times to check the sense before blocking */
+			static const unsigned int Spins = 2000;
+
+		public:
+			/*! \brief A handle to a member of the barrier */
+			class Member
+			{
+				friend class Barrier;
+
+				private:
+					/*! \brief The sense this member waits for next */
+					std::atomic< bool > _sense;
+					/*! \brief The position, or Pending until it joins */
+					std::atomic< unsigned int > _rank;
+					bool _leaving;
+			};
+
+		private:
+			static const unsigned int Pending = ~0u;
+			static const unsigned int Root = ~0u;
+
+			/*! \brief A counter of the tree on a cache line of its own */
+			class Node
+			{
+				public:
+					std::atomic< unsigned int > arrived;
+					unsigned int expected;
+					unsigned int parent;
+
+				private:
+					char _padding[ 64 - 3 * sizeof( unsigned int ) ];
+
+				public:
+					Node();
+			};
+
+			typedef std::vector< Node > NodeVector;
+			typedef std::vector< Member* > MemberVector;
+
+		private:
+			NodeVector _nodes;
+			/*! \brief Members by rank */
+			MemberVector _members;
+			/*! \brief Members that take part from the next episode */
+			MemberVector _joining;
+			/*! \brief Is a member leaving at the end of this episode */
+			bool _leaving;
+
+		private:
+			std::atomic< bool > _sense;
+			/*! \brief Set while a membership change holds the lock */
+			std::atomic< bool > _changing;
+			unsigned int _sleepers;
+			boost::mutex _mutex;
+			boost::condition_variable _condition;
+
+		private:
+			void _build();
+			bool _idle() const;
+			bool _arrive( unsigned int rank );
+			void _release();
+			void _remove( Member* );
+
+		private:
+			Barrier( const Barrier& );
+			Barrier& operator=( const Barrier& );
+
+		public:
+			Barrier();
+			~Barrier();
+
+		public:
+			/*! \brief Add a member, it waits with the handle returned */
+			Member* join();
+			/*! \brief Remove a member, the handle is invalid afterwards */
+			void leave( Member* member );
+			/*! \brief Block until every member has arrived */
+			void wait( Member* member );
+
+		public:
+			/*! \brief The number of members taking part */
+			unsigned int size();
+	};
+
+}
+
+#endif
+
@@ -0,0 +1,523 @@
+/*!
+	\file BodyKeys.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BTree body key storage.
+*/
+
+#ifndef BODY_KEYS_H_INCLUDED
+#define BODY_KEYS_H_INCLUDED
+
+#include <hydrazine/interface/NodeSearch.h>
+
+#include <new>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief Can the separators of a body be stored as byte strings
+			that compare the same way as the keys?
+	*/
+	template< typename Key, typename Compare >
+	class PrefixCompressible
+	{
+		public:
+			static const bool value = false;
+	};
+
+	template<>
+	class PrefixCompressible< std::string, std::less< std::string > >
+	{
+		public:
+			static const bool value = true;
+	};
+
+	/*!
+		\brief The separator keys of a BTree body.
+
+		The generic version is a plain array of keys.  Every change goes
+		through the functions here rather than through the array, along
+		with the number of keys that the body holds, so that other
+		versions can pack keys in ways that do not map one key to one
+		slot.
+	*/
+	template< typename Key, typename Compare,
+		bool Compressed = PrefixCompressible< Key, Compare >::value >
+	class BodyKeys
+	{
+		public:
+			/*! \brief The bytes of a page set aside for each key */
+			static const size_t SlotSize = sizeof( Key );
+
+		public:
+			template< size_t Capacity >
+			class Storage
+			{
+				public:
+					typedef const Key& const_reference;
+
+				private:
+					typedef NodeSearch< Key, Compare > Search;
+
+				public:
+					Key keys[ Capacity ];
+
+				public:
+					inline void constructKeys()
+					{
+						if( !std::is_trivially_default_constructible<
+							Key >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								::new( keys + i ) Key;
+							}
+						}
+					}
+
+					inline void destroyKeys()
+					{
+						if( !std::is_trivially_destructible< Key >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								keys[ i ].~Key();
+							}
+						}
+					}
+
+				public:
+					inline const_reference key( size_t i ) const
+					{
+						return keys[ i ];
+					}
+
+					/*! \brief The index in [begin, end) of the first key
+						greater than key */
+					template< typename K >
+					inline size_t upperBound( size_t begin, size_t end,
+						const K& key, const Compare& compare ) const
+					{
+						return begin + Search::upperBound( keys + begin,
+							end - begin, key, compare );
+					}
+
+					/*! \brief Is key less than the key at i? */
+					inline bool before( const Key& key, size_t i,
+						const Compare& compare ) const
+					{
+						return compare( key, keys[ i ] );
+					}
+
+				public:
+					/*! \brief Replace key i of size keys */
+					template< typename K >
+					inline void setKey( size_t i, size_t, K&& key )
+					{
+						keys[ i ] = std::forward< K >( key );
+					}
+
+					/*! \brief Insert a key at i, moving [i, size) up */
+					template< typename K >
+					inline void insertKey( size_t i, size_t size, K&& key )
+					{
+						std::move_backward( keys + i, keys + size,
+							keys + size + 1 );
+						keys[ i ] = std::forward< K >( key );
+					}
+
+					/*! \brief Move [begin, end) of source in at i, moving
+						[i, size) up.  Source is left to be erased. */
+					inline void insertKeys( size_t i, size_t size,
+						Storage& source, size_t begin, size_t end )
+					{
+						if( begin == end )
+						{
+							return;
+						}
+						std::move_backward( keys + i, keys + size,
+							keys + size + end - begin );
+						std::move( source.keys + begin, source.keys + end,
+							keys + i );
+					}
+
+					/*! \brief Remove [begin, end) of size keys */
+					inline void eraseKeys( size_t begin, size_t end,
+						size_t size )
+					{
+						// moving a key onto itself may empty it
+						if( begin != end )
+						{
+							std::move( keys + end, keys + size, keys + begin );
+						}
+					}
+
+					/*! \brief Copy the first size keys of source into this
+						empty body */
+					inline void copyKeys( const Storage& source, size_t size )
+					{
+						std::copy( source.keys, source.keys + size, keys );
+					}
+
+					/*! \brief Fill this empty body from a range */
+					template< typename InputIterator >
+					inline void assignKeys( InputIterator first,
+						InputIterator last )
+					{
+						std::copy( first, last, keys );
+					}
+
+				public:
+					/*! \brief Set key i to a key that is greater than left
+						and not greater than right */
+					inline void setSeparator( size_t i, size_t size,
+						const Key&, const Key& right )
+					{
+						setKey( i, size, right );
+					}
+
+					/*! \brief Insert a key at i that is greater than left
+						and not greater than right */
+					inline void insertSeparator( size_t i, size_t size,
+						const Key&, const Key& right )
+					{
+						insertKey( i, size, right );
+					}
+			};
+	};
+
+	/*!
+		\brief The separator keys of a BTree body keyed by std::string.
+
+		A separator only has to fall between the last key on its left and
+		the first key on its right, so the shortest prefix of the right
+		key that does that is stored rather than the whole key.  The
+		prefix that every separator of a body shares is stored once, and
+		each separator keeps only the bytes past it, as a slice of a byte
+		buffer in the node.  Keys are compared with memcmp, the same way
+		std::less< std::string > orders them.
+
+		Bytes of replaced or erased keys are left in the buffer until it
+		fills up, then the live keys are packed again.  If they still do
+		not fit, the buffer moves to the heap.
+	*/
+	template< typename Compare >
+	class BodyKeys< std::string, Compare, true >
+	{
+		public:
+			/*! \brief The bytes of each slice kept in the node */
+			static const size_t InlineBytes = 8;
+
+		private:
+			class Slot
+			{
+				public:
+					unsigned int offset;
+					unsigned int length;
+			};
+
+		public:
+			static const size_t SlotSize = sizeof( Slot ) + InlineBytes;
+
+		public:
+			template< size_t Capacity >
+			class Storage
+			{
+				public:
+					typedef std::string const_reference;
+
+				private:
+					typedef std::vector< std::string > StringVector;
+
+				private:
+					Slot _slots[ Capacity ];
+					/*! \brief The prefix followed by the slices */
+					char* _bytes;
+					size_t _capacity;
+					size_t _used;
+					/*! \brief The length of the shared prefix */
+					size_t _prefix;
+					char _inline[ Capacity * InlineBytes ];
+
+				public:
+					inline void constructKeys()
+					{
+						_bytes = _inline;
+						_capacity = sizeof( _inline );
+						_used = 0;
+						_prefix = 0;
+					}
+
+					inline void destroyKeys()
+					{
+						if( _bytes != _inline )
+						{
+							delete[] _bytes;
+						}
+					}
+
+				public:
+					inline const_reference key( size_t i ) const
+					{
+						std::string result( _bytes, _prefix );
+						result.append( _bytes + _slots[ i ].offset,
+							_slots[ i ].length );
+						return result;
+					}
+
+					inline size_t upperBound( size_t begin, size_t end,
+						const std::string& key, const Compare& ) const
+					{
+						int prefix = _comparePrefix( key );
+						if( prefix != 0 )
+						{
+							return prefix < 0 ? begin : end;
+						}
+
+						const char* rest = key.data() + _prefix;
+						size_t length = key.size() - _prefix;
+
+						while( begin < end )
+						{
+							size_t middle = begin + ( end - begin ) / 2;
+							if( _compareSlice( rest, length, middle ) < 0 )
+							{
+								end = middle;
+							}
+							else
+							{
+								begin = middle + 1;
+							}
+						}
+						return begin;
+					}
+
+					inline bool before( const std::string& key, size_t i,
+						const Compare& ) const
+					{
+						int prefix = _comparePrefix( key );
+						if( prefix != 0 )
+						{
+							return prefix < 0;
+						}
+						return _compareSlice( key.data() + _prefix,
+							key.size() - _prefix, i ) < 0;
+					}
+
+				public:
+					inline void setKey( size_t i, size_t size,
+						const std::string& key )
+					{
+						if( _comparePrefix( key ) != 0
+							|| _used + key.size() - _prefix > _capacity )
+						{
+							_pack( size, i, key );
+							return;
+						}
+
+						_slots[ i ].offset = _used;
+						_slots[ i ].length = key.size() - _prefix;
+						std::memcpy( _bytes + _used, key.data() + _prefix,
+							key.size() - _prefix );
+						_used += key.size() - _prefix;
+					}
+
+					inline void insertKey( size_t i, size_t size,
+						const std::string& key )
+					{
+						std::copy_backward( _slots + i, _slots + size,
+							_slots + size + 1 );
+						setKey( i, size + 1, key );
+					}
+
+					inline void insertKeys( size_t i, size_t size,
+						const Storage& source, size_t begin, size_t end )
+					{
+						size_t count = end - begin;
+						std::copy_backward( _slots + i, _slots + size,
+							_slots + size + count );
+						// Packing may happen before every new slot is set, so
+						// they start out holding the prefix alone
+						for( size_t k = i; k < i + count; ++k )
+						{
+							_slots[ k ].offset = 0;
+							_slots[ k ].length = 0;
+						}
+						for( size_t k = 0; k < count; ++k )
+						{
+							setKey( i + k, size + count,
+								source.key( begin + k ) );
+						}
+					}
+
+					inline void eraseKeys( size_t begin, size_t end,
+						size_t size )
+					{
+						std::copy( _slots + end, _slots + size,
+							_slots + begin );
+					}
+
+					inline void copyKeys( const Storage& source, size_t size )
+					{
+						if( source._used > _capacity )
+						{
+							_reserve( source._used );
+						}
+						std::memcpy( _bytes, source._bytes, source._used );
+						std::copy( source._slots, source._slots + size,
+							_slots );
+						_used = source._used;
+						_prefix = source._prefix;
+					}
+
+					template< typename InputIterator >
+					inline void assignKeys( InputIterator first,
+						InputIterator last )
+					{
+						for( size_t i = 0; first != last; ++first, ++i )
+						{
+							setKey( i, i + 1, *first );
+						}
+					}
+
+				public:
+					inline void setSeparator( size_t i, size_t size,
+						const std::string& left, const std::string& right )
+					{
+						setKey( i, size, _separator( left, right ) );
+					}
+
+					inline void insertSeparator( size_t i, size_t size,
+						const std::string& left, const std::string& right )
+					{
+						insertKey( i, size, _separator( left, right ) );
+					}
+
+				private:
+					/*! \brief The shortest prefix of right that is greater
+						than left */
+					static inline std::string _separator(
+						const std::string& left, const std::string& right )
+					{
+						size_t common = std::mismatch( left.begin(),
+							left.begin() + std::min( left.size(),
+							right.size() ), right.begin() ).first
+							- left.begin();
+						return right.substr( 0, common + 1 );
+					}
+
+					/*! \brief Order key against the shared prefix, 0 if
+						key starts with it */
+					inline int _comparePrefix( const std::string& key ) const
+					{
+						if( key.size() < _prefix )
+						{
+							int result = std::memcmp( key.data(), _bytes,
+								key.size() );
+							return result != 0 ? result : -1;
+						}
+						return std::memcmp( key.data(), _bytes, _prefix );
+					}
+
+					/*! \brief Order the rest of a key past the shared
+						prefix against the slice of key i */
+					inline int _compareSlice( const char* rest,
+						size_t length, size_t i ) const
+					{
+						const Slot& slot = _slots[ i ];
+						int result = std::memcmp( rest, _bytes + slot.offset,
+							std::min< size_t >( length, slot.length ) );
+						if( result != 0 )
+						{
+							return result;
+						}
+						return length < slot.length ? -1
+							: ( length > slot.length ? 1 : 0 );
+					}
+
+					/*! \brief Make room for at least bytes, dropping the
+						contents */
+					inline void _reserve( size_t bytes )
+					{
+						if( bytes <= _capacity )
+						{
+							return;
+						}
+						if( _bytes != _inline )
+						{
+							delete[] _bytes;
+						}
+						_capacity = std::max( bytes, 2 * _capacity );
+						_bytes = new char[ _capacity ];
+					}
+
+					/*!
+						\brief Store the size keys again without garbage and
+							with the longest shared prefix, replacing key i
+					*/
+					inline void _pack( size_t size, size_t i,
+						const std::string& key )
+					{
+						StringVector keys;
+						keys.reserve( size );
+						for( size_t k = 0; k < size; ++k )
+						{
+							keys.push_back( k == i ? key : this->key( k ) );
+						}
+
+						size_t prefix = keys.empty() ? 0 : keys[ 0 ].size();
+						size_t bytes = 0;
+						for( StringVector::iterator k = keys.begin();
+							k != keys.end(); ++k )
+						{
+							prefix = std::mismatch( k->begin(), k->begin()
+								+ std::min( prefix, k->size() ),
+								keys[ 0 ].begin() ).first - k->begin();
+							bytes += k->size();
+						}
+						bytes -= prefix * ( keys.size() - 1 );
+
+						if( bytes > _capacity )
+						{
+							_reserve( bytes );
+						}
+						else if( _bytes != _inline
+							&& bytes <= sizeof( _inline ) )
+						{
+							delete[] _bytes;
+							_bytes = _inline;
+							_capacity = sizeof( _inline );
+						}
+
+						_prefix = prefix;
+						_used = prefix;
+						if( !keys.empty() )
+						{
+							std::memcpy( _bytes, keys[ 0 ].data(), prefix );
+						}
+
+						for( size_t k = 0; k < size; ++k )
+						{
+							_slots[ k ].offset = _used;
+							_slots[ k ].length = keys[ k ].size() - prefix;
+							std::memcpy( _bytes + _used,
+								keys[ k ].data() + prefix,
+								keys[ k ].size() - prefix );
+							_used += keys[ k ].size() - prefix;
+						}
+					}
+			};
+	};
+
+}
+
+#endif
+
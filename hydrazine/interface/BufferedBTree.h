@@ -0,0 +1,1540 @@
+/*!
+	\file BufferedBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BufferedBTree class.
+*/
+
+#ifndef BUFFERED_B_TREE_H_INCLUDED
+#define BUFFERED_B_TREE_H_INCLUDED
+
+#include <hydrazine/interface/macros.h>
+#include <hydrazine/interface/debug.h>
+#include <hydrazine/interface/ValueCompare.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <memory>
+#include <new>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A write optimized B-epsilon tree with the interface of an STL
+			map.
+
+		Every body keeps a buffer of messages next to its children.  Inserts
+		and erases are written as messages into the buffer of the root.  When
+		a buffer fills up, the messages bound for the child that has the most
+		of them move down together, so a leaf is read and written once for a
+		whole batch of changes rather than once per change.  The pivots of a
+		body take about a sixteenth of a page and the buffer takes the rest.
+
+		Point lookups (find, count, operator[]) search the buffers on the path
+		to the leaf.  insert and erase look the key up first so that they can
+		return what std::map returns.  insert_buffered and erase_buffered only
+		write a message, which is the fast path for insert heavy work.
+
+		Visiting the elements in order needs every message to be in its leaf,
+		so begin, lower_bound, upper_bound, equal_range, size, and moving an
+		iterator apply all pending messages first.  That changes the tree,
+		so those have no const overloads.  The const lookups, find and
+		count, only search the buffers, so several threads may read a
+		const tree at once as long as none of them moves an iterator, not
+		even a const_iterator.  Inserts and erases invalidate iterators.  The iterators returned by find and insert may
+		point into a buffer, so the first of those ordered operations after a
+		change invalidates them as well.
+
+		Empty leaves are freed and small neighboring leaves are merged, but
+		bodies are never merged, so the tree only gets shorter when the root
+		is left with a single child.
+	*/
+	template< typename Key, typename Value,
+		typename Compare = std::less< Key >,
+		typename _Allocator = std::allocator< std::pair< const Key,
+		Value > >, size_t PageSize = 4096 >
+	class BufferedBTree
+	{
+		public:
+			class Iterator;
+			class ConstIterator;
+
+		public:
+			typedef Key key_type;
+			typedef Value mapped_type;
+			typedef std::pair< key_type, mapped_type > value_type;
+
+		public:
+			typedef typename _Allocator::template rebind<
+				value_type >::other Allocator;
+
+		public:
+			typedef BufferedBTree type;
+			typedef Compare key_compare;
+			typedef Allocator allocator_type;
+			typedef value_type& reference;
+			typedef const value_type& const_reference;
+			typedef value_type* pointer;
+			typedef const value_type* const_pointer;
+			typedef Iterator iterator;
+			typedef ConstIterator const_iterator;
+			typedef typename Allocator::size_type size_type;
+			typedef typename Allocator::difference_type difference_type;
+			typedef std::reverse_iterator< iterator > reverse_iterator;
+			typedef std::reverse_iterator< const_iterator >
+				const_reverse_iterator;
+			typedef std::pair< iterator, bool > insertion;
+			typedef ValueCompare< Compare, type > value_compare;
+
+		private:
+			class Node;
+			class Body;
+			class Leaf;
+
+			/*! \brief What a message does to its key once it reaches a leaf */
+			enum Operation
+			{
+				/*! \brief Add the value if the key is missing */
+				Insert,
+				/*! \brief Replace whatever is there with the value */
+				Assign,
+				/*! \brief Remove the key */
+				Erase
+			};
+
+			/*! \brief A pending change to a key.  It is a value_type so that
+				node searches and iterators can use it directly. */
+			class Message : public value_type
+			{
+				public:
+					Operation operation;
+			};
+
+			typedef NodeSearch< key_type, key_compare > Search;
+
+		private:
+			/*! \brief The pivots of a body */
+			static const size_type MaxNodes = MAX( 4, PageSize
+				/ ( 16 * ( sizeof( key_type ) + sizeof( Node* ) ) ) );
+			/*! \brief The bytes taken by the pivots */
+			static const size_type PivotBytes = MaxNodes
+				* ( sizeof( key_type ) + sizeof( Node* ) );
+			/*! \brief The messages buffered in a body */
+			static const size_type MaxMessages = MAX( 8, PageSize > PivotBytes
+				? ( PageSize - PivotBytes ) / sizeof( Message ) : 0 );
+			/*! \brief The elements in a leaf */
+			static const size_type MaxLeafs = MAX( 8,
+				PageSize / sizeof( value_type ) );
+			/*! \brief A leaf smaller than this is merged with a neighbor */
+			static const size_type MinLeafs = MaxLeafs / 4;
+			/*! \brief The most leaves a full batch can turn one leaf into */
+			static const size_type LeafSplits = ( 2 * MaxLeafs + MaxMessages
+				- 1 ) / MaxLeafs;
+			/*! \brief Extra pivots a body holds until its parent splits it */
+			static const size_type Slack = MAX( 1, LeafSplits - 1 );
+
+			static_assert( Slack <= MaxNodes, "A batch of messages may split "
+				"a leaf into more pieces than a body can hold." );
+
+		private:
+			class Node
+			{
+				public:
+					/*! \brief Zero for leaves */
+					size_type level;
+					/*! \brief The pivots of a body or the elements of a leaf */
+					size_type size;
+
+				public:
+					inline Node( size_type l ) : level( l ), size( 0 )
+					{
+
+					}
+
+					inline bool leaf() const
+					{
+						return level == 0;
+					}
+			};
+
+			/*! \brief Child i holds the keys in [keys[i-1], keys[i]), and the
+				messages are sorted with at most one per key */
+			class Body : public Node
+			{
+				public:
+					key_type keys[ MaxNodes + Slack ];
+					Node* children[ MaxNodes + Slack + 1 ];
+					Message messages[ MaxMessages ];
+					size_type messageCount;
+					/*! \brief The messages here and in every body below */
+					size_type pending;
+
+				public:
+					inline Body( size_type level ) : Node( level ),
+						messageCount( 0 ), pending( 0 )
+					{
+
+					}
+
+					/*! \brief Does the parent need to split this body */
+					inline bool overflowing() const
+					{
+						return this->size > MaxNodes;
+					}
+			};
+
+			class Leaf : public Node
+			{
+				public:
+					value_type data[ MaxLeafs ];
+					Leaf* previous;
+					Leaf* next;
+
+				public:
+					inline Leaf() : Node( 0 ), previous( 0 ), next( 0 )
+					{
+
+					}
+			};
+
+		private:
+			typedef typename _Allocator::template rebind< Body >::other
+				BodyAllocator;
+			typedef typename _Allocator::template rebind< Leaf >::other
+				LeafAllocator;
+			typedef typename _Allocator::template rebind< Message >::other
+				MessageAllocator;
+			typedef std::vector< value_type, Allocator > ValueVector;
+			typedef std::vector< Message, MessageAllocator > MessageVector;
+			typedef std::vector< key_type, typename _Allocator::template
+				rebind< key_type >::other > KeyVector;
+
+		public:
+			class Iterator
+			{
+				friend class BufferedBTree;
+				friend class ConstIterator;
+
+				public:
+					typedef BufferedBTree::value_type value_type;
+					typedef BufferedBTree::difference_type difference_type;
+					typedef BufferedBTree::pointer pointer;
+					typedef BufferedBTree::reference reference;
+					typedef std::bidirectional_iterator_tag iterator_category;
+
+				private:
+					BufferedBTree* _tree;
+					/*! \brief Zero unless the element is known to be in a
+						leaf of a tree with no pending messages */
+					Leaf* _leaf;
+					size_type _current;
+					/*! \brief Zero for end */
+					pointer _entry;
+
+				private:
+					inline Iterator( BufferedBTree* t, Leaf* l, size_type c,
+						pointer e ) : _tree( t ), _leaf( l ), _current( c ),
+						_entry( e )
+					{
+
+					}
+
+				public:
+					inline Iterator() : _tree( 0 ), _leaf( 0 ),
+						_current( 0 ), _entry( 0 )
+					{
+
+					}
+
+					inline reference operator*() const
+					{
+						return *_entry;
+					}
+
+					inline pointer operator->() const
+					{
+						return _entry;
+					}
+
+					inline Iterator& operator++()
+					{
+						*this = _tree->_next( _leaf, _current, _entry );
+						return *this;
+					}
+
+					inline Iterator operator++( int )
+					{
+						Iterator result = *this;
+						++*this;
+						return result;
+					}
+
+					inline Iterator& operator--()
+					{
+						*this = _tree->_previous( _leaf, _current, _entry );
+						return *this;
+					}
+
+					inline Iterator operator--( int )
+					{
+						Iterator result = *this;
+						--*this;
+						return result;
+					}
+
+					inline bool operator==( const Iterator& i ) const
+					{
+						return _entry == i._entry;
+					}
+
+					inline bool operator!=( const Iterator& i ) const
+					{
+						return _entry != i._entry;
+					}
+
+					inline bool operator==( const ConstIterator& i ) const
+					{
+						return _entry == i._entry;
+					}
+
+					inline bool operator!=( const ConstIterator& i ) const
+					{
+						return _entry != i._entry;
+					}
+			};
+
+			class ConstIterator
+			{
+				friend class BufferedBTree;
+				friend class Iterator;
+
+				public:
+					typedef BufferedBTree::value_type value_type;
+					typedef BufferedBTree::difference_type difference_type;
+					typedef BufferedBTree::const_pointer pointer;
+					typedef BufferedBTree::const_reference reference;
+					typedef std::bidirectional_iterator_tag iterator_category;
+
+				private:
+					/*! \brief Moving applies messages, which leaves the
+						contents of the tree the same */
+					BufferedBTree* _tree;
+					const Leaf* _leaf;
+					size_type _current;
+					const_pointer _entry;
+
+				private:
+					inline ConstIterator( BufferedBTree* t, const Leaf* l,
+						size_type c, const_pointer e ) : _tree( t ), _leaf( l ),
+						_current( c ), _entry( e )
+					{
+
+					}
+
+				public:
+					inline ConstIterator() : _tree( 0 ), _leaf( 0 ),
+						_current( 0 ), _entry( 0 )
+					{
+
+					}
+
+					inline ConstIterator( const Iterator& i ) :
+						_tree( i._tree ), _leaf( i._leaf ),
+						_current( i._current ), _entry( i._entry )
+					{
+
+					}
+
+					inline reference operator*() const
+					{
+						return *_entry;
+					}
+
+					inline pointer operator->() const
+					{
+						return _entry;
+					}
+
+					inline ConstIterator& operator++()
+					{
+						*this = _tree->_next( _leaf, _current, _entry );
+						return *this;
+					}
+
+					inline ConstIterator operator++( int )
+					{
+						ConstIterator result = *this;
+						++*this;
+						return result;
+					}
+
+					inline ConstIterator& operator--()
+					{
+						*this = _tree->_previous( _leaf, _current, _entry );
+						return *this;
+					}
+
+					inline ConstIterator operator--( int )
+					{
+						ConstIterator result = *this;
+						--*this;
+						return result;
+					}
+
+					inline bool operator==( const ConstIterator& i ) const
+					{
+						return _entry == i._entry;
+					}
+
+					inline bool operator!=( const ConstIterator& i ) const
+					{
+						return _entry != i._entry;
+					}
+
+					inline bool operator==( const Iterator& i ) const
+					{
+						return _entry == i._entry;
+					}
+
+					inline bool operator!=( const Iterator& i ) const
+					{
+						return _entry != i._entry;
+					}
+			};
+
+		private:
+			Allocator _allocator;
+			value_compare _compare;
+			key_compare _keyCompare;
+			BodyAllocator _bodyAllocator;
+			LeafAllocator _leafAllocator;
+			Body* _root;
+			/*! \brief The elements in leaves, exact once no messages wait */
+			size_type _size;
+			/*! \brief The messages in all buffers */
+			size_type _pending;
+			/*! \brief Scratch space for merging a batch into a leaf */
+			ValueVector _values;
+			/*! \brief Scratch space for merging a batch into a buffer */
+			MessageVector _messages;
+
+		private:
+			inline Body* _allocateBody( size_type level )
+			{
+				Body* body = _bodyAllocator.allocate( 1 );
+				::new( body ) Body( level );
+				return body;
+			}
+
+			inline Leaf* _allocateLeaf()
+			{
+				Leaf* leaf = _leafAllocator.allocate( 1 );
+				::new( leaf ) Leaf;
+				return leaf;
+			}
+
+			inline void _free( Node* node )
+			{
+				if( node->leaf() )
+				{
+					Leaf* leaf = static_cast< Leaf* >( node );
+					leaf->~Leaf();
+					_leafAllocator.deallocate( leaf, 1 );
+					return;
+				}
+
+				Body* body = static_cast< Body* >( node );
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					_free( body->children[ i ] );
+				}
+				body->~Body();
+				_bodyAllocator.deallocate( body, 1 );
+			}
+
+			inline Node* _clone( const Node* node, Leaf*& previous )
+			{
+				if( node->leaf() )
+				{
+					const Leaf* leaf = static_cast< const Leaf* >( node );
+					Leaf* copy = _allocateLeaf();
+					std::copy( leaf->data, leaf->data + leaf->size,
+						copy->data );
+					copy->size = leaf->size;
+					copy->previous = previous;
+					if( previous != 0 )
+					{
+						previous->next = copy;
+					}
+					previous = copy;
+					return copy;
+				}
+
+				const Body* body = static_cast< const Body* >( node );
+				Body* copy = _allocateBody( body->level );
+				std::copy( body->keys, body->keys + body->size, copy->keys );
+				std::copy( body->messages,
+					body->messages + body->messageCount, copy->messages );
+				copy->size = body->size;
+				copy->messageCount = body->messageCount;
+				copy->pending = body->pending;
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					copy->children[ i ] = _clone( body->children[ i ],
+						previous );
+				}
+				return copy;
+			}
+
+			inline void _copy( const BufferedBTree& tree )
+			{
+				if( tree._root != 0 )
+				{
+					Leaf* previous = 0;
+					_root = static_cast< Body* >( _clone( tree._root,
+						previous ) );
+				}
+				_size = tree._size;
+				_pending = tree._pending;
+			}
+
+		private:
+			inline Leaf* _leftmost() const
+			{
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					node = static_cast< Body* >( node )->children[ 0 ];
+				}
+				return static_cast< Leaf* >( node );
+			}
+
+			inline Leaf* _rightmost() const
+			{
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					node = body->children[ body->size ];
+				}
+				return static_cast< Leaf* >( node );
+			}
+
+			/*! \brief The leaf that key belongs in, ignoring the buffers */
+			inline Leaf* _findLeaf( const key_type& key ) const
+			{
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					node = body->children[ Search::upperBound( body->keys,
+						body->size, key, _keyCompare ) ];
+				}
+				return static_cast< Leaf* >( node );
+			}
+
+			/*! \brief The first element at or after index in leaf */
+			inline iterator _at( Leaf* leaf, size_type index )
+			{
+				while( leaf != 0 && index == leaf->size )
+				{
+					leaf = leaf->next;
+					index = 0;
+				}
+
+				if( leaf == 0 )
+				{
+					return end();
+				}
+
+				return iterator( this, leaf, index, leaf->data + index );
+			}
+
+			/*! \brief The last element before index in leaf */
+			inline iterator _before( Leaf* leaf, size_type index )
+			{
+				while( leaf != 0 && index == 0 )
+				{
+					leaf = leaf->previous;
+					index = leaf != 0 ? leaf->size : 0;
+				}
+
+				if( leaf == 0 )
+				{
+					return end();
+				}
+
+				return iterator( this, leaf, index - 1, leaf->data + index - 1 );
+			}
+
+			inline iterator _lowerBound( const key_type& key )
+			{
+				if( _root == 0 )
+				{
+					return end();
+				}
+				Leaf* leaf = _findLeaf( key );
+				return _at( leaf, Search::lowerBound( leaf->data, leaf->size,
+					key, _keyCompare ) );
+			}
+
+			inline iterator _upperBound( const key_type& key )
+			{
+				if( _root == 0 )
+				{
+					return end();
+				}
+				Leaf* leaf = _findLeaf( key );
+				return _at( leaf, Search::upperBound( leaf->data, leaf->size,
+					key, _keyCompare ) );
+			}
+
+			/*! \brief The element after entry, which is in leaf at current
+				when leaf is set */
+			inline iterator _next( const Leaf* leaf, size_type current,
+				const_pointer entry )
+			{
+				if( _pending != 0 || leaf == 0 )
+				{
+					key_type key = entry->first;
+					flush();
+					return _upperBound( key );
+				}
+				return _at( const_cast< Leaf* >( leaf ), current + 1 );
+			}
+
+			/*! \brief The element before entry, or the last one for end */
+			inline iterator _previous( const Leaf* leaf, size_type current,
+				const_pointer entry )
+			{
+				if( entry == 0 )
+				{
+					flush();
+					if( _root == 0 )
+					{
+						return end();
+					}
+					Leaf* last = _rightmost();
+					return _before( last, last->size );
+				}
+
+				if( _pending != 0 || leaf == 0 )
+				{
+					key_type key = entry->first;
+					flush();
+					Leaf* position = _findLeaf( key );
+					return _before( position, Search::lowerBound(
+						position->data, position->size, key, _keyCompare ) );
+				}
+				return _before( const_cast< Leaf* >( leaf ), current );
+			}
+
+			/*! \brief The current value of key, searching the buffers from
+				the root down.  leaf and index are set if it is in a leaf. */
+			inline pointer _locate( const key_type& key, Leaf*& leaf,
+				size_type& index ) const
+			{
+				if( _root == 0 )
+				{
+					return 0;
+				}
+
+				// An insert only takes effect if nothing older holds the key,
+				//  and then the oldest one wins
+				pointer insert = 0;
+				Node* node = _root;
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					size_type position = Search::lowerBound( body->messages,
+						body->messageCount, key, _keyCompare );
+					if( position < body->messageCount && !_keyCompare( key,
+						body->messages[ position ].first ) )
+					{
+						Message& message = body->messages[ position ];
+						if( message.operation == Erase )
+						{
+							return insert;
+						}
+						if( message.operation == Assign )
+						{
+							return &message;
+						}
+						insert = &message;
+					}
+					node = body->children[ Search::upperBound( body->keys,
+						body->size, key, _keyCompare ) ];
+				}
+
+				Leaf* l = static_cast< Leaf* >( node );
+				size_type position = Search::lowerBound( l->data, l->size,
+					key, _keyCompare );
+				if( position < l->size
+					&& !_keyCompare( key, l->data[ position ].first ) )
+				{
+					leaf = l;
+					index = position;
+					return l->data + position;
+				}
+				return insert;
+			}
+
+		private:
+			/*! \brief Fold a newer change to a key into the older message */
+			template< typename Pair >
+			inline void _combine( Message& older, Pair&& newer,
+				Operation operation )
+			{
+				if( operation == Insert )
+				{
+					if( older.operation != Erase )
+					{
+						return;
+					}
+					operation = Assign;
+				}
+				static_cast< value_type& >( older ) =
+					std::forward< Pair >( newer );
+				older.operation = operation;
+			}
+
+			inline void _eraseMessages( Body* body, size_type begin,
+				size_type end )
+			{
+				std::move( body->messages + end,
+					body->messages + body->messageCount,
+					body->messages + begin );
+				body->messageCount -= end - begin;
+			}
+
+			/*! \brief Add node as child position of body, after pivot key */
+			inline void _insertChild( Body* body, size_type position,
+				key_type&& key, Node* node )
+			{
+				std::move_backward( body->keys + position - 1,
+					body->keys + body->size, body->keys + body->size + 1 );
+				std::copy_backward( body->children + position,
+					body->children + body->size + 1,
+					body->children + body->size + 2 );
+				body->keys[ position - 1 ] = std::move( key );
+				body->children[ position ] = node;
+				++body->size;
+			}
+
+			/*! \brief Free leaf position of body, its neighbor takes over
+				the range */
+			inline void _removeChild( Body* body, size_type position )
+			{
+				Leaf* leaf = static_cast< Leaf* >( body->children[ position ] );
+				if( leaf->previous != 0 )
+				{
+					leaf->previous->next = leaf->next;
+				}
+				if( leaf->next != 0 )
+				{
+					leaf->next->previous = leaf->previous;
+				}
+				_free( leaf );
+
+				size_type pivot = position == 0 ? 0 : position - 1;
+				std::move( body->keys + pivot + 1, body->keys + body->size,
+					body->keys + pivot );
+				std::copy( body->children + position + 1,
+					body->children + body->size + 1,
+					body->children + position );
+				--body->size;
+			}
+
+			/*! \brief Split child position of body in half, along with its
+				buffer */
+			inline void _split( Body* body, size_type position )
+			{
+				Body* left = static_cast< Body* >( body->children[ position ] );
+				Body* right = _allocateBody( left->level );
+
+				size_type middle = left->size / 2;
+				key_type separator = std::move( left->keys[ middle ] );
+
+				std::move( left->keys + middle + 1, left->keys + left->size,
+					right->keys );
+				std::copy( left->children + middle + 1,
+					left->children + left->size + 1, right->children );
+				right->size = left->size - middle - 1;
+				left->size = middle;
+
+				size_type cut = Search::lowerBound( left->messages,
+					left->messageCount, separator, _keyCompare );
+				std::move( left->messages + cut,
+					left->messages + left->messageCount, right->messages );
+				right->messageCount = left->messageCount - cut;
+				left->messageCount = cut;
+
+				right->pending = right->messageCount;
+				if( right->level > 1 )
+				{
+					for( size_type i = 0; i <= right->size; ++i )
+					{
+						right->pending += static_cast< Body* >(
+							right->children[ i ] )->pending;
+					}
+				}
+				left->pending -= right->pending;
+
+				report( "   Split body " << left << " at " << separator );
+
+				_insertChild( body, position + 1, std::move( separator ),
+					right );
+			}
+
+			/*! \brief Give the root a parent if it has too many children */
+			inline void _growRoot()
+			{
+				if( _root->overflowing() )
+				{
+					Body* root = _allocateBody( _root->level + 1 );
+					root->children[ 0 ] = _root;
+					root->pending = _root->pending;
+					_root = root;
+					_split( root, 0 );
+				}
+			}
+
+			/*! \brief Remove roots with a single child and no messages */
+			inline void _collapseRoot()
+			{
+				while( _root->size == 0 && _root->messageCount == 0
+					&& !_root->children[ 0 ]->leaf() )
+				{
+					Body* root = _root;
+					_root = static_cast< Body* >( root->children[ 0 ] );
+					root->~Body();
+					_bodyAllocator.deallocate( root, 1 );
+				}
+			}
+
+			/*! \brief Merge the batch of messages [begin, end) of body with
+				the buffer of its child next, the batch is newer.  Returns
+				the messages folded into older ones. */
+			inline size_type _push( Body* body, Body* next, size_type begin,
+				size_type end )
+			{
+				size_type combined = 0;
+				_messages.clear();
+
+				Message* older = next->messages;
+				Message* olderEnd = older + next->messageCount;
+				Message* newer = body->messages + begin;
+				Message* newerEnd = body->messages + end;
+
+				while( older != olderEnd && newer != newerEnd )
+				{
+					if( _keyCompare( older->first, newer->first ) )
+					{
+						_messages.push_back( std::move( *older++ ) );
+					}
+					else if( _keyCompare( newer->first, older->first ) )
+					{
+						_messages.push_back( std::move( *newer++ ) );
+					}
+					else
+					{
+						_combine( *older, std::move( *newer ),
+							newer->operation );
+						_messages.push_back( std::move( *older ) );
+						++older;
+						++newer;
+						++combined;
+					}
+				}
+
+				_messages.insert( _messages.end(),
+					std::make_move_iterator( older ),
+					std::make_move_iterator( olderEnd ) );
+				_messages.insert( _messages.end(),
+					std::make_move_iterator( newer ),
+					std::make_move_iterator( newerEnd ) );
+
+				std::move( _messages.begin(), _messages.end(),
+					next->messages );
+				next->messageCount = _messages.size();
+				next->pending += end - begin - combined;
+				_eraseMessages( body, begin, end );
+				_pending -= combined;
+
+				return combined;
+			}
+
+			/*! \brief Apply the batch of messages [begin, end) of body to its
+				leaf child, splitting or merging leaves as needed */
+			inline void _apply( Body* body, size_type child, size_type begin,
+				size_type end )
+			{
+				Leaf* leaf = static_cast< Leaf* >( body->children[ child ] );
+
+				report( "   Applying " << ( end - begin )
+					<< " messages to leaf " << leaf );
+
+				_values.clear();
+
+				value_type* entry = leaf->data;
+				value_type* entryEnd = entry + leaf->size;
+
+				for( Message* message = body->messages + begin;
+					message != body->messages + end; ++message )
+				{
+					while( entry != entryEnd
+						&& _keyCompare( entry->first, message->first ) )
+					{
+						_values.push_back( std::move( *entry++ ) );
+					}
+
+					if( entry != entryEnd
+						&& !_keyCompare( message->first, entry->first ) )
+					{
+						if( message->operation == Assign )
+						{
+							_values.push_back( std::move( *message ) );
+						}
+						else if( message->operation == Insert )
+						{
+							_values.push_back( std::move( *entry ) );
+						}
+						else
+						{
+							--_size;
+						}
+						++entry;
+					}
+					else if( message->operation != Erase )
+					{
+						_values.push_back( std::move( *message ) );
+						++_size;
+					}
+				}
+
+				_values.insert( _values.end(),
+					std::make_move_iterator( entry ),
+					std::make_move_iterator( entryEnd ) );
+
+				_pending -= end - begin;
+				_eraseMessages( body, begin, end );
+
+				size_type total = _values.size();
+				size_type pieces = ( total + MaxLeafs - 1 ) / MaxLeafs;
+
+				if( pieces < 2 )
+				{
+					std::move( _values.begin(), _values.end(), leaf->data );
+					leaf->size = total;
+					_shrink( body, child );
+					return;
+				}
+
+				size_type first = 0;
+				Leaf* previous = 0;
+				for( size_type piece = 0; piece < pieces; ++piece )
+				{
+					size_type last = total * ( piece + 1 ) / pieces;
+					Leaf* target = leaf;
+					if( piece != 0 )
+					{
+						target = _allocateLeaf();
+						target->previous = previous;
+						target->next = previous->next;
+						if( target->next != 0 )
+						{
+							target->next->previous = target;
+						}
+						previous->next = target;
+						_insertChild( body, child + piece,
+							key_type( _values[ first ].first ), target );
+					}
+					std::move( _values.begin() + first,
+						_values.begin() + last, target->data );
+					target->size = last - first;
+					previous = target;
+					first = last;
+				}
+			}
+
+			/*! \brief Free child of body if it is empty, or merge it with a
+				neighbor if both are small */
+			inline void _shrink( Body* body, size_type child )
+			{
+				Leaf* leaf = static_cast< Leaf* >( body->children[ child ] );
+				if( body->size == 0 || leaf->size >= MinLeafs )
+				{
+					return;
+				}
+
+				if( leaf->size == 0 )
+				{
+					_removeChild( body, child );
+					return;
+				}
+
+				size_type left = child == body->size ? child - 1 : child;
+				Leaf* first = static_cast< Leaf* >( body->children[ left ] );
+				Leaf* second = static_cast< Leaf* >(
+					body->children[ left + 1 ] );
+
+				if( first->size + second->size > MaxLeafs / 2 )
+				{
+					return;
+				}
+
+				std::move( second->data, second->data + second->size,
+					first->data + first->size );
+				first->size += second->size;
+				_removeChild( body, left + 1 );
+			}
+
+			/*! \brief Move the messages bound for the child of body with the
+				most of them down a level.  body may be left with too many
+				children for its parent to split.  Returns the messages that
+				were applied or folded into older ones. */
+			inline size_type _flush( Body* body )
+			{
+				size_type retired = 0;
+
+				size_type child = 0;
+				size_type begin = 0;
+				size_type end = 0;
+				size_type first = 0;
+
+				for( size_type i = 0; i <= body->size; ++i )
+				{
+					size_type last = i == body->size ? body->messageCount
+						: first + Search::lowerBound( body->messages + first,
+						body->messageCount - first, body->keys[ i ],
+						_keyCompare );
+					if( last - first > end - begin )
+					{
+						child = i;
+						begin = first;
+						end = last;
+					}
+					first = last;
+				}
+
+				Body* next = static_cast< Body* >( body->children[ child ] );
+				if( next->leaf() )
+				{
+					retired = end - begin;
+					_apply( body, child, begin, end );
+				}
+				else if( next->messageCount + end - begin > MaxMessages )
+				{
+					retired = _flush( next );
+					if( next->overflowing() )
+					{
+						_split( body, child );
+					}
+				}
+				else
+				{
+					report( "   Pushing " << ( end - begin )
+						<< " messages into body " << next );
+
+					retired = _push( body, next, begin, end );
+				}
+
+				body->pending -= retired;
+				return retired;
+			}
+
+			/*! \brief Apply every message below body, adding the messages
+				retired to retired.  Returns false if body was left with too
+				many children and must be split first. */
+			inline bool _drain( Body* body, size_type& retired )
+			{
+				while( body->messageCount != 0 )
+				{
+					retired += _flush( body );
+					if( body->overflowing() )
+					{
+						return false;
+					}
+				}
+
+				if( body->level == 1 )
+				{
+					return true;
+				}
+
+				for( size_type i = 0; i <= body->size && body->pending != 0; )
+				{
+					Body* child = static_cast< Body* >( body->children[ i ] );
+					size_type drained = 0;
+					bool done = child->pending == 0 || _drain( child, drained );
+
+					body->pending -= drained;
+					retired += drained;
+
+					if( done )
+					{
+						++i;
+						continue;
+					}
+
+					_split( body, i );
+					if( body->overflowing() )
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			/*! \brief Make sure the root has a free message */
+			inline void _makeRoom()
+			{
+				if( _root == 0 )
+				{
+					_root = _allocateBody( 1 );
+					_root->children[ 0 ] = _allocateLeaf();
+				}
+
+				while( _root->messageCount == MaxMessages )
+				{
+					_flush( _root );
+					_growRoot();
+				}
+			}
+
+			/*! \brief Write a message into the root, returning its value */
+			template< typename Pair >
+			inline pointer _post( Pair&& x, Operation operation )
+			{
+				_makeRoom();
+
+				Body* root = _root;
+				size_type index = Search::lowerBound( root->messages,
+					root->messageCount, x.first, _keyCompare );
+				Message& message = root->messages[ index ];
+
+				if( index < root->messageCount
+					&& !_keyCompare( x.first, message.first ) )
+				{
+					_combine( message, std::forward< Pair >( x ), operation );
+					return &message;
+				}
+
+				std::move_backward( root->messages + index,
+					root->messages + root->messageCount,
+					root->messages + root->messageCount + 1 );
+				static_cast< value_type& >( message ) =
+					std::forward< Pair >( x );
+				message.operation = operation;
+				++root->messageCount;
+				++root->pending;
+				++_pending;
+
+				return &message;
+			}
+
+			template< typename Pair >
+			inline insertion _insert( Pair&& x )
+			{
+				Leaf* leaf = 0;
+				size_type index = 0;
+				pointer entry = _locate( x.first, leaf, index );
+
+				if( entry != 0 )
+				{
+					return insertion( iterator( this, leaf, index, entry ),
+						false );
+				}
+
+				report( "Inserting " << x.first );
+
+				return insertion( iterator( this, 0, 0,
+					_post( std::forward< Pair >( x ), Assign ) ), true );
+			}
+
+		public:
+			explicit inline BufferedBTree( const Compare& comp = Compare(),
+				const Allocator& alloc = Allocator() ) : _allocator( alloc ),
+				_compare( comp ), _keyCompare( comp ), _bodyAllocator( alloc ),
+				_leafAllocator( alloc ), _root( 0 ), _size( 0 ), _pending( 0 ),
+				_values( alloc ), _messages( alloc )
+			{
+
+			}
+
+			template< typename InputIterator >
+			inline BufferedBTree( InputIterator first, InputIterator last,
+				const Compare& comp = Compare(),
+				const Allocator& alloc = Allocator() ) : _allocator( alloc ),
+				_compare( comp ), _keyCompare( comp ), _bodyAllocator( alloc ),
+				_leafAllocator( alloc ), _root( 0 ), _size( 0 ), _pending( 0 ),
+				_values( alloc ), _messages( alloc )
+			{
+				insert( first, last );
+			}
+
+			inline BufferedBTree( const BufferedBTree& tree ) :
+				_allocator( tree._allocator ), _compare( tree._compare ),
+				_keyCompare( tree._keyCompare ),
+				_bodyAllocator( tree._bodyAllocator ),
+				_leafAllocator( tree._leafAllocator ), _root( 0 ),
+				_size( 0 ), _pending( 0 ), _values( tree._allocator ),
+				_messages( tree._allocator )
+			{
+				_copy( tree );
+			}
+
+			inline ~BufferedBTree()
+			{
+				clear();
+			}
+
+			inline BufferedBTree& operator=( const BufferedBTree& tree )
+			{
+				if( &tree != this )
+				{
+					clear();
+					_copy( tree );
+				}
+				return *this;
+			}
+
+		public:
+			inline iterator begin()
+			{
+				flush();
+				if( _root == 0 )
+				{
+					return end();
+				}
+				return _at( _leftmost(), 0 );
+			}
+
+			inline iterator end()
+			{
+				return iterator( this, 0, 0, 0 );
+			}
+
+			inline const_iterator end() const
+			{
+				return const_iterator( const_cast< BufferedBTree* >( this ),
+					0, 0, 0 );
+			}
+
+			inline reverse_iterator rbegin()
+			{
+				return reverse_iterator( end() );
+			}
+
+			inline reverse_iterator rend()
+			{
+				return reverse_iterator( begin() );
+			}
+
+
+		public:
+			inline size_type size()
+			{
+				flush();
+				return _size;
+			}
+
+			inline bool empty()
+			{
+				return size() == 0;
+			}
+
+			inline size_type max_size() const
+			{
+				return _allocator.max_size();
+			}
+
+		public:
+			inline mapped_type& operator[]( const key_type& key )
+			{
+				return insert( value_type( key, mapped_type() ) ).first->second;
+			}
+
+			inline insertion insert( const value_type& x )
+			{
+				return _insert( x );
+			}
+
+			inline insertion insert( value_type&& x )
+			{
+				return _insert( std::move( x ) );
+			}
+
+			template< typename... Args >
+			inline insertion emplace( Args&&... args )
+			{
+				return _insert( value_type( std::forward< Args >( args )... ) );
+			}
+
+			inline iterator insert( iterator, const value_type& x )
+			{
+				return insert( x ).first;
+			}
+
+			template< typename InputIterator >
+			inline void insert( InputIterator first, InputIterator last )
+			{
+				for( ; first != last; ++first )
+				{
+					insert( *first );
+				}
+			}
+
+			/*! \brief Insert x if its key is missing without looking it up,
+				the fastest way to write */
+			inline void insert_buffered( const value_type& x )
+			{
+				_post( x, Insert );
+			}
+
+			/*! \brief Erase x if it is there without looking it up */
+			inline void erase_buffered( const key_type& x )
+			{
+				_post( value_type( x, mapped_type() ), Erase );
+			}
+
+			inline void erase( iterator position )
+			{
+				key_type key = position->first;
+				erase( key );
+			}
+
+			inline size_type erase( const key_type& x )
+			{
+				Leaf* leaf = 0;
+				size_type index = 0;
+				if( _locate( x, leaf, index ) == 0 )
+				{
+					return 0;
+				}
+
+				report( "Erasing " << x );
+
+				_post( value_type( x, mapped_type() ), Erase );
+				return 1;
+			}
+
+			inline void erase( iterator first, iterator last )
+			{
+				if( first == begin() && last == end() )
+				{
+					clear();
+					return;
+				}
+
+				KeyVector keys;
+				for( ; first != last; ++first )
+				{
+					keys.push_back( first->first );
+				}
+
+				for( typename KeyVector::iterator key = keys.begin();
+					key != keys.end(); ++key )
+				{
+					erase_buffered( *key );
+				}
+			}
+
+			inline void swap( BufferedBTree& tree )
+			{
+				std::swap( _allocator, tree._allocator );
+				std::swap( _compare, tree._compare );
+				std::swap( _keyCompare, tree._keyCompare );
+				std::swap( _bodyAllocator, tree._bodyAllocator );
+				std::swap( _leafAllocator, tree._leafAllocator );
+				std::swap( _root, tree._root );
+				std::swap( _size, tree._size );
+				std::swap( _pending, tree._pending );
+				_values.swap( tree._values );
+				_messages.swap( tree._messages );
+			}
+
+			inline void clear()
+			{
+				if( _root != 0 )
+				{
+					_free( _root );
+				}
+				_root = 0;
+				_size = 0;
+				_pending = 0;
+			}
+
+			/*! \brief Apply every pending message to the leaves */
+			inline void flush()
+			{
+				if( _pending == 0 )
+				{
+					return;
+				}
+
+				report( "Flushing " << _pending << " messages" );
+
+				size_type retired = 0;
+				while( !_drain( _root, retired ) )
+				{
+					_growRoot();
+				}
+				_collapseRoot();
+			}
+
+		public:
+			inline key_compare key_comp() const
+			{
+				return _keyCompare;
+			}
+
+			inline value_compare value_comp() const
+			{
+				return _compare;
+			}
+
+			inline allocator_type get_allocator() const
+			{
+				return _allocator;
+			}
+
+		public:
+			inline iterator find( const key_type& x )
+			{
+				Leaf* leaf = 0;
+				size_type index = 0;
+				pointer entry = _locate( x, leaf, index );
+				if( entry == 0 )
+				{
+					return end();
+				}
+				return iterator( this, leaf, index, entry );
+			}
+
+			inline const_iterator find( const key_type& x ) const
+			{
+				Leaf* leaf = 0;
+				size_type index = 0;
+				const_pointer entry = _locate( x, leaf, index );
+				if( entry == 0 )
+				{
+					return end();
+				}
+				return const_iterator( const_cast< BufferedBTree* >( this ),
+					leaf, index, entry );
+			}
+
+			inline size_type count( const key_type& x ) const
+			{
+				Leaf* leaf = 0;
+				size_type index = 0;
+				return _locate( x, leaf, index ) != 0;
+			}
+
+			inline iterator lower_bound( const key_type& x )
+			{
+				flush();
+				return _lowerBound( x );
+			}
+
+			inline iterator upper_bound( const key_type& x )
+			{
+				flush();
+				return _upperBound( x );
+			}
+
+			inline std::pair< iterator, iterator > equal_range(
+				const key_type& x )
+			{
+				iterator first = lower_bound( x );
+				iterator last = first;
+				if( last != end() && !_keyCompare( x, last->first ) )
+				{
+					++last;
+				}
+				return std::make_pair( first, last );
+			}
+	};
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator==(BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		if( x.size() != y.size() )
+		{
+			return false;
+		}
+		return std::equal( x.begin(), x.end(), y.begin() );
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator< (BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		return std::lexicographical_compare( x.begin(), x.end(), y.begin(),
+			y.end() );
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator!=(BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		return !( x == y );
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator> (BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		return y < x;
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator>=(BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		return !( x < y );
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	bool operator<=(BufferedBTree< Key, T, Compare, Allocator,
+		PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		return !( x > y );
+	}
+
+	template < typename Key, typename T, typename Compare, typename Allocator,
+		size_t PageSize >
+	void swap(BufferedBTree< Key, T, Compare, Allocator, PageSize >& x,
+		BufferedBTree< Key, T, Compare, Allocator, PageSize >& y)
+	{
+		x.swap( y );
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,574 @@
+/*!
+	\file Channel.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the Channel class
+*/
+
+#ifndef CHANNEL_H_INCLUDED
+#define CHANNEL_H_INCLUDED
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <atomic>
+#include <new>
+#include <utility>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*! \brief Channels with one sending and one receiving thread at a
+		time, claiming cells does not need a compare and swap */
+	class SingleProducerSingleConsumer
+	{
+		public:
+			static const bool Shared = false;
+	};
+
+	/*! \brief Channels with any number of sending and receiving threads */
+	class MultipleProducerMultipleConsumer
+	{
+		public:
+			static const bool Shared = true;
+	};
+
+	/*!
+		\brief A bounded queue of typed items between threads.
+
+		Items live in a ring of cells, each with a sequence that says
+		whether it is free or full for a position, so sending and
+		receiving do not take a lock.  A batch claims a run of cells with
+		a single update of the position, then moves items in or out of
+		them and publishes them, so a batch of any size costs one
+		synchronization.
+
+		The ring never grows.  Sending to a full channel and receiving
+		from an empty one spin briefly and then sleep, and they are only
+		woken by the other side when something is asleep, which bounds the
+		memory of a pipeline of threads.  The try versions never block.
+
+		A channel is closed when each of its senders has called close().
+		Sending to a closed channel fails, and receiving from one fails
+		once it is empty.
+
+		A claimed cell must be filled or emptied, or every thread behind
+		it would wait forever, so items have to move without throwing.
+		Sending a copy makes the copy before claiming a cell, a copy that
+		throws leaves the channel as it was.
+
+		The Access policy is SingleProducerSingleConsumer or
+		MultipleProducerMultipleConsumer.
+	*/
+	template< typename T, typename Access = MultipleProducerMultipleConsumer >
+	class Channel
+	{
+		public:
+			typedef T value_type;
+			typedef Access access_type;
+
+		public:
+			/*! \brief Rounds of looking for room or items before sleeping */
+			static const unsigned int Spins = 64;
+
+			static_assert( std::is_nothrow_move_constructible< T >::value,
+				"Channel items must move construct without throwing" );
+			static_assert( std::is_nothrow_move_assignable< T >::value,
+				"Channel items must move assign without throwing" );
+
+		private:
+			class Cell
+			{
+				public:
+					std::atomic< size_t > sequence;
+					typename std::aligned_storage< sizeof( T ),
+						std::alignment_of< T >::value >::type storage;
+
+				public:
+					T* item()
+					{
+						return reinterpret_cast< T* >( &storage );
+					}
+			};
+
+			/*! \brief A position on its own cache line */
+			class Position
+			{
+				public:
+					std::atomic< size_t > value;
+
+				private:
+					char _padding[ 64 - sizeof( std::atomic< size_t > ) ];
+
+				public:
+					Position() : value( 0 ) {}
+			};
+
+		private:
+			Position _enqueue;
+			Position _dequeue;
+
+		private:
+			Cell* _cells;
+			const size_t _mask;
+			/*! \brief Senders that have not closed */
+			std::atomic< unsigned int > _open;
+
+		private:
+			std::atomic< unsigned int > _waitingSenders;
+			std::atomic< unsigned int > _waitingReceivers;
+			boost::mutex _mutex;
+			boost::condition_variable _notFull;
+			boost::condition_variable _notEmpty;
+
+		private:
+			/*! \brief At least two cells, with one the sequence of a full
+				cell would be the same as that of the next free one */
+			static size_t _round( size_t capacity )
+			{
+				size_t size = 2;
+
+				while( size < capacity )
+				{
+					size <<= 1;
+				}
+
+				return size;
+			}
+
+		private:
+			/*! \brief Claim up to count cells that are free, for an offset
+				of 0, or full, for an offset of 1
+
+				\return The number claimed, starting at position
+			*/
+			size_t _claim( std::atomic< size_t >& counter, size_t offset,
+				size_t count, size_t& position )
+			{
+				position = counter.load( std::memory_order_relaxed );
+
+				while( true )
+				{
+					size_t available = 0;
+
+					while( available < count && available <= _mask
+						&& _cells[ ( position + available ) & _mask ].sequence
+						.load( std::memory_order_acquire )
+						== position + available + offset )
+					{
+						++available;
+					}
+
+					if( available == 0 )
+					{
+						size_t current = counter.load(
+							std::memory_order_relaxed );
+
+						if( current == position )
+						{
+							return 0;
+						}
+
+						position = current;
+						continue;
+					}
+
+					if( !Access::Shared )
+					{
+						counter.store( position + available,
+							std::memory_order_relaxed );
+						return available;
+					}
+
+					if( counter.compare_exchange_weak( position,
+						position + available, std::memory_order_relaxed ) )
+					{
+						return available;
+					}
+				}
+			}
+
+			/*! \brief Is the next cell free, or full, for an offset of 1 */
+			bool _ready( const std::atomic< size_t >& counter,
+				size_t offset ) const
+			{
+				size_t position = counter.load( std::memory_order_relaxed );
+
+				return _cells[ position & _mask ].sequence.load(
+					std::memory_order_acquire ) == position + offset;
+			}
+
+			bool _closed() const
+			{
+				return _open.load( std::memory_order_acquire ) == 0;
+			}
+
+			void _sleep( bool sending )
+			{
+				std::atomic< unsigned int >& waiting =
+					sending ? _waitingSenders : _waitingReceivers;
+				boost::condition_variable& condition =
+					sending ? _notFull : _notEmpty;
+				std::atomic< size_t >& counter =
+					sending ? _enqueue.value : _dequeue.value;
+
+				boost::unique_lock< boost::mutex > lock( _mutex );
+
+				// The other side publishes cells before it checks for
+				//  sleepers, this side counts itself before it checks cells
+				waiting.fetch_add( 1 );
+				std::atomic_thread_fence( std::memory_order_seq_cst );
+
+				while( !_ready( counter, sending ? 0 : 1 ) && !_closed() )
+				{
+					condition.wait( lock );
+				}
+
+				waiting.fetch_sub( 1 );
+			}
+
+			/*! \brief Wake the other side if it is asleep */
+			void _wake( bool sent, size_t count )
+			{
+				std::atomic_thread_fence( std::memory_order_seq_cst );
+
+				std::atomic< unsigned int >& waiting =
+					sent ? _waitingReceivers : _waitingSenders;
+
+				if( waiting.load( std::memory_order_relaxed ) == 0 )
+				{
+					return;
+				}
+
+				boost::condition_variable& condition =
+					sent ? _notEmpty : _notFull;
+
+				boost::unique_lock< boost::mutex > lock( _mutex );
+
+				if( count == 1 )
+				{
+					condition.notify_one();
+				}
+				else
+				{
+					condition.notify_all();
+				}
+			}
+
+			/*! \brief Claim cells to send to, or to receive from
+
+				\return The number claimed, 0 if the channel is closed or
+					if it would block and block is false
+			*/
+			size_t _acquire( bool sending, size_t count, bool block,
+				size_t& position )
+			{
+				std::atomic< size_t >& counter =
+					sending ? _enqueue.value : _dequeue.value;
+				unsigned int spins = 0;
+
+				while( true )
+				{
+					// Closing happens after the last send, so a closed
+					//  channel that is empty stays empty
+					bool closed = _closed();
+
+					if( sending && closed )
+					{
+						return 0;
+					}
+
+					size_t claimed = _claim( counter, sending ? 0 : 1,
+						count, position );
+
+					if( claimed != 0 || closed || !block )
+					{
+						return claimed;
+					}
+
+					if( ++spins < Spins )
+					{
+						boost::this_thread::yield();
+						continue;
+					}
+
+					spins = 0;
+					_sleep( sending );
+				}
+			}
+
+			void _sent( size_t position, size_t count )
+			{
+				for( size_t i = 0; i < count; ++i )
+				{
+					_cells[ ( position + i ) & _mask ].sequence.store(
+						position + i + 1, std::memory_order_release );
+				}
+
+				_wake( true, count );
+			}
+
+			void _received( size_t position, size_t count )
+			{
+				for( size_t i = 0; i < count; ++i )
+				{
+					Cell& cell = _cells[ ( position + i ) & _mask ];
+
+					cell.item()->~T();
+					cell.sequence.store( position + i + _mask + 1,
+						std::memory_order_release );
+				}
+
+				_wake( false, count );
+			}
+
+			bool _send( T&& item, bool block )
+			{
+				size_t position = 0;
+
+				if( _acquire( true, 1, block, position ) == 0 )
+				{
+					return false;
+				}
+
+				::new( _cells[ position & _mask ].item() )
+					T( std::move( item ) );
+
+				_sent( position, 1 );
+
+				return true;
+			}
+
+			/*! \brief Copy before claiming a cell, the copy may throw */
+			bool _send( const T& item, bool block )
+			{
+				T copy( item );
+
+				return _send( std::move( copy ), block );
+			}
+
+			bool _receive( T& item, bool block )
+			{
+				size_t position = 0;
+
+				if( _acquire( false, 1, block, position ) == 0 )
+				{
+					return false;
+				}
+
+				item = std::move( *_cells[ position & _mask ].item() );
+
+				_received( position, 1 );
+
+				return true;
+			}
+
+			size_t _sendBatch( T* items, size_t count, bool block )
+			{
+				size_t position = 0;
+				size_t claimed = _acquire( true, count, block, position );
+
+				for( size_t i = 0; i < claimed; ++i )
+				{
+					::new( _cells[ ( position + i ) & _mask ].item() )
+						T( std::move( items[ i ] ) );
+				}
+
+				if( claimed != 0 )
+				{
+					_sent( position, claimed );
+				}
+
+				return claimed;
+			}
+
+			size_t _receiveBatch( T* items, size_t count, bool block )
+			{
+				size_t position = 0;
+				size_t claimed = _acquire( false, count, block, position );
+
+				for( size_t i = 0; i < claimed; ++i )
+				{
+					items[ i ] = std::move(
+						*_cells[ ( position + i ) & _mask ].item() );
+				}
+
+				if( claimed != 0 )
+				{
+					_received( position, claimed );
+				}
+
+				return claimed;
+			}
+
+		private:
+			Channel( const Channel& );
+			Channel& operator=( const Channel& );
+
+		public:
+			/*! \brief Make a channel that holds at least capacity items,
+				rounded up to a power of two of at least 2, and that closes
+				after senders calls to close() */
+			explicit Channel( size_t capacity, unsigned int senders = 1 ) :
+				_cells( new Cell[ _round( capacity ) ] ),
+				_mask( _round( capacity ) - 1 ), _open( senders ),
+				_waitingSenders( 0 ), _waitingReceivers( 0 )
+			{
+				for( size_t i = 0; i <= _mask; ++i )
+				{
+					_cells[ i ].sequence.store( i, std::memory_order_relaxed );
+				}
+			}
+
+			/*! \brief Destroy the items that were never received */
+			~Channel()
+			{
+				size_t position = _dequeue.value.load();
+
+				while( _cells[ position & _mask ].sequence.load()
+					== position + 1 )
+				{
+					_cells[ position & _mask ].item()->~T();
+					++position;
+				}
+
+				delete[] _cells;
+			}
+
+		public:
+			/*! \brief Send an item, waiting for room
+
+				\return False if the channel is closed
+			*/
+			bool send( const T& item )
+			{
+				return _send( item, true );
+			}
+
+			bool send( T&& item )
+			{
+				return _send( std::move( item ), true );
+			}
+
+			/*! \brief Send an item if there is room, it is only moved
+				from if it was sent */
+			bool try_send( const T& item )
+			{
+				return _send( item, false );
+			}
+
+			bool try_send( T&& item )
+			{
+				return _send( std::move( item ), false );
+			}
+
+			/*! \brief Move every item of a span into the channel, waiting
+				for room, with one synchronization for each run of free
+				cells
+
+				\return The number sent, less than count only if the
+					channel is closed
+			*/
+			size_t send_batch( T* items, size_t count )
+			{
+				size_t sent = 0;
+
+				while( sent < count )
+				{
+					size_t claimed = _sendBatch( items + sent, count - sent,
+						true );
+
+					if( claimed == 0 )
+					{
+						break;
+					}
+
+					sent += claimed;
+				}
+
+				return sent;
+			}
+
+			/*! \brief Move as many items of a span as there is room for
+
+				\return The number sent
+			*/
+			size_t try_send_batch( T* items, size_t count )
+			{
+				return _sendBatch( items, count, false );
+			}
+
+			/*! \brief Receive an item, waiting for one
+
+				\return False if the channel is closed and empty
+			*/
+			bool receive( T& item )
+			{
+				return _receive( item, true );
+			}
+
+			/*! \brief Receive an item if there is one */
+			bool try_receive( T& item )
+			{
+				return _receive( item, false );
+			}
+
+			/*! \brief Move up to count items into a span, waiting until
+				there is at least one
+
+				\return The number received, 0 only if the channel is
+					closed and empty
+			*/
+			size_t receive_batch( T* items, size_t count )
+			{
+				return _receiveBatch( items, count, true );
+			}
+
+			/*! \brief Move up to count items into a span without waiting
+
+				\return The number received
+			*/
+			size_t try_receive_batch( T* items, size_t count )
+			{
+				return _receiveBatch( items, count, false );
+			}
+
+			/*! \brief A sender is done, the channel closes once every
+				sender is */
+			void close()
+			{
+				assert( _open.load() > 0 );
+
+				if( _open.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+				{
+					boost::unique_lock< boost::mutex > lock( _mutex );
+
+					_notFull.notify_all();
+					_notEmpty.notify_all();
+				}
+			}
+
+			/*! \brief Has every sender closed the channel */
+			bool closed() const
+			{
+				return _closed();
+			}
+
+			/*! \brief The number of items that fit in the channel */
+			size_t capacity() const
+			{
+				return _mask + 1;
+			}
+	};
+
+	template< typename T, typename Access >
+	const unsigned int Channel< T, Access >::Spins;
+
+}
+
+#endif
+
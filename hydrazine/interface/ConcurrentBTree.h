@@ -0,0 +1,1097 @@
+/*!
+	\file ConcurrentBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the ConcurrentBTree class
+*/
+
+#ifndef CONCURRENT_BTREE_H_INCLUDED
+#define CONCURRENT_BTREE_H_INCLUDED
+
+#include <hydrazine/interface/debug.h>
+#include <hydrazine/interface/macros.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <hydrazine/interface/LeafLayout.h>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/functional/hash.hpp>
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A B+tree that can be read and written by many threads at once.
+
+		The nodes are laid out like those of BTree, but each one carries a
+		version counter rather than a lock.  Readers never write shared
+		memory, they traverse optimistically and restart if the version
+		of a node they looked at changed before they were done with it.
+		Writers lock only the leaf they modify, plus the parent when a
+		node has to split.  Full nodes are split on the way down, so a
+		split never propagates more than one level.
+
+		The leaf chain is singly linked and may be walked concurrently
+		with writers by scan().
+
+		An erase that empties a leaf unlinks it from its parent and from
+		the leaf chain, along with any ancestors that are left without
+		children.  The unlinked nodes are marked obsolete, so that anyone
+		who still reaches them restarts, and are retired rather than
+		released.  Every operation announces the epoch it started in, and
+		a retired node is only released once every operation that was
+		running when it was unlinked has finished.  An optimistic reader
+		can therefore always dereference a stale pointer safely, and
+		memory stays proportional to the number of live elements, even
+		when keys keep moving, without ever stopping other threads.
+		Bodies are not merged, so the height of the tree never shrinks.
+
+		Because readers copy keys and values that a writer might be
+		changing, both must be trivially copyable.
+	*/
+	template< typename Key, typename Value, typename Compare = std::less<Key>,
+		typename _Allocator = std::allocator< std::pair< const Key,
+		Value > >, size_t PageSize = 1024,
+		typename Layout = PairedLeafLayout >
+	class ConcurrentBTree
+	{
+		public:
+			typedef Key key_type;
+			typedef Value mapped_type;
+			typedef std::pair< key_type, mapped_type > value_type;
+			typedef ConcurrentBTree type;
+			typedef Compare key_compare;
+			typedef size_t size_type;
+
+		private:
+			typedef typename Layout::template Storage< key_type, mapped_type,
+				PageSize > LeafStorage;
+			typedef NodeSearch< key_type, key_compare > Search;
+			typedef unsigned long long Version;
+			typedef unsigned long long Epoch;
+
+		private:
+			class Body;
+			class Node;
+			class Leaf;
+
+		private:
+			static const size_type MaxNodes = MAX( 8,
+				PageSize / ( sizeof( key_type ) + sizeof( Node* ) ) );
+			static const size_type MaxLeafs = LeafStorage::Capacity;
+
+			/*! \brief The bit of a version that is set while locked */
+			static const Version Locked = 2;
+			/*! \brief The bit of a version that is set once unlinked */
+			static const Version Obsolete = 1;
+
+			/*! \brief Leaves are only created by splitting a full node, so
+				this bounds the height with a 64 bit size_type */
+			static const size_type MaxHeight = 4 * sizeof( size_type ) + 2;
+
+			/*! \brief The number of threads that can be inside an
+				operation at once without waiting for each other */
+			static const size_type Slots = 64;
+
+		private:
+			typedef typename _Allocator::template rebind< Body >::other
+				BodyAllocator;
+			typedef typename _Allocator::template rebind< Leaf >::other
+				LeafAllocator;
+
+		private:
+			/*!
+				\brief A base class for an internal node, holding the version
+					that guards it.
+			*/
+			class Node
+			{
+				public:
+					std::atomic< Version > version;
+					size_type level;
+					size_type size;
+
+				public:
+					inline void construct( size_type l )
+					{
+						version.store( 0, std::memory_order_relaxed );
+						level = l;
+						size = 0;
+					}
+
+					inline bool leaf() const
+					{
+						return level == 0;
+					}
+
+				public:
+					/*! \brief Wait for any writer and return the version */
+					inline Version readLock() const
+					{
+						Version v = version.load( std::memory_order_acquire );
+						for( unsigned int spins = 0; v & Locked; ++spins )
+						{
+							pause( spins );
+							v = version.load( std::memory_order_acquire );
+						}
+						return v;
+					}
+
+					/*! \brief Did nothing change since readLock returned v? */
+					inline bool validate( Version v ) const
+					{
+						std::atomic_thread_fence( std::memory_order_acquire );
+						return version.load( std::memory_order_relaxed ) == v;
+					}
+
+					/*! \brief Lock if nothing changed since version v */
+					inline bool upgrade( Version v )
+					{
+						return version.compare_exchange_strong( v,
+							v + Locked, std::memory_order_acquire );
+					}
+
+					/*! \brief Unlock and publish a new version */
+					inline void unlock()
+					{
+						version.fetch_add( Locked, std::memory_order_release );
+					}
+
+					/*! \brief Unlock a node that was unlinked, anyone who
+						still reaches it will restart */
+					inline void unlockObsolete()
+					{
+						version.fetch_add( Locked + Obsolete,
+							std::memory_order_release );
+					}
+
+					/*! \brief Was the node unlinked when v was read? */
+					static inline bool obsolete( Version v )
+					{
+						return v & Obsolete;
+					}
+
+				public:
+					static inline void pause( unsigned int spins )
+					{
+						if( spins < 64 )
+						{
+							#ifdef __SSE2__
+							__builtin_ia32_pause();
+							#endif
+						}
+						else
+						{
+							boost::this_thread::yield();
+						}
+					}
+			};
+
+			/*!
+				\brief Body Node
+			*/
+			class Body : public Node
+			{
+				public:
+					key_type keys[ MaxNodes ];
+					Node* children[ MaxNodes + 1 ];
+
+				public:
+					/*! \brief Children start out null so that an optimistic
+						reader never follows an uninitialized pointer */
+					inline void construct( const size_type level )
+					{
+						Node::construct( level );
+						std::fill( children, children + MaxNodes + 1,
+							( Node* ) 0 );
+					}
+
+					inline bool full() const
+					{
+						return this->size >= MaxNodes;
+					}
+			};
+
+			/*!
+				\brief A leaf node
+			*/
+			class Leaf : public Node, public LeafStorage
+			{
+				public:
+					std::atomic< Leaf* > next;
+
+				public:
+					inline void construct()
+					{
+						Node::construct( 0 );
+						next.store( 0, std::memory_order_relaxed );
+					}
+
+					inline bool full() const
+					{
+						return this->size >= MaxLeafs;
+					}
+			};
+
+			/*! \brief An epoch announced by one thread, alone on its cache
+				line so that announcing does not slow down its neighbors */
+			class Announcement
+			{
+				public:
+					/*! \brief The epoch the operation started in, 0 if the
+						slot is free */
+					std::atomic< Epoch > epoch;
+					char padding[ 64 - sizeof( std::atomic< Epoch > ) ];
+			};
+
+			/*! \brief Announces the calling thread for as long as it lives,
+				nothing it might still reach is released meanwhile */
+			class Guard
+			{
+				private:
+					std::atomic< Epoch >& _slot;
+
+				private:
+					Guard( const Guard& );
+					Guard& operator=( const Guard& );
+
+				public:
+					explicit inline Guard( const ConcurrentBTree& tree ) :
+						_slot( tree._enter() )
+					{
+					}
+
+					inline ~Guard()
+					{
+						_slot.store( 0, std::memory_order_release );
+					}
+			};
+
+			/*! \brief A node on the path to a leaf that is being unlinked */
+			class PathNode
+			{
+				public:
+					Node* node;
+					Version version;
+					size_type index;
+			};
+
+			/*! \brief An unlinked node and the epoch it was unlinked in */
+			typedef std::pair< Epoch, Node* > Retired;
+			typedef std::vector< Retired > RetiredVector;
+
+			/*! \brief The outcome of one optimistic attempt */
+			enum Attempt
+			{
+				Restart,
+				Succeeded,
+				Failed
+			};
+
+		private:
+			key_compare _keyCompare;
+			BodyAllocator _bodyAllocator;
+			LeafAllocator _leafAllocator;
+			std::atomic< Node* > _root;
+			std::atomic< size_type > _elements;
+			std::atomic< Epoch > _epoch;
+			mutable Announcement _announcements[ Slots ];
+			boost::mutex _retiredMutex;
+			RetiredVector _retired;
+
+		private:
+			ConcurrentBTree( const ConcurrentBTree& );
+			ConcurrentBTree& operator=( const ConcurrentBTree& );
+
+		public:
+			explicit ConcurrentBTree( const Compare& comp = Compare(),
+				const _Allocator& alloc = _Allocator() ) :
+				_keyCompare( comp ), _bodyAllocator( alloc ),
+				_leafAllocator( alloc ), _elements( 0 ), _epoch( 1 )
+			{
+				static_assert( std::is_trivially_copyable< Key >::value
+					&& std::is_trivially_copyable< Value >::value,
+					"Optimistic readers copy keys and values without locks" );
+				for( size_type i = 0; i < Slots; ++i )
+				{
+					_announcements[ i ].epoch.store( 0,
+						std::memory_order_relaxed );
+				}
+				_root.store( _allocateLeaf(), std::memory_order_relaxed );
+			}
+
+			~ConcurrentBTree()
+			{
+				_clear( _root.load( std::memory_order_relaxed ) );
+				_releaseRetired();
+			}
+
+		public:
+			/*! \brief The number of elements, exact once writers are done */
+			inline size_type size() const
+			{
+				return _elements.load( std::memory_order_relaxed );
+			}
+
+			inline bool empty() const
+			{
+				return size() == 0;
+			}
+
+			inline key_compare key_comp() const
+			{
+				return _keyCompare;
+			}
+
+		public:
+			/*!
+				\brief Insert a value if its key is not already present
+				\return true if the value was inserted
+			*/
+			inline bool insert( const value_type& value )
+			{
+				Guard guard( *this );
+				Attempt attempt;
+				while( ( attempt = _insert( value ) ) == Restart );
+				return attempt == Succeeded;
+			}
+
+			/*!
+				\brief Remove a key
+				\return true if the key was present
+			*/
+			inline bool erase( const key_type& key )
+			{
+				Guard guard( *this );
+				Attempt attempt;
+				bool emptied = false;
+				while( ( attempt = _erase( key, emptied ) ) == Restart );
+				if( emptied )
+				{
+					while( _unlink( key ) == Restart );
+				}
+				return attempt == Succeeded;
+			}
+
+			/*!
+				\brief Look up a key
+				\param value Set to the mapped value if the key is found
+				\return true if the key was found
+			*/
+			inline bool find( const key_type& key, mapped_type& value ) const
+			{
+				Guard guard( *this );
+				Attempt attempt;
+				while( ( attempt = _find( key, value ) ) == Restart );
+				return attempt == Succeeded;
+			}
+
+			inline size_type count( const key_type& key ) const
+			{
+				mapped_type value;
+				return find( key, value ) ? 1 : 0;
+			}
+
+			/*!
+				\brief Visit the elements in [lower, upper) in order.
+
+				Each leaf is copied out and validated before any of its
+				elements are handed to the function, so function sees every
+				element that was present for the whole scan exactly once.
+
+				\param function Called as function( key, value ).
+				\return The number of elements visited.
+			*/
+			template< typename Function >
+			size_type scan( const key_type& lower, const key_type& upper,
+				Function function ) const
+			{
+				Guard guard( *this );
+				std::vector< value_type > buffer;
+				buffer.reserve( MaxLeafs );
+
+				key_type from = lower;
+				bool inclusive = true;
+				size_type visited = 0;
+
+				Version version;
+				const Leaf* leaf = _findLeaf( from, version );
+
+				while( true )
+				{
+					size_type size = MIN( leaf->size, MaxLeafs );
+					size_type index = inclusive
+						? Search::lowerBound( leaf->entries(), size, from,
+							_keyCompare )
+						: Search::upperBound( leaf->entries(), size, from,
+							_keyCompare );
+
+					bool done = false;
+					for( ; index < size; ++index )
+					{
+						if( !_keyCompare( leaf->key( index ), upper ) )
+						{
+							done = true;
+							break;
+						}
+						buffer.push_back( value_type( leaf->key( index ),
+							leaf->at( index ).second ) );
+					}
+
+					const Leaf* next = leaf->next.load(
+						std::memory_order_acquire );
+
+					if( !leaf->validate( version ) )
+					{
+						report( "Scan restarting from " << from );
+						buffer.clear();
+						leaf = _findLeaf( from, version );
+						continue;
+					}
+
+					for( typename std::vector< value_type >::const_iterator
+						fi = buffer.begin(); fi != buffer.end(); ++fi )
+					{
+						function( fi->first, fi->second );
+					}
+
+					if( !buffer.empty() )
+					{
+						from = buffer.back().first;
+						inclusive = false;
+						visited += buffer.size();
+						buffer.clear();
+					}
+
+					if( done || next == 0 )
+					{
+						break;
+					}
+
+					leaf = next;
+					version = leaf->readLock();
+					if( Node::obsolete( version ) )
+					{
+						// the next leaf was unlinked after it was read
+						leaf = _findLeaf( from, version );
+					}
+				}
+
+				return visited;
+			}
+
+			/*! \brief Remove everything, not safe with concurrent access */
+			inline void clear()
+			{
+				_clear( _root.load( std::memory_order_relaxed ) );
+				_releaseRetired();
+				_root.store( _allocateLeaf(), std::memory_order_relaxed );
+				_elements.store( 0, std::memory_order_relaxed );
+			}
+
+		private:
+			/*! \brief Descend to the leaf that holds key */
+			inline const Leaf* _findLeaf( const key_type& key,
+				Version& version ) const
+			{
+				while( true )
+				{
+					const Node* node = _root.load( std::memory_order_acquire );
+					version = node->readLock();
+					if( Node::obsolete( version )
+						|| node != _root.load( std::memory_order_acquire ) )
+					{
+						continue;
+					}
+
+					while( !node->leaf() )
+					{
+						const Body* body = static_cast< const Body* >( node );
+						node = body->children[ Search::upperBound( body->keys,
+							MIN( body->size, MaxNodes ), key, _keyCompare ) ];
+						if( node == 0 )
+						{
+							break;
+						}
+						// the parent must be checked after the child is read
+						//  in case the child split in between
+						Version childVersion = node->readLock();
+						if( !body->validate( version )
+							|| Node::obsolete( childVersion ) )
+						{
+							node = 0;
+							break;
+						}
+						version = childVersion;
+					}
+
+					if( node != 0 )
+					{
+						return static_cast< const Leaf* >( node );
+					}
+					report( "Lookup of " << key << " restarting" );
+				}
+			}
+
+			inline Attempt _find( const key_type& key,
+				mapped_type& value ) const
+			{
+				Version version;
+				const Leaf* leaf = _findLeaf( key, version );
+				size_type size = MIN( leaf->size, MaxLeafs );
+				size_type index = Search::lowerBound( leaf->entries(), size,
+					key, _keyCompare );
+				bool found = index < size
+					&& !_keyCompare( key, leaf->key( index ) );
+				if( found )
+				{
+					value = leaf->at( index ).second;
+				}
+				if( !leaf->validate( version ) )
+				{
+					return Restart;
+				}
+				return found ? Succeeded : Failed;
+			}
+
+			/*! \brief Erase from the leaf holding key, emptied is set if
+				the leaf was left without elements */
+			inline Attempt _erase( const key_type& key, bool& emptied )
+			{
+				Version version;
+				Leaf* leaf = const_cast< Leaf* >( _findLeaf( key, version ) );
+				if( !leaf->upgrade( version ) )
+				{
+					return Restart;
+				}
+				size_type index = Search::lowerBound( leaf->entries(),
+					leaf->size, key, _keyCompare );
+				bool found = index < leaf->size
+					&& !_keyCompare( key, leaf->key( index ) );
+				if( found )
+				{
+					leaf->copy( *leaf, index + 1, leaf->size, index );
+					--leaf->size;
+					_elements.fetch_sub( 1, std::memory_order_relaxed );
+					emptied = leaf->size == 0;
+				}
+				leaf->unlock();
+				return found ? Succeeded : Failed;
+			}
+
+			/*!
+				\brief Unlink the leaf holding key if it is still empty,
+					along with the ancestors that it leaves without children.
+
+				The deepest ancestor that keeps other children, every node
+				below it on the path, and the previous leaf in the chain are
+				locked, so nothing can be inserted into the leaf or route
+				through the path while it is removed.
+			*/
+			inline Attempt _unlink( const key_type& key )
+			{
+				PathNode path[ MaxHeight ];
+				size_type depth = 0;
+
+				// the lowest key that can be routed to the leaf
+				key_type lower = key_type();
+				bool bounded = false;
+
+				Node* node = _root.load( std::memory_order_acquire );
+				Version version = node->readLock();
+				if( Node::obsolete( version )
+					|| node != _root.load( std::memory_order_acquire ) )
+				{
+					return Restart;
+				}
+
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					size_type index = Search::upperBound( body->keys,
+						MIN( body->size, MaxNodes ), key, _keyCompare );
+					if( index > 0 )
+					{
+						lower = body->keys[ index - 1 ];
+						bounded = true;
+					}
+					path[ depth ].node = body;
+					path[ depth ].version = version;
+					path[ depth ].index = index;
+					++depth;
+					node = body->children[ index ];
+					if( node == 0 )
+					{
+						return Restart;
+					}
+					Version childVersion = node->readLock();
+					if( !body->validate( version )
+						|| Node::obsolete( childVersion ) )
+					{
+						return Restart;
+					}
+					version = childVersion;
+				}
+
+				Leaf* leaf = static_cast< Leaf* >( node );
+				path[ depth ].node = leaf;
+				path[ depth ].version = version;
+				path[ depth ].index = 0;
+
+				if( leaf->size != 0 )
+				{
+					return leaf->validate( version ) ? Failed : Restart;
+				}
+
+				size_type keep = depth;
+				while( keep > 0 && path[ keep - 1 ].node->size == 0 )
+				{
+					--keep;
+				}
+				if( keep == 0 )
+				{
+					// the only leaf in the tree stays
+					return leaf->validate( version ) ? Failed : Restart;
+				}
+				--keep;
+
+				Leaf* previous = 0;
+				Version previousVersion = 0;
+				if( bounded )
+				{
+					previous = _findPrevious( lower, previousVersion );
+					if( previous == 0 )
+					{
+						return Restart;
+					}
+				}
+
+				size_type locked = keep;
+				for( ; locked <= depth; ++locked )
+				{
+					if( !path[ locked ].node->upgrade(
+						path[ locked ].version ) )
+					{
+						break;
+					}
+				}
+				bool success = locked > depth;
+				if( success && previous != 0 )
+				{
+					success = previous->upgrade( previousVersion );
+					if( success && previous->next.load(
+						std::memory_order_relaxed ) != leaf )
+					{
+						previous->unlock();
+						success = false;
+					}
+				}
+				if( !success )
+				{
+					for( size_type i = keep; i < locked; ++i )
+					{
+						path[ i ].node->unlock();
+					}
+					return Restart;
+				}
+
+				report( "   Unlinking leaf below level "
+					<< path[ keep ].node->level );
+
+				if( previous != 0 )
+				{
+					previous->next.store( leaf->next.load(
+						std::memory_order_relaxed ),
+						std::memory_order_release );
+				}
+
+				// the neighbor on the side of the dropped key takes over
+				//  the range of the removed child
+				Body* body = static_cast< Body* >( path[ keep ].node );
+				size_type index = path[ keep ].index;
+				size_type separator = index > 0 ? index - 1 : 0;
+				std::copy( body->keys + separator + 1,
+					body->keys + body->size, body->keys + separator );
+				std::copy( body->children + index + 1,
+					body->children + body->size + 1, body->children + index );
+				body->children[ body->size ] = 0;
+				--body->size;
+
+				for( size_type i = keep + 1; i <= depth; ++i )
+				{
+					path[ i ].node->unlockObsolete();
+				}
+				body->unlock();
+				if( previous != 0 )
+				{
+					previous->unlock();
+				}
+
+				for( size_type i = keep + 1; i <= depth; ++i )
+				{
+					_retire( path[ i ].node );
+				}
+				_reclaim();
+
+				return Succeeded;
+			}
+
+			/*!
+				\brief Descend to the leaf holding the keys just below key
+				\return The leaf, or 0 if the descent has to restart
+			*/
+			inline Leaf* _findPrevious( const key_type& key,
+				Version& version )
+			{
+				Node* node = _root.load( std::memory_order_acquire );
+				version = node->readLock();
+				if( Node::obsolete( version )
+					|| node != _root.load( std::memory_order_acquire ) )
+				{
+					return 0;
+				}
+
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					node = body->children[ Search::lowerBound( body->keys,
+						MIN( body->size, MaxNodes ), key, _keyCompare ) ];
+					if( node == 0 )
+					{
+						return 0;
+					}
+					Version childVersion = node->readLock();
+					if( !body->validate( version )
+						|| Node::obsolete( childVersion ) )
+					{
+						return 0;
+					}
+					version = childVersion;
+				}
+
+				return static_cast< Leaf* >( node );
+			}
+
+			inline Attempt _insert( const value_type& value )
+			{
+				Node* node = _root.load( std::memory_order_acquire );
+				Version version = node->readLock();
+				if( Node::obsolete( version )
+					|| node != _root.load( std::memory_order_acquire ) )
+				{
+					return Restart;
+				}
+				Body* parent = 0;
+				Version parentVersion = 0;
+
+				while( !node->leaf() )
+				{
+					Body* body = static_cast< Body* >( node );
+					if( body->full() )
+					{
+						return _split( parent, parentVersion, body, version );
+					}
+					parent = body;
+					parentVersion = version;
+					node = body->children[ Search::upperBound( body->keys,
+						MIN( body->size, MaxNodes ), value.first,
+						_keyCompare ) ];
+					if( node == 0 )
+					{
+						return Restart;
+					}
+					Version childVersion = node->readLock();
+					if( !body->validate( version )
+						|| Node::obsolete( childVersion ) )
+					{
+						return Restart;
+					}
+					version = childVersion;
+				}
+
+				Leaf* leaf = static_cast< Leaf* >( node );
+				if( leaf->full() )
+				{
+					return _split( parent, parentVersion, leaf, version );
+				}
+				if( !leaf->upgrade( version ) )
+				{
+					return Restart;
+				}
+
+				size_type position = Search::lowerBound( leaf->entries(),
+					leaf->size, value.first, _keyCompare );
+				if( position != leaf->size
+					&& !_keyCompare( value.first, leaf->key( position ) ) )
+				{
+					leaf->unlock();
+					return Failed;
+				}
+				leaf->copyBackward( *leaf, position, leaf->size,
+					leaf->size + 1 );
+				leaf->set( position, value );
+				++leaf->size;
+				leaf->unlock();
+				_elements.fetch_add( 1, std::memory_order_relaxed );
+				return Succeeded;
+			}
+
+			/*!
+				\brief Split a full node, locking it and its parent.  The
+					insert always restarts afterwards.
+			*/
+			template< typename NodeType >
+			inline Attempt _split( Body* parent, Version parentVersion,
+				NodeType* node, Version version )
+			{
+				if( parent != 0 && !parent->upgrade( parentVersion ) )
+				{
+					return Restart;
+				}
+				if( !node->upgrade( version ) )
+				{
+					if( parent != 0 )
+					{
+						parent->unlock();
+					}
+					return Restart;
+				}
+				if( parent == 0 && node != _root.load(
+					std::memory_order_relaxed ) )
+				{
+					node->unlock();
+					return Restart;
+				}
+
+				key_type key;
+				Node* right = _splitNode( node, key );
+
+				if( parent != 0 )
+				{
+					_propagate( parent, right, key );
+				}
+				else
+				{
+					_bumpRoot( node, right, key );
+				}
+
+				node->unlock();
+				if( parent != 0 )
+				{
+					parent->unlock();
+				}
+				return Restart;
+			}
+
+			inline Node* _splitNode( Leaf* leaf, key_type& key )
+			{
+				report( "   Splitting leaf node." );
+				Leaf* right = _allocateLeaf();
+				size_type median = leaf->size / 2;
+				right->copy( *leaf, median, leaf->size, 0 );
+				right->size = leaf->size - median;
+				right->next.store( leaf->next.load(
+					std::memory_order_relaxed ), std::memory_order_relaxed );
+				leaf->size = median;
+				leaf->next.store( right, std::memory_order_release );
+				key = right->key( 0 );
+				return right;
+			}
+
+			inline Node* _splitNode( Body* body, key_type& key )
+			{
+				report( "   Splitting body node." );
+				Body* right = _allocateBody( body->level );
+				size_type median = body->size / 2;
+				right->size = body->size - median - 1;
+				std::copy( body->keys + median + 1, body->keys + body->size,
+					right->keys );
+				std::copy( body->children + median + 1,
+					body->children + body->size + 1, right->children );
+				// a reader that saw the old size must not follow a child
+				//  that could be released after moving to the right
+				std::fill( body->children + median + 1,
+					body->children + body->size + 1, ( Node* ) 0 );
+				body->size = median;
+				key = body->keys[ median ];
+				return right;
+			}
+
+			/*! \brief Add a new right sibling below a locked parent */
+			inline void _propagate( Body* parent, Node* right,
+				const key_type& key )
+			{
+				assert( !parent->full() );
+				size_type position = Search::upperBound( parent->keys,
+					parent->size, key, _keyCompare );
+				std::copy_backward( parent->keys + position,
+					parent->keys + parent->size,
+					parent->keys + parent->size + 1 );
+				std::copy_backward( parent->children + position + 1,
+					parent->children + parent->size + 1,
+					parent->children + parent->size + 2 );
+				parent->keys[ position ] = key;
+				parent->children[ position + 1 ] = right;
+				++parent->size;
+			}
+
+			inline void _bumpRoot( Node* left, Node* right,
+				const key_type& key )
+			{
+				report( "   Bumped to level " << ( left->level + 1 ) );
+				Body* root = _allocateBody( left->level + 1 );
+				root->size = 1;
+				root->keys[ 0 ] = key;
+				root->children[ 0 ] = left;
+				root->children[ 1 ] = right;
+				_root.store( root, std::memory_order_release );
+			}
+
+		private:
+			inline Body* _allocateBody( size_type level )
+			{
+				Body* body = _bodyAllocator.allocate( 1 );
+				body->construct( level );
+				return body;
+			}
+
+			inline Leaf* _allocateLeaf()
+			{
+				Leaf* leaf = _leafAllocator.allocate( 1 );
+				leaf->construct();
+				return leaf;
+			}
+
+			/*! \brief Release a single node, leaving its children */
+			inline void _release( Node* n )
+			{
+				if( n->leaf() )
+				{
+					_leafAllocator.deallocate( static_cast< Leaf* >( n ), 1 );
+				}
+				else
+				{
+					_bodyAllocator.deallocate( static_cast< Body* >( n ), 1 );
+				}
+			}
+
+			inline void _clear( Node* n )
+			{
+				if( n->leaf() )
+				{
+					_leafAllocator.deallocate( static_cast< Leaf* >( n ), 1 );
+				}
+				else
+				{
+					Body* body = static_cast< Body* >( n );
+					for( size_type i = 0; i <= body->size; ++i )
+					{
+						_clear( body->children[ i ] );
+					}
+					_bodyAllocator.deallocate( body, 1 );
+				}
+			}
+
+		private:
+			/*! \brief Claim a free slot and announce the current epoch */
+			inline std::atomic< Epoch >& _enter() const
+			{
+				size_type start = boost::hash< boost::thread::id >()(
+					boost::this_thread::get_id() );
+				for( unsigned int spins = 0; ; ++spins )
+				{
+					for( size_type i = 0; i < Slots; ++i )
+					{
+						std::atomic< Epoch >& slot = _announcements[
+							( start + i ) % Slots ].epoch;
+						Epoch free = 0;
+						if( slot.load( std::memory_order_relaxed ) == 0
+							&& slot.compare_exchange_strong( free,
+							_epoch.load( std::memory_order_acquire ) ) )
+						{
+							// the announcement must be visible before
+							//  anything in the tree is read
+							std::atomic_thread_fence(
+								std::memory_order_seq_cst );
+							return slot;
+						}
+					}
+					Node::pause( spins );
+				}
+			}
+
+			/*! \brief Hold an unlinked node until nobody can reach it */
+			inline void _retire( Node* node )
+			{
+				Epoch epoch = _epoch.fetch_add( 1,
+					std::memory_order_acq_rel );
+				boost::mutex::scoped_lock lock( _retiredMutex );
+				_retired.push_back( Retired( epoch, node ) );
+			}
+
+			/*! \brief Release the nodes that were retired before the oldest
+				operation that is still running started */
+			inline void _reclaim()
+			{
+				std::atomic_thread_fence( std::memory_order_seq_cst );
+				Epoch oldest = std::numeric_limits< Epoch >::max();
+				for( size_type i = 0; i < Slots; ++i )
+				{
+					Epoch epoch = _announcements[ i ].epoch.load(
+						std::memory_order_acquire );
+					if( epoch != 0 )
+					{
+						oldest = std::min( oldest, epoch );
+					}
+				}
+
+				boost::mutex::scoped_lock lock( _retiredMutex );
+				typename RetiredVector::iterator end = _retired.begin();
+				for( typename RetiredVector::iterator
+					retired = _retired.begin();
+					retired != _retired.end(); ++retired )
+				{
+					if( retired->first < oldest )
+					{
+						_release( retired->second );
+					}
+					else
+					{
+						*end++ = *retired;
+					}
+				}
+				_retired.erase( end, _retired.end() );
+			}
+
+			/*! \brief Release every retired node, nobody may be running */
+			inline void _releaseRetired()
+			{
+				for( typename RetiredVector::iterator
+					retired = _retired.begin();
+					retired != _retired.end(); ++retired )
+				{
+					_release( retired->second );
+				}
+				_retired.clear();
+			}
+	};
+
+}
+
+#endif
+
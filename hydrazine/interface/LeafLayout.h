@@ -0,0 +1,344 @@
+/*!
+	\file LeafLayout.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BTree leaf layout policies.
+*/
+
+#ifndef LEAF_LAYOUT_H_INCLUDED
+#define LEAF_LAYOUT_H_INCLUDED
+
+#include <hydrazine/interface/macros.h>
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief Store the entries of a BTree leaf as an array of key/value
+			pairs.  This is the layout of a std::map node, iterators hand
+			out real references to the pairs.
+	*/
+	class PairedLeafLayout
+	{
+		public:
+			template< typename Key, typename Value, size_t PageSize >
+			class Storage
+			{
+				public:
+					typedef std::pair< Key, Value > value_type;
+					typedef value_type& reference;
+					typedef const value_type& const_reference;
+					typedef value_type* pointer;
+					typedef const value_type* const_pointer;
+					/*! \brief The type that searches run over */
+					typedef value_type entry_type;
+
+				public:
+					/*! \brief As many pairs as fit in a page */
+					static const size_t Capacity = MAX( 8,
+						PageSize / sizeof( value_type ) );
+
+				public:
+					value_type data[ Capacity ];
+
+				public:
+					inline void constructEntries()
+					{
+						if( !std::is_trivially_default_constructible<
+							Key >::value
+							|| !std::is_trivially_default_constructible<
+							Value >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								::new( data + i ) value_type;
+							}
+						}
+					}
+
+					inline void destroyEntries()
+					{
+						if( !std::is_trivially_destructible<
+							value_type >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								data[ i ].~value_type();
+							}
+						}
+					}
+
+				public:
+					inline const entry_type* entries() const
+					{
+						return data;
+					}
+
+					inline const Key& key( size_t i ) const
+					{
+						return data[ i ].first;
+					}
+
+					inline reference at( size_t i )
+					{
+						return data[ i ];
+					}
+
+					inline const_reference at( size_t i ) const
+					{
+						return data[ i ];
+					}
+
+					inline pointer address( size_t i )
+					{
+						return data + i;
+					}
+
+					inline const_pointer address( size_t i ) const
+					{
+						return data + i;
+					}
+
+					template< typename Pair >
+					inline void set( size_t i, Pair&& pair )
+					{
+						data[ i ] = std::forward< Pair >( pair );
+					}
+
+					/*! \brief Copy [begin, end) of source to position */
+					inline void copy( const Storage& source, size_t begin,
+						size_t end, size_t position )
+					{
+						std::copy( source.data + begin, source.data + end,
+							data + position );
+					}
+
+					/*! \brief Copy [begin, end) of source to end at position */
+					inline void copyBackward( const Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::copy_backward( source.data + begin,
+							source.data + end, data + position );
+					}
+
+					/*! \brief Move [begin, end) of source to position */
+					inline void move( Storage& source, size_t begin,
+						size_t end, size_t position )
+					{
+						std::move( source.data + begin, source.data + end,
+							data + position );
+					}
+
+					/*! \brief Move [begin, end) of source to end at position */
+					inline void moveBackward( Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::move_backward( source.data + begin,
+							source.data + end, data + position );
+					}
+
+					/*! \brief Drop what [begin, end) holds once it is no
+						longer part of the leaf */
+					inline void clear( size_t begin, size_t end )
+					{
+						if( !std::is_trivially_destructible<
+							value_type >::value )
+						{
+							std::fill( data + begin, data + end,
+								value_type() );
+						}
+					}
+			};
+	};
+
+	/*!
+		\brief Store the keys of a BTree leaf in one dense array and the
+			values in another.
+
+		Searching a leaf only touches key cache lines, and the key array
+		rather than the pair array is sized to the page.  Iterators hand
+		out pairs of references, a pair-like proxy that supports first and
+		second but not taking the address of the pair.
+	*/
+	class SplitLeafLayout
+	{
+		public:
+			template< typename Key, typename Value, size_t PageSize >
+			class Storage
+			{
+				public:
+					typedef std::pair< Key, Value > value_type;
+					typedef std::pair< const Key&, Value& > reference;
+					typedef std::pair< const Key&, const Value& >
+						const_reference;
+					typedef Key entry_type;
+
+				public:
+					/*! \brief Make operator-> work on a reference proxy */
+					template< typename Reference >
+					class Arrow
+					{
+						private:
+							Reference _reference;
+
+						public:
+							inline Arrow( const Reference& r ) :
+								_reference( r )
+							{}
+
+							inline const Reference* operator->() const
+							{
+								return &_reference;
+							}
+					};
+
+					typedef Arrow< reference > pointer;
+					typedef Arrow< const_reference > const_pointer;
+
+				public:
+					/*! \brief As many keys as fit in a page */
+					static const size_t Capacity = MAX( 8,
+						PageSize / sizeof( Key ) );
+
+				public:
+					Key keys[ Capacity ];
+					Value values[ Capacity ];
+
+				public:
+					inline void constructEntries()
+					{
+						if( !std::is_trivially_default_constructible<
+							Key >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								::new( keys + i ) Key;
+							}
+						}
+						if( !std::is_trivially_default_constructible<
+							Value >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								::new( values + i ) Value;
+							}
+						}
+					}
+
+					inline void destroyEntries()
+					{
+						if( !std::is_trivially_destructible< Key >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								keys[ i ].~Key();
+							}
+						}
+						if( !std::is_trivially_destructible< Value >::value )
+						{
+							for( size_t i = 0; i < Capacity; ++i )
+							{
+								values[ i ].~Value();
+							}
+						}
+					}
+
+				public:
+					inline const entry_type* entries() const
+					{
+						return keys;
+					}
+
+					inline const Key& key( size_t i ) const
+					{
+						return keys[ i ];
+					}
+
+					inline reference at( size_t i )
+					{
+						return reference( keys[ i ], values[ i ] );
+					}
+
+					inline const_reference at( size_t i ) const
+					{
+						return const_reference( keys[ i ], values[ i ] );
+					}
+
+					inline pointer address( size_t i )
+					{
+						return pointer( at( i ) );
+					}
+
+					inline const_pointer address( size_t i ) const
+					{
+						return const_pointer( at( i ) );
+					}
+
+					template< typename Pair >
+					inline void set( size_t i, Pair&& pair )
+					{
+						keys[ i ] = std::forward< Pair >( pair ).first;
+						values[ i ] = std::forward< Pair >( pair ).second;
+					}
+
+					inline void copy( const Storage& source, size_t begin,
+						size_t end, size_t position )
+					{
+						std::copy( source.keys + begin, source.keys + end,
+							keys + position );
+						std::copy( source.values + begin, source.values + end,
+							values + position );
+					}
+
+					inline void copyBackward( const Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::copy_backward( source.keys + begin,
+							source.keys + end, keys + position );
+						std::copy_backward( source.values + begin,
+							source.values + end, values + position );
+					}
+
+					inline void move( Storage& source, size_t begin,
+						size_t end, size_t position )
+					{
+						std::move( source.keys + begin, source.keys + end,
+							keys + position );
+						std::move( source.values + begin, source.values + end,
+							values + position );
+					}
+
+					inline void moveBackward( Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::move_backward( source.keys + begin,
+							source.keys + end, keys + position );
+						std::move_backward( source.values + begin,
+							source.values + end, values + position );
+					}
+
+					inline void clear( size_t begin, size_t end )
+					{
+						if( !std::is_trivially_destructible< Key >::value )
+						{
+							std::fill( keys + begin, keys + end, Key() );
+						}
+						if( !std::is_trivially_destructible< Value >::value )
+						{
+							std::fill( values + begin, values + end,
+								Value() );
+						}
+					}
+			};
+	};
+
+}
+
+#endif
+
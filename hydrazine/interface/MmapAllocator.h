@@ -8,17 +8,36 @@
 #ifndef MMAP_ALLOCATOR_H_INCLUDED
 #define MMAP_ALLOCATOR_H_INCLUDED
 
+#include <hydrazine/interface/MmapPool.h>
+
 #include <new>
+#include <memory>
 #include <sys/mman.h>
 
 namespace hydrazine
 {
 	/*!
 		\brief An allocator that draws from blocks of file backed memory
+
+		By default every allocation is a mapping of its own.  Set Pooled to
+		carve allocations out of the size classes of an MmapPool instead,
+		which saves a system call and most of a page for every small
+		object.  Copies and rebinds of a pooled allocator share its pool, a
+		default constructed one creates a new pool.  Set Synchronized if
+		copies of a pooled allocator are used by more than one thread at a
+		time.
+
+		Construct an allocator from an MmapPolicy to choose huge pages,
+		NUMA placement, or pre-faulting.  A pooled allocator applies it to
+		the regions of its pool, otherwise it is applied to every
+		allocation, and it is shared by copies and rebinds either way.
 	*/
-	template< typename T >
+	template< typename T, bool Pooled = false, bool Synchronized = false >
 	class MmapAllocator
 	{
+		template< typename SomeT, bool SomePooled, bool SomeSynchronized >
+			friend class MmapAllocator;
+
 		public:
 			typedef size_t size_type;
 			typedef ptrdiff_t difference_type;
@@ -27,19 +46,41 @@ namespace hydrazine
 			typedef T& reference;
 			typedef const T& const_reference;
 			typedef T value_type;
+			typedef std::shared_ptr< MmapPool > PoolPointer;
+			typedef std::shared_ptr< MmapPolicy > PolicyPointer;
 			
 		public:
 			template< typename NewT >
 			struct rebind
 			{
-				typedef MmapAllocator< NewT > other;
+				typedef MmapAllocator< NewT, Pooled, Synchronized > other;
 			};
-			
-			MmapAllocator() throw() {}
-			MmapAllocator( const MmapAllocator& ) throw() {}
+
+		private:
+			/*! \brief Null unless Pooled */
+			PoolPointer _pool;
+			/*! \brief Null if Pooled or if plain mappings are used */
+			PolicyPointer _policy;
+
+		public:
+			MmapAllocator() : _pool( Pooled
+				? new MmapPool( Synchronized ) : 0 ) {}
+			MmapAllocator( const MmapAllocator& a ) throw() :
+				_pool( a._pool ), _policy( a._policy ) {}
 			
 			template< typename SomeT >
-			MmapAllocator( const MmapAllocator< SomeT >& ) throw() {}
+			MmapAllocator( const MmapAllocator< SomeT, Pooled,
+				Synchronized >& a ) throw() : _pool( a._pool ),
+				_policy( a._policy ) {}
+
+			/*! \brief Share a pool with other allocators */
+			explicit MmapAllocator( const PoolPointer& pool ) throw() :
+				_pool( pool ) {}
+
+			/*! \brief Map memory according to a policy */
+			explicit MmapAllocator( const MmapPolicy& policy ) :
+				_pool( Pooled ? new MmapPool( Synchronized, policy ) : 0 ),
+				_policy( Pooled ? 0 : new MmapPolicy( policy ) ) {}
 			
 			~MmapAllocator() throw() {}
 			
@@ -52,6 +93,16 @@ namespace hydrazine
 				{
 					throw std::bad_alloc();
 				}
+				if( Pooled )
+				{
+					return static_cast< pointer >(
+						_pool->allocate( n * sizeof( value_type ) ) );
+				}
+				if( _policy )
+				{
+					return static_cast< pointer >(
+						_policy->map( n * sizeof( value_type ) ) );
+				}
 				return static_cast< pointer >( mmap( 0, 
 					n * sizeof( value_type ), 
 					PROT_READ | PROT_WRITE | PROT_EXEC, 
@@ -60,7 +111,18 @@ namespace hydrazine
 			
 			void deallocate( pointer p, size_type s )
 			{
-				munmap( p, s * sizeof( value_type ) );
+				if( Pooled )
+				{
+					_pool->deallocate( p, s * sizeof( value_type ) );
+				}
+				else if( _policy )
+				{
+					_policy->unmap( p, s * sizeof( value_type ) );
+				}
+				else
+				{
+					munmap( p, s * sizeof( value_type ) );
+				}
 			}
 			
 			size_type max_size() const throw()
@@ -77,21 +139,36 @@ namespace hydrazine
 			{
 				p->~value_type();
 			}
+
+		public:
+			/*! \brief The pool shared by copies of this allocator, null
+				unless Pooled */
+			const PoolPointer& pool() const
+			{
+				return _pool;
+			}
+
+			/*! \brief The policy that memory is mapped with, null for plain
+				mappings */
+			MmapPolicy* policy() const
+			{
+				return Pooled ? &_pool->policy() : _policy.get();
+			}
 			
 	};
 
-	template< typename T >
-	inline bool operator==( const MmapAllocator< T >&, 
-		const MmapAllocator< T >& )
+	template< typename T, bool P, bool S >
+	inline bool operator==( const MmapAllocator< T, P, S >& one, 
+		const MmapAllocator< T, P, S >& two )
 	{
-		return true;
+		return one.pool() == two.pool() && one.policy() == two.policy();
 	}
 
-	template< typename T >
-	inline bool operator!=( const MmapAllocator< T >&, 
-		const MmapAllocator< T >& )
+	template< typename T, bool P, bool S >
+	inline bool operator!=( const MmapAllocator< T, P, S >& one, 
+		const MmapAllocator< T, P, S >& two )
 	{
-		return false;
+		return !( one == two );
 	}
 
 }
@@ -0,0 +1,139 @@
+/*!
+	\file MmapPolicy.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the MmapPolicy class
+*/
+
+#ifndef MMAP_POLICY_H_INCLUDED
+#define MMAP_POLICY_H_INCLUDED
+
+#include <boost/thread/mutex.hpp>
+
+#include <cstddef>
+#include <string>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief How anonymous memory is mapped: the page size, where it is
+			placed on a NUMA machine, and whether it is faulted in up front.
+
+		Every request falls back to plain pages on the default node when
+		the system does not offer what was asked for, so a policy never
+		makes a mapping fail that would have succeeded without it.  What
+		was actually obtained is counted in a Report.
+
+		HugePages asks for MAP_HUGETLB, which needs pages reserved in
+		/proc/sys/vm/nr_hugepages, and rounds every mapping up to a whole
+		huge page whether or not it gets one.  TransparentHugePages only
+		advises the kernel with MADV_HUGEPAGE and aligns mappings of a huge
+		page or more so that they can be backed by one.  Interleave spreads
+		pages over every online node and LocalNode binds them to the node
+		of the calling thread, both through mbind, and both are skipped on
+		machines with a single node.
+	*/
+	class MmapPolicy
+	{
+		public:
+			enum PageSize
+			{
+				SmallPages,
+				TransparentHugePages,
+				HugePages
+			};
+
+			enum Placement
+			{
+				DefaultPlacement,
+				Interleave,
+				LocalNode
+			};
+
+			/*! \brief What a policy actually obtained */
+			class Report
+			{
+				public:
+					/*! \brief Mappings made and the bytes in them */
+					size_t mappings;
+					size_t bytes;
+					/*! \brief Mappings backed by MAP_HUGETLB pages */
+					size_t hugePages;
+					/*! \brief MAP_HUGETLB requests that fell back */
+					size_t hugePageFallbacks;
+					/*! \brief Mappings advised with MADV_HUGEPAGE */
+					size_t advised;
+					/*! \brief MADV_HUGEPAGE requests that were refused */
+					size_t adviceFallbacks;
+					/*! \brief Mappings that were faulted in */
+					size_t populated;
+					/*! \brief Mappings placed with mbind */
+					size_t placed;
+					/*! \brief Placements skipped or refused */
+					size_t placementFallbacks;
+
+				public:
+					Report();
+
+				public:
+					std::string toString() const;
+			};
+
+		private:
+			PageSize _pageSize;
+			Placement _placement;
+			bool _populate;
+			Report _report;
+			boost::mutex _mutex;
+
+		private:
+			MmapPolicy& operator=( const MmapPolicy& );
+
+		private:
+			void* _hugePages( size_t bytes, size_t alignment );
+			void* _smallPages( size_t bytes, size_t alignment );
+			void _advise( void* pointer, size_t bytes );
+			void _place( void* pointer, size_t bytes );
+			void _fault( void* pointer, size_t bytes );
+
+		public:
+			explicit MmapPolicy( PageSize pageSize = SmallPages,
+				Placement placement = DefaultPlacement,
+				bool populate = false );
+			/*! \brief Copy the settings, start with an empty report */
+			MmapPolicy( const MmapPolicy& policy );
+
+		public:
+			/*! \brief Map bytes at a multiple of alignment, which is a
+				power of two */
+			void* map( size_t bytes, size_t alignment = 0 );
+			/*! \brief Unmap a block of bytes returned by map */
+			void unmap( void* pointer, size_t bytes );
+			/*! \brief The bytes that a mapping of bytes really takes */
+			size_t mappedSize( size_t bytes ) const;
+
+		public:
+			PageSize pageSize() const;
+			Placement placement() const;
+			bool populate() const;
+			/*! \brief What was obtained so far */
+			Report obtained();
+
+		public:
+			/*! \brief The size of a huge page in bytes */
+			static size_t hugePageSize();
+			/*! \brief The number of online NUMA nodes, at least 1 */
+			static unsigned int nodes();
+			/*! \brief The node that the page at an address lives on, -1 if
+				it is not known */
+			static int nodeOf( const void* address );
+			/*! \brief The bytes backed by huge pages in the mappings that
+				overlap a range, as reported in /proc/self/smaps */
+			static size_t hugePageBytes( const void* address, size_t bytes );
+	};
+
+}
+
+#endif
+
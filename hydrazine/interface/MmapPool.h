@@ -0,0 +1,138 @@
+/*!
+	\file MmapPool.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the MmapPool class
+*/
+
+#ifndef MMAP_POOL_H_INCLUDED
+#define MMAP_POOL_H_INCLUDED
+
+#include <hydrazine/interface/MmapPolicy.h>
+
+#include <boost/thread/mutex.hpp>
+
+#include <cstddef>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief Size class blocks carved out of large regions of mapped
+			memory.
+
+		Every region is mapped at an address that is a multiple of its size
+		and starts with a header, so the region of a block is found by
+		masking its address.  A region serves a single size class, hands
+		out freed blocks first and then untouched ones, and is unmapped as
+		soon as its last block is freed, unless it is the only region of
+		its class with free space.  Requests larger than MaxBlockSize get a
+		mapping of their own, as MmapAllocator always did.
+
+		Classes are 16 bytes apart up to 1 KB and four per power of two
+		above that, so no block wastes more than a quarter of its size.
+
+		Regions and large blocks are mapped through an MmapPolicy.  A region
+		is the size of a huge page on x86, so a huge page policy backs each
+		region with a single TLB entry.
+	*/
+	class MmapPool
+	{
+		public:
+			/*! \brief The bytes in a region, a power of two */
+			static const size_t RegionSize = 2 << 20;
+			/*! \brief Larger requests are mapped on their own */
+			static const size_t MaxBlockSize = RegionSize / 8;
+			/*! \brief Block sizes are rounded up to this */
+			static const size_t Alignment = 16;
+			/*! \brief The number of size classes */
+			static const unsigned int Classes = 96;
+
+		private:
+			class FreeBlock
+			{
+				public:
+					FreeBlock* next;
+			};
+
+			/*! \brief The header at the start of every region */
+			class Region
+			{
+				public:
+					/*! \brief Every region of the pool */
+					Region* next;
+					Region* previous;
+					/*! \brief The regions of the class with free blocks */
+					Region* nextPartial;
+					Region* previousPartial;
+					/*! \brief Blocks that were freed */
+					FreeBlock* free;
+					/*! \brief The next untouched block */
+					char* untouched;
+					char* end;
+					/*! \brief The number of blocks handed out */
+					size_t live;
+					unsigned int sizeClass;
+					bool partial;
+			};
+
+			class SizeClass
+			{
+				public:
+					size_t size;
+					/*! \brief The regions with free blocks */
+					Region* partial;
+			};
+
+		private:
+			SizeClass _classes[ Classes ];
+			Region* _regions;
+			size_t _regionCount;
+			size_t _live;
+			boost::mutex _mutex;
+			bool _synchronized;
+			MmapPolicy _policy;
+
+		private:
+			MmapPool( const MmapPool& );
+			MmapPool& operator=( const MmapPool& );
+
+		private:
+			static unsigned int _classOf( size_t bytes );
+			static size_t _classSize( unsigned int index );
+			static size_t _headerSize();
+			Region* _mapRegion( unsigned int sizeClass );
+			void _unmapRegion( Region* region );
+			void _linkPartial( Region* region );
+			void _unlinkPartial( Region* region );
+
+		public:
+			/*! \brief Create an empty pool, lock it if it is shared */
+			explicit MmapPool( bool synchronized = false,
+				const MmapPolicy& policy = MmapPolicy() );
+			/*! \brief Unmap every region */
+			~MmapPool();
+
+		public:
+			/*! \brief Get a block of at least bytes */
+			void* allocate( size_t bytes );
+			/*! \brief Return a block of bytes */
+			void deallocate( void* block, size_t bytes );
+
+		public:
+			/*! \brief The size of the block handed out for bytes */
+			static size_t blockSize( size_t bytes );
+			/*! \brief The number of regions that are mapped */
+			size_t regions();
+			/*! \brief The number of blocks handed out from regions */
+			size_t live();
+			/*! \brief Is the pool safe to share between threads? */
+			bool synchronized() const;
+			/*! \brief How regions and large blocks are mapped */
+			MmapPolicy& policy();
+	};
+
+}
+
+#endif
+
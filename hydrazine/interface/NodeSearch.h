@@ -0,0 +1,312 @@
+/*!
+	\file NodeSearch.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the NodeSearch class.
+*/
+
+#ifndef NODE_SEARCH_H_INCLUDED
+#define NODE_SEARCH_H_INCLUDED
+
+#include <cstddef>
+#include <utility>
+#include <functional>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace hydrazine
+{
+
+	/*! \brief Get the key of a node entry that is a bare key */
+	template< typename Key >
+	inline const Key& nodeKey( const Key& key )
+	{
+		return key;
+	}
+
+	/*! \brief Get the key of a node entry that is a key/value pair */
+	template< typename Key, typename Value >
+	inline const Key& nodeKey( const std::pair< Key, Value >& pair )
+	{
+		return pair.first;
+	}
+
+	/*!
+		\brief Is a comparison just a builtin operator that compiles to a
+			conditional move rather than a call?
+	*/
+	template< typename Compare >
+	class BranchFreeCompare
+	{
+		public:
+			static const bool value = false;
+	};
+
+	template< typename T >
+	class BranchFreeCompare< std::less< T > >
+	{
+		public:
+			static const bool value = std::is_arithmetic< T >::value;
+	};
+
+	template< typename T >
+	class BranchFreeCompare< std::greater< T > >
+	{
+		public:
+			static const bool value = std::is_arithmetic< T >::value;
+	};
+
+	/*!
+		\brief The search kernel used within a single BTree node.
+
+		The generic version is a plain binary search that only relies on
+		Compare.  Both functions return an index into a sorted array of
+		either keys or key/value pairs.  The key that is searched for may
+		be of any type that Compare can order against Key.
+	*/
+	template< typename Key, typename Compare,
+		bool Fast = BranchFreeCompare< Compare >::value >
+	class NodeSearch
+	{
+		public:
+			/*! \brief The index of the first entry not less than key */
+			template< typename T, typename K >
+			static inline size_t lowerBound( const T* begin, size_t size,
+				const K& key, const Compare& compare )
+			{
+				const T* base = begin;
+				while( size > 0 )
+				{
+					size_t half = size / 2;
+					if( compare( nodeKey< Key >( base[ half ] ), key ) )
+					{
+						base += half + 1;
+						size -= half + 1;
+					}
+					else
+					{
+						size = half;
+					}
+				}
+				return base - begin;
+			}
+
+			/*! \brief The index of the first entry greater than key */
+			template< typename T, typename K >
+			static inline size_t upperBound( const T* begin, size_t size,
+				const K& key, const Compare& compare )
+			{
+				const T* base = begin;
+				while( size > 0 )
+				{
+					size_t half = size / 2;
+					if( !compare( key, nodeKey< Key >( base[ half ] ) ) )
+					{
+						base += half + 1;
+						size -= half + 1;
+					}
+					else
+					{
+						size = half;
+					}
+				}
+				return base - begin;
+			}
+	};
+
+	/*!
+		\brief The search kernel for arithmetic keys with a builtin compare.
+
+		The range is halved without branching until it is small enough to
+		fit in a few cache lines, then the remaining entries that precede
+		the key are counted.  Neither loop depends on the outcome of a
+		comparison, so there is nothing to mispredict.  Runs of 32-bit
+		integer keys are counted four at a time with SSE2.
+	*/
+	template< typename Key, typename Compare >
+	class NodeSearch< Key, Compare, true >
+	{
+		public:
+			/*! \brief Below this many entries, scan rather than bisect */
+			static const size_t LinearThreshold = 16;
+
+		public:
+			template< typename T >
+			static inline size_t lowerBound( const T* begin, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				const T* base = begin;
+				while( size > LinearThreshold )
+				{
+					size_t half = size / 2;
+					base = compare( nodeKey< Key >( base[ half ] ), key )
+						? base + half : base;
+					size -= half;
+				}
+				return ( base - begin ) + _countBefore( base, size, key,
+					compare );
+			}
+
+			template< typename T >
+			static inline size_t upperBound( const T* begin, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				const T* base = begin;
+				while( size > LinearThreshold )
+				{
+					size_t half = size / 2;
+					base = !compare( key, nodeKey< Key >( base[ half ] ) )
+						? base + half : base;
+					size -= half;
+				}
+				return ( base - begin ) + size - _countAfter( base, size, key,
+					compare );
+			}
+
+		private:
+			/*! \brief Count the entries that are ordered before key */
+			template< typename T >
+			static inline size_t _countBefore( const T* base, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				size_t count = 0;
+				for( size_t i = 0; i < size; ++i )
+				{
+					count += compare( nodeKey< Key >( base[ i ] ), key );
+				}
+				return count;
+			}
+
+			/*! \brief Count the entries that are ordered after key */
+			template< typename T >
+			static inline size_t _countAfter( const T* base, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				size_t count = 0;
+				for( size_t i = 0; i < size; ++i )
+				{
+					count += compare( key, nodeKey< Key >( base[ i ] ) );
+				}
+				return count;
+			}
+
+			#ifdef __SSE2__
+			/*! \brief Count 32-bit keys that are less than key */
+			static inline size_t _countLess( const Key* base, size_t size,
+				const Key& key )
+			{
+				const __m128i bias = _mm_set1_epi32( _bias() );
+				const __m128i pivot = _mm_xor_si128(
+					_mm_set1_epi32( key ), bias );
+				size_t count = 0;
+				size_t i = 0;
+				for( ; i + 4 <= size; i += 4 )
+				{
+					__m128i keys = _mm_xor_si128( _mm_loadu_si128(
+						reinterpret_cast< const __m128i* >( base + i ) ),
+						bias );
+					count += __builtin_popcount( _mm_movemask_ps(
+						_mm_castsi128_ps( _mm_cmplt_epi32( keys, pivot ) ) ) );
+				}
+				for( ; i < size; ++i )
+				{
+					count += base[ i ] < key;
+				}
+				return count;
+			}
+
+			/*! \brief Count 32-bit keys that are greater than key */
+			static inline size_t _countGreater( const Key* base, size_t size,
+				const Key& key )
+			{
+				const __m128i bias = _mm_set1_epi32( _bias() );
+				const __m128i pivot = _mm_xor_si128(
+					_mm_set1_epi32( key ), bias );
+				size_t count = 0;
+				size_t i = 0;
+				for( ; i + 4 <= size; i += 4 )
+				{
+					__m128i keys = _mm_xor_si128( _mm_loadu_si128(
+						reinterpret_cast< const __m128i* >( base + i ) ),
+						bias );
+					count += __builtin_popcount( _mm_movemask_ps(
+						_mm_castsi128_ps( _mm_cmpgt_epi32( keys, pivot ) ) ) );
+				}
+				for( ; i < size; ++i )
+				{
+					count += key < base[ i ];
+				}
+				return count;
+			}
+
+			/*! \brief Flipping the sign bit makes a signed compare unsigned */
+			static inline int _bias()
+			{
+				return std::is_signed< Key >::value ? 0 : (int)0x80000000u;
+			}
+
+			/*! \brief Is Key a 32-bit integer that SSE2 can compare? */
+			typedef std::integral_constant< bool,
+				std::is_integral< Key >::value && sizeof( Key ) == 4
+				&& ( std::is_same< Compare, std::less< Key > >::value
+				|| std::is_same< Compare, std::greater< Key > >::value ) >
+				Vector;
+
+			static inline size_t _countBefore( const Key* base, size_t size,
+				const Key& key, const Compare& compare, std::false_type )
+			{
+				return _countBefore< Key >( base, size, key, compare );
+			}
+
+			static inline size_t _countBefore( const Key* base, size_t size,
+				const Key& key, const std::less< Key >&, std::true_type )
+			{
+				return _countLess( base, size, key );
+			}
+
+			static inline size_t _countBefore( const Key* base, size_t size,
+				const Key& key, const std::greater< Key >&, std::true_type )
+			{
+				return _countGreater( base, size, key );
+			}
+
+			static inline size_t _countAfter( const Key* base, size_t size,
+				const Key& key, const Compare& compare, std::false_type )
+			{
+				return _countAfter< Key >( base, size, key, compare );
+			}
+
+			static inline size_t _countAfter( const Key* base, size_t size,
+				const Key& key, const std::less< Key >&, std::true_type )
+			{
+				return _countGreater( base, size, key );
+			}
+
+			static inline size_t _countAfter( const Key* base, size_t size,
+				const Key& key, const std::greater< Key >&, std::true_type )
+			{
+				return _countLess( base, size, key );
+			}
+
+			/*! \brief Bare key arrays take the vector path when possible */
+			static inline size_t _countBefore( const Key* base, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				return _countBefore( base, size, key, compare, Vector() );
+			}
+
+			static inline size_t _countAfter( const Key* base, size_t size,
+				const Key& key, const Compare& compare )
+			{
+				return _countAfter( base, size, key, compare, Vector() );
+			}
+			#endif
+	};
+
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+/*!
+	\file OffsetPointer.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the OffsetPointer class
+*/
+
+#ifndef OFFSET_POINTER_H_INCLUDED
+#define OFFSET_POINTER_H_INCLUDED
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A pointer that stores the distance from itself to its
+			target.
+
+		Moving a whole mapping, with the pointer and its target in it,
+		leaves the distance unchanged, so an OffsetPointer in a
+		SharedSegment is valid in every process that maps the segment,
+		wherever it lands.  Copying one recomputes the distance for the
+		new location.  A distance of one is null, no object of a type that
+		an OffsetPointer can point to starts one byte after the pointer.
+	*/
+	template< typename T >
+	class OffsetPointer
+	{
+		public:
+			typedef T element_type;
+
+		private:
+			static const intptr_t Null = 1;
+
+		private:
+			intptr_t _distance;
+
+		private:
+			void _set( const T* target )
+			{
+				_distance = target == 0 ? Null
+					: reinterpret_cast< intptr_t >( target )
+					- reinterpret_cast< intptr_t >( this );
+			}
+
+		public:
+			OffsetPointer() : _distance( Null ) {}
+			OffsetPointer( T* target ) { _set( target ); }
+			OffsetPointer( const OffsetPointer& p ) { _set( p.get() ); }
+
+			OffsetPointer& operator=( const OffsetPointer& p )
+			{
+				_set( p.get() );
+				return *this;
+			}
+
+			OffsetPointer& operator=( T* target )
+			{
+				_set( target );
+				return *this;
+			}
+
+		public:
+			T* get() const
+			{
+				return _distance == Null ? 0 : reinterpret_cast< T* >(
+					reinterpret_cast< intptr_t >( this ) + _distance );
+			}
+
+			T& operator*() const
+			{
+				return *get();
+			}
+
+			T* operator->() const
+			{
+				return get();
+			}
+
+			bool null() const
+			{
+				return _distance == Null;
+			}
+
+		public:
+			bool operator==( const OffsetPointer& p ) const
+			{
+				return get() == p.get();
+			}
+
+			bool operator!=( const OffsetPointer& p ) const
+			{
+				return get() != p.get();
+			}
+	};
+
+}
+
+#endif
+
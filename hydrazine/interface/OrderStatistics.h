@@ -0,0 +1,113 @@
+/*!
+	\file OrderStatistics.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BTree order statistic policies.
+*/
+
+#ifndef ORDER_STATISTICS_H_INCLUDED
+#define ORDER_STATISTICS_H_INCLUDED
+
+#include <cstddef>
+#include <algorithm>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief Do not keep subtree sizes in BTree bodies.  The storage is an
+			empty base class, so bodies are exactly as large as before and
+			every update compiles away.
+	*/
+	class NoOrderStatistics
+	{
+		public:
+			static const bool Enabled = false;
+
+		public:
+			template< typename Size, size_t Children >
+			class Storage
+			{
+				public:
+					inline Size count( size_t ) const
+					{
+						return 0;
+					}
+
+					inline void setCount( size_t, Size )
+					{
+					}
+
+					inline void addCount( size_t, Size )
+					{
+					}
+
+					inline void copyCounts( const Storage&, size_t, size_t,
+						size_t )
+					{
+					}
+
+					inline void copyCountsBackward( const Storage&, size_t,
+						size_t, size_t )
+					{
+					}
+			};
+	};
+
+	/*!
+		\brief Keep the number of elements below each child of a BTree body
+			next to the child pointer.
+
+		This lets the tree find the k-th element and the rank of a key in
+		a single walk down from the root.
+	*/
+	class OrderStatistics
+	{
+		public:
+			static const bool Enabled = true;
+
+		public:
+			template< typename Size, size_t Children >
+			class Storage
+			{
+				public:
+					Size counts[ Children ];
+
+				public:
+					inline Size count( size_t i ) const
+					{
+						return counts[ i ];
+					}
+
+					inline void setCount( size_t i, Size count )
+					{
+						counts[ i ] = count;
+					}
+
+					inline void addCount( size_t i, Size count )
+					{
+						counts[ i ] += count;
+					}
+
+					/*! \brief Copy [begin, end) of source to position */
+					inline void copyCounts( const Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::copy( source.counts + begin, source.counts + end,
+							counts + position );
+					}
+
+					/*! \brief Copy [begin, end) of source to end at position */
+					inline void copyCountsBackward( const Storage& source,
+						size_t begin, size_t end, size_t position )
+					{
+						std::copy_backward( source.counts + begin,
+							source.counts + end, counts + position );
+					}
+			};
+	};
+
+}
+
+#endif
+
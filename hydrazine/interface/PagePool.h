@@ -0,0 +1,124 @@
+/*!
+	\file PagePool.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the PagePool class
+*/
+
+#ifndef PAGE_POOL_H_INCLUDED
+#define PAGE_POOL_H_INCLUDED
+
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+#include <cstddef>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A set of fixed size block slabs carved out of large chunks.
+
+		Blocks of the same rounded size share a size class.  Each class
+		hands out blocks from an intrusive free list first and then by
+		bumping through its newest chunk.  Freeing a block only pushes it
+		on the free list, chunks are only returned to the system when a
+		whole class is released or the pool is destroyed.
+
+		A synchronized pool is split into several arenas, each behind its
+		own lock, and every thread sticks to one of them.  This keeps
+		threads that allocate at the same time off of each other's locks
+		and cache lines.  An unsynchronized pool uses a single arena and
+		never locks.
+	*/
+	class PagePool
+	{
+		public:
+			/*! \brief The number of arenas in a synchronized pool */
+			static const unsigned int Arenas = 16;
+			/*! \brief The smallest chunk that is requested from the system */
+			static const size_t MinChunkSize = 65536;
+			/*! \brief The fewest blocks carved out of a single chunk */
+			static const size_t MinChunkBlocks = 16;
+			/*! \brief Block sizes are rounded up to this */
+			static const size_t Alignment = 16;
+
+		private:
+			class FreeBlock
+			{
+				public:
+					FreeBlock* next;
+			};
+
+			class SizeClass
+			{
+				public:
+					/*! \brief The rounded size of each block */
+					size_t size;
+					/*! \brief Blocks that were freed */
+					FreeBlock* free;
+					/*! \brief The next untouched block of the newest chunk */
+					char* next;
+					/*! \brief The end of the newest chunk */
+					char* end;
+					/*! \brief The number of blocks handed out */
+					size_t live;
+					/*! \brief Every chunk owned by the class */
+					std::vector< char* > chunks;
+
+				public:
+					SizeClass( size_t size );
+			};
+
+			typedef std::vector< SizeClass > SizeClassVector;
+
+			class Arena
+			{
+				public:
+					boost::mutex mutex;
+					SizeClassVector classes;
+			};
+
+		private:
+			Arena _arenas[ Arenas ];
+			bool _synchronized;
+
+		private:
+			PagePool( const PagePool& );
+			PagePool& operator=( const PagePool& );
+
+		private:
+			Arena& _arena();
+			static size_t _round( size_t bytes );
+			static SizeClass& _class( Arena& arena, size_t size );
+			static void* _allocate( SizeClass& sizeClass );
+			static void _release( SizeClass& sizeClass );
+
+		public:
+			/*! \brief Create an empty pool, lock it if it is shared */
+			explicit PagePool( bool synchronized = false );
+			/*! \brief Return every chunk to the system */
+			~PagePool();
+
+		public:
+			/*! \brief Get a block of at least bytes */
+			void* allocate( size_t bytes );
+			/*! \brief Return a block of bytes to its class */
+			void deallocate( void* block, size_t bytes );
+			/*! \brief Free every chunk of the class that holds bytes,
+				invalidating all blocks handed out from it */
+			void release( size_t bytes );
+
+		public:
+			/*! \brief The number of blocks of bytes that are handed out */
+			size_t live( size_t bytes );
+			/*! \brief The number of chunks held by the pool */
+			size_t chunks();
+			/*! \brief Is the pool safe to share between threads? */
+			bool synchronized() const;
+	};
+
+}
+
+#endif
+
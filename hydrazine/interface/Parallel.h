@@ -0,0 +1,655 @@
+/*!
+	\file Parallel.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the parallel algorithms
+*/
+
+#ifndef PARALLEL_H_INCLUDED
+#define PARALLEL_H_INCLUDED
+
+#include <hydrazine/interface/ThreadPool.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+namespace hydrazine
+{
+
+	/*! \brief The pool that the parallel algorithms run on unless they are
+		given another, one worker per hardware thread, started on first use
+	*/
+	ThreadPool& parallelPool();
+
+	/*! \brief Helpers for the parallel algorithms */
+	namespace parallel
+	{
+		/*! \brief Pieces per worker that a range is split into by default */
+		const size_t Splits = 8;
+		/*! \brief The smallest piece by default, shorter ranges run
+			serially */
+		const size_t MinimumGrain = 4096;
+
+		/*! \brief The largest piece of a range that runs serially */
+		inline size_t grainOf( size_t size, size_t grain,
+			const ThreadPool& pool )
+		{
+			if( grain != 0 )
+			{
+				return grain;
+			}
+
+			return std::max( size / ( Splits * pool.size() ), MinimumGrain );
+		}
+
+		/*! \brief Ranges are of iterators or of integers */
+		template< typename Position,
+			bool Integral = std::is_integral< Position >::value >
+		class Traits
+		{
+			private:
+				typedef typename std::iterator_traits< Position >::
+					iterator_category Category;
+
+			public:
+				static const bool RandomAccess = std::is_same< Category,
+					std::random_access_iterator_tag >::value;
+
+			public:
+				static size_t distance( Position begin, Position end )
+				{
+					return std::distance( begin, end );
+				}
+
+				static Position advance( Position position, size_t n )
+				{
+					std::advance( position, n );
+					return position;
+				}
+		};
+
+		template< typename Position >
+		class Traits< Position, true >
+		{
+			public:
+				static const bool RandomAccess = true;
+
+			public:
+				static size_t distance( Position begin, Position end )
+				{
+					return end - begin;
+				}
+
+				static Position advance( Position position, size_t n )
+				{
+					return position + n;
+				}
+		};
+
+		/*! \brief Wait for every piece, then rethrow the first failure,
+			so no piece outlives the call that made it */
+		template< typename R >
+		void waitAll( const std::vector< ThreadPool::Future< R > >& pieces )
+		{
+			for( typename std::vector< ThreadPool::Future< R > >::
+				const_iterator piece = pieces.begin();
+				piece != pieces.end(); ++piece )
+			{
+				piece->wait();
+			}
+
+			for( typename std::vector< ThreadPool::Future< R > >::
+				const_iterator piece = pieces.begin();
+				piece != pieces.end(); ++piece )
+			{
+				piece->get();
+			}
+		}
+
+		/*! \brief Call a function for every position of a range, splitting
+			it in half until the pieces fit in the grain */
+		template< typename Position, typename Function >
+		class For
+		{
+			public:
+				Position begin;
+				Position end;
+				size_t grain;
+				const Function* function;
+				ThreadPool* pool;
+
+			public:
+				For( Position b, Position e, size_t g, const Function* f,
+					ThreadPool* p ) : begin( b ), end( e ), grain( g ),
+					function( f ), pool( p ) {}
+
+			public:
+				void operator()() const
+				{
+					size_t size = Traits< Position >::distance( begin, end );
+
+					if( size <= grain )
+					{
+						for( Position i = begin; i != end; ++i )
+						{
+							( *function )( i );
+						}
+
+						return;
+					}
+
+					Position middle = Traits< Position >::advance( begin,
+						size / 2 );
+
+					ThreadPool::Future< void > left = pool->submit(
+						For( begin, middle, grain, function, pool ) );
+
+					try
+					{
+						For( middle, end, grain, function, pool )();
+					}
+					catch( ... )
+					{
+						left.wait();
+						throw;
+					}
+
+					left.get();
+				}
+		};
+
+		/*! \brief Combine the elements of a range, splitting it in half
+			until the pieces fit in the grain */
+		template< typename Iterator, typename T, typename Operation >
+		class Reduce
+		{
+			public:
+				Iterator begin;
+				Iterator end;
+				/*! \brief Every piece starts from this */
+				const T* identity;
+				size_t grain;
+				const Operation* operation;
+				ThreadPool* pool;
+
+			public:
+				Reduce( Iterator b, Iterator e, const T* i, size_t g,
+					const Operation* o, ThreadPool* p ) : begin( b ),
+					end( e ), identity( i ), grain( g ), operation( o ),
+					pool( p ) {}
+
+			public:
+				T operator()() const
+				{
+					size_t size = Traits< Iterator >::distance( begin, end );
+
+					if( size <= grain )
+					{
+						T result = *identity;
+
+						for( Iterator i = begin; i != end; ++i )
+						{
+							result = ( *operation )( result, *i );
+						}
+
+						return result;
+					}
+
+					Iterator middle = Traits< Iterator >::advance( begin,
+						size / 2 );
+
+					ThreadPool::Future< T > left = pool->submit(
+						Reduce( begin, middle, identity, grain, operation,
+						pool ) );
+
+					try
+					{
+						T right = Reduce( middle, end, identity, grain,
+							operation, pool )();
+						return ( *operation )( left.get(), right );
+					}
+					catch( ... )
+					{
+						left.wait();
+						throw;
+					}
+				}
+		};
+
+		/*! \brief The first pass of a scan, combine one block */
+		template< typename Input, typename T, typename Operation >
+		class ScanSum
+		{
+			public:
+				Input begin;
+				Input end;
+				const Operation* operation;
+
+			public:
+				ScanSum( Input b, Input e, const Operation* o ) : begin( b ),
+					end( e ), operation( o ) {}
+
+			public:
+				/*! \brief The block must not be empty */
+				T operator()() const
+				{
+					return std::accumulate( begin + 1, end, T( *begin ),
+						*operation );
+				}
+		};
+
+		/*! \brief The second pass of a scan, over one block */
+		template< typename Input, typename Output, typename T,
+			typename Operation >
+		class ScanBlock
+		{
+			public:
+				Input begin;
+				Input end;
+				Output output;
+				/*! \brief Everything before the block, 0 for the first */
+				const T* offset;
+				const Operation* operation;
+
+			public:
+				ScanBlock( Input b, Input e, Output o, const T* f,
+					const Operation* op ) : begin( b ), end( e ), output( o ),
+					offset( f ), operation( op ) {}
+
+			public:
+				void operator()() const
+				{
+					if( offset == 0 )
+					{
+						std::partial_sum( begin, end, output, *operation );
+						return;
+					}
+
+					Output o = output;
+					T sum = ( *operation )( *offset, *begin );
+					*o = sum;
+
+					for( Input i = begin + 1; i != end; ++i )
+					{
+						sum = ( *operation )( sum, *i );
+						*++o = sum;
+					}
+				}
+		};
+
+		/*! \brief Merge two sorted ranges, splitting the longer one in half
+			and the other where its middle would go, the grain must be at
+			least 2 because two single elements do not split */
+		template< typename Source, typename Destination, typename Compare >
+		class Merge
+		{
+			public:
+				Source firstBegin;
+				Source firstEnd;
+				Source secondBegin;
+				Source secondEnd;
+				Destination output;
+				size_t grain;
+				const Compare* compare;
+				ThreadPool* pool;
+
+			public:
+				Merge( Source fb, Source fe, Source sb, Source se,
+					Destination o, size_t g, const Compare* c,
+					ThreadPool* p ) : firstBegin( fb ), firstEnd( fe ),
+					secondBegin( sb ), secondEnd( se ), output( o ),
+					grain( g ), compare( c ), pool( p ) {}
+
+			public:
+				void operator()() const
+				{
+					size_t first = firstEnd - firstBegin;
+					size_t second = secondEnd - secondBegin;
+
+					assert( grain >= 2 );
+
+					if( first + second <= grain )
+					{
+						std::merge( std::make_move_iterator( firstBegin ),
+							std::make_move_iterator( firstEnd ),
+							std::make_move_iterator( secondBegin ),
+							std::make_move_iterator( secondEnd ),
+							output, *compare );
+						return;
+					}
+
+					Source firstMiddle;
+					Source secondMiddle;
+
+					// Equal elements of the first range stay in front
+					if( first >= second )
+					{
+						firstMiddle = firstBegin + first / 2;
+						secondMiddle = std::lower_bound( secondBegin,
+							secondEnd, *firstMiddle, *compare );
+					}
+					else
+					{
+						secondMiddle = secondBegin + second / 2;
+						firstMiddle = std::upper_bound( firstBegin,
+							firstEnd, *secondMiddle, *compare );
+					}
+
+					Destination middle = output + ( firstMiddle - firstBegin )
+						+ ( secondMiddle - secondBegin );
+
+					ThreadPool::Future< void > left = pool->submit(
+						Merge( firstBegin, firstMiddle, secondBegin,
+						secondMiddle, output, grain, compare, pool ) );
+
+					try
+					{
+						Merge( firstMiddle, firstEnd, secondMiddle, secondEnd,
+							middle, grain, compare, pool )();
+					}
+					catch( ... )
+					{
+						left.wait();
+						throw;
+					}
+
+					left.get();
+				}
+		};
+
+		/*!
+			\brief Merge sort a range of the data into the data or into the
+				buffer.
+
+			The buffer starts out as a copy of the data.  Pieces that fit
+			in the grain are sorted where the result should end up, and
+			larger ones sort both halves into the other array and merge
+			them back, so nothing is copied between levels.
+		*/
+		template< typename Data, typename Buffer, typename Compare >
+		class Sort
+		{
+			public:
+				Data data;
+				Buffer buffer;
+				size_t size;
+				bool toBuffer;
+				size_t grain;
+				const Compare* compare;
+				ThreadPool* pool;
+
+			public:
+				Sort( Data d, Buffer b, size_t s, bool t, size_t g,
+					const Compare* c, ThreadPool* p ) : data( d ),
+					buffer( b ), size( s ), toBuffer( t ), grain( g ),
+					compare( c ), pool( p ) {}
+
+			public:
+				void operator()() const
+				{
+					if( size <= grain )
+					{
+						if( toBuffer )
+						{
+							std::sort( buffer, buffer + size, *compare );
+						}
+						else
+						{
+							std::sort( data, data + size, *compare );
+						}
+
+						return;
+					}
+
+					size_t half = size / 2;
+
+					ThreadPool::Future< void > left = pool->submit(
+						Sort( data, buffer, half, !toBuffer, grain, compare,
+						pool ) );
+
+					try
+					{
+						Sort( data + half, buffer + half, size - half,
+							!toBuffer, grain, compare, pool )();
+					}
+					catch( ... )
+					{
+						left.wait();
+						throw;
+					}
+
+					left.get();
+
+					if( toBuffer )
+					{
+						Merge< Data, Buffer, Compare >( data, data + half,
+							data + half, data + size, buffer, grain, compare,
+							pool )();
+					}
+					else
+					{
+						Merge< Buffer, Data, Compare >( buffer,
+							buffer + half, buffer + half, buffer + size, data,
+							grain, compare, pool )();
+					}
+				}
+		};
+	}
+
+	/*!
+		\brief Call a function for every position of a range in parallel
+
+		The range is of integers or of iterators, and the function is
+		called with each one.  It is shared by every worker, so it is
+		called through a const reference.  Ranges with random access are
+		split in half recursively, others, like ranges of a BTree, are cut
+		into pieces in a single walk.  Pieces of up to grain positions run
+		serially, by default a grain is an eighth of the share of a worker
+		and at least parallel::MinimumGrain.
+	*/
+	template< typename Position, typename Function >
+	void parallel_for( Position begin, Position end,
+		const Function& function, size_t grain = 0,
+		ThreadPool& pool = parallelPool() )
+	{
+		typedef parallel::Traits< Position > Traits;
+		typedef parallel::For< Position, Function > For;
+
+		size_t size = Traits::distance( begin, end );
+		grain = parallel::grainOf( size, grain, pool );
+
+		if( size <= grain || Traits::RandomAccess )
+		{
+			For( begin, end, grain, &function, &pool )();
+			return;
+		}
+
+		std::vector< ThreadPool::Future< void > > pieces;
+
+		for( Position piece = begin; piece != end; )
+		{
+			Position next = Traits::advance( piece,
+				std::min( grain, size ) );
+			size -= std::min( grain, size );
+
+			pieces.push_back( pool.submit( For( piece, next,
+				std::numeric_limits< size_t >::max(), &function, &pool ) ) );
+
+			piece = next;
+		}
+
+		parallel::waitAll( pieces );
+	}
+
+	/*!
+		\brief Combine every element of a range in parallel, like
+			std::accumulate
+
+		Every piece starts from the identity, so it must not change what
+		it is combined with, like 0 for a sum.  The operation must be
+		associative, it is applied to neighboring pieces in order, but not
+		from left to right.  It is called with two results, and with a
+		result and an element, so the elements of a BTree may be reduced
+		to a sum of their values.
+	*/
+	template< typename Iterator, typename T,
+		typename Operation = std::plus< T > >
+	T parallel_reduce( Iterator begin, Iterator end, T identity,
+		const Operation& operation = Operation(), size_t grain = 0,
+		ThreadPool& pool = parallelPool() )
+	{
+		typedef parallel::Traits< Iterator > Traits;
+		typedef parallel::Reduce< Iterator, T, Operation > Reduce;
+
+		size_t size = Traits::distance( begin, end );
+		grain = parallel::grainOf( size, grain, pool );
+
+		if( size == 0 )
+		{
+			return identity;
+		}
+
+		if( size <= grain || Traits::RandomAccess )
+		{
+			return Reduce( begin, end, &identity, grain, &operation,
+				&pool )();
+		}
+
+		std::vector< ThreadPool::Future< T > > pieces;
+
+		for( Iterator piece = begin; piece != end; )
+		{
+			Iterator next = Traits::advance( piece, std::min( grain, size ) );
+			size -= std::min( grain, size );
+
+			pieces.push_back( pool.submit( Reduce( piece, next, &identity,
+				std::numeric_limits< size_t >::max(), &operation,
+				&pool ) ) );
+
+			piece = next;
+		}
+
+		parallel::waitAll( pieces );
+
+		T result = pieces.front().get();
+
+		for( typename std::vector< ThreadPool::Future< T > >::iterator
+			piece = pieces.begin() + 1; piece != pieces.end(); ++piece )
+		{
+			result = operation( result, piece->get() );
+		}
+
+		return result;
+	}
+
+	/*!
+		\brief Write the running combination of a range in parallel, like
+			std::partial_sum
+
+		Both ranges need random access, and may be the same.  The range is
+		cut into blocks of the grain.  One pass combines every block, the
+		combinations before each block are found serially, and a second
+		pass scans every block starting from them.  The operation must be
+		associative.
+	*/
+	template< typename Input, typename Output,
+		typename Operation = std::plus<
+		typename std::iterator_traits< Input >::value_type > >
+	Output parallel_scan( Input begin, Input end, Output output,
+		const Operation& operation = Operation(), size_t grain = 0,
+		ThreadPool& pool = parallelPool() )
+	{
+		typedef typename std::iterator_traits< Input >::value_type T;
+		typedef parallel::ScanSum< Input, T, Operation > ScanSum;
+		typedef parallel::ScanBlock< Input, Output, T, Operation > ScanBlock;
+
+		size_t size = end - begin;
+		grain = parallel::grainOf( size, grain, pool );
+
+		if( size <= grain )
+		{
+			return std::partial_sum( begin, end, output, operation );
+		}
+
+		size_t blocks = ( size + grain - 1 ) / grain;
+
+		std::vector< ThreadPool::Future< T > > sums;
+		sums.reserve( blocks );
+
+		for( size_t block = 0; block < blocks; ++block )
+		{
+			sums.push_back( pool.submit( ScanSum( begin + block * grain,
+				begin + std::min( size, ( block + 1 ) * grain ),
+				&operation ) ) );
+		}
+
+		parallel::waitAll( sums );
+
+		std::vector< T > offsets;
+		offsets.reserve( blocks );
+		offsets.push_back( sums[ 0 ].get() );
+
+		for( size_t block = 1; block < blocks; ++block )
+		{
+			offsets.push_back( operation( offsets.back(),
+				sums[ block ].get() ) );
+		}
+
+		std::vector< ThreadPool::Future< void > > scans;
+		scans.reserve( blocks );
+
+		for( size_t block = 0; block < blocks; ++block )
+		{
+			scans.push_back( pool.submit( ScanBlock( begin + block * grain,
+				begin + std::min( size, ( block + 1 ) * grain ),
+				output + block * grain,
+				block == 0 ? 0 : &offsets[ block - 1 ], &operation ) ) );
+		}
+
+		parallel::waitAll( scans );
+
+		return output + size;
+	}
+
+	/*!
+		\brief Sort a range with random access in parallel, like std::sort
+
+		A merge sort that sorts pieces of up to the grain with std::sort
+		and merges them in parallel, through a buffer as large as the
+		range.  Like std::sort it is not stable.
+	*/
+	template< typename Iterator, typename Compare = std::less<
+		typename std::iterator_traits< Iterator >::value_type > >
+	void parallel_sort( Iterator begin, Iterator end,
+		const Compare& compare = Compare(), size_t grain = 0,
+		ThreadPool& pool = parallelPool() )
+	{
+		typedef typename std::iterator_traits< Iterator >::value_type T;
+		typedef std::vector< T > Vector;
+		typedef parallel::Sort< Iterator, typename Vector::iterator,
+			Compare > Sort;
+
+		size_t size = end - begin;
+		grain = std::max( parallel::grainOf( size, grain, pool ), size_t( 2 ) );
+
+		if( size <= grain )
+		{
+			std::sort( begin, end, compare );
+			return;
+		}
+
+		Vector buffer( begin, end );
+
+		Sort( begin, buffer.begin(), size, false, grain, &compare, &pool )();
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,1209 @@
+/*!
+	\file PersistentBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the PersistentBTree class
+*/
+
+#ifndef PERSISTENT_BTREE_H_INCLUDED
+#define PERSISTENT_BTREE_H_INCLUDED
+
+#include <hydrazine/interface/debug.h>
+#include <hydrazine/interface/macros.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <hydrazine/interface/LeafLayout.h>
+#include <hydrazine/interface/Exception.h>
+
+#ifdef REPORT_BASE
+#undef REPORT_BASE
+#endif
+
+#define REPORT_BASE 0
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A B+tree whose pages live in a memory mapped file.
+
+		The first page of the file is a superblock holding the root, the
+		ends of the leaf chain, a free page list, and the element and
+		node counts.  Every other page is a node.  Nodes refer to each
+		other by their offset in the file rather than by address, so the
+		file can be mapped anywhere, and reopening an index only maps it
+		and checks the superblock.
+
+		The file grows by doubling and is remapped when it does, which
+		moves every node.  Iterators hold offsets and survive that, but
+		like those of BTree they are invalidated by any insert or erase.
+
+		Modifications reach the file as the kernel writes back the
+		mapping.  sync() is an explicit checkpoint, when it returns
+		everything written so far is on disk.  A crash in the middle of
+		a modification that was not followed by sync() may leave the
+		file inconsistent.
+
+		Leafs always use the paired layout, a split leaf sizes only its
+		keys to the page and would not fit in one.  Keys and values are
+		written to and read back from the file as raw bytes, so both
+		must be trivially copyable, and the same program must open a
+		file that created it.
+	*/
+	template< typename Key, typename Value, typename Compare = std::less<Key>,
+		size_t PageSize = 4096 >
+	class PersistentBTree
+	{
+		public:
+			typedef Key key_type;
+			typedef Value mapped_type;
+			typedef std::pair< key_type, mapped_type > value_type;
+			typedef PersistentBTree type;
+			typedef Compare key_compare;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+			/*! \brief The position of a page in the file */
+			typedef unsigned long long Offset;
+
+		private:
+			class Node;
+			class Body;
+			class Leaf;
+			class FreePage;
+			class Stats;
+			class Superblock;
+
+			/*! \brief The bytes of a leaf page left after its header */
+			static const size_type LeafBytes = PageSize
+				- 2 * sizeof( size_type ) - 2 * sizeof( Offset );
+
+			typedef PairedLeafLayout::Storage< key_type, mapped_type,
+				LeafBytes > LeafStorage;
+			typedef NodeSearch< key_type, key_compare > Search;
+
+		public:
+			typedef typename LeafStorage::reference reference;
+			typedef typename LeafStorage::const_reference const_reference;
+			typedef typename LeafStorage::pointer pointer;
+			typedef typename LeafStorage::const_pointer const_pointer;
+
+		private:
+			static const size_type MaxNodes = ( PageSize
+				- 2 * sizeof( size_type ) - sizeof( Offset ) )
+				/ ( sizeof( key_type ) + sizeof( Offset ) );
+			static const size_type MinNodes = ( MaxNodes - 1 ) / 2;
+			static const size_type MaxLeafs = LeafStorage::Capacity;
+			static const size_type MinLeafs = MaxLeafs / 2;
+			static const size_type MaxHeight = 4 * sizeof( size_type ) + 2;
+
+			/*! \brief Pages in a new file */
+			static const size_type InitialPages = 16;
+
+			/*! \brief "HYDRBTRE" */
+			static const Offset Magic = 0x4552544252445948ULL;
+			/*! \brief Bumped whenever the page format changes */
+			static const Offset FormatVersion = 1;
+
+		private:
+			class Node
+			{
+				public:
+					size_type level;
+					size_type size;
+
+				public:
+					inline bool leaf() const
+					{
+						return level == 0;
+					}
+			};
+
+			/*!
+				\brief Body Node
+			*/
+			class Body : public Node
+			{
+				public:
+					key_type keys[ MaxNodes ];
+					Offset children[ MaxNodes + 1 ];
+			};
+
+			/*!
+				\brief A leaf node, linked to its neighbors
+			*/
+			class Leaf : public Node, public LeafStorage
+			{
+				public:
+					Offset previous;
+					Offset next;
+			};
+
+			/*!
+				\brief A page on the free list
+			*/
+			class FreePage
+			{
+				public:
+					Offset next;
+			};
+
+			class Stats
+			{
+				public:
+					size_type elements;
+					size_type leafs;
+					size_type bodies;
+			};
+
+			/*!
+				\brief The first page of the file
+			*/
+			class Superblock
+			{
+				public:
+					Offset magic;
+					Offset version;
+					Offset pageSize;
+					Offset keySize;
+					Offset valueSize;
+					/*! \brief The root node, 0 if the tree is empty */
+					Offset root;
+					/*! \brief The first and last leafs */
+					Offset begin;
+					Offset end;
+					/*! \brief The head of the free page list */
+					Offset free;
+					/*! \brief The number of pages ever handed out */
+					Offset pages;
+					Stats stats;
+			};
+
+		public:
+			/*!
+				\brief An iterator over the leaf chain.  The end iterator
+					is the null leaf.
+			*/
+			template< typename Tree, typename Reference, typename Pointer >
+			class Iterator
+			{
+				friend class PersistentBTree;
+				template< typename T, typename R, typename P >
+					friend class Iterator;
+
+				public:
+					typedef std::bidirectional_iterator_tag iterator_category;
+					typedef typename PersistentBTree::value_type value_type;
+					typedef typename PersistentBTree::difference_type
+						difference_type;
+					typedef Reference reference;
+					typedef Pointer pointer;
+
+				private:
+					Tree* _tree;
+					Offset _leaf;
+					size_type _current;
+
+				private:
+					inline Iterator( Tree* tree, Offset leaf,
+						size_type current ) :
+						_tree( tree ), _leaf( leaf ), _current( current )
+					{}
+
+				public:
+					inline Iterator() : _tree( 0 ), _leaf( 0 ), _current( 0 )
+					{}
+
+					template< typename T, typename R, typename P >
+					inline Iterator( const Iterator< T, R, P >& i ) :
+						_tree( i._tree ), _leaf( i._leaf ),
+						_current( i._current )
+					{}
+
+				public:
+					inline Reference operator*() const
+					{
+						return _tree->_leafAt( _leaf )->at( _current );
+					}
+
+					inline Pointer operator->() const
+					{
+						return _tree->_leafAt( _leaf )->address( _current );
+					}
+
+					inline Iterator& operator++()
+					{
+						const Leaf* leaf = _tree->_leafAt( _leaf );
+						if( ++_current == leaf->size )
+						{
+							_leaf = leaf->next;
+							_current = 0;
+						}
+						return *this;
+					}
+
+					inline Iterator operator++( int )
+					{
+						Iterator previous = *this;
+						++*this;
+						return previous;
+					}
+
+					inline Iterator& operator--()
+					{
+						if( _leaf == 0 )
+						{
+							_leaf = _tree->_superblock()->end;
+							_current = _tree->_leafAt( _leaf )->size;
+						}
+						else if( _current == 0 )
+						{
+							_leaf = _tree->_leafAt( _leaf )->previous;
+							_current = _tree->_leafAt( _leaf )->size;
+						}
+						--_current;
+						return *this;
+					}
+
+					inline Iterator operator--( int )
+					{
+						Iterator next = *this;
+						--*this;
+						return next;
+					}
+
+					template< typename T, typename R, typename P >
+					inline bool operator==( const Iterator< T, R, P >& i ) const
+					{
+						return _leaf == i._leaf && _current == i._current;
+					}
+
+					template< typename T, typename R, typename P >
+					inline bool operator!=( const Iterator< T, R, P >& i ) const
+					{
+						return !( *this == i );
+					}
+			};
+
+			typedef Iterator< PersistentBTree, reference, pointer > iterator;
+			typedef Iterator< const PersistentBTree, const_reference,
+				const_pointer > const_iterator;
+			typedef std::reverse_iterator< iterator > reverse_iterator;
+			typedef std::reverse_iterator< const_iterator >
+				const_reverse_iterator;
+
+		private:
+			std::string _path;
+			int _file;
+			char* _base;
+			/*! \brief The number of pages that fit in the file */
+			size_type _capacity;
+			key_compare _keyCompare;
+
+		private:
+			PersistentBTree( const PersistentBTree& );
+			PersistentBTree& operator=( const PersistentBTree& );
+
+		public:
+			/*!
+				\brief Open the index in a file, creating it if it does not
+					exist or is empty
+			*/
+			explicit PersistentBTree( const std::string& path,
+				const Compare& comp = Compare() ) : _path( path ),
+				_file( -1 ), _base( 0 ), _capacity( 0 ), _keyCompare( comp )
+			{
+				static_assert( std::is_trivially_copyable< Key >::value
+					&& std::is_trivially_copyable< Value >::value,
+					"Pages are stored in a file as raw bytes" );
+				static_assert( sizeof( Leaf ) <= PageSize
+					&& sizeof( Body ) <= PageSize
+					&& sizeof( Superblock ) <= PageSize,
+					"Every node must fit in a page" );
+				static_assert( MaxNodes >= 8, "Bodies need a fanout of 8" );
+
+				_open();
+			}
+
+			/*!
+				\brief Unmap the file.  Changes since the last sync() are
+					written back by the kernel, but not waited for.
+			*/
+			~PersistentBTree()
+			{
+				_close();
+			}
+
+		public:
+			inline iterator begin()
+			{
+				return iterator( this, _superblock()->begin, 0 );
+			}
+
+			inline const_iterator begin() const
+			{
+				return const_iterator( this, _superblock()->begin, 0 );
+			}
+
+			inline iterator end()
+			{
+				return iterator( this, 0, 0 );
+			}
+
+			inline const_iterator end() const
+			{
+				return const_iterator( this, 0, 0 );
+			}
+
+			inline reverse_iterator rbegin()
+			{
+				return reverse_iterator( end() );
+			}
+
+			inline const_reverse_iterator rbegin() const
+			{
+				return const_reverse_iterator( end() );
+			}
+
+			inline reverse_iterator rend()
+			{
+				return reverse_iterator( begin() );
+			}
+
+			inline const_reverse_iterator rend() const
+			{
+				return const_reverse_iterator( begin() );
+			}
+
+		public:
+			inline size_type size() const
+			{
+				return _superblock()->stats.elements;
+			}
+
+			inline bool empty() const
+			{
+				return size() == 0;
+			}
+
+			inline key_compare key_comp() const
+			{
+				return _keyCompare;
+			}
+
+			/*! \brief The file holding the index */
+			inline const std::string& path() const
+			{
+				return _path;
+			}
+
+			/*! \brief The number of pages in use, including the
+				superblock */
+			inline size_type pages() const
+			{
+				return 1 + _superblock()->stats.leafs
+					+ _superblock()->stats.bodies;
+			}
+
+		public:
+			/*!
+				\brief Insert a value if its key is not already present
+				\return An iterator to the element with the key, and true
+					if it was inserted
+			*/
+			std::pair< iterator, bool > insert( const value_type& value )
+			{
+				if( _superblock()->root == 0 )
+				{
+					Offset leaf = _allocateLeaf();
+					Superblock* superblock = _superblock();
+					superblock->root = leaf;
+					superblock->begin = leaf;
+					superblock->end = leaf;
+				}
+
+				Offset path[ MaxHeight ];
+				size_type positions[ MaxHeight ];
+				size_type depth = 0;
+
+				Offset node = _superblock()->root;
+				while( !_nodeAt( node )->leaf() )
+				{
+					const Body* body = _bodyAt( node );
+					size_type position = Search::upperBound( body->keys,
+						body->size, value.first, _keyCompare );
+					path[ depth ] = node;
+					positions[ depth ] = position;
+					++depth;
+					node = body->children[ position ];
+				}
+
+				Leaf* leaf = _leafAt( node );
+				size_type position = Search::lowerBound( leaf->entries(),
+					leaf->size, value.first, _keyCompare );
+
+				if( position < leaf->size
+					&& !_keyCompare( value.first, leaf->key( position ) ) )
+				{
+					return std::make_pair( iterator( this, node, position ),
+						false );
+				}
+
+				leaf->moveBackward( *leaf, position, leaf->size,
+					leaf->size + 1 );
+				leaf->set( position, value );
+				++leaf->size;
+				++_superblock()->stats.elements;
+
+				report( "Inserted key " << value.first << " into leaf at "
+					<< node );
+
+				if( leaf->size < MaxLeafs )
+				{
+					return std::make_pair( iterator( this, node, position ),
+						true );
+				}
+
+				return std::make_pair( _split( path, positions, depth, node,
+					position ), true );
+			}
+
+			/*!
+				\brief Remove a key
+				\return The number of elements removed
+			*/
+			size_type erase( const key_type& key )
+			{
+				Offset node = _superblock()->root;
+
+				if( node == 0 )
+				{
+					return 0;
+				}
+
+				Offset path[ MaxHeight ];
+				size_type positions[ MaxHeight ];
+				size_type depth = 0;
+
+				while( !_nodeAt( node )->leaf() )
+				{
+					const Body* body = _bodyAt( node );
+					size_type position = Search::upperBound( body->keys,
+						body->size, key, _keyCompare );
+					path[ depth ] = node;
+					positions[ depth ] = position;
+					++depth;
+					node = body->children[ position ];
+				}
+
+				Leaf* leaf = _leafAt( node );
+				size_type position = Search::lowerBound( leaf->entries(),
+					leaf->size, key, _keyCompare );
+
+				if( position == leaf->size
+					|| _keyCompare( key, leaf->key( position ) ) )
+				{
+					return 0;
+				}
+
+				leaf->move( *leaf, position + 1, leaf->size, position );
+				--leaf->size;
+				--_superblock()->stats.elements;
+
+				report( "Erased key " << key << " from leaf at " << node );
+
+				for( ; depth > 0; --depth )
+				{
+					if( !_underflow( node ) )
+					{
+						break;
+					}
+					node = path[ depth - 1 ];
+					_rebalance( node, positions[ depth - 1 ] );
+				}
+
+				_shrink();
+
+				return 1;
+			}
+
+			/*! \brief Remove every element and shrink the file */
+			void clear()
+			{
+				_create();
+			}
+
+		public:
+			inline iterator find( const key_type& key )
+			{
+				iterator result = lower_bound( key );
+				if( result != end() && _keyCompare( key, result->first ) )
+				{
+					return end();
+				}
+				return result;
+			}
+
+			inline const_iterator find( const key_type& key ) const
+			{
+				const_iterator result = lower_bound( key );
+				if( result != end() && _keyCompare( key, result->first ) )
+				{
+					return end();
+				}
+				return result;
+			}
+
+			inline size_type count( const key_type& key ) const
+			{
+				return find( key ) != end();
+			}
+
+			inline iterator lower_bound( const key_type& key )
+			{
+				return _bound< false, iterator >( this, key );
+			}
+
+			inline const_iterator lower_bound( const key_type& key ) const
+			{
+				return _bound< false, const_iterator >( this, key );
+			}
+
+			inline iterator upper_bound( const key_type& key )
+			{
+				return _bound< true, iterator >( this, key );
+			}
+
+			inline const_iterator upper_bound( const key_type& key ) const
+			{
+				return _bound< true, const_iterator >( this, key );
+			}
+
+			inline std::pair< iterator, iterator > equal_range(
+				const key_type& key )
+			{
+				return std::make_pair( lower_bound( key ),
+					upper_bound( key ) );
+			}
+
+			inline std::pair< const_iterator, const_iterator > equal_range(
+				const key_type& key ) const
+			{
+				return std::make_pair( lower_bound( key ),
+					upper_bound( key ) );
+			}
+
+		public:
+			/*!
+				\brief Checkpoint the index, block until every page written
+					so far is on disk
+			*/
+			void sync()
+			{
+				if( msync( _base, _capacity * PageSize, MS_SYNC ) != 0 )
+				{
+					_fail( "Could not sync" );
+				}
+			}
+
+		private:
+			inline Superblock* _superblock()
+			{
+				return reinterpret_cast< Superblock* >( _base );
+			}
+
+			inline const Superblock* _superblock() const
+			{
+				return reinterpret_cast< const Superblock* >( _base );
+			}
+
+			inline Node* _nodeAt( Offset offset )
+			{
+				return reinterpret_cast< Node* >( _base + offset );
+			}
+
+			inline const Node* _nodeAt( Offset offset ) const
+			{
+				return reinterpret_cast< const Node* >( _base + offset );
+			}
+
+			inline Body* _bodyAt( Offset offset )
+			{
+				return reinterpret_cast< Body* >( _base + offset );
+			}
+
+			inline const Body* _bodyAt( Offset offset ) const
+			{
+				return reinterpret_cast< const Body* >( _base + offset );
+			}
+
+			inline Leaf* _leafAt( Offset offset )
+			{
+				return reinterpret_cast< Leaf* >( _base + offset );
+			}
+
+			inline const Leaf* _leafAt( Offset offset ) const
+			{
+				return reinterpret_cast< const Leaf* >( _base + offset );
+			}
+
+		private:
+			void _fail( const std::string& message ) const
+			{
+				throw Exception( message + " persistent btree '" + _path
+					+ "': " + std::strerror( errno ) );
+			}
+
+			void _invalid( const std::string& message ) const
+			{
+				throw Exception( "Persistent btree '" + _path + "' "
+					+ message );
+			}
+
+			void _open()
+			{
+				_file = ::open( _path.c_str(), O_RDWR | O_CREAT, 0644 );
+
+				if( _file < 0 )
+				{
+					_fail( "Could not open" );
+				}
+
+				try
+				{
+					struct stat status;
+					if( fstat( _file, &status ) != 0 )
+					{
+						_fail( "Could not stat" );
+					}
+
+					if( status.st_size == 0 )
+					{
+						report( "Creating " << _path );
+						_create();
+					}
+					else
+					{
+						_load( status.st_size );
+					}
+				}
+				catch( ... )
+				{
+					_close();
+					throw;
+				}
+			}
+
+			/*! \brief Map an existing file and check its superblock */
+			void _load( size_type bytes )
+			{
+				if( bytes < PageSize || bytes % PageSize != 0 )
+				{
+					_invalid( "is not a whole number of pages" );
+				}
+
+				_map( bytes / PageSize );
+				const Superblock* superblock = _superblock();
+
+				if( superblock->magic != Magic )
+				{
+					_invalid( "is not an index" );
+				}
+				if( superblock->version != FormatVersion )
+				{
+					_invalid( "has an unsupported format version" );
+				}
+				if( superblock->pageSize != PageSize
+					|| superblock->keySize != sizeof( key_type )
+					|| superblock->valueSize != sizeof( mapped_type ) )
+				{
+					_invalid( "was created with a different page, key, or "
+						"value size" );
+				}
+				if( superblock->pages > _capacity )
+				{
+					_invalid( "is truncated" );
+				}
+
+				report( "Opened " << _path << " with "
+					<< superblock->stats.elements << " elements in "
+					<< superblock->pages << " pages" );
+			}
+
+			/*! \brief Truncate the file to an empty index */
+			void _create()
+			{
+				if( _base != 0 )
+				{
+					munmap( _base, _capacity * PageSize );
+					_base = 0;
+				}
+
+				if( ftruncate( _file, 0 ) != 0
+					|| ftruncate( _file, InitialPages * PageSize ) != 0 )
+				{
+					_fail( "Could not size" );
+				}
+
+				_map( InitialPages );
+
+				Superblock* superblock = _superblock();
+				superblock->magic = Magic;
+				superblock->version = FormatVersion;
+				superblock->pageSize = PageSize;
+				superblock->keySize = sizeof( key_type );
+				superblock->valueSize = sizeof( mapped_type );
+				superblock->root = 0;
+				superblock->begin = 0;
+				superblock->end = 0;
+				superblock->free = 0;
+				superblock->pages = 1;
+				superblock->stats.elements = 0;
+				superblock->stats.leafs = 0;
+				superblock->stats.bodies = 0;
+			}
+
+			void _map( size_type pages )
+			{
+				void* base = mmap( 0, pages * PageSize,
+					PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0 );
+
+				if( base == MAP_FAILED )
+				{
+					_fail( "Could not map" );
+				}
+
+				_base = static_cast< char* >( base );
+				_capacity = pages;
+			}
+
+			void _close()
+			{
+				if( _base != 0 )
+				{
+					munmap( _base, _capacity * PageSize );
+					_base = 0;
+				}
+				if( _file >= 0 )
+				{
+					::close( _file );
+					_file = -1;
+				}
+			}
+
+			/*! \brief Double the size of the file, moving the mapping */
+			void _grow()
+			{
+				size_type pages = 2 * _capacity;
+
+				report( "Growing " << _path << " to " << pages << " pages" );
+
+				if( ftruncate( _file, pages * PageSize ) != 0 )
+				{
+					_fail( "Could not grow" );
+				}
+
+				#ifdef MREMAP_MAYMOVE
+				void* base = mremap( _base, _capacity * PageSize,
+					pages * PageSize, MREMAP_MAYMOVE );
+				#else
+				munmap( _base, _capacity * PageSize );
+				void* base = mmap( 0, pages * PageSize,
+					PROT_READ | PROT_WRITE, MAP_SHARED, _file, 0 );
+				#endif
+
+				if( base == MAP_FAILED )
+				{
+					_base = 0;
+					_fail( "Could not remap" );
+				}
+
+				_base = static_cast< char* >( base );
+				_capacity = pages;
+			}
+
+		private:
+			/*! \brief Get a page, this may move every node */
+			Offset _allocate()
+			{
+				Superblock* superblock = _superblock();
+
+				if( superblock->free != 0 )
+				{
+					Offset page = superblock->free;
+					superblock->free = reinterpret_cast< FreePage* >(
+						_base + page )->next;
+					return page;
+				}
+
+				if( superblock->pages == _capacity )
+				{
+					_grow();
+					superblock = _superblock();
+				}
+
+				return superblock->pages++ * PageSize;
+			}
+
+			void _free( Offset page )
+			{
+				Superblock* superblock = _superblock();
+				reinterpret_cast< FreePage* >( _base + page )->next
+					= superblock->free;
+				superblock->free = page;
+			}
+
+			Offset _allocateLeaf()
+			{
+				Offset page = _allocate();
+				Leaf* leaf = _leafAt( page );
+				leaf->level = 0;
+				leaf->size = 0;
+				leaf->previous = 0;
+				leaf->next = 0;
+				++_superblock()->stats.leafs;
+				return page;
+			}
+
+			Offset _allocateBody( size_type level )
+			{
+				Offset page = _allocate();
+				Body* body = _bodyAt( page );
+				body->level = level;
+				body->size = 0;
+				++_superblock()->stats.bodies;
+				return page;
+			}
+
+			void _freeLeaf( Offset page )
+			{
+				_free( page );
+				--_superblock()->stats.leafs;
+			}
+
+			void _freeBody( Offset page )
+			{
+				_free( page );
+				--_superblock()->stats.bodies;
+			}
+
+		private:
+			template< bool Upper, typename I, typename Tree >
+			static I _bound( Tree* tree, const key_type& key )
+			{
+				Offset node = tree->_superblock()->root;
+
+				if( node == 0 )
+				{
+					return I( tree, 0, 0 );
+				}
+
+				while( !tree->_nodeAt( node )->leaf() )
+				{
+					const Body* body = tree->_bodyAt( node );
+					node = body->children[ Search::upperBound( body->keys,
+						body->size, key, tree->_keyCompare ) ];
+				}
+
+				const Leaf* leaf = tree->_leafAt( node );
+				size_type position = Upper
+					? Search::upperBound( leaf->entries(), leaf->size, key,
+						tree->_keyCompare )
+					: Search::lowerBound( leaf->entries(), leaf->size, key,
+						tree->_keyCompare );
+
+				if( position == leaf->size )
+				{
+					return I( tree, leaf->next, 0 );
+				}
+
+				return I( tree, node, position );
+			}
+
+			/*!
+				\brief Split a full leaf and carry the split up the path
+				\return An iterator to the element that was just inserted
+					at position of the leaf
+			*/
+			iterator _split( const Offset* path, const size_type* positions,
+				size_type depth, Offset node, size_type position )
+			{
+				Offset right = _allocateLeaf();
+
+				Leaf* leaf = _leafAt( node );
+				Leaf* sibling = _leafAt( right );
+
+				size_type median = leaf->size / 2;
+				sibling->move( *leaf, median, leaf->size, 0 );
+				sibling->size = leaf->size - median;
+				leaf->size = median;
+
+				sibling->previous = node;
+				sibling->next = leaf->next;
+				if( leaf->next != 0 )
+				{
+					_leafAt( leaf->next )->previous = right;
+				}
+				else
+				{
+					_superblock()->end = right;
+				}
+				leaf->next = right;
+
+				report( "Split leaf at " << node << " into " << right );
+
+				iterator result = position < median
+					? iterator( this, node, position )
+					: iterator( this, right, position - median );
+
+				key_type key = sibling->key( 0 );
+				Offset child = node;
+
+				for( ; depth > 0; --depth )
+				{
+					Offset parent = path[ depth - 1 ];
+					size_type index = positions[ depth - 1 ];
+					Body* body = _bodyAt( parent );
+
+					std::copy_backward( body->keys + index,
+						body->keys + body->size,
+						body->keys + body->size + 1 );
+					std::copy_backward( body->children + index + 1,
+						body->children + body->size + 1,
+						body->children + body->size + 2 );
+					body->keys[ index ] = key;
+					body->children[ index + 1 ] = right;
+					++body->size;
+
+					if( body->size < MaxNodes )
+					{
+						return result;
+					}
+
+					Offset split = _allocateBody( body->level );
+					body = _bodyAt( parent );
+					Body* half = _bodyAt( split );
+
+					median = body->size / 2;
+					key = body->keys[ median ];
+					std::copy( body->keys + median + 1,
+						body->keys + body->size, half->keys );
+					std::copy( body->children + median + 1,
+						body->children + body->size + 1, half->children );
+					half->size = body->size - median - 1;
+					body->size = median;
+
+					report( "Split body at " << parent << " into " << split );
+
+					child = parent;
+					right = split;
+				}
+
+				Offset root = _allocateBody( _nodeAt( child )->level + 1 );
+				Body* body = _bodyAt( root );
+				body->keys[ 0 ] = key;
+				body->children[ 0 ] = child;
+				body->children[ 1 ] = right;
+				body->size = 1;
+				_superblock()->root = root;
+
+				report( "New root at " << root );
+
+				return result;
+			}
+
+			inline bool _underflow( Offset node ) const
+			{
+				const Node* n = _nodeAt( node );
+				return n->size < ( n->leaf() ? MinLeafs : MinNodes );
+			}
+
+			/*!
+				\brief Merge a child of a body that is too small with a
+					neighbor, or borrow from the neighbor if both do not fit
+					in one node
+			*/
+			void _rebalance( Offset parent, size_type index )
+			{
+				Body* body = _bodyAt( parent );
+				size_type left = index == body->size ? index - 1 : index;
+				Offset first = body->children[ left ];
+				Offset second = body->children[ left + 1 ];
+
+				if( _nodeAt( first )->leaf() )
+				{
+					_rebalanceLeafs( body, left, first, second );
+				}
+				else
+				{
+					_rebalanceBodies( body, left, first, second );
+				}
+			}
+
+			void _rebalanceLeafs( Body* parent, size_type left,
+				Offset first, Offset second )
+			{
+				Leaf* one = _leafAt( first );
+				Leaf* two = _leafAt( second );
+
+				if( one->size + two->size < MaxLeafs )
+				{
+					one->move( *two, 0, two->size, one->size );
+					one->size += two->size;
+
+					one->next = two->next;
+					if( two->next != 0 )
+					{
+						_leafAt( two->next )->previous = first;
+					}
+					else
+					{
+						_superblock()->end = first;
+					}
+
+					_remove( parent, left );
+					_freeLeaf( second );
+
+					report( "Merged leaf at " << second << " into " << first );
+					return;
+				}
+
+				size_type half = ( one->size + two->size ) / 2;
+
+				if( one->size < half )
+				{
+					size_type moved = half - one->size;
+					one->move( *two, 0, moved, one->size );
+					two->move( *two, moved, two->size, 0 );
+					one->size += moved;
+					two->size -= moved;
+				}
+				else
+				{
+					size_type moved = one->size - half;
+					two->moveBackward( *two, 0, two->size,
+						two->size + moved );
+					two->move( *one, half, one->size, 0 );
+					one->size -= moved;
+					two->size += moved;
+				}
+
+				parent->keys[ left ] = two->key( 0 );
+			}
+
+			void _rebalanceBodies( Body* parent, size_type left,
+				Offset first, Offset second )
+			{
+				Body* one = _bodyAt( first );
+				Body* two = _bodyAt( second );
+
+				if( one->size + two->size + 1 < MaxNodes )
+				{
+					one->keys[ one->size ] = parent->keys[ left ];
+					std::copy( two->keys, two->keys + two->size,
+						one->keys + one->size + 1 );
+					std::copy( two->children, two->children + two->size + 1,
+						one->children + one->size + 1 );
+					one->size += two->size + 1;
+
+					_remove( parent, left );
+					_freeBody( second );
+
+					report( "Merged body at " << second << " into " << first );
+					return;
+				}
+
+				size_type half = ( one->size + two->size ) / 2;
+
+				if( one->size < half )
+				{
+					// Rotate the separator down into one and the last key
+					// taken from two up into the parent
+					size_type moved = half - one->size;
+					one->keys[ one->size ] = parent->keys[ left ];
+					std::copy( two->keys, two->keys + moved - 1,
+						one->keys + one->size + 1 );
+					std::copy( two->children, two->children + moved,
+						one->children + one->size + 1 );
+					parent->keys[ left ] = two->keys[ moved - 1 ];
+					std::copy( two->keys + moved, two->keys + two->size,
+						two->keys );
+					std::copy( two->children + moved,
+						two->children + two->size + 1, two->children );
+					one->size += moved;
+					two->size -= moved;
+				}
+				else
+				{
+					size_type moved = one->size - half;
+					std::copy_backward( two->keys, two->keys + two->size,
+						two->keys + two->size + moved );
+					std::copy_backward( two->children,
+						two->children + two->size + 1,
+						two->children + two->size + 1 + moved );
+					two->keys[ moved - 1 ] = parent->keys[ left ];
+					std::copy( one->keys + one->size - moved + 1,
+						one->keys + one->size, two->keys );
+					std::copy( one->children + one->size - moved + 1,
+						one->children + one->size + 1, two->children );
+					parent->keys[ left ] = one->keys[ one->size - moved ];
+					one->size -= moved;
+					two->size += moved;
+				}
+			}
+
+			/*! \brief Remove a key and the child to its right */
+			inline void _remove( Body* body, size_type index )
+			{
+				std::copy( body->keys + index + 1, body->keys + body->size,
+					body->keys + index );
+				std::copy( body->children + index + 2,
+					body->children + body->size + 1,
+					body->children + index + 1 );
+				--body->size;
+			}
+
+			/*! \brief Drop a root that is empty or has a single child */
+			void _shrink()
+			{
+				Superblock* superblock = _superblock();
+				Offset root = superblock->root;
+				const Node* node = _nodeAt( root );
+
+				if( node->size != 0 )
+				{
+					return;
+				}
+
+				if( node->leaf() )
+				{
+					_freeLeaf( root );
+					superblock->root = 0;
+					superblock->begin = 0;
+					superblock->end = 0;
+				}
+				else
+				{
+					superblock->root = _bodyAt( root )->children[ 0 ];
+					_freeBody( root );
+				}
+			}
+
+	};
+
+}
+
+#endif
+
@@ -0,0 +1,123 @@
+/*!
+	\file PipelineThread.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the PipelineThread class
+*/
+
+#ifndef PIPELINE_THREAD_H_INCLUDED
+#define PIPELINE_THREAD_H_INCLUDED
+
+#include <hydrazine/interface/Thread.h>
+#include <hydrazine/interface/Channel.h>
+
+#include <vector>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A Thread that runs one stage of a pipeline of Channels.
+
+		It receives batches from its input, hands each one to process(),
+		and sends what that produces to its output as a single batch, so
+		a stage costs one synchronization on each side per batch and never
+		holds more than one batch while the channels bound the rest.  Once
+		the input is closed and empty the thread closes its output and
+		returns.  Several threads may run the same stage on shared
+		channels, the output should then be made with one sender for
+		each.
+	*/
+	template< typename InputChannel, typename OutputChannel >
+	class PipelineThread : public Thread
+	{
+		public:
+			typedef typename InputChannel::value_type Input;
+			typedef typename OutputChannel::value_type Output;
+			typedef std::vector< Input > InputVector;
+			typedef std::vector< Output > OutputVector;
+
+		public:
+			/*! \brief The largest batch received by default */
+			static const size_t DefaultBatch = 64;
+
+		private:
+			InputChannel* _input;
+			OutputChannel* _output;
+			size_t _batch;
+
+		protected:
+			/*! \brief Handle a batch of inputs, appending any outputs */
+			virtual void process( InputVector& inputs,
+				OutputVector& outputs ) = 0;
+
+		protected:
+			void execute()
+			{
+				assert( _input != 0 );
+
+				InputVector inputs;
+				OutputVector outputs;
+
+				while( true )
+				{
+					inputs.resize( _batch );
+
+					size_t received = _input->receive_batch( &inputs[ 0 ],
+						_batch );
+
+					if( received == 0 )
+					{
+						break;
+					}
+
+					inputs.resize( received );
+					outputs.clear();
+
+					process( inputs, outputs );
+
+					if( _output != 0 && !outputs.empty() )
+					{
+						_output->send_batch( &outputs[ 0 ], outputs.size() );
+					}
+				}
+
+				if( _output != 0 )
+				{
+					_output->close();
+				}
+			}
+
+		public:
+			PipelineThread() : _input( 0 ), _output( 0 ),
+				_batch( DefaultBatch )
+			{
+
+			}
+
+		public:
+			/*! \brief Set the channels of the stage before starting it
+
+				\param input The channel to receive from
+				\param output The channel to send to, 0 for the last stage
+				\param batch The most items to receive at once
+			*/
+			void connect( InputChannel* input, OutputChannel* output,
+				size_t batch = DefaultBatch )
+			{
+				assert( !started() );
+				assert( batch > 0 );
+
+				_input = input;
+				_output = output;
+				_batch = batch;
+			}
+	};
+
+	template< typename InputChannel, typename OutputChannel >
+	const size_t PipelineThread< InputChannel, OutputChannel >::DefaultBatch;
+
+}
+
+#endif
+
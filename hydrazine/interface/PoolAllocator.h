@@ -0,0 +1,181 @@
+/*!
+	\file PoolAllocator.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the PoolAllocator class
+*/
+
+#ifndef POOL_ALLOCATOR_H_INCLUDED
+#define POOL_ALLOCATOR_H_INCLUDED
+
+#include <hydrazine/interface/PagePool.h>
+
+#include <memory>
+#include <new>
+
+namespace hydrazine
+{
+	/*!
+		\brief An allocator that hands out single objects from the slabs
+			of a PagePool.
+
+		Copies and rebinds of an allocator share its pool, a default
+		constructed allocator creates a new one.  Node based containers
+		allocate one object at a time, larger requests go straight to
+		operator new.  Set Synchronized if copies of the allocator are
+		used by more than one thread at a time.
+	*/
+	template< typename T, bool Synchronized = false >
+	class PoolAllocator
+	{
+		template< typename SomeT, bool SomeSynchronized >
+			friend class PoolAllocator;
+
+		public:
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef T value_type;
+			typedef std::shared_ptr< PagePool > PoolPointer;
+
+		public:
+			template< typename NewT >
+			struct rebind
+			{
+				typedef PoolAllocator< NewT, Synchronized > other;
+			};
+
+		private:
+			PoolPointer _pool;
+
+		public:
+			PoolAllocator() : _pool( new PagePool( Synchronized ) ) {}
+			PoolAllocator( const PoolAllocator& a ) throw() :
+				_pool( a._pool ) {}
+
+			template< typename SomeT >
+			PoolAllocator( const PoolAllocator< SomeT, Synchronized >& a )
+				throw() : _pool( a._pool ) {}
+
+			~PoolAllocator() throw() {}
+
+			pointer address( reference r ) { return &r; }
+			const_pointer address( const_reference r ) { return &r; }
+
+			pointer allocate( size_type n, const void* = 0 )
+			{
+				if( n > max_size() )
+				{
+					throw std::bad_alloc();
+				}
+				if( n != 1 )
+				{
+					return static_cast< pointer >(
+						::operator new( n * sizeof( value_type ) ) );
+				}
+				return static_cast< pointer >(
+					_pool->allocate( sizeof( value_type ) ) );
+			}
+
+			void deallocate( pointer p, size_type n )
+			{
+				if( n != 1 )
+				{
+					::operator delete( p );
+				}
+				else
+				{
+					_pool->deallocate( p, sizeof( value_type ) );
+				}
+			}
+
+			size_type max_size() const throw()
+			{
+				return size_type( -1 ) / sizeof( value_type );
+			}
+
+			void construct( pointer p, const_reference val )
+			{
+				::new(p) value_type( val );
+			}
+
+			void destroy( pointer p )
+			{
+				p->~value_type();
+			}
+
+		public:
+			/*! \brief Are count objects all that is allocated from the
+				size class of T? */
+			bool owns( size_type count ) const
+			{
+				return _pool->live( sizeof( value_type ) ) == count;
+			}
+
+			/*! \brief Free every object of the size class of T at once,
+				without running destructors */
+			void release()
+			{
+				_pool->release( sizeof( value_type ) );
+			}
+
+			/*! \brief The pool shared by copies of this allocator */
+			const PoolPointer& pool() const
+			{
+				return _pool;
+			}
+	};
+
+	template< typename T, bool S >
+	inline bool operator==( const PoolAllocator< T, S >& one,
+		const PoolAllocator< T, S >& two )
+	{
+		return one.pool() == two.pool();
+	}
+
+	template< typename T, bool S >
+	inline bool operator!=( const PoolAllocator< T, S >& one,
+		const PoolAllocator< T, S >& two )
+	{
+		return one.pool() != two.pool();
+	}
+
+	/*!
+		\brief Can every object of an allocator be dropped at once?
+
+		True only if the allocator can release its objects in bulk and
+		count objects are all that it has handed out.
+	*/
+	template< typename Allocator >
+	inline bool ownsAll( const Allocator&, size_t )
+	{
+		return false;
+	}
+
+	template< typename T, bool S >
+	inline bool ownsAll( const PoolAllocator< T, S >& allocator,
+		size_t count )
+	{
+		return allocator.owns( count );
+	}
+
+	/*! \brief Drop every object of an allocator, see ownsAll() */
+	template< typename Allocator >
+	inline void releaseAll( Allocator& )
+	{
+
+	}
+
+	template< typename T, bool S >
+	inline void releaseAll( PoolAllocator< T, S >& allocator )
+	{
+		allocator.release();
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,124 @@
+/*!
+	\file SharedAllocator.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the SharedAllocator class
+*/
+
+#ifndef SHARED_ALLOCATOR_H_INCLUDED
+#define SHARED_ALLOCATOR_H_INCLUDED
+
+#include <hydrazine/interface/SharedSegment.h>
+
+#include <new>
+
+namespace hydrazine
+{
+	/*!
+		\brief An allocator that draws from a SharedSegment, a shared
+			mapping of a file.
+
+		Containers built with it keep all of their nodes in the segment.
+		Construct the container itself in the segment too, with
+		SharedSegment::allocate and placement new, and record its offset
+		in a root slot, and another process that attaches to the segment
+		at the same address can read it.  The allocator refers to the
+		segment object of the process that made it, so only that process
+		may modify the container.
+	*/
+	template< typename T >
+	class SharedAllocator
+	{
+		template< typename SomeT > friend class SharedAllocator;
+
+		public:
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef T value_type;
+
+		public:
+			template< typename NewT >
+			struct rebind
+			{
+				typedef SharedAllocator< NewT > other;
+			};
+
+		private:
+			SharedSegment* _segment;
+
+		public:
+			explicit SharedAllocator( SharedSegment& segment ) throw() :
+				_segment( &segment ) {}
+			SharedAllocator( const SharedAllocator& a ) throw() :
+				_segment( a._segment ) {}
+
+			template< typename SomeT >
+			SharedAllocator( const SharedAllocator< SomeT >& a ) throw() :
+				_segment( a._segment ) {}
+
+			~SharedAllocator() throw() {}
+
+			pointer address( reference r ) { return &r; }
+			const_pointer address( const_reference r ) { return &r; }
+
+			pointer allocate( size_type n, const void* = 0 )
+			{
+				if( n > max_size() )
+				{
+					throw std::bad_alloc();
+				}
+				return static_cast< pointer >(
+					_segment->allocate( n * sizeof( value_type ) ) );
+			}
+
+			void deallocate( pointer p, size_type s )
+			{
+				_segment->deallocate( p, s * sizeof( value_type ) );
+			}
+
+			size_type max_size() const throw()
+			{
+				return size_type( -1 ) / sizeof( value_type );
+			}
+
+			void construct( pointer p, const_reference val )
+			{
+				::new(p) value_type( val );
+			}
+
+			void destroy( pointer p )
+			{
+				p->~value_type();
+			}
+
+		public:
+			/*! \brief The segment that this allocator draws from */
+			SharedSegment& segment() const
+			{
+				return *_segment;
+			}
+
+	};
+
+	template< typename T >
+	inline bool operator==( const SharedAllocator< T >& one,
+		const SharedAllocator< T >& two )
+	{
+		return &one.segment() == &two.segment();
+	}
+
+	template< typename T >
+	inline bool operator!=( const SharedAllocator< T >& one,
+		const SharedAllocator< T >& two )
+	{
+		return !( one == two );
+	}
+
+}
+
+#endif
+
@@ -0,0 +1,144 @@
+/*!
+	\file SharedSegment.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the SharedSegment class
+*/
+
+#ifndef SHARED_SEGMENT_H_INCLUDED
+#define SHARED_SEGMENT_H_INCLUDED
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A heap in a shared mapping of a named file or an anonymous
+			memory file, that several processes can map at once.
+
+		The segment starts with a header holding the allocator state and
+		a few root slots, so everything about the heap lives in the file
+		and any process that maps it sees the same blocks.  Blocks come
+		in power of two size classes, freed blocks are kept on a list per
+		class, and the file grows on demand by doubling.
+
+		A segment reserves capacity bytes of address space up front and
+		grows the file in place inside the reservation, so blocks never
+		move.  The header records the address the segment was created at
+		and a process that attaches asks for the same one.  When it gets
+		it, containers that hold raw pointers, like BTree, can be read
+		from every process.  When it does not, relocated() is true and
+		only offsets, or OffsetPointers, are meaningful.
+
+		Allocating and freeing are not synchronized, one process should
+		modify a segment while others read it.  Modifications reach the
+		file as the kernel writes back the mapping, flush() waits until
+		they are on disk.
+	*/
+	class SharedSegment
+	{
+		public:
+			/*! \brief A position in the segment, Null is never a block */
+			typedef uint64_t Offset;
+
+			static const Offset Null = 0;
+			/*! \brief The number of root slots */
+			static const unsigned int Roots = 8;
+			/*! \brief Blocks are aligned to this */
+			static const size_t Alignment = 16;
+			/*! \brief Size classes are powers of two up to 2^Classes */
+			static const unsigned int Classes = 48;
+
+		private:
+			class Header
+			{
+				public:
+					uint64_t magic;
+					uint64_t version;
+					/*! \brief Where the segment was first mapped */
+					uint64_t base;
+					/*! \brief The bytes in the file */
+					Offset size;
+					/*! \brief The end of the blocks ever handed out */
+					Offset top;
+					/*! \brief Freed blocks by size class */
+					Offset free[ Classes ];
+					Offset roots[ Roots ];
+			};
+
+		private:
+			std::string _path;
+			int _file;
+			char* _base;
+			/*! \brief The bytes of the file this process has mapped */
+			size_t _mapped;
+			size_t _capacity;
+			bool _relocated;
+
+		private:
+			SharedSegment( const SharedSegment& );
+			SharedSegment& operator=( const SharedSegment& );
+
+		private:
+			void _fail( const std::string& message ) const;
+			void _invalid( const std::string& message ) const;
+			void _attach( size_t bytes );
+			void _close();
+			void _grow( Offset bytes );
+			Header& _header() const;
+			static unsigned int _classOf( size_t bytes );
+
+		public:
+			/*! \brief Open a named file, or create it with room for bytes,
+				and reserve capacity bytes of address space for it */
+			explicit SharedSegment( const std::string& path,
+				size_t bytes = 1 << 20, size_t capacity = size_t( 1 ) << 34 );
+			/*! \brief Create an anonymous memory file that is shared with
+				children and with processes that open descriptorPath() */
+			explicit SharedSegment( size_t bytes = 1 << 20,
+				size_t capacity = size_t( 1 ) << 34 );
+			/*! \brief Unmap the segment, the file stays */
+			~SharedSegment();
+
+		public:
+			/*! \brief Get a block of at least bytes, grow the file if
+				there is no room */
+			void* allocate( size_t bytes );
+			/*! \brief Return a block of bytes */
+			void deallocate( void* block, size_t bytes );
+			/*! \brief Wait until the segment is on disk */
+			void flush();
+			/*! \brief Map growth made by another process */
+			void remap();
+
+		public:
+			/*! \brief The offset of an address in the segment */
+			Offset offset( const void* address ) const;
+			/*! \brief The address of an offset in the segment */
+			void* address( Offset offset ) const;
+			/*! \brief A root slot, use it to find data after attaching */
+			Offset& root( unsigned int index );
+
+		public:
+			/*! \brief The start of the mapping */
+			void* base() const;
+			/*! \brief The bytes in the file */
+			size_t size() const;
+			/*! \brief The bytes that blocks were ever carved out of */
+			size_t used() const;
+			/*! \brief Was it mapped somewhere other than where it was
+				created? */
+			bool relocated() const;
+			/*! \brief The name of the file */
+			const std::string& path() const;
+			/*! \brief A path that other processes can open the file at */
+			std::string descriptorPath() const;
+	};
+
+}
+
+#endif
+
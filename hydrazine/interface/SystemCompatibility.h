@@ -25,6 +25,13 @@ namespace hydrazine
 	std::string getExecutablePath(const std::string& executableName);
 	/*! \brief The the amount of free physical memory */
 	long long unsigned int getFreePhysicalMemory();
+	/*! \brief Get the size of a data cache line in bytes, 0 if unknown */
+	unsigned int getCacheLineSize();
+	/*! \brief Get the size of the level 1, 2, or 3 data cache in bytes,
+		0 if unknown */
+	long long unsigned int getDataCacheSize(unsigned int level);
+	/*! \brief Get a BTree PageSize in bytes that suits the data caches */
+	unsigned int getBTreePageSize();
 	/*! \brief Has there been an OpenGL context bound to this process */
 	bool isAnOpenGLContextAvailable();
 	/*! \brief Is a string name mangled? */
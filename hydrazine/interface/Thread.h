@@ -9,8 +9,11 @@
 
 #include <boost/thread.hpp>
 #include <hydrazine/interface/SystemCompatibility.h>
+#include <hydrazine/interface/Barrier.h>
 
-#include <list>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
 #include <cassert>
 
 #define THREAD_CONTROLLER_ID 0
@@ -82,21 +85,127 @@ namespace hydrazine
 					Type type;
 			};
 	
+			/*! \brief The messages sent to one thread, or to the controller
+
+				Senders push into a small ring without taking a lock,
+				claiming a cell with a compare and swap.  The receiver
+				moves messages out of the ring into a mailbox for each
+				source, so receiving from a specific source or from any
+				source never scans messages from other sources.  Mailboxes
+				are lists threaded through a pool of slots.  A mailbox is
+				created by the first message from its source and kept
+				after it empties, so there is one for each thread that
+				ever sent to the queue.
+
+				Sends never wait for the receiver.  When the ring is full,
+				because the receiver is not receiving, senders append to
+				an overflow list under a lock that the receiver only holds
+				to swap the list out, after it has emptied the ring.
+				Senders keep spilling until it does, so the messages from
+				each source stay in order.
+
+				Nothing is allocated for a message unless more of them are
+				waiting than ever before.  The ring is allocated once, and
+				the slots and the overflow lists keep what they grew to, so
+				the pools only grow with the largest backlog.
+
+				Only the receiver is ever woken, and only when it is
+				asleep waiting for a message.
+			*/
 			class Queue
 			{
 				private:
 					friend class Group;
-			
+
+				public:
+					/*! \brief The number of messages in flight in the ring,
+						a power of two */
+					static const size_t Capacity = 64;
+
 				private:
-					typedef std::list< Message > MessageQueue;
-				
+					static const size_t Nil = ~size_t( 0 );
+
+					/*! \brief A cell of the ring, the sequence says whether
+						it is free or full for a position */
+					class Cell
+					{
+						public:
+							std::atomic< size_t > sequence;
+							Message message;
+					};
+
+					class Mailbox
+					{
+						public:
+							size_t head;
+							size_t tail;
+
+						public:
+							Mailbox();
+					};
+
+					/*! \brief A received message, linked into the list of
+						its source and the list of all messages by age */
+					class Slot
+					{
+						public:
+							Message message;
+							Mailbox* mailbox;
+							/*! \brief The next message from the source */
+							size_t next;
+							size_t older;
+							size_t newer;
+					};
+
+					typedef std::vector< Slot > SlotVector;
+					typedef std::vector< Message > MessageVector;
+					typedef std::unordered_map< Id, Mailbox > MailboxMap;
+
+				private:
+					Cell* _ring;
+					/*! \brief The next position to send to */
+					std::atomic< size_t > _enqueue;
+					/*! \brief The next position to receive from */
+					size_t _dequeue;
+
+				private:
+					/*! \brief Held by senders while they spill */
+					boost::mutex _overflowMutex;
+					/*! \brief Messages sent while the ring was full, in
+						order */
+					MessageVector _overflow;
+					/*! \brief Is anything in the overflow list? */
+					std::atomic< bool > _spilled;
+
+				private:
+					/*! \brief Held by the receiver */
+					boost::mutex _receiver;
+					/*! \brief The overflow list that was swapped out */
+					MessageVector _spills;
+					SlotVector _slots;
+					size_t _free;
+					size_t _oldest;
+					size_t _newest;
+					MailboxMap _mailboxes;
+
 				private:
+					std::atomic< bool > _sleeping;
 					boost::condition_variable _condition;
 					boost::mutex _mutex;
-			
+
 				private:
-					MessageQueue _queue;
-			
+					bool _ready() const;
+					void _drain();
+					void _spill( const Message& );
+					void _store( const Message& );
+					size_t _find( Id ) const;
+					Message _take( size_t );
+					void _sleep();
+
+				private:
+					Queue( const Queue& );
+					Queue& operator=( const Queue& );
+
 				public:
 					Queue();
 					~Queue();
@@ -110,7 +219,7 @@ namespace hydrazine
 			class Group
 			{
 				private:
-					boost::mutex _mutex;
+					mutable boost::mutex _mutex;
 			
 				public:
 					typedef std::unordered_map< Id, Thread* > ThreadMap;
@@ -118,6 +227,7 @@ namespace hydrazine
 				private:
 					ThreadMap _threads;
 					Queue _controllerQueue;
+					Barrier _barrier;
 				
 				public:
 					Group();
@@ -130,6 +240,8 @@ namespace hydrazine
 					void push( const Message& );
 					Message pull( Id );
 					bool test( Id&, bool );
+					
+					void barrier( Thread* );
 			
 					bool empty() const;
 					unsigned int size() const;
@@ -171,6 +283,9 @@ namespace hydrazine
 
 			/*! \brief The thread id */
 			Id _id;
+
+			/*! \brief This thread's place in the barrier of its group */
+			Barrier::Member* _member;
 			
 		protected:
 		
@@ -217,7 +332,13 @@ namespace hydrazine
 				Id id = THREAD_CONTROLLER_ID );
 			
 			/*! \brief All associated threads will block here until all other 
-					threads have hit the barrier */
+					threads have hit the barrier
+				
+				A thread that is associated with the group while others are
+				waiting takes part from the next barrier.  A thread that is
+				removed from the group while others are waiting counts as
+				having hit it.
+			*/
 			void barrier();					
 			
 		public:
@@ -0,0 +1,373 @@
+/*!
+	\file ThreadPool.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the ThreadPool class
+*/
+
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <hydrazine/interface/Thread.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <exception>
+#include <type_traits>
+#include <new>
+#include <cstdint>
+
+namespace hydrazine
+{
+
+	/*!
+		\brief A fixed set of worker threads that run submitted functions.
+
+		Every worker owns a Chase-Lev deque.  Functions submitted by a
+		worker, from inside another function, go on the bottom of its own
+		deque, and it takes work from the bottom, so nested work runs
+		depth first in the cache of the worker that made it.  A worker that
+		runs out takes from the top of a random victim's deque, the oldest
+		and usually largest piece of work there.  Functions submitted by
+		any other thread, including Threads that run execute() and pass
+		messages, go on a shared queue that every worker checks.
+
+		Submitting returns a Future.  The function and its result share a
+		single allocation that the Future refers to.  Waiting on a Future
+		runs other work from the pool until the result is ready, so
+		functions may wait on the work that they submit.
+
+		Idle workers sleep, and a submission only takes a lock when some
+		worker is asleep.
+	*/
+	class ThreadPool
+	{
+		private:
+			/*! \brief A submitted function and the state of its result */
+			class Task
+			{
+				public:
+					ThreadPool* pool;
+					/*! \brief The Future and the pool each hold one */
+					std::atomic< unsigned int > references;
+					std::atomic< bool > done;
+					/*! \brief Is a thread blocked until this is done */
+					std::atomic< bool > waiting;
+					std::exception_ptr exception;
+
+				public:
+					Task( ThreadPool* p );
+					virtual ~Task();
+
+				public:
+					/*! \brief Run the function, catching what it throws */
+					virtual void run() = 0;
+			};
+
+			/*! \brief The result of a function */
+			template< typename R >
+			class Result : public Task
+			{
+				private:
+					typename std::aligned_storage< sizeof( R ),
+						std::alignment_of< R >::value >::type _storage;
+
+				public:
+					Result( ThreadPool* p ) : Task( p ) {}
+
+					~Result()
+					{
+						if( done.load( std::memory_order_relaxed )
+							&& !exception )
+						{
+							value().~R();
+						}
+					}
+
+				public:
+					template< typename Function >
+					void compute( Function& function )
+					{
+						::new( &_storage ) R( function() );
+					}
+
+					R& value()
+					{
+						return *reinterpret_cast< R* >( &_storage );
+					}
+			};
+
+			template< typename Function, typename R >
+			class Closure : public Result< R >
+			{
+				private:
+					Function _function;
+
+				public:
+					Closure( ThreadPool* p, const Function& f ) :
+						Result< R >( p ), _function( f ) {}
+
+				public:
+					void run()
+					{
+						try
+						{
+							this->compute( _function );
+						}
+						catch( ... )
+						{
+							this->exception = std::current_exception();
+						}
+					}
+			};
+
+			/*! \brief A growable ring of tasks, replaced when full */
+			class Array
+			{
+				public:
+					const int64_t mask;
+					std::atomic< Task* >* tasks;
+
+				public:
+					explicit Array( int64_t size );
+					~Array();
+
+				public:
+					Task* get( int64_t index ) const;
+					void put( int64_t index, Task* task );
+			};
+
+			/*!
+				\brief A Chase-Lev work stealing deque.
+
+				The owner pushes and takes at the bottom, any other thread
+				steals from the top.  Arrays that were outgrown are kept
+				until the deque is destroyed, since a thief may still be
+				reading one.
+			*/
+			class Deque
+			{
+				private:
+					std::atomic< int64_t > _top;
+					std::atomic< int64_t > _bottom;
+					std::atomic< Array* > _array;
+					std::vector< Array* > _retired;
+
+				private:
+					Array* _grow( Array* array, int64_t bottom, int64_t top );
+
+				public:
+					Deque();
+					~Deque();
+
+				public:
+					void push( Task* task );
+					Task* take();
+					Task* steal();
+					bool empty() const;
+			};
+
+			class Worker : public Thread
+			{
+				public:
+					ThreadPool* pool;
+					Deque deque;
+					/*! \brief The state for picking victims */
+					unsigned int seed;
+
+				protected:
+					void execute();
+			};
+
+			typedef std::vector< Worker* > WorkerVector;
+			typedef std::deque< Task* > TaskQueue;
+
+		public:
+			/*! \brief A handle to the result of a submitted function */
+			template< typename R >
+			class Future
+			{
+				friend class ThreadPool;
+
+				public:
+					typedef typename std::add_lvalue_reference< R >::type
+						Reference;
+
+				private:
+					Result< R >* _task;
+
+				private:
+					explicit Future( Result< R >* task ) : _task( task )
+					{
+						_task->references.fetch_add( 1,
+							std::memory_order_relaxed );
+					}
+
+				public:
+					Future() : _task( 0 ) {}
+
+					Future( const Future& f ) : _task( f._task )
+					{
+						if( _task != 0 )
+						{
+							_task->references.fetch_add( 1,
+								std::memory_order_relaxed );
+						}
+					}
+
+					~Future()
+					{
+						if( _task != 0 )
+						{
+							ThreadPool::_release( _task );
+						}
+					}
+
+					Future& operator=( const Future& f )
+					{
+						Future copy( f );
+						std::swap( _task, copy._task );
+						return *this;
+					}
+
+				public:
+					/*! \brief Is this a handle to a submitted function */
+					bool valid() const
+					{
+						return _task != 0;
+					}
+
+					/*! \brief Has the function returned */
+					bool ready() const
+					{
+						return _task->done.load( std::memory_order_acquire );
+					}
+
+					/*! \brief Run other work until the function returns */
+					void wait() const
+					{
+						_task->pool->_wait( _task );
+					}
+
+					/*! \brief Wait and return the result, or rethrow what
+						the function threw */
+					Reference get() const
+					{
+						wait();
+
+						if( _task->exception )
+						{
+							std::rethrow_exception( _task->exception );
+						}
+
+						return _task->value();
+					}
+			};
+
+		public:
+			/*! \brief Rounds of looking for work before sleeping */
+			static const unsigned int Spins = 64;
+
+		private:
+			static thread_local Worker* _current;
+
+		private:
+			WorkerVector _workers;
+			/*! \brief Work submitted by threads outside of the pool */
+			TaskQueue _submitted;
+			boost::mutex _submittedMutex;
+			std::atomic< bool > _hasSubmitted;
+
+		private:
+			std::atomic< unsigned int > _sleeping;
+			std::atomic< bool > _stopping;
+			boost::mutex _mutex;
+			/*! \brief Idle workers sleep here */
+			boost::condition_variable _idle;
+			/*! \brief Threads waiting on a Future sleep here */
+			boost::condition_variable _finished;
+
+		private:
+			static void _release( Task* task );
+
+		private:
+			void _push( Task* task );
+			Task* _find( Worker* worker );
+			void _run( Task* task );
+			void _wait( Task* task );
+			bool _sleep( Worker* worker );
+
+		private:
+			ThreadPool( const ThreadPool& );
+			ThreadPool& operator=( const ThreadPool& );
+
+		public:
+			/*! \brief Start the workers, one per hardware thread if 0 */
+			explicit ThreadPool( unsigned int threads = 0 );
+			/*! \brief Run everything that was submitted, then stop */
+			~ThreadPool();
+
+		public:
+			/*! \brief Run a function, or any object that can be called
+				with no arguments, on the pool */
+			template< typename Function >
+			Future< typename std::result_of< Function() >::type >
+				submit( Function function )
+			{
+				typedef typename std::result_of< Function() >::type R;
+
+				Closure< Function, R >* task =
+					new Closure< Function, R >( this, function );
+				Future< R > future( task );
+
+				_push( task );
+
+				return future;
+			}
+
+		public:
+			/*! \brief The number of workers */
+			unsigned int size() const;
+			/*! \brief Is the calling thread a worker of this pool */
+			bool inPool() const;
+	};
+
+	/*! \brief Functions that return nothing only record that they ran */
+	template<>
+	class ThreadPool::Result< void > : public ThreadPool::Task
+	{
+		public:
+			Result( ThreadPool* p ) : Task( p ) {}
+
+		public:
+			template< typename Function >
+			void compute( Function& function )
+			{
+				function();
+			}
+
+			void value()
+			{
+
+			}
+	};
+
+	template<>
+	inline void ThreadPool::Future< void >::get() const
+	{
+		wait();
+
+		if( _task->exception )
+		{
+			std::rethrow_exception( _task->exception );
+		}
+	}
+
+}
+
+#endif
+
@@ -8,9 +8,41 @@
 #define VALUE_COMPARE_H_INCLUDED
 
 #include <functional>
+#include <type_traits>
 
 namespace hydrazine
 {
+	/*!
+		\brief Does Compare define is_transparent, so that it can compare
+			keys against other types?  K is only there to make the test
+			depend on the type of a lookup.
+	*/
+	template< typename Compare, typename K = void >
+	class IsTransparent
+	{
+		private:
+			template< typename C >
+			static char _test( typename C::is_transparent* );
+			template< typename C >
+			static long _test( ... );
+
+		public:
+			static const bool value = sizeof( _test< Compare >( 0 ) ) == 1;
+	};
+
+	/*! \brief Passes is_transparent on from Compare, if it has it */
+	template< typename Compare, bool = IsTransparent< Compare >::value >
+	class Transparent
+	{
+	};
+
+	template< typename Compare >
+	class Transparent< Compare, true >
+	{
+		public:
+			typedef typename Compare::is_transparent is_transparent;
+	};
+
 	/*!
 		\brief A class for comparing key/value pairs based on the key only
 	*/
@@ -21,7 +53,8 @@ namespace hydrazine
 		public std::binary_function< typename Container::value_type, 
 			typename Container::key_type, bool >, 
 		public std::binary_function< typename Container::key_type, 
-			typename Container::value_type, bool >
+			typename Container::value_type, bool >,
+		public Transparent< Compare >
 	{
 		public:
 			typedef size_t size_type;
@@ -62,6 +95,21 @@ namespace hydrazine
 			{
 				return _compare( x.first, y );
 			}
+
+			/*! \brief Any key-like type, if Compare is transparent */
+			template< typename K >
+			typename std::enable_if< IsTransparent< Compare, K >::value,
+				bool >::type operator()( const K& x, const_reference y ) const
+			{
+				return _compare( x, y.first );
+			}
+
+			template< typename K >
+			typename std::enable_if< IsTransparent< Compare, K >::value,
+				bool >::type operator()( const_reference x, const K& y ) const
+			{
+				return _compare( x.first, y );
+			}
 	};
 
 }
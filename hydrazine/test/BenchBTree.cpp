@@ -0,0 +1,285 @@
+/*!
+	\file BenchBTree.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the BenchBTree class.
+*/
+
+#ifndef BENCH_B_TREE_CPP_INCLUDED
+#define BENCH_B_TREE_CPP_INCLUDED
+
+#include <hydrazine/test/BenchBTree.h>
+#include <hydrazine/implementation/BTree.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <hydrazine/interface/SystemCompatibility.h>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+namespace test
+{
+
+	long long unsigned int ByteCounter::bytes = 0;
+
+	/*! \brief The largest page size to sweep */
+	static const size_t MaxPageSize = 8192;
+
+	template< typename Container, typename Key, typename Value >
+	bool BenchBTree::_run( const std::vector< Key >& keys,
+		const IndexVector& order, const IndexVector& finds, Result& result )
+	{
+		long long unsigned int before = ByteCounter::bytes;
+		Container container;
+		hydrazine::Timer timer;
+
+		timer.start();
+		for( IndexVector::const_iterator index = order.begin();
+			index != order.end(); ++index )
+		{
+			container.insert( std::make_pair( keys[ *index ], Value() ) );
+		}
+		timer.stop();
+
+		result.insert = timer.seconds() * 1.0e9 / order.size();
+		result.bytes = double( ByteCounter::bytes - before ) / keys.size();
+
+		unsigned int found = 0;
+
+		timer.start();
+		for( IndexVector::const_iterator index = finds.begin();
+			index != finds.end(); ++index )
+		{
+			found += container.find( keys[ *index ] ) != container.end();
+		}
+		timer.stop();
+
+		result.find = timer.seconds() * 1.0e9 / finds.size();
+
+		if( found != finds.size() )
+		{
+			status << " Only found " << found << " of " << finds.size()
+				<< " keys.\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	template< typename Key, typename Value, size_t PageSize >
+	bool BenchBTree::_sweepPages( const std::vector< Key >& keys,
+		const IndexVector& order, const IndexVector& finds, size_t& best,
+		double& fastest, std::true_type )
+	{
+		typedef hydrazine::BTree< Key, Value, std::less< Key >,
+			BenchAllocator< std::pair< const Key, Value > >,
+			PageSize > Tree;
+
+		Result result;
+		if( !_run< Tree, Key, Value >( keys, order, finds, result ) )
+		{
+			return false;
+		}
+
+		std::stringstream name;
+		name << "BTree " << PageSize;
+		_report( name.str(), result );
+
+		if( best == 0 || result.find < fastest )
+		{
+			best = PageSize;
+			fastest = result.find;
+		}
+
+		return _sweepPages< Key, Value, 2 * PageSize >( keys, order, finds,
+			best, fastest, std::integral_constant< bool,
+			2 * PageSize <= MaxPageSize >() );
+	}
+
+	template< typename Key, typename Value, size_t PageSize >
+	bool BenchBTree::_sweepPages( const std::vector< Key >&,
+		const IndexVector&, const IndexVector&, size_t&, double&,
+		std::false_type )
+	{
+		return true;
+	}
+
+	template< typename Key, typename Value >
+	bool BenchBTree::_sweep( const std::string& name )
+	{
+		typedef std::pair< const Key, Value > Pair;
+		typedef std::map< Key, Value, std::less< Key >,
+			BenchAllocator< Pair > > Map;
+		typedef std::unordered_map< Key, Value, std::hash< Key >,
+			std::equal_to< Key >, BenchAllocator< Pair > > HashMap;
+
+		// Multiplying by an odd constant is a bijection, so the keys are
+		//  distinct but not in the order of their indices
+		std::vector< Key > keys( elements );
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			keys[ i ] = Key( i ) * Key( 0x9e3779b97f4a7c15ULL );
+		}
+		std::sort( keys.begin(), keys.end() );
+
+		const char* patterns[] = { "sequential", "random", "zipf" };
+
+		for( unsigned int pattern = Sequential; pattern <= Zipf;
+			++pattern )
+		{
+			status << " " << name << ", " << patterns[ pattern ] << ":\n";
+
+			IndexVector order;
+			IndexVector finds;
+			_order( ( Pattern ) pattern, order, finds );
+
+			size_t best = 0;
+			double fastest = 0.0;
+			if( !_sweepPages< Key, Value, 256 >( keys, order, finds, best,
+				fastest, std::true_type() ) )
+			{
+				return false;
+			}
+
+			Result result;
+			if( !_run< Map, Key, Value >( keys, order, finds, result ) )
+			{
+				return false;
+			}
+			_report( "std::map", result );
+
+			if( !_run< HashMap, Key, Value >( keys, order, finds, result ) )
+			{
+				return false;
+			}
+			_report( "std::unordered_map", result );
+
+			status << "  fastest finds with a " << best
+				<< " byte page\n";
+		}
+
+		return true;
+	}
+
+	void BenchBTree::_report( const std::string& name, const Result& result )
+	{
+		status << "  " << name << ": insert " << result.insert
+			<< " ns/op, find " << result.find << " ns/op, "
+			<< result.bytes << " bytes/element\n";
+	}
+
+	void BenchBTree::_order( Pattern pattern, IndexVector& order,
+		IndexVector& finds )
+	{
+		order.resize( elements );
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			order[ i ] = i;
+		}
+
+		finds.resize( lookups );
+
+		if( pattern == Sequential )
+		{
+			for( unsigned int i = 0; i < lookups; ++i )
+			{
+				finds[ i ] = i % elements;
+			}
+			return;
+		}
+
+		for( unsigned int i = elements; i > 1; --i )
+		{
+			std::swap( order[ i - 1 ], order[ random() % i ] );
+		}
+
+		if( pattern == Random )
+		{
+			for( unsigned int i = 0; i < lookups; ++i )
+			{
+				finds[ i ] = random() % elements;
+			}
+			return;
+		}
+
+		// Rank r is drawn with weight 1/(r+1)^skew, and the ranks are
+		//  scattered over the keys by the insert order
+		std::vector< double > cdf( elements );
+		double total = 0.0;
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			total += 1.0 / std::pow( i + 1.0, skew );
+			cdf[ i ] = total;
+		}
+
+		for( unsigned int i = 0; i < lookups; ++i )
+		{
+			double draw = total * ( random() / 4294967296.0 );
+			unsigned int rank = std::upper_bound( cdf.begin(), cdf.end(),
+				draw ) - cdf.begin();
+			finds[ i ] = order[ std::min( rank, elements - 1 ) ];
+		}
+	}
+
+	bool BenchBTree::doTest()
+	{
+		if( elements == 0 || lookups == 0 )
+		{
+			return true;
+		}
+
+		status << "The data caches have " << hydrazine::getCacheLineSize()
+			<< " byte lines, L1 is " << hydrazine::getDataCacheSize( 1 )
+			<< " bytes, and L2 is " << hydrazine::getDataCacheSize( 2 )
+			<< " bytes, getBTreePageSize picks "
+			<< hydrazine::getBTreePageSize() << " bytes\n";
+
+		return _sweep< unsigned int, unsigned int >(
+			"4 byte keys, 4 byte values" )
+			&& _sweep< long long unsigned int, long long unsigned int >(
+			"8 byte keys, 8 byte values" )
+			&& _sweep< long long unsigned int, Payload< 64 > >(
+			"8 byte keys, 64 byte values" );
+	}
+
+	BenchBTree::BenchBTree()
+	{
+		name = "BenchBTree";
+		description = "A benchmark that sweeps the PageSize of BTree. ";
+		description += "Test Points: 1) Insert and find keys of several ";
+		description += "sizes in sequential, random, and Zipf order in ";
+		description += "BTrees with page sizes from 256 to 8192 bytes, a ";
+		description += "std::map, and a std::unordered_map.  Report ns/op ";
+		description += "and bytes/element, the fastest page size, and the ";
+		description += "page size picked from the cache sizes of this ";
+		description += "machine.  Assert that every find succeeds.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::BenchBTree test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys to insert into each container." );
+	parser.parse( "-l", "--lookups", test.lookups, 1000000,
+		"The number of finds to time in each container." );
+	parser.parse( "-z", "--skew", test.skew, 0.99,
+		"The exponent of the Zipf distribution of finds." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
@@ -0,0 +1,147 @@
+/*!
+	\file BenchBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the BenchBTree class.
+*/
+
+#ifndef BENCH_B_TREE_H_INCLUDED
+#define BENCH_B_TREE_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <memory>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <type_traits>
+
+namespace test
+{
+
+	/*! \brief The bytes held by every BenchAllocator */
+	class ByteCounter
+	{
+		public:
+			static long long unsigned int bytes;
+	};
+
+	/*! \brief An allocator that keeps track of the bytes it holds */
+	template< typename T >
+	class BenchAllocator : public std::allocator< T >, public ByteCounter
+	{
+		public:
+			template< typename NewT >
+			struct rebind
+			{
+				typedef BenchAllocator< NewT > other;
+			};
+
+		public:
+			BenchAllocator() {}
+
+			template< typename SomeT >
+			BenchAllocator( const BenchAllocator< SomeT >& ) {}
+
+			T* allocate( size_t n, const void* = 0 )
+			{
+				bytes += n * sizeof( T );
+				return std::allocator< T >::allocate( n );
+			}
+
+			void deallocate( T* pointer, size_t n )
+			{
+				bytes -= n * sizeof( T );
+				std::allocator< T >::deallocate( pointer, n );
+			}
+	};
+
+	/*! \brief A value that is larger than a machine word */
+	template< unsigned int Bytes >
+	class Payload
+	{
+		public:
+			char data[ Bytes ];
+	};
+
+	/*! \brief BTree reports the values it finds */
+	template< unsigned int Bytes >
+	std::ostream& operator<<( std::ostream& out, const Payload< Bytes >& )
+	{
+		return out << Bytes << " byte payload";
+	}
+
+	/*!
+		\brief A benchmark that sweeps the PageSize of BTree.
+
+		Test Points:
+
+			1) For 4 byte keys and values, 8 byte keys and values, and 8
+				byte keys with 64 byte values, insert keys into BTrees with
+				page sizes from 256 to 8192 bytes, a std::map, and a
+				std::unordered_map, then find them again.  Insert and find
+				in sequential order, random order, and with finds drawn
+				from a Zipf distribution over the keys.  Report ns/op for
+				inserts and finds and the bytes held per element, along
+				with the fastest page size for finds and the page size
+				that getBTreePageSize picks for this machine.  Assert that
+				every find succeeds.
+	*/
+	class BenchBTree : public Test
+	{
+		public:
+			/*! \brief The order keys are inserted and found in */
+			enum Pattern
+			{
+				Sequential,
+				Random,
+				Zipf
+			};
+
+			/*! \brief The results of a single run */
+			class Result
+			{
+				public:
+					double insert;
+					double find;
+					double bytes;
+			};
+
+			typedef std::vector< unsigned int > IndexVector;
+
+		private:
+			template< typename Key, typename Value >
+			bool _sweep( const std::string& name );
+			template< typename Key, typename Value, size_t PageSize >
+			bool _sweepPages( const std::vector< Key >& keys,
+				const IndexVector& order, const IndexVector& lookups,
+				size_t& best, double& fastest, std::true_type );
+			template< typename Key, typename Value, size_t PageSize >
+			bool _sweepPages( const std::vector< Key >& keys,
+				const IndexVector& order, const IndexVector& lookups,
+				size_t& best, double& fastest, std::false_type );
+			template< typename Container, typename Key, typename Value >
+			bool _run( const std::vector< Key >& keys,
+				const IndexVector& order, const IndexVector& lookups,
+				Result& result );
+			void _report( const std::string& name, const Result& result );
+			void _order( Pattern pattern, IndexVector& order,
+				IndexVector& lookups );
+
+		private:
+			bool doTest();
+
+		public:
+			unsigned int elements;
+			unsigned int lookups;
+			double skew;
+
+		public:
+			BenchBTree();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
@@ -12,10 +12,14 @@
 #include <hydrazine/implementation/Exception.h>
 #include <hydrazine/implementation/ArgumentParser.h>
 #include <fstream>
-
 namespace test
 {
 
+	unsigned int AllocationCounter::allocations = 0;
+	unsigned int StringLess::stringCompares = 0;
+	bool ThrowingValue::armed = false;
+	unsigned int HeldValue::held = 0;
+
 	void TestBTree::_init( Vector& v )
 	{
 		for( Vector::iterator fi = v.begin(); fi != v.end(); ++fi )
@@ -38,6 +42,25 @@ namespace test
 		out << tree;
 	}
 
+	template< typename Tree >
+	static bool matches( const TestBTree::Map& map, const Tree& tree )
+	{
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+		typename Tree::const_iterator ti = tree.begin();
+		for( TestBTree::Map::const_iterator mi = map.begin(); 
+			mi != map.end(); ++mi, ++ti )
+		{
+			if( mi->first != ti->first || mi->second != ti->second )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
 	bool TestBTree::testRandom()
 	{
 		typedef std::pair< Map::iterator, bool > MapInsertion;
@@ -1060,7 +1083,7 @@ namespace test
 
 	bool TestBTree::testErase()
 	{
-		status << "Running Test Insert\n";
+		status << "Running Test Erase\n";
 
 		Map map;
 		Tree tree;
@@ -1069,7 +1092,7 @@ namespace test
 		
 		for( unsigned int i = 0; i < iterations; ++i )
 		{
-			switch( random() % 2 )
+			switch( random() % 3 )
 			{
 				case 0:
 				{
@@ -1122,6 +1145,31 @@ namespace test
 					tree.erase( ti, ti1 );
 					break;
 				}
+				
+				case 2:
+				{
+					size_t index = random() % vector.size();
+					size_t mapErased = map.erase( vector[ index ] );
+					size_t treeErased = tree.erase( vector[ index ] );
+					
+					if( mapErased != treeErased )
+					{
+						status << "Erase failed, map erased " << mapErased 
+							<< " elements with key " << vector[ index ] 
+							<< ", tree erased " << treeErased << "\n";
+						dumpTree( tree, path );
+						return false;
+					}
+					break;
+				}
+			}
+			
+			if( map.size() != tree.size() )
+			{
+				status << "Erase failed, map size " << map.size() 
+					<< " does not match tree size " << tree.size() << "\n";
+				dumpTree( tree, path );
+				return false;
 			}
 		}
 			
@@ -1250,7 +1298,1431 @@ namespace test
 		status << "  Test Copy Passed.\n";
 		return true;
 	}
+
+	bool TestBTree::testBulkLoad()
+	{
+		status << "Running Test Bulk Load\n";
+
+		Map map;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			map.insert( std::make_pair( vector[ i ], i ) );
+		}
+
+		Tree tree( map.begin(), map.end() );
+		Tree sorted( hydrazine::sorted_unique, map.begin(), map.end() );
+		Tree sparse;
+		sparse.bulk_load( hydrazine::sorted_unique, map.begin(), map.end(), 
+			0.5 );
+
+		Tree* trees[] = { &tree, &sorted, &sparse };
+
+		for( unsigned int t = 0; t < 3; ++t )
+		{
+			if( trees[ t ]->size() != map.size() )
+			{
+				status << "Bulk load " << t << " failed, map size " 
+					<< map.size() << " does not match tree size " 
+					<< trees[ t ]->size() << "\n";
+				return false;
+			}
+		}
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			Tree& current = *trees[ i % 3 ];
+			size_t index = random() % vector.size();
+
+			if( random() % 2 )
+			{
+				map.insert( std::make_pair( vector[ index ], i ) );
+				for( unsigned int t = 0; t < 3; ++t )
+				{
+					trees[ t ]->insert( std::make_pair( vector[ index ], i ) );
+				}
+			}
+			else
+			{
+				map.erase( vector[ index ] );
+				for( unsigned int t = 0; t < 3; ++t )
+				{
+					trees[ t ]->erase( vector[ index ] );
+				}
+			}
+
+			if( current.size() != map.size() )
+			{
+				status << "At index " << i << " map size " << map.size() 
+					<< " does not match tree size " << current.size() 
+					<< "\n";
+				dumpTree( current, path );
+				return false;
+			}
+		}
+
+		for( unsigned int t = 0; t < 3; ++t )
+		{
+			Map::iterator mi = map.begin();
+			Tree::iterator ti = trees[ t ]->begin();
+
+			for( ; mi != map.end() && ti != trees[ t ]->end(); ++mi, ++ti )
+			{
+				if( mi->first != ti->first || mi->second != ti->second )
+				{
+					status << "Bulk load " << t << " failed, map pair (" 
+						<< mi->first << ", " << mi->second 
+						<< ") does not match tree pair (" << ti->first 
+						<< ", " << ti->second << ")\n";
+					dumpTree( *trees[ t ], path );
+					return false;
+				}
+			}
+			
+			if( mi != map.end() || ti != trees[ t ]->end() )
+			{
+				status << "Bulk load " << t 
+					<< " failed, iteration did not hit the end\n";
+				dumpTree( *trees[ t ], path );
+				return false;
+			}
+		}
+	
+		status << "  Test Bulk Load Passed.\n";
+		return true;
+	}
+
+	bool TestBTree::testSplitLayout()
+	{
+		status << "Running Test Split Layout\n";
+
+		Map map;
+		SplitTree tree;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+
+			switch( random() % 3 )
+			{
+				case 0:
+				{
+					map.insert( std::make_pair( vector[ index ], i ) );
+					tree.insert( std::make_pair( vector[ index ], i ) );
+					break;
+				}
+				
+				case 1:
+				{
+					map[ vector[ index ] ] = i;
+					SplitTree::iterator ti = tree.find( vector[ index ] );
+					if( ti == tree.end() )
+					{
+						tree[ vector[ index ] ] = i;
+					}
+					else
+					{
+						ti->second = i;
+					}
+					break;
+				}
+				
+				case 2:
+				{
+					map.erase( vector[ index ] );
+					tree.erase( vector[ index ] );
+					break;
+				}
+			}
+			
+			if( map.size() != tree.size() )
+			{
+				status << "At index " << i << " map size " << map.size() 
+					<< " does not match tree size " << tree.size() << "\n";
+				return false;
+			}
+		}
+
+		Map::const_iterator mi = map.begin();
+		SplitTree::const_iterator ti = tree.begin();
+
+		for( ; mi != map.end() && ti != tree.end(); ++mi, ++ti )
+		{
+			if( mi->first != ti->first || mi->second != (*ti).second )
+			{
+				status << "Split layout failed, map pair (" << mi->first 
+					<< ", " << mi->second << ") does not match tree pair (" 
+					<< ti->first << ", " << ti->second << ")\n";
+				return false;
+			}
+		}
+		
+		if( mi != map.end() || ti != tree.end() )
+		{
+			status << "Split layout failed, iteration did not hit the end\n";
+			return false;
+		}
+	
+		status << "  Test Split Layout Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testPoolAllocator()
+	{
+		status << "Running Test Pool Allocator\n";
+
+		Map map;
+		PoolTree tree;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+
+			if( random() % 2 )
+			{
+				map.insert( std::make_pair( vector[ index ], i ) );
+				tree.insert( std::make_pair( vector[ index ], i ) );
+			}
+			else
+			{
+				map.erase( vector[ index ] );
+				tree.erase( vector[ index ] );
+			}
+		}
+
+		PoolTree copy( tree );
+		PoolTree swapped;
+		swapped.swap( copy );
+
+		if( !copy.empty() || swapped.size() != map.size() )
+		{
+			status << "Pool allocator failed, swapped tree has " 
+				<< swapped.size() << " elements, expecting " << map.size() 
+				<< "\n";
+			return false;
+		}
+
+		swapped.clear();
+
+		if( !matches( map, tree ) )
+		{
+			status << "Pool allocator failed, clearing a copy "
+				<< "modified the original tree.\n";
+			return false;
+		}
+
+		hydrazine::PagePool& pool = *tree.get_allocator().pool();
+
+		tree.clear();
+		
+		if( pool.chunks() != 0 )
+		{
+			status << "Pool allocator failed, " << pool.chunks() 
+				<< " chunks are still held after clearing every tree.\n";
+			return false;
+		}
+	
+		for( Map::iterator mi = map.begin(); mi != map.end(); ++mi )
+		{
+			tree.insert( *mi );
+		}
+
+		if( !matches( map, tree ) )
+		{
+			status << "Pool allocator failed, could not refill the tree "
+				<< "after releasing the pool.\n";
+			return false;
+		}
+	
+		status << "  Test Pool Allocator Passed.\n";
+		return true;
+	}
 	
+	bool TestBTree::testAllocationFree()
+	{
+		status << "Running Test Allocation Free\n";
+
+		Map map;
+		CountingTree tree;
+		Vector vector( elements );
+		_init( vector );
+
+		unsigned int splitting = 0;
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int key = vector[ random() % vector.size() ];
+			bool present = !map.insert( std::make_pair( key, i ) ).second;
+
+			unsigned int nodes = AllocationCounter::allocations;
+
+			switch( i % 3 )
+			{
+				case 0:
+				{
+					tree.insert( std::make_pair( key, i ) );
+					break;
+				}
+				case 1:
+				{
+					tree.emplace( key, i );
+					break;
+				}
+				case 2:
+				{
+					tree.try_emplace( key, i );
+					break;
+				}
+			}
+			
+			nodes = AllocationCounter::allocations - nodes;
+
+			if( nodes != 0 )
+			{
+				if( present )
+				{
+					status << "Allocation free failed, inserting key " 
+						<< key << " that was already present allocated " 
+						<< nodes << " nodes.\n";
+					return false;
+				}
+				
+				++splitting;
+			}
+		}
+
+		if( !matches( map, tree ) )
+		{
+			status << "Allocation free failed, tree does not match map.\n";
+			return false;
+		}
+
+		ThrowingTree throwing;
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int key = vector[ random() % vector.size() ];
+			ThrowingValue value( i );
+			ThrowingTree::value_type pair( key, value );
+			ThrowingTree::size_type size = throwing.size();
+			bool present = throwing.count( key ) != 0;
+			bool threw = false;
+
+			ThrowingValue::armed = random() % 2;
+
+			try
+			{
+				if( i % 2 )
+				{
+					throwing.insert( pair );
+				}
+				else
+				{
+					throwing.try_emplace( key, value );
+				}
+			}
+			catch( const hydrazine::Exception& )
+			{
+				threw = true;
+			}
+
+			bool armed = ThrowingValue::armed;
+			ThrowingValue::armed = false;
+
+			if( threw != ( armed && !present ) )
+			{
+				status << "Allocation free failed, inserting key " << key
+					<< " threw " << threw << " while armed " << armed 
+					<< ".\n";
+				return false;
+			}
+
+			if( throwing.size() != size + ( !present && !threw ) 
+				|| ( throwing.count( key ) != 0 ) != ( present || !threw ) )
+			{
+				status << "Allocation free failed, inserting key " << key
+					<< " that threw changed the tree.\n";
+				return false;
+			}
+
+			unsigned int count = 0;
+			unsigned int last = 0;
+			for( ThrowingTree::iterator fi = throwing.begin(); 
+				fi != throwing.end(); ++fi, ++count )
+			{
+				if( count != 0 && fi->first <= last )
+				{
+					status << "Allocation free failed, inserting key " 
+						<< key << " left keys out of order.\n";
+					return false;
+				}
+				last = fi->first;
+			}
+
+			if( count != throwing.size() )
+			{
+				status << "Allocation free failed, inserting key " << key
+					<< " left " << count << " elements in a tree of size "
+					<< throwing.size() << ".\n";
+				return false;
+			}
+
+			if( random() % 64 == 0 )
+			{
+				throwing.clear();
+			}
+		}
+
+		status << "  " << splitting << " of " << iterations 
+			<< " inserts allocated a node.\n";
+		status << "  Test Allocation Free Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testSnapshot()
+	{
+		typedef std::vector< std::pair< Tree::Snapshot, Map > > SnapshotVector;
+
+		status << "Running Test Snapshot\n";
+
+		Map map;
+		Tree tree;
+		SnapshotVector snapshots;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+
+			switch( random() % 6 )
+			{
+				case 0:
+				case 1:
+				{
+					map[ vector[ index ] ] = i;
+					tree[ vector[ index ] ] = i;
+					break;
+				}
+				case 5:
+				{
+					Tree::iterator ti;
+					switch( random() % 4 )
+					{
+						case 0: ti = tree.find( vector[ index ] ); break;
+						case 1: ti = tree.lower_bound( vector[ index ] ); 
+							break;
+						case 2: ti = tree.upper_bound( vector[ index ] ); 
+							break;
+						case 3: ti = tree.begin(); break;
+					}
+					if( ti != tree.end() )
+					{
+						ti->second = i;
+						map[ ti->first ] = i;
+						if( ++ti != tree.end() )
+						{
+							ti->second = i;
+							map[ ti->first ] = i;
+						}
+					}
+					break;
+				}
+				case 2:
+				{
+					map.erase( vector[ index ] );
+					tree.erase( vector[ index ] );
+					break;
+				}
+				case 3:
+				{
+					Map::iterator mi = map.lower_bound( vector[ index ] );
+					Tree::iterator ti = tree.lower_bound( vector[ index ] );
+					size_t count = random() % 8;
+					Map::iterator mend = mi;
+					Tree::iterator tend = ti;
+					for( size_t j = 0; j < count && mend != map.end(); ++j )
+					{
+						++mend;
+						++tend;
+					}
+					map.erase( mi, mend );
+					tree.erase( ti, tend );
+					break;
+				}
+				case 4:
+				{
+					if( random() % 8 == 0 )
+					{
+						snapshots.push_back( std::make_pair( 
+							tree.snapshot(), map ) );
+					}
+					if( snapshots.size() > 4 )
+					{
+						snapshots.erase( snapshots.begin() 
+							+ random() % snapshots.size() );
+					}
+					break;
+				}
+			}
+		}
+
+		snapshots.push_back( std::make_pair( tree.snapshot(), map ) );
+		tree.clear();
+
+		for( SnapshotVector::iterator si = snapshots.begin(); 
+			si != snapshots.end(); ++si )
+		{
+			const Tree::Snapshot& snapshot = si->first;
+			const Map& expected = si->second;
+
+			if( snapshot.size() != expected.size() )
+			{
+				status << "Snapshot failed, snapshot size " << snapshot.size()
+					<< " does not match map size " << expected.size() 
+					<< "\n";
+				return false;
+			}
+
+			Tree::Snapshot::const_iterator fi = snapshot.begin();
+			for( Map::const_iterator mi = expected.begin(); 
+				mi != expected.end(); ++mi, ++fi )
+			{
+				if( fi == snapshot.end() || fi->first != mi->first 
+					|| fi->second != mi->second )
+				{
+					status << "Snapshot failed, map pair (" << mi->first 
+						<< ", " << mi->second << ") does not match the "
+						<< "snapshot.\n";
+					return false;
+				}
+			}
+
+			for( Vector::iterator vi = vector.begin(); 
+				vi != vector.end(); ++vi )
+			{
+				Map::const_iterator mi = expected.upper_bound( *vi );
+				Tree::Snapshot::const_iterator ti 
+					= snapshot.upper_bound( *vi );
+				if( snapshot.count( *vi ) != expected.count( *vi ) 
+					|| ( mi == expected.end() ) != ( ti == snapshot.end() )
+					|| ( mi != expected.end() && mi->first != ti->first ) )
+				{
+					status << "Snapshot failed, searching for " << *vi 
+						<< " does not match the map.\n";
+					return false;
+				}
+			}
+		}
+
+		status << "  Test Snapshot Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testOrderStatistics()
+	{
+		status << "Running Test Order Statistics\n";
+
+		Map map;
+		RankTree tree;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+
+			switch( random() % 3 )
+			{
+				case 0:
+				case 1:
+				{
+					map.insert( std::make_pair( vector[ index ], i ) );
+					tree.insert( std::make_pair( vector[ index ], i ) );
+					break;
+				}
+				case 2:
+				{
+					Map::iterator mi = map.lower_bound( vector[ index ] );
+					RankTree::iterator ti = tree.lower_bound( 
+						vector[ index ] );
+					size_t count = random() % 4;
+					Map::iterator mend = mi;
+					RankTree::iterator tend = ti;
+					for( size_t j = 0; j < count && mend != map.end(); ++j )
+					{
+						++mend;
+						++tend;
+					}
+					map.erase( mi, mend );
+					tree.erase( ti, tend );
+					break;
+				}
+			}
+
+			if( map.empty() )
+			{
+				continue;
+			}
+
+			size_t k = random() % map.size();
+			Map::iterator mi = map.begin();
+			std::advance( mi, k );
+			RankTree::iterator ti = tree.nth( k );
+
+			if( ti == tree.end() || ti->first != mi->first )
+			{
+				status << "Order statistics failed, element " << k 
+					<< " of the tree does not match key " << mi->first 
+					<< " in the map.\n";
+				return false;
+			}
+
+			size_t rank = std::distance( map.begin(), 
+				map.lower_bound( vector[ index ] ) );
+
+			if( tree.rank( vector[ index ] ) != rank )
+			{
+				status << "Order statistics failed, rank of key " 
+					<< vector[ index ] << " is " 
+					<< tree.rank( vector[ index ] ) << ", expecting " 
+					<< rank << ".\n";
+				return false;
+			}
+
+			if( tree.distance( ti, tree.end() ) 
+				!= std::distance( mi, map.end() ) )
+			{
+				status << "Order statistics failed, distance from element " 
+					<< k << " to the end does not match.\n";
+				return false;
+			}
+		}
+
+		if( tree.nth( tree.size() ) != tree.end() )
+		{
+			status << "Order statistics failed, element past the end "
+				<< "is not end().\n";
+			return false;
+		}
+	
+		status << "  Test Order Statistics Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testBatch()
+	{
+		status << "Running Test Batch\n";
+
+		Map map;
+		RankTree tree;
+
+		for( unsigned int i = 0; i < iterations / 16 + 1; ++i )
+		{
+			// A sorted run that is shuffled a little and repeats some keys
+			std::vector< std::pair< unsigned int, unsigned int > > batch;
+			unsigned int base = random() % ( elements * 4 );
+			unsigned int length = random() % ( elements + 1 );
+			for( unsigned int j = 0; j < length; ++j )
+			{
+				batch.push_back( std::make_pair( base + j * ( 1 + j % 3 ), 
+					i ) );
+			}
+			for( unsigned int j = 0; j < length / 8; ++j )
+			{
+				std::swap( batch[ random() % length ], 
+					batch[ random() % length ] );
+			}
+			if( length > 0 && random() % 2 )
+			{
+				batch.push_back( std::make_pair( batch.front().first, 
+					i + 1 ) );
+			}
+
+			Map before = map;
+			RankTree::Snapshot snapshot = tree.snapshot();
+
+			size_t expected = 0;
+			for( unsigned int j = 0; j < batch.size(); ++j )
+			{
+				expected += map.insert( batch[ j ] ).second;
+			}
+
+			size_t inserted = tree.insert_batch( batch.begin(), 
+				batch.end() );
+
+			if( inserted != expected )
+			{
+				status << "Batch insert failed, inserted " << inserted 
+					<< " values, expecting " << expected << ".\n";
+				return false;
+			}
+
+			if( !matches( map, tree ) )
+			{
+				status << "Batch insert failed, tree does not match map.\n";
+				return false;
+			}
+
+			if( !matches( before, snapshot ) )
+			{
+				status << "Batch insert failed, it changed a snapshot.\n";
+				return false;
+			}
+
+			Vector keys;
+			for( unsigned int j = 0; j < batch.size(); ++j )
+			{
+				keys.push_back( batch[ j ].first + j % 2 );
+			}
+
+			std::vector< RankTree::const_iterator > found;
+			const RankTree& constant = tree;
+			constant.find_batch( keys.begin(), keys.end(), 
+				std::back_inserter( found ) );
+
+			for( unsigned int j = 0; j < keys.size(); ++j )
+			{
+				Map::iterator mi = map.find( keys[ j ] );
+				bool missing = mi == map.end();
+				if( missing != ( found[ j ] == tree.end() ) 
+					|| ( !missing && ( found[ j ]->first != mi->first 
+					|| found[ j ]->second != mi->second ) ) )
+				{
+					status << "Batch find failed for key " << keys[ j ] 
+						<< ".\n";
+					return false;
+				}
+
+				size_t rank = std::distance( map.begin(), 
+					map.lower_bound( keys[ j ] ) );
+				if( tree.rank( keys[ j ] ) != rank )
+				{
+					status << "Batch insert failed, rank of key " 
+						<< keys[ j ] << " is " << tree.rank( keys[ j ] ) 
+						<< ", expecting " << rank << ".\n";
+					return false;
+				}
+			}
+
+			if( random() % 4 == 0 )
+			{
+				map.clear();
+				tree.clear();
+			}
+		}
+
+		status << "  Test Batch Passed.\n";
+		return true;
+	}
+	
+	/*! \brief Does a tree keyed by strings hold the same elements as a
+		std::map? */
+	template< typename Tree >
+	static bool matchesStrings( const TestBTree::StringMap& map, 
+		const Tree& tree )
+	{
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+
+		typename Tree::const_iterator element = tree.begin();
+		for( TestBTree::StringMap::const_iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element == tree.end() || element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		return element == tree.end();
+	}
+
+	bool TestBTree::testStringKeys()
+	{
+		status << "Running Test String Keys\n";
+
+		const char* directories[] = { "/usr/lib/", 
+			"/usr/lib/x86_64-linux-gnu/", "/usr/local/lib/", 
+			"/usr/share/doc/", "/" };
+		const unsigned int count = sizeof( directories ) 
+			/ sizeof( const char* );
+
+		StringMap map;
+		StringTree tree;
+		StringMap snapshotMap;
+		StringTree::Snapshot snapshot = tree.snapshot();
+
+		for( unsigned int i = 0; i < iterations * 4; ++i )
+		{
+			std::stringstream stream;
+			stream << directories[ random() % count ] << "lib" 
+				<< ( random() % ( elements * 4 + 1 ) ) << ".so";
+			std::string key = stream.str();
+
+			switch( random() % 8 )
+			{
+				case 0:
+				case 1:
+				case 2:
+				{
+					if( tree.insert( std::make_pair( key, i ) ).second
+						!= map.insert( std::make_pair( key, i ) ).second )
+					{
+						status << "String keys failed, insert of " << key
+							<< " did not match std::map.\n";
+						return false;
+					}
+					break;
+				}
+				case 3:
+				case 4:
+				{
+					if( tree.erase( key ) != map.erase( key ) )
+					{
+						status << "String keys failed, erase of " << key
+							<< " did not match std::map.\n";
+						return false;
+					}
+					break;
+				}
+				case 5:
+				{
+					std::string upper = key + "~";
+					tree.erase( tree.lower_bound( key ), 
+						tree.lower_bound( upper ) );
+					map.erase( map.lower_bound( key ), 
+						map.lower_bound( upper ) );
+					break;
+				}
+				case 6:
+				{
+					StringTree::iterator element = tree.lower_bound( key );
+					StringMap::iterator expected = map.lower_bound( key );
+					if( ( element == tree.end() ) 
+						!= ( expected == map.end() ) 
+						|| ( element != tree.end() 
+						&& element->first != expected->first ) )
+					{
+						status << "String keys failed, lower bound of " 
+							<< key << " did not match std::map.\n";
+						return false;
+					}
+					break;
+				}
+				case 7:
+				{
+					if( random() % 2 )
+					{
+						snapshot = tree.snapshot();
+						snapshotMap = map;
+					}
+					else
+					{
+						StringTree copy( tree );
+						if( !matchesStrings( map, copy ) )
+						{
+							status << "String keys failed, copy does not "
+								<< "match std::map.\n";
+							return false;
+						}
+					}
+					break;
+				}
+			}
+		}
+
+		if( !matchesStrings( map, tree ) )
+		{
+			status << "String keys failed, tree does not match std::map.\n";
+			return false;
+		}
+
+		if( !matchesStrings( snapshotMap, snapshot ) )
+		{
+			status << "String keys failed, snapshot does not match "
+				<< "std::map.\n";
+			return false;
+		}
+
+		tree.clear();
+
+		if( !tree.empty() || !matchesStrings( snapshotMap, snapshot ) )
+		{
+			status << "String keys failed, clear did not empty the tree "
+				<< "or it changed a snapshot.\n";
+			return false;
+		}
+
+		status << "  Test String Keys Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testSetOperations()
+	{
+		status << "Running Test Set Operations\n";
+
+		for( unsigned int i = 0; i < iterations / 16 + 1; ++i )
+		{
+			Map leftMap;
+			Map rightMap;
+			Tree left;
+			Tree right;
+
+			// random keys, alternating keys, or two separate ranges
+			unsigned int shape = random() % 3;
+			unsigned int leftSize = random() % ( elements * 8 + 1 );
+			unsigned int rightSize = random() % ( elements * 8 + 1 );
+			for( unsigned int j = 0; j < leftSize; ++j )
+			{
+				unsigned int key = shape == 0 ? random() % ( elements * 8 )
+					: ( shape == 1 ? 2 * j : j );
+				left.insert( std::make_pair( key, j ) );
+				leftMap.insert( std::make_pair( key, j ) );
+			}
+			for( unsigned int j = 0; j < rightSize; ++j )
+			{
+				unsigned int key = shape == 0 ? random() % ( elements * 8 )
+					: ( shape == 1 ? 2 * j + 1 : leftSize + j );
+				right.insert( std::make_pair( key, j + leftSize ) );
+				rightMap.insert( std::make_pair( key, j + leftSize ) );
+			}
+
+			Map unionMap = leftMap;
+			Map mergeMap = rightMap;
+			Map intersectionMap;
+			Map differenceMap;
+			unionMap.insert( rightMap.begin(), rightMap.end() );
+			mergeMap.insert( leftMap.begin(), leftMap.end() );
+			for( Map::iterator fi = leftMap.begin(); 
+				fi != leftMap.end(); ++fi )
+			{
+				if( rightMap.count( fi->first ) != 0 )
+				{
+					intersectionMap.insert( *fi );
+				}
+				else
+				{
+					differenceMap.insert( *fi );
+				}
+			}
+
+			if( !matches( unionMap, hydrazine::set_union( left, right ) ) )
+			{
+				status << "Set operations failed, union does not match "
+					<< "std::map.\n";
+				return false;
+			}
+
+			if( !matches( intersectionMap, 
+				hydrazine::set_intersection( left, right ) ) )
+			{
+				status << "Set operations failed, intersection does not "
+					<< "match std::map.\n";
+				return false;
+			}
+
+			if( !matches( differenceMap, 
+				hydrazine::set_difference( left, right ) ) )
+			{
+				status << "Set operations failed, difference does not "
+					<< "match std::map.\n";
+				return false;
+			}
+
+			if( !matches( mergeMap, hydrazine::merge( left, right ) ) )
+			{
+				status << "Set operations failed, merge does not match "
+					<< "std::map.\n";
+				return false;
+			}
+
+			if( !matches( leftMap, left ) || !matches( rightMap, right ) )
+			{
+				status << "Set operations failed, an operation changed "
+					<< "its inputs.\n";
+				return false;
+			}
+
+			bool snapshotLeft = random() % 2;
+			Tree::Snapshot snapshot = snapshotLeft 
+				? left.snapshot() : right.snapshot();
+
+			left.merge( right );
+
+			if( !matches( mergeMap, left ) || !right.empty() 
+				|| right.begin() != right.end() )
+			{
+				status << "Set operations failed, in place merge does not "
+					<< "match std::map or did not empty its source.\n";
+				return false;
+			}
+
+			if( !matches( snapshotLeft ? leftMap : rightMap, snapshot ) )
+			{
+				status << "Set operations failed, in place merge changed "
+					<< "a snapshot.\n";
+				return false;
+			}
+
+			for( unsigned int j = 0; j < elements; ++j )
+			{
+				unsigned int key = random() % ( elements * 8 );
+				left.erase( key );
+				mergeMap.erase( key );
+			}
+
+			if( !matches( mergeMap, left ) )
+			{
+				status << "Set operations failed, erasing from a merged "
+					<< "tree does not match std::map.\n";
+				return false;
+			}
+		}
+
+		CountingTree left;
+		CountingTree right;
+		for( unsigned int j = 0; j < elements * 8; ++j )
+		{
+			left.insert( std::make_pair( j, j ) );
+			right.insert( std::make_pair( j + elements * 8, j ) );
+		}
+
+		unsigned int nodes = AllocationCounter::allocations;
+		CountingTree combined;
+		combined.combine( hydrazine::SetUnion, left, right );
+		unsigned int built = AllocationCounter::allocations - nodes;
+
+		nodes = AllocationCounter::allocations;
+		left.merge( right );
+		unsigned int merged = AllocationCounter::allocations - nodes;
+
+		if( left != combined || 2 * merged >= built )
+		{
+			status << "Set operations failed, merging trees that do not "
+				<< "overlap made " << merged << " allocations, building "
+				<< "their union made " << built << ".\n";
+			return false;
+		}
+
+		status << "  Test Set Operations Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testTransparent()
+	{
+		status << "Running Test Transparent\n";
+
+		StringMap map;
+		TransparentTree tree;
+		const TransparentTree& constant = tree;
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			std::stringstream stream;
+			stream << "/usr/lib/x86_64-linux-gnu/lib" 
+				<< ( random() % ( elements * 4 + 1 ) ) << ".so";
+			std::string key = stream.str();
+
+			if( random() % 3 )
+			{
+				tree.insert( std::make_pair( key, i ) );
+				map.insert( std::make_pair( key, i ) );
+			}
+			else
+			{
+				tree.erase( key );
+				map.erase( key );
+			}
+
+			TransparentTree::Snapshot snapshot = tree.snapshot();
+			const char* probe = key.c_str();
+
+			unsigned int compares = StringLess::stringCompares;
+			TransparentTree::iterator found = tree.find( probe );
+			TransparentTree::const_iterator constFound 
+				= constant.find( probe );
+			TransparentTree::Snapshot::const_iterator snapshotFound 
+				= snapshot.find( probe );
+			unsigned int count = tree.count( probe ) 
+				+ snapshot.count( probe );
+			TransparentTree::iterator lower = tree.lower_bound( probe );
+			TransparentTree::const_iterator upper 
+				= constant.upper_bound( probe );
+			TransparentTree::Snapshot::const_iterator snapshotUpper 
+				= snapshot.upper_bound( probe );
+			std::pair< TransparentTree::iterator, TransparentTree::iterator >
+				range = tree.equal_range( probe );
+			unsigned int converted = StringLess::stringCompares - compares;
+
+			StringMap::iterator expected = map.find( key );
+			StringMap::iterator expectedUpper = map.upper_bound( key );
+			bool present = expected != map.end();
+
+			if( converted != 0 )
+			{
+				status << "Transparent failed, looking up " << key
+					<< " compared " << converted << " std::strings.\n";
+				return false;
+			}
+
+			if( ( found != tree.end() ) != present 
+				|| ( constFound != constant.end() ) != present
+				|| ( snapshotFound != snapshot.end() ) != present
+				|| count != 2 * present 
+				|| ( present && found->second != expected->second ) )
+			{
+				status << "Transparent failed, find of " << key 
+					<< " did not match std::map.\n";
+				return false;
+			}
+
+			if( ( expectedUpper == map.end() ) != ( upper == tree.end() )
+				|| ( upper != tree.end() 
+				&& upper->first != expectedUpper->first )
+				|| ( snapshotUpper != snapshot.end() ) 
+				!= ( upper != tree.end() )
+				|| ( upper != tree.end() 
+				&& snapshotUpper->first != upper->first ) )
+			{
+				status << "Transparent failed, upper bound of " << key 
+					<< " did not match std::map.\n";
+				return false;
+			}
+
+			if( range.first != lower 
+				|| TransparentTree::const_iterator( range.second ) != upper )
+			{
+				status << "Transparent failed, equal range of " << key 
+					<< " did not match the bounds.\n";
+				return false;
+			}
+		}
+
+		if( !matchesStrings( map, tree ) )
+		{
+			status << "Transparent failed, tree does not match std::map.\n";
+			return false;
+		}
+
+		status << "  Test Transparent Passed.\n";
+		return true;
+	}
+
+	bool TestBTree::testMmapAllocator()
+	{
+		status << "Running Test Mmap Allocator\n";
+
+		Map map;
+		MmapTree tree;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+
+			if( random() % 2 )
+			{
+				map.insert( std::make_pair( vector[ index ], i ) );
+				tree.insert( std::make_pair( vector[ index ], i ) );
+			}
+			else
+			{
+				map.erase( vector[ index ] );
+				tree.erase( vector[ index ] );
+			}
+		}
+
+		if( !matches( map, tree ) )
+		{
+			status << "Mmap allocator failed, tree does not match "
+				<< "std::map.\n";
+			return false;
+		}
+
+		MmapTree::allocator_type allocator = tree.get_allocator();
+		hydrazine::MmapPool& pool = *allocator.pool();
+		
+		MmapTree::allocator_type::rebind< double >::other rebound( 
+			allocator );
+		
+		if( rebound.pool() != allocator.pool() )
+		{
+			status << "Mmap allocator failed, a rebound allocator does "
+				<< "not share the pool.\n";
+			return false;
+		}
+
+		if( pool.live() == 0 || map.empty() )
+		{
+			status << "Mmap allocator failed, no nodes were drawn from "
+				<< "the pool.\n";
+			return false;
+		}
+
+		{
+			MmapTree copy( tree );
+			
+			if( !matches( map, copy ) )
+			{
+				status << "Mmap allocator failed, copy does not match "
+					<< "std::map.\n";
+				return false;
+			}
+			
+			copy.clear();
+		}
+
+		tree.clear();
+		
+		if( pool.live() != 0 )
+		{
+			status << "Mmap allocator failed, " << pool.live() 
+				<< " blocks are still held after clearing every tree.\n";
+			return false;
+		}
+
+		// At most one region per node size is kept around
+		if( pool.regions() > 4 )
+		{
+			status << "Mmap allocator failed, " << pool.regions() 
+				<< " regions are still mapped after clearing every tree.\n";
+			return false;
+		}
+	
+		for( Map::iterator mi = map.begin(); mi != map.end(); ++mi )
+		{
+			tree.insert( *mi );
+		}
+
+		if( !matches( map, tree ) )
+		{
+			status << "Mmap allocator failed, could not refill the tree "
+				<< "after emptying the pool.\n";
+			return false;
+		}
+	
+		status << "  Test Mmap Allocator Passed.\n";
+		return true;
+	}
+	
+	template< typename Tree >
+	bool TestBTree::testErasedValuesReleased( const std::string& name )
+	{
+		Map map;
+		Tree tree;
+		Vector vector( elements );
+		_init( vector );
+		
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t index = random() % vector.size();
+			unsigned int key = vector[ index ];
+		
+			switch( random() % 3 )
+			{
+				case 0:
+				{
+					map.insert( std::make_pair( key, i + 1 ) );
+					tree.insert( std::make_pair( key, 
+						HeldValue( i + 1 ) ) );
+					break;
+				}
+				
+				case 1:
+				{
+					map.erase( key );
+					tree.erase( key );
+					break;
+				}
+				
+				case 2:
+				{
+					unsigned int last = vector[ random() % vector.size() ];
+					if( last < key )
+					{
+						std::swap( key, last );
+					}
+					map.erase( map.lower_bound( key ), 
+						map.lower_bound( last ) );
+					tree.erase( tree.lower_bound( key ), 
+						tree.lower_bound( last ) );
+					break;
+				}
+			}
+			
+			if( HeldValue::held != tree.size() )
+			{
+				status << name << " failed, " << HeldValue::held 
+					<< " values hold something, but the tree only has " 
+					<< tree.size() << ".\n";
+				return false;
+			}
+		}
+		
+		if( map.size() != tree.size() )
+		{
+			status << name << " failed, tree has " << tree.size() 
+				<< " values, map has " << map.size() << ".\n";
+			return false;
+		}
+		
+		typename Tree::const_iterator ti = tree.begin();
+		for( Map::iterator mi = map.begin(); mi != map.end(); ++mi, ++ti )
+		{
+			if( mi->first != ti->first || mi->second != ti->second.value )
+			{
+				status << name << " failed, tree has (" << ti->first 
+					<< "," << ti->second << "), map has (" << mi->first 
+					<< "," << mi->second << ").\n";
+				return false;
+			}
+		}
+		
+		tree.clear();
+		
+		if( HeldValue::held != 0 )
+		{
+			status << name << " failed, " << HeldValue::held 
+				<< " values still hold something after a clear.\n";
+			return false;
+		}
+		
+		return true;
+	}
+	
+	bool TestBTree::testErasedValues()
+	{
+		status << "Running Test Erased Values\n";
+		
+		if( !testErasedValuesReleased< HeldTree >( "Erased values" ) )
+		{
+			return false;
+		}
+		
+		if( !testErasedValuesReleased< SplitHeldTree >( 
+			"Erased split values" ) )
+		{
+			return false;
+		}
+		
+		status << "  Test Erased Values Passed.\n";
+		return true;
+	}
+	
+	bool TestBTree::testSnapshotWrites()
+	{
+		status << "Running Test Snapshot Writes\n";
+
+		Map map;
+		CountingTree tree;
+		unsigned int size = elements * 8 + 64;
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			map[ i ] = i;
+			tree[ i ] = i;
+		}
+
+		unsigned int before = AllocationCounter::allocations;
+		CountingTree copy( tree );
+		unsigned int nodes = AllocationCounter::allocations - before;
+
+		for( unsigned int i = 0; i < 4; ++i )
+		{
+			Map expected = map;
+			CountingTree::Snapshot snapshot = tree.snapshot();
+
+			before = AllocationCounter::allocations;
+			CountingTree::iterator ti;
+			switch( i )
+			{
+				case 0: ti = tree.begin(); break;
+				case 1: ti = tree.rbegin().base(); --ti; break;
+				case 2: ti = tree.end(); --ti; break;
+				case 3: ti = tree.begin(); break;
+			}
+			unsigned int copies = AllocationCounter::allocations - before;
+
+			if( 4 * copies > nodes )
+			{
+				status << "Snapshot writes failed, starting iterator " << i 
+					<< " copied " << copies << " of " << nodes 
+					<< " nodes.\n";
+				return false;
+			}
+
+			// write through every element, walking away from the start
+			for( unsigned int j = 0; j < size; ++j )
+			{
+				ti->second = i + j;
+				map[ ti->first ] = i + j;
+				if( j + 1 < size )
+				{
+					if( i == 0 || i == 3 )
+					{
+						++ti;
+					}
+					else
+					{
+						--ti;
+					}
+				}
+			}
+
+			if( !matches( map, tree ) )
+			{
+				status << "Snapshot writes failed, tree does not match map "
+					<< "after writing from iterator " << i << ".\n";
+				return false;
+			}
+
+			CountingTree::Snapshot::const_iterator si = snapshot.begin();
+			for( Map::iterator mi = expected.begin(); mi != expected.end();
+				++mi, ++si )
+			{
+				if( si == snapshot.end() || si->first != mi->first 
+					|| si->second != mi->second )
+				{
+					status << "Snapshot writes failed, writing from "
+						<< "iterator " << i << " changed the snapshot at "
+						<< "key " << mi->first << ".\n";
+					return false;
+				}
+			}
+		}
+
+		// every snapshot is gone, so nothing should be copied
+		before = AllocationCounter::allocations;
+		for( CountingTree::iterator ti = tree.begin(); ti != tree.end(); 
+			++ti )
+		{
+			ti->second = ti->first;
+		}
+		tree.find( size / 2 );
+		tree.lower_bound( size / 3 );
+		tree.rbegin();
+		if( AllocationCounter::allocations != before )
+		{
+			status << "Snapshot writes failed, writing after the snapshot "
+				<< "was released made " << AllocationCounter::allocations 
+				- before << " allocations.\n";
+			return false;
+		}
+
+		status << "  Test Snapshot Writes Passed.\n";
+		return true;
+	}
+
 	void TestBTree::doBenchmark()
 	{
 		Tree tree;
@@ -1293,7 +2765,13 @@ namespace test
 		{
 			return testRandom() && testClear() && testIteration() 
 				&& testComparisons() && testSearching() && testSwap() 
-				&& testInsert() && testErase() && testCopy();
+				&& testInsert() && testErase() && testCopy() 
+				&& testBulkLoad() && testSplitLayout() && testPoolAllocator()
+				&& testAllocationFree() && testSnapshot()
+				&& testOrderStatistics() && testBatch() 
+				&& testStringKeys() && testSetOperations()
+				&& testTransparent() && testMmapAllocator()
+				&& testErasedValues() && testSnapshotWrites();
 		}
 	}
 
@@ -1312,7 +2790,42 @@ namespace test
 		description += "operators. 5) Test searching functions. 6) Test ";
 		description += "swapping with another map 7) Test all of the insert ";
 		description += "functions. 8) Test all of the erase functions. 9) ";
-		description += "Test assignment and copy constructors. 10) Do not ";
+		description += "Test assignment and copy constructors. 10) Build ";
+		description += "trees in bulk from sorted ranges and then randomly ";
+		description += "modify them. 11) Randomly modify a std::map and a ";
+		description += "Map that splits keys from values and assert that ";
+		description += "they match. 12) Randomly modify a Map that draws ";
+		description += "nodes from a pool, copy, swap, and clear it, and ";
+		description += "assert that the pool is empty after the last clear. ";
+		description += "13) Insert into a Map with every insert ";
+		description += "function and assert that inserts of keys that are ";
+		description += "present do not allocate and that inserts of values ";
+		description += "that throw leave it alone. 14) Take snapshots while ";
+		description += "modifying a Map, also through iterators, and ";
+		description += "assert that each one still ";
+		description += "matches the contents at the time. 15) Assert that ";
+		description += "nth, rank, and distance on a Map with subtree ";
+		description += "counts match a std::map. 16) Insert and find ";
+		description += "nearly sorted batches with a snapshot held and ";
+		description += "assert that they match a std::map. 17) Randomly ";
+		description += "modify a Map keyed by path names with shared ";
+		description += "prefixes, taking snapshots and copies, and assert ";
+		description += "that they match a std::map. 18) Assert that the ";
+		description += "union, intersection, difference, and merge of two ";
+		description += "Maps, and merging one into the other in place, ";
+		description += "match a std::map, and that merging Maps that do ";
+		description += "not overlap splices their leaves. 19) Look up C ";
+		description += "strings in a Map with a transparent compare and ";
+		description += "assert that the lookups match a std::map without ";
+		description += "converting them. 20) Randomly modify a Map that draws ";
+		description += "nodes from a pooled mmap allocator, copy and clear ";
+		description += "it, and assert that clearing every Map empties the ";
+		description += "pool. 21) Randomly modify Maps whose values count ";
+		description += "how many of them hold something and assert that ";
+		description += "erased values do not. 22) Write through mutable ";
+		description += "iterators while a snapshot is held and assert ";
+		description += "that begin() copies a single path and the ";
+		description += "snapshot does not change. 23) Do not ";
 		description += "run any tests, simply add a ";
 		description += "sequence to the Map and write it out to graph viz ";
 		description += "files after each operaton.";
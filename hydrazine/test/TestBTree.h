@@ -9,9 +9,12 @@
 #define TEST_B_TREE_H_INCLUDED
 
 #include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/Exception.h>
 #include <hydrazine/implementation/BTree.h>
 #include <hydrazine/implementation/MmapAllocator.h>
+#include <hydrazine/interface/PoolAllocator.h>
 #include <vector>
+#include <string>
 #include <map>
 
 #define PAGE_SIZE 4
@@ -21,6 +24,182 @@
 namespace test
 {
 
+	/*! \brief The allocations made by every CountingAllocator */
+	class AllocationCounter
+	{
+		public:
+			static unsigned int allocations;
+	};
+
+	/*! \brief An allocator that counts every allocation */
+	template< typename T >
+	class CountingAllocator : public std::allocator< T >, 
+		public AllocationCounter
+	{
+		public:
+			template< typename NewT >
+			struct rebind
+			{
+				typedef CountingAllocator< NewT > other;
+			};
+
+		public:
+			CountingAllocator() {}
+
+			template< typename SomeT >
+			CountingAllocator( const CountingAllocator< SomeT >& ) {}
+
+			T* allocate( size_t n, const void* = 0 )
+			{
+				++allocations;
+				return std::allocator< T >::allocate( n );
+			}
+	};
+
+	/*! \brief A value whose copies throw while it is armed */
+	class ThrowingValue
+	{
+		public:
+			static bool armed;
+
+		public:
+			unsigned int value;
+
+		public:
+			ThrowingValue( unsigned int v = 0 ) : value( v ) {}
+
+			ThrowingValue( const ThrowingValue& v ) : value( v.value )
+			{
+				_check();
+			}
+
+			ThrowingValue( ThrowingValue&& v ) : value( v.value ) {}
+
+			ThrowingValue& operator=( const ThrowingValue& v )
+			{
+				_check();
+				value = v.value;
+				return *this;
+			}
+
+			ThrowingValue& operator=( ThrowingValue&& v )
+			{
+				value = v.value;
+				return *this;
+			}
+
+		private:
+			void _check() const
+			{
+				if( armed )
+				{
+					throw hydrazine::Exception( "Copied an armed value." );
+				}
+			}
+	};
+
+	inline std::ostream& operator<<( std::ostream& out, 
+		const ThrowingValue& v )
+	{
+		return out << v.value;
+	}
+
+	/*! \brief A value that counts how many copies of it hold something,
+		like a handle on a resource, so a test can see if a tree keeps
+		values alive after they are erased */
+	class HeldValue
+	{
+		public:
+			/*! \brief The number of values that hold something */
+			static unsigned int held;
+
+		public:
+			unsigned int value;
+
+		public:
+			HeldValue( unsigned int v = 0 ) : value( v ) { _hold(); }
+
+			HeldValue( const HeldValue& v ) : value( v.value ) { _hold(); }
+
+			HeldValue( HeldValue&& v ) : value( v.value ) { v.value = 0; }
+
+			~HeldValue() { _release(); }
+
+			HeldValue& operator=( const HeldValue& v )
+			{
+				if( this != &v )
+				{
+					_release();
+					value = v.value;
+					_hold();
+				}
+				return *this;
+			}
+
+			HeldValue& operator=( HeldValue&& v )
+			{
+				if( this != &v )
+				{
+					_release();
+					value = v.value;
+					v.value = 0;
+				}
+				return *this;
+			}
+
+		private:
+			void _hold()
+			{
+				if( value != 0 )
+				{
+					++held;
+				}
+			}
+
+			void _release()
+			{
+				if( value != 0 )
+				{
+					--held;
+				}
+			}
+	};
+
+	inline std::ostream& operator<<( std::ostream& out, const HeldValue& v )
+	{
+		return out << v.value;
+	}
+
+	/*! \brief A transparent compare of std::strings and C strings */
+	class StringLess
+	{
+		public:
+			typedef void is_transparent;
+
+		public:
+			/*! \brief Compares of two std::strings, which a lookup of a C
+				string only makes if it converted the string */
+			static unsigned int stringCompares;
+
+		public:
+			bool operator()( const std::string& x, 
+				const std::string& y ) const
+			{
+				++stringCompares;
+				return x < y;
+			}
+
+			bool operator()( const std::string& x, const char* y ) const
+			{
+				return x.compare( y ) < 0;
+			}
+
+			bool operator()( const char* x, const std::string& y ) const
+			{
+				return y.compare( x ) > 0;
+			}
+	};
+
 		/*!
 		\brief A unit test for a BTree data structure implementing
 			the STL map interface.
@@ -49,7 +228,82 @@ namespace test
 			
 			9) Test assignment and copy constructors.
 			
-			10) Do not run any tests, simply add a sequence to the localMap 
+			10) Build trees in bulk from sorted ranges with different fill
+				factors, randomly modify them, and assert that they match
+				a std::map.
+			
+			11) Randomly insert, update, and remove elements from a std::map
+				and a BTree that stores keys and values in separate arrays,
+				assert that they match.
+			
+			12) Randomly modify a BTree that draws its nodes from a pool
+				and a std::map and assert that they match.  Copy and swap
+				it, assert that clearing one tree leaves trees sharing the
+				pool intact, and that clearing the last one frees every
+				chunk of the pool.
+			
+			13) Insert with insert, emplace, and try_emplace into a BTree
+				that counts node allocations.  Assert that no insert of a
+				key that is already present allocates, and that the tree
+				matches a std::map.  Insert values that throw when they
+				are copied and assert that the tree is left unchanged.
+			
+			14) Take snapshots of a BTree while randomly modifying it,
+				including through the iterators that lookups return, and
+				keep a copy of the std::map that matches each one.  Assert
+				that every snapshot still matches its map, including after
+				the tree is cleared, and that lookups in snapshots agree
+				with the map.
+			
+			15) Randomly insert and remove elements from a std::map and a
+				BTree that keeps subtree counts, assert that nth, rank, and
+				distance agree with walking the std::map.
+			
+			16) Insert nearly sorted batches, with duplicates, into a BTree
+				that keeps subtree counts while a snapshot is held, and find
+				batches of present and missing keys.  Assert that the tree,
+				the lookups, and the ranks match a std::map and that the
+				snapshot did not change.
+			
+			17) Randomly insert, erase, and find path names with long
+				shared prefixes in a BTree keyed by std::string, which
+				compresses the keys in its bodies, erasing ranges and
+				taking snapshots and copies along the way.  Assert that
+				the tree, the copies, and the snapshots match a std::map.
+			
+			18) Build pairs of BTrees that overlap, interleave, or do not
+				overlap at all, and assert that their union, intersection,
+				difference, and merge, along with an in place merge while
+				a snapshot is held, match a std::map.  Assert that an in
+				place merge of trees that do not overlap allocates less
+				than half as much as building the union.
+			
+			19) Randomly insert and erase path names in a BTree with a
+				transparent compare and a std::map, and look up C strings
+				with find, count, lower_bound, upper_bound, and
+				equal_range in the tree, a const reference to it, and a
+				snapshot.  Assert that they agree with std::map and that
+				none of the lookups convert the C string to a std::string.
+			
+			20) Randomly modify a std::map and a BTree that draws nodes
+				from a pooled MmapAllocator, copy and clear it.  Assert
+				that they match, that copies and rebinds of the allocator
+				share a pool, and that clearing every tree hands back all
+				of the blocks and unmaps all but a few regions.
+			
+			21) Randomly insert, erase, and erase ranges from BTrees,
+				with both leaf layouts, whose values count how many of
+				them hold something.  Assert that only the values left in
+				the trees hold anything after each change.
+
+			22) Take a snapshot of a BTree that counts node allocations
+				and write through mutable iterators from begin(), rbegin(),
+				and end(), forward and backward.  Assert that begin() and
+				rbegin() copy a single path rather than the whole tree,
+				that the snapshot does not change, and that nothing is
+				copied once the snapshot is released.
+
+			23) Do not run any tests, simply add a sequence to the localMap 
 				and write it out to graph viz files after each operaton.
 
 	*/
@@ -59,8 +313,48 @@ namespace test
 			typedef hydrazine::BTree< unsigned int, unsigned int, 
 				std::less<unsigned int>, ALLOCATOR, 
 				PAGE_SIZE > Tree;
+			typedef hydrazine::BTree< unsigned int, unsigned int, 
+				std::less<unsigned int>, ALLOCATOR, 
+				PAGE_SIZE, hydrazine::SplitLeafLayout > SplitTree;
+			typedef hydrazine::BTree< unsigned int, unsigned int, 
+				std::less<unsigned int>, hydrazine::PoolAllocator< 
+				std::pair< const unsigned int, unsigned int > >, 
+				PAGE_SIZE > PoolTree;
+			typedef hydrazine::BTree< unsigned int, unsigned int, 
+				std::less<unsigned int>, hydrazine::MmapAllocator< 
+				std::pair< const unsigned int, unsigned int >, true >, 
+				PAGE_SIZE > MmapTree;
+			typedef hydrazine::BTree< unsigned int, unsigned int, 
+				std::less<unsigned int>, CountingAllocator< 
+				std::pair< const unsigned int, unsigned int > >, 
+				PAGE_SIZE > CountingTree;
+			typedef hydrazine::BTree< unsigned int, ThrowingValue, 
+				std::less<unsigned int>, std::allocator< std::pair< 
+				const unsigned int, ThrowingValue > >, 
+				PAGE_SIZE > ThrowingTree;
+			typedef hydrazine::BTree< unsigned int, HeldValue, 
+				std::less<unsigned int>, std::allocator< std::pair< 
+				const unsigned int, HeldValue > >, 
+				PAGE_SIZE > HeldTree;
+			typedef hydrazine::BTree< unsigned int, HeldValue, 
+				std::less<unsigned int>, std::allocator< std::pair< 
+				const unsigned int, HeldValue > >, 
+				PAGE_SIZE, hydrazine::SplitLeafLayout > SplitHeldTree;
+			typedef hydrazine::BTree< unsigned int, unsigned int, 
+				std::less<unsigned int>, ALLOCATOR, PAGE_SIZE, 
+				hydrazine::PairedLeafLayout, 
+				hydrazine::OrderStatistics > RankTree;
+			typedef hydrazine::BTree< std::string, unsigned int, 
+				std::less< std::string >, std::allocator< std::pair< 
+				const std::string, unsigned int > >, 
+				PAGE_SIZE > StringTree;
+			typedef hydrazine::BTree< std::string, unsigned int, 
+				StringLess, std::allocator< std::pair< 
+				const std::string, unsigned int > >, 
+				PAGE_SIZE > TransparentTree;
 			typedef std::vector< unsigned int > Vector;
 			typedef std::map< unsigned int, unsigned int > Map;
+			typedef std::map< std::string, unsigned int > StringMap;
 		
 		private:
 			void _init( Vector& v );
@@ -75,6 +369,21 @@ namespace test
 			bool testInsert();
 			bool testErase();
 			bool testCopy();
+			bool testBulkLoad();
+			bool testSplitLayout();
+			bool testPoolAllocator();
+			bool testAllocationFree();
+			bool testSnapshot();
+			bool testOrderStatistics();
+			bool testBatch();
+			bool testStringKeys();
+			bool testSetOperations();
+			bool testTransparent();
+			bool testMmapAllocator();
+			template< typename Tree >
+			bool testErasedValuesReleased( const std::string& name );
+			bool testErasedValues();
+			bool testSnapshotWrites();
 			void doBenchmark();
 			bool doTest();
 		
@@ -0,0 +1,390 @@
+/*!
+	\file TestBTreeImage.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestBTreeImage class.
+*/
+
+#ifndef TEST_BTREE_IMAGE_CPP_INCLUDED
+#define TEST_BTREE_IMAGE_CPP_INCLUDED
+
+#include <hydrazine/test/TestBTreeImage.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+namespace test
+{
+
+	/*! \brief Do an image and a map hold the same elements, in both
+		directions? */
+	template< typename Image >
+	static bool matches( const TestBTreeImage::Map& map,
+		const Image& image )
+	{
+		if( map.size() != image.size() )
+		{
+			return false;
+		}
+
+		typename Image::const_iterator element = image.begin();
+		for( TestBTreeImage::Map::const_iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element == image.end() || element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		if( element != image.end() )
+		{
+			return false;
+		}
+
+		typename Image::const_reverse_iterator reverse = image.rbegin();
+		for( TestBTreeImage::Map::const_reverse_iterator
+			fi = map.rbegin(); fi != map.rend(); ++fi, ++reverse )
+		{
+			if( reverse == image.rend() || reverse->first != fi->first )
+			{
+				return false;
+			}
+		}
+
+		return reverse == image.rend();
+	}
+
+	/*! \brief Do an iterator into a map and one into an image point at
+		the same element, or are both at the end? */
+	template< typename Image >
+	static bool same( const TestBTreeImage::Map& map,
+		TestBTreeImage::Map::const_iterator expected, const Image& image,
+		typename Image::const_iterator element )
+	{
+		if( ( expected == map.end() ) != ( element == image.end() ) )
+		{
+			return false;
+		}
+		return element == image.end() || ( element->first == expected->first
+			&& element->second == expected->second );
+	}
+
+	/*! \brief Do searches in an image agree with a map? */
+	template< typename Image >
+	static bool searches( const TestBTreeImage::Map& map,
+		const Image& image, unsigned int key )
+	{
+		if( !same( map, map.find( key ), image, image.find( key ) ) )
+		{
+			return false;
+		}
+		if( image.count( key ) != map.count( key ) )
+		{
+			return false;
+		}
+
+		typename Image::const_iterator element = image.lower_bound( key );
+		if( !same( map, map.lower_bound( key ), image, element ) )
+		{
+			return false;
+		}
+
+		typename Image::const_iterator upper = image.upper_bound( key );
+		if( !same( map, map.upper_bound( key ), image, upper ) )
+		{
+			return false;
+		}
+
+		return image.equal_range( key ) == std::make_pair( element, upper );
+	}
+
+	bool TestBTreeImage::testRandom()
+	{
+		status << "Running Test Random\n";
+
+		// Cover an empty image, a single block, and several levels
+		unsigned int sizes[] = { 0, 1, 15, 16, 17, 300, elements };
+		bool pass = true;
+
+		for( unsigned int size = 0;
+			size < sizeof( sizes ) / sizeof( unsigned int ) && pass; ++size )
+		{
+			Map map;
+			MemoryTree tree;
+
+			while( map.size() < sizes[ size ] )
+			{
+				unsigned int key = random() % ( 4 * sizes[ size ] );
+				map.insert( std::make_pair( key, key + size ) );
+				tree.insert( std::make_pair( key, key + size ) );
+			}
+
+			SmallImage::write( file, tree );
+			SmallImage image( file );
+
+			if( !matches( map, image ) )
+			{
+				status << " Image of " << sizes[ size ]
+					<< " elements does not match std::map.\n";
+				pass = false;
+			}
+
+			// An image does not care where it is, so read it in one word
+			//  past the start of a buffer
+			std::vector< unsigned long long > copy( image.bytes()
+				/ sizeof( unsigned long long ) + 2 );
+			{
+				std::ifstream in( file.c_str(), std::ios::binary );
+				in.read( reinterpret_cast< char* >( &copy[ 1 ] ),
+					image.bytes() );
+			}
+			SmallImage moved( &copy[ 1 ], image.bytes() );
+
+			for( unsigned int i = 0; i < iterations && pass; ++i )
+			{
+				unsigned int key = random() % ( 4 * sizes[ size ] + 2 );
+				if( !searches( map, image, key )
+					|| !searches( map, moved, key ) )
+				{
+					status << " Searching for " << key << " in an image of "
+						<< sizes[ size ] << " elements disagreed with "
+						<< "std::map.\n";
+					pass = false;
+				}
+			}
+
+			if( pass && !matches( map, moved ) )
+			{
+				status << " Copied image of " << sizes[ size ]
+					<< " elements does not match std::map.\n";
+				pass = false;
+			}
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Random Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBTreeImage::testLoad()
+	{
+		status << "Running Test Load\n";
+
+		std::vector< unsigned int > keys( elements );
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			*fi = random();
+		}
+
+		Map map;
+
+		{
+			MemoryTree tree;
+			for( std::vector< unsigned int >::iterator fi = keys.begin();
+				fi != keys.end(); ++fi )
+			{
+				tree.insert( std::make_pair( *fi, *fi / 2 ) );
+				map.insert( std::make_pair( *fi, *fi / 2 ) );
+			}
+			Image::write( file, tree );
+		}
+
+		hydrazine::Timer timer;
+		timer.start();
+
+		Image image( file );
+		unsigned int found = 0;
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			found += image.count( *fi );
+		}
+
+		timer.stop();
+		hydrazine::Timer::Second load = timer.seconds();
+
+		timer.start();
+
+		MemoryTree memory;
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			memory.insert( std::make_pair( *fi, *fi / 2 ) );
+		}
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			found += memory.count( *fi );
+		}
+
+		timer.stop();
+		hydrazine::Timer::Second rebuild = timer.seconds();
+
+		status << " Mapping an image of " << image.size() << " elements in "
+			<< image.bytes() << " bytes and finding each took "
+			<< ( load * 1000.0 ) << " ms, rebuilding a BTree took "
+			<< ( rebuild * 1000.0 ) << " ms\n";
+
+		bool pass = true;
+
+		if( found != 2 * elements )
+		{
+			status << " Only found " << found << " of " << 2 * elements
+				<< " keys.\n";
+			pass = false;
+		}
+
+		if( !matches( map, image ) )
+		{
+			status << " Mapped image does not match std::map.\n";
+			pass = false;
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Load Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBTreeImage::testInvalid()
+	{
+		status << "Running Test Invalid\n";
+
+		bool pass = true;
+
+		Map map;
+		for( unsigned int i = 0; i < 1000; ++i )
+		{
+			map.insert( std::make_pair( i, i ) );
+		}
+
+		Image::write( file, map );
+
+		try
+		{
+			SmallImage image( file );
+			status << " Opened an image with the wrong page size.\n";
+			pass = false;
+		}
+		catch( const hydrazine::Exception& e )
+		{
+			status << " Wrong page size: " << e.what() << "\n";
+		}
+
+		{
+			std::vector< char > bytes;
+			{
+				std::ifstream in( file.c_str(), std::ios::binary );
+				bytes.assign( std::istreambuf_iterator< char >( in ),
+					std::istreambuf_iterator< char >() );
+			}
+
+			std::ofstream out( file.c_str(),
+				std::ios::binary | std::ios::trunc );
+			out.write( &bytes[ 0 ], bytes.size() / 2 );
+		}
+
+		try
+		{
+			Image image( file );
+			status << " Opened a truncated image.\n";
+			pass = false;
+		}
+		catch( const hydrazine::Exception& e )
+		{
+			status << " Truncated: " << e.what() << "\n";
+		}
+
+		std::remove( file.c_str() );
+
+		{
+			std::ofstream out( file.c_str() );
+			for( unsigned int i = 0; i < 256; ++i )
+			{
+				out << "not an image";
+			}
+		}
+
+		try
+		{
+			Image image( file );
+			status << " Opened a file that is not an image.\n";
+			pass = false;
+		}
+		catch( const hydrazine::Exception& e )
+		{
+			status << " Not an image: " << e.what() << "\n";
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Invalid Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBTreeImage::doTest()
+	{
+		return testRandom() && testLoad() && testInvalid();
+	}
+
+	TestBTreeImage::TestBTreeImage()
+	{
+		name = "TestBTreeImage";
+		description = "A unit test and benchmark for BTreeImage. ";
+		description += "Test Points: 1) Write BTrees of several sizes as ";
+		description += "images with small pages, map them, and assert that ";
+		description += "they match a std::map and that searches agree with ";
+		description += "it, also for a copy of the image at another address. ";
+		description += "2) Time mapping a large image and finding every key ";
+		description += "against building a BTree, assert nothing was lost. ";
+		description += "3) Assert that opening an image with another page ";
+		description += "size, a file that is not an image, or a truncated ";
+		description += "image throws.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestBTreeImage test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-f", "--file", test.file, "TestBTreeImage.image",
+		"The file to write images to, it is removed afterwards." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys in the largest image." );
+	parser.parse( "-i", "--iterations", test.iterations, 10000,
+		"The number of random searches in each image." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
@@ -0,0 +1,67 @@
+/*!
+	\file TestBTreeImage.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestBTreeImage class.
+*/
+
+#ifndef TEST_BTREE_IMAGE_H_INCLUDED
+#define TEST_BTREE_IMAGE_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/BTreeImage.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for BTreeImage.
+
+		Test Points:
+
+			1) Write BTrees of several sizes as images with small pages and
+				map them.  Assert that they match a std::map forwards and
+				backwards, and that find, count, lower_bound, upper_bound,
+				and equal_range agree with it for random keys.  Copy each
+				image to another address and assert the same of a view of
+				the copy.
+
+			2) Write a large image.  Time mapping it and finding every key
+				against building a BTree with the same keys.  Assert that
+				nothing was lost.
+
+			3) Assert that opening an image with a different page size, a
+				file that is not an image, and a truncated image all throw.
+	*/
+	class TestBTreeImage : public Test
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+			typedef hydrazine::BTree< unsigned int, unsigned int > MemoryTree;
+			typedef hydrazine::BTreeImage< unsigned int, unsigned int,
+				std::less< unsigned int >, 128 > SmallImage;
+			typedef hydrazine::BTreeImage< unsigned int, unsigned int > Image;
+
+		private:
+			bool testRandom();
+			bool testLoad();
+			bool testInvalid();
+			bool doTest();
+
+		public:
+			std::string file;
+			unsigned int elements;
+			unsigned int iterations;
+
+		public:
+			TestBTreeImage();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
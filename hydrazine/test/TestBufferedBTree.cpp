@@ -0,0 +1,420 @@
+/*!
+	\file TestBufferedBTree.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestBufferedBTree class.
+*/
+
+#ifndef TEST_BUFFERED_B_TREE_CPP_INCLUDED
+#define TEST_BUFFERED_B_TREE_CPP_INCLUDED
+
+#include <hydrazine/test/TestBufferedBTree.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <vector>
+
+namespace test
+{
+
+	/*! \brief Do a tree and a map hold the same elements, in both
+		directions? */
+	template< typename Tree >
+	static bool matches( const TestBufferedBTree::Map& map,
+		Tree& tree )
+	{
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+
+		typename Tree::const_iterator element = tree.begin();
+		for( TestBufferedBTree::Map::const_iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element == tree.end() || element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		if( element != tree.end() )
+		{
+			return false;
+		}
+
+		typename Tree::const_reverse_iterator reverse = tree.rbegin();
+		for( TestBufferedBTree::Map::const_reverse_iterator
+			fi = map.rbegin(); fi != map.rend(); ++fi, ++reverse )
+		{
+			if( reverse == tree.rend() || reverse->first != fi->first )
+			{
+				return false;
+			}
+		}
+
+		return reverse == tree.rend();
+	}
+
+	bool TestBufferedBTree::testRandom()
+	{
+		status << "Running Test Random\n";
+
+		Map map;
+		SmallTree tree;
+		bool pass = true;
+
+		for( unsigned int i = 0; i < iterations && pass; ++i )
+		{
+			unsigned int key = random() % elements;
+
+			switch( random() % 6 )
+			{
+				case 0:
+				{
+					bool inserted = tree.insert(
+						std::make_pair( key, i ) ).second;
+					if( inserted != map.insert(
+						std::make_pair( key, i ) ).second )
+					{
+						status << " Insert of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+				case 1:
+				{
+					tree.insert_buffered( std::make_pair( key, i ) );
+					map.insert( std::make_pair( key, i ) );
+					break;
+				}
+				case 2:
+				{
+					if( tree.erase( key ) != map.erase( key ) )
+					{
+						status << " Erase of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+				case 3:
+				{
+					tree.erase_buffered( key );
+					map.erase( key );
+					break;
+				}
+				case 4:
+				{
+					tree[ key ] = i;
+					map[ key ] = i;
+					break;
+				}
+				case 5:
+				{
+					SmallTree::iterator element = tree.find( key );
+					Map::iterator expected = map.find( key );
+					if( ( element == tree.end() )
+						!= ( expected == map.end() ) || ( element
+						!= tree.end() && element->second
+						!= expected->second ) )
+					{
+						status << " Find of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+
+					// const lookups search the buffers in place
+					const SmallTree& reader = tree;
+					SmallTree::const_iterator read = reader.find( key );
+					if( read != element 
+						|| reader.count( key ) != map.count( key ) )
+					{
+						status << " Const find of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+			}
+
+			if( ( i + 1 ) % ( iterations / 8 + 1 ) == 0 )
+			{
+				SmallTree copy( tree );
+
+				if( !matches( map, copy ) )
+				{
+					status << " Copied tree does not match std::map after "
+						<< ( i + 1 ) << " operations.\n";
+					pass = false;
+				}
+
+				if( !matches( map, tree ) )
+				{
+					status << " Tree does not match std::map after "
+						<< ( i + 1 ) << " operations.\n";
+					pass = false;
+				}
+			}
+		}
+
+		if( pass && !matches( map, tree ) )
+		{
+			status << " Final tree does not match std::map.\n";
+			pass = false;
+		}
+
+		for( Map::iterator fi = map.begin(); fi != map.end() && pass; ++fi )
+		{
+			tree.erase_buffered( fi->first );
+		}
+
+		if( pass && ( !tree.empty() || tree.begin() != tree.end() ) )
+		{
+			status << " Tree is not empty after erasing every key.\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			status << "Test Random Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBufferedBTree::testOrdered()
+	{
+		status << "Running Test Ordered\n";
+
+		Map map;
+		SmallTree tree;
+		bool pass = true;
+
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			unsigned int key = random() % ( 4 * elements );
+			map.insert( std::make_pair( key, i ) );
+			tree.insert_buffered( std::make_pair( key, i ) );
+		}
+
+		for( unsigned int i = 0; i < elements && pass; ++i )
+		{
+			unsigned int key = random() % ( 4 * elements );
+
+			Map::iterator lower = map.lower_bound( key );
+			SmallTree::iterator treeLower = tree.lower_bound( key );
+			if( ( lower == map.end() ) != ( treeLower == tree.end() )
+				|| ( lower != map.end() && lower->first != treeLower->first ) )
+			{
+				status << " lower_bound of " << key
+					<< " disagreed with std::map.\n";
+				pass = false;
+			}
+
+			Map::iterator upper = map.upper_bound( key );
+			SmallTree::iterator treeUpper = tree.upper_bound( key );
+			if( ( upper == map.end() ) != ( treeUpper == tree.end() )
+				|| ( upper != map.end() && upper->first != treeUpper->first ) )
+			{
+				status << " upper_bound of " << key
+					<< " disagreed with std::map.\n";
+				pass = false;
+			}
+
+			std::pair< SmallTree::iterator, SmallTree::iterator > range
+				= tree.equal_range( key );
+			if( range.first != treeLower || range.second != treeUpper )
+			{
+				status << " equal_range of " << key
+					<< " disagreed with lower_bound and upper_bound.\n";
+				pass = false;
+			}
+
+			// Writes leave messages behind, so the next search must apply
+			//  them before it walks the leaves
+			if( i % 2 == 0 )
+			{
+				tree.erase_buffered( key );
+				tree.insert_buffered( std::make_pair( key + 1, i ) );
+				map.erase( key );
+				map.insert( std::make_pair( key + 1, i ) );
+			}
+		}
+
+		if( pass && !matches( map, tree ) )
+		{
+			status << " Tree does not match std::map after searching.\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			unsigned int first = random() % ( 4 * elements );
+			unsigned int last = first + random() % elements;
+
+			map.erase( map.lower_bound( first ), map.lower_bound( last ) );
+			tree.erase( tree.lower_bound( first ), tree.lower_bound( last ) );
+
+			if( !matches( map, tree ) )
+			{
+				status << " Erasing [" << first << ", " << last
+					<< ") disagreed with std::map.\n";
+				pass = false;
+			}
+		}
+
+		SmallTree copy( tree );
+
+		if( pass && ( copy != tree || copy < tree || tree < copy
+			|| !( copy <= tree ) || !( copy >= tree ) ) )
+		{
+			status << " A copy does not compare equal to the tree.\n";
+			pass = false;
+		}
+
+		copy.insert_buffered( std::make_pair( 4 * elements, 0 ) );
+
+		if( pass && ( copy == tree || !( tree < copy ) || !( copy > tree ) ) )
+		{
+			status << " A larger copy does not compare greater.\n";
+			pass = false;
+		}
+
+		SmallTree empty;
+		empty.swap( tree );
+
+		if( pass && ( !tree.empty() || !matches( map, empty ) ) )
+		{
+			status << " Swap did not exchange the trees.\n";
+			pass = false;
+		}
+
+		empty.clear();
+
+		if( pass && ( !empty.empty() || empty.begin() != empty.end()
+			|| empty.find( map.begin()->first ) != empty.end() ) )
+		{
+			status << " Cleared tree is not empty.\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			status << "Test Ordered Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBufferedBTree::testInsertHeavy()
+	{
+		status << "Running Test Insert Heavy\n";
+
+		std::vector< unsigned int > keys( elements );
+		for( std::vector< unsigned int >::iterator key = keys.begin();
+			key != keys.end(); ++key )
+		{
+			*key = random();
+		}
+
+		MemoryTree reference;
+		Tree tree;
+		Tree blind;
+		hydrazine::Timer timer;
+
+		timer.start();
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			reference.insert( std::make_pair( keys[ i ], i ) );
+		}
+		timer.stop();
+		hydrazine::Timer::Second btree = timer.seconds();
+
+		timer.start();
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			tree.insert( std::make_pair( keys[ i ], i ) );
+		}
+		tree.flush();
+		timer.stop();
+		hydrazine::Timer::Second buffered = timer.seconds();
+
+		timer.start();
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			blind.insert_buffered( std::make_pair( keys[ i ], i ) );
+		}
+		blind.flush();
+		timer.stop();
+		hydrazine::Timer::Second unchecked = timer.seconds();
+
+		status << " Inserting " << elements << " random keys took "
+			<< ( btree * 1.0e9 / elements ) << " ns/op in a BTree, "
+			<< ( buffered * 1.0e9 / elements )
+			<< " ns/op with insert, and " << ( unchecked * 1.0e9 / elements )
+			<< " ns/op with insert_buffered.\n";
+
+		bool pass = reference.size() == tree.size()
+			&& reference.size() == blind.size()
+			&& std::equal( reference.begin(), reference.end(), tree.begin() )
+			&& std::equal( reference.begin(), reference.end(), blind.begin() );
+
+		if( !pass )
+		{
+			status << " The trees do not hold the same elements.\n";
+		}
+		else
+		{
+			status << "Test Insert Heavy Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestBufferedBTree::doTest()
+	{
+		return testRandom() && testOrdered() && testInsertHeavy();
+	}
+
+	TestBufferedBTree::TestBufferedBTree()
+	{
+		name = "TestBufferedBTree";
+		description = "A unit test and benchmark for BufferedBTree. ";
+		description += "Test Points: 1) Randomly insert, erase, and find ";
+		description += "in a tree with small pages and a std::map, with and ";
+		description += "without lookups before writes and through a const ";
+		description += "reference, assert that they ";
+		description += "always match. 2) Assert that lower_bound, ";
+		description += "upper_bound, equal_range, range erase, comparisons, ";
+		description += "swap, and clear agree with std::map. 3) Time random ";
+		description += "inserts into a BTree and a BufferedBTree, assert ";
+		description += "that they hold the same elements.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestBufferedBTree test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys in each tree." );
+	parser.parse( "-i", "--iterations", test.iterations, 100000,
+		"The number of random operations in the random test." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
@@ -0,0 +1,68 @@
+/*!
+	\file TestBufferedBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestBufferedBTree class.
+*/
+
+#ifndef TEST_BUFFERED_B_TREE_H_INCLUDED
+#define TEST_BUFFERED_B_TREE_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/implementation/BufferedBTree.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for BufferedBTree.
+
+		Test Points:
+
+			1) Randomly insert, erase, and look up keys in a tree with small
+				pages and in a std::map, with and without looking keys up
+				before writing them, and through a const reference.  Now
+				and then walk the tree, copy it, and search it in order.
+				Assert that it always matches.
+
+			2) Fill a tree and a std::map, then assert that lower_bound,
+				upper_bound, equal_range, erasing ranges, the comparison
+				operators, swap, and clear all agree with std::map.
+
+			3) Insert random keys into a BTree and a BufferedBTree, with and
+				without lookups, and time them.  Assert that they end up with
+				the same elements.
+	*/
+	class TestBufferedBTree : public Test
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+			typedef hydrazine::BufferedBTree< unsigned int, unsigned int,
+				std::less< unsigned int >, std::allocator< std::pair<
+				const unsigned int, unsigned int > >, 128 > SmallTree;
+			typedef hydrazine::BufferedBTree< unsigned int, unsigned int >
+				Tree;
+			typedef hydrazine::BTree< unsigned int, unsigned int > MemoryTree;
+
+		private:
+			bool testRandom();
+			bool testOrdered();
+			bool testInsertHeavy();
+			bool doTest();
+
+		public:
+			unsigned int elements;
+			unsigned int iterations;
+
+		public:
+			TestBufferedBTree();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
@@ -0,0 +1,582 @@
+/*!
+	\file TestChannel.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestChannel class.
+*/
+
+#ifndef TEST_CHANNEL_CPP_INCLUDED
+#define TEST_CHANNEL_CPP_INCLUDED
+
+#include <hydrazine/test/TestChannel.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <hydrazine/implementation/Timer.h>
+
+#include <algorithm>
+#include <string>
+
+namespace test
+{
+
+	bool ThrowingItem::armed = false;
+
+	/*! \brief The next of a simple sequence of random numbers */
+	static unsigned int next( unsigned int& seed )
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+
+		return seed;
+	}
+
+	template< typename Channel >
+	void SenderThread< Channel >::execute()
+	{
+		std::vector< unsigned long long > items;
+		unsigned long long value = begin;
+
+		while( value < end )
+		{
+			if( next( seed ) % 2 == 0 )
+			{
+				channel->send( value++ );
+				continue;
+			}
+
+			size_t size = std::min( ( unsigned long long ) next( seed )
+				% batch + 1, end - value );
+
+			items.resize( size );
+
+			for( size_t i = 0; i < size; ++i )
+			{
+				items[ i ] = value++;
+			}
+
+			channel->send_batch( &items[ 0 ], size );
+		}
+
+		channel->close();
+	}
+
+	template< typename Channel >
+	void ReceiverThread< Channel >::execute()
+	{
+		std::vector< unsigned long long > items( batch );
+		std::vector< unsigned long long > expected;
+		unsigned int seed = id();
+
+		received = 0;
+		sum = 0;
+		ordered = true;
+
+		while( true )
+		{
+			size_t size = 0;
+
+			if( next( seed ) % 2 == 0 )
+			{
+				size = channel->receive( items[ 0 ] ) ? 1 : 0;
+			}
+			else
+			{
+				size = channel->receive_batch( &items[ 0 ],
+					next( seed ) % batch + 1 );
+			}
+
+			if( size == 0 )
+			{
+				break;
+			}
+
+			for( size_t i = 0; i < size; ++i )
+			{
+				size_t sender = items[ i ] / range;
+
+				if( sender >= expected.size() )
+				{
+					expected.resize( sender + 1, 0 );
+				}
+
+				if( items[ i ] < sender * range + expected[ sender ] )
+				{
+					ordered = false;
+				}
+
+				expected[ sender ] = items[ i ] - sender * range + 1;
+				sum += items[ i ];
+			}
+
+			received += size;
+		}
+	}
+
+	void SquareThread::process( InputVector& inputs, OutputVector& outputs )
+	{
+		for( InputVector::iterator input = inputs.begin();
+			input != inputs.end(); ++input )
+		{
+			outputs.push_back( *input * *input );
+		}
+	}
+
+	SumThread::SumThread() : sum( 0 )
+	{
+
+	}
+
+	void SumThread::process( InputVector& inputs, OutputVector& outputs )
+	{
+		for( InputVector::iterator input = inputs.begin();
+			input != inputs.end(); ++input )
+		{
+			sum += *input;
+		}
+	}
+
+	void MessageThread::execute()
+	{
+		for( unsigned int i = 0; i < messages; ++i )
+		{
+			unsigned long long* value = 0;
+			threadReceive( value );
+		}
+	}
+
+	bool TestChannel::testSingle()
+	{
+		status << "Running Test Single\n";
+
+		SpscChannel channel( capacity );
+		SenderThread< SpscChannel > sender;
+		ReceiverThread< SpscChannel > receiver;
+
+		sender.channel = &channel;
+		sender.begin = 0;
+		sender.end = values;
+		sender.batch = batch;
+		sender.seed = random() | 1;
+
+		receiver.channel = &channel;
+		receiver.batch = batch;
+		receiver.range = values;
+
+		sender.start();
+		receiver.start();
+
+		sender.join();
+		receiver.join();
+
+		unsigned long long expected = ( unsigned long long ) values
+			* ( values - 1 ) / 2;
+
+		if( receiver.received != values || receiver.sum != expected
+			|| !receiver.ordered )
+		{
+			status << " Received " << receiver.received << " of " << values
+				<< " values summing to " << receiver.sum << ", expected "
+				<< expected << ( receiver.ordered ? "." : ", out of order." )
+				<< "\n";
+			return false;
+		}
+
+		status << "Test Single Passed\n";
+
+		return true;
+	}
+
+	bool TestChannel::testMultiple()
+	{
+		status << "Running Test Multiple\n";
+
+		MpmcChannel channel( capacity, threads );
+		std::vector< SenderThread< MpmcChannel > > senders( threads );
+		std::vector< ReceiverThread< MpmcChannel > > receivers( threads );
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			senders[ i ].channel = &channel;
+			senders[ i ].begin = ( unsigned long long ) i * values;
+			senders[ i ].end = ( unsigned long long ) ( i + 1 ) * values;
+			senders[ i ].batch = batch;
+			senders[ i ].seed = random() | 1;
+
+			receivers[ i ].channel = &channel;
+			receivers[ i ].batch = batch;
+			receivers[ i ].range = values;
+		}
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			senders[ i ].start();
+			receivers[ i ].start();
+		}
+
+		unsigned long long received = 0;
+		unsigned long long sum = 0;
+		bool pass = true;
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			senders[ i ].join();
+			receivers[ i ].join();
+
+			received += receivers[ i ].received;
+			sum += receivers[ i ].sum;
+
+			if( !receivers[ i ].ordered )
+			{
+				status << " Receiver " << i << " saw the values of a sender "
+					<< "out of order.\n";
+				pass = false;
+			}
+		}
+
+		unsigned long long total = ( unsigned long long ) values * threads;
+		unsigned long long expected = total * ( total - 1 ) / 2;
+
+		if( received != total || sum != expected )
+		{
+			status << " Received " << received << " of " << total
+				<< " values summing to " << sum << ", expected " << expected
+				<< ".\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			status << "Test Multiple Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestChannel::testTry()
+	{
+		status << "Running Test Try\n";
+
+		typedef hydrazine::Channel< std::string > StringChannel;
+
+		StringChannel channel( capacity );
+		std::string item;
+
+		if( channel.try_receive( item ) )
+		{
+			status << " Received from an empty channel.\n";
+			return false;
+		}
+
+		unsigned int sent = 0;
+
+		while( true )
+		{
+			std::string text( 64, 'a' + sent % 26 );
+
+			if( !channel.try_send( std::move( text ) ) )
+			{
+				if( text.size() != 64 )
+				{
+					status << " A failed try_send moved from its item.\n";
+					return false;
+				}
+
+				break;
+			}
+
+			++sent;
+		}
+
+		if( sent != channel.capacity() )
+		{
+			status << " A channel with a capacity of " << channel.capacity()
+				<< " held " << sent << " items.\n";
+			return false;
+		}
+
+		std::vector< std::string > items( 3 );
+
+		if( channel.try_receive_batch( &items[ 0 ], 3 ) != std::min( 3u,
+			sent ) || items[ 0 ] != std::string( 64, 'a' ) )
+		{
+			status << " Received the wrong batch from a full channel.\n";
+			return false;
+		}
+
+		channel.close();
+
+		if( channel.send( std::string( "closed" ) )
+			|| channel.try_send_batch( &items[ 0 ], 3 ) != 0 )
+		{
+			status << " Sent to a closed channel.\n";
+			return false;
+		}
+
+		if( sent > 3 )
+		{
+			if( !channel.receive( item ) || item != std::string( 64, 'd' ) )
+			{
+				status << " A closed channel did not deliver what it held.\n";
+				return false;
+			}
+		}
+
+		// The first channel is destroyed with items still in it
+		StringChannel drained( 4 );
+		drained.send( std::string( 100, 'x' ) );
+		drained.close();
+
+		if( !drained.receive( item ) || drained.receive( item )
+			|| drained.receive_batch( &items[ 0 ], 3 ) != 0 )
+		{
+			status << " A closed channel did not fail once empty.\n";
+			return false;
+		}
+
+		hydrazine::Channel< ThrowingItem > throwing( 4 );
+		unsigned int threw = 0;
+
+		for( unsigned int i = 0; i < 3 * throwing.capacity(); ++i )
+		{
+			ThrowingItem value( i );
+			ThrowingItem::armed = i % 3 == 1;
+
+			try
+			{
+				throwing.send( value );
+			}
+			catch( const hydrazine::Exception& )
+			{
+				++threw;
+			}
+
+			ThrowingItem::armed = false;
+
+			if( i % 3 == 2 )
+			{
+				ThrowingItem first;
+				ThrowingItem second;
+
+				if( !throwing.try_receive( first )
+					|| !throwing.try_receive( second )
+					|| throwing.try_receive( first )
+					|| first.value != i - 2 || second.value != i )
+				{
+					status << " A copy that threw wedged a channel.\n";
+					return false;
+				}
+			}
+		}
+
+		if( threw != throwing.capacity() )
+		{
+			status << " Only " << threw << " armed copies threw.\n";
+			return false;
+		}
+
+		status << "Test Try Passed\n";
+
+		return true;
+	}
+
+	bool TestChannel::testPipeline()
+	{
+		status << "Running Test Pipeline\n";
+
+		MpmcChannel inputs( capacity );
+		MpmcChannel squares( capacity, threads );
+		std::vector< SquareThread > squarers( threads );
+		SumThread summer;
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			squarers[ i ].connect( &inputs, &squares, batch );
+			squarers[ i ].start();
+		}
+
+		summer.connect( &squares, 0, batch );
+		summer.start();
+
+		std::vector< unsigned long long > items;
+		unsigned long long expected = 0;
+
+		for( unsigned long long value = 0; value < values; )
+		{
+			size_t size = std::min( ( unsigned long long ) random() % batch
+				+ 1, values - value );
+
+			items.resize( size );
+
+			for( size_t i = 0; i < size; ++i, ++value )
+			{
+				items[ i ] = value;
+				expected += value * value;
+			}
+
+			inputs.send_batch( &items[ 0 ], size );
+		}
+
+		inputs.close();
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			squarers[ i ].join();
+		}
+
+		summer.join();
+
+		if( summer.sum != expected )
+		{
+			status << " The pipeline summed to " << summer.sum
+				<< ", expected " << expected << ".\n";
+			return false;
+		}
+
+		status << "Test Pipeline Passed\n";
+
+		return true;
+	}
+
+	bool TestChannel::testBenchmark()
+	{
+		status << "Running Test Benchmark\n";
+
+		hydrazine::Timer timer;
+		unsigned long long value = 0;
+
+		MessageThread thread;
+		thread.messages = values;
+
+		timer.start();
+		thread.start();
+
+		for( unsigned int i = 0; i < values; ++i )
+		{
+			thread.send( &value );
+		}
+
+		thread.join();
+		timer.stop();
+
+		hydrazine::Timer::Second messages = timer.seconds();
+
+		hydrazine::Timer::Second single = 0;
+		hydrazine::Timer::Second batched = 0;
+
+		for( unsigned int pass = 0; pass < 2; ++pass )
+		{
+			unsigned int b = pass == 0 ? 1 : batch;
+
+			SpscChannel channel( capacity );
+			ReceiverThread< SpscChannel > receiver;
+
+			receiver.channel = &channel;
+			receiver.batch = b;
+			receiver.range = values;
+
+			std::vector< unsigned long long > items( b );
+
+			timer.start();
+			receiver.start();
+
+			for( unsigned long long v = 0; v < values; )
+			{
+				size_t size = std::min( ( unsigned long long ) b,
+					values - v );
+
+				for( size_t i = 0; i < size; ++i, ++v )
+				{
+					items[ i ] = v;
+				}
+
+				channel.send_batch( &items[ 0 ], size );
+			}
+
+			channel.close();
+			receiver.join();
+			timer.stop();
+
+			if( receiver.received != values )
+			{
+				status << " The channel delivered " << receiver.received
+					<< " of " << values << " values.\n";
+				return false;
+			}
+
+			if( pass == 0 )
+			{
+				single = timer.seconds();
+			}
+			else
+			{
+				batched = timer.seconds();
+			}
+		}
+
+		status << " " << values << " values took " << messages
+			<< "s as Thread messages, " << single
+			<< "s through a channel one at a time, and " << batched
+			<< "s in batches of up to " << batch << ".\n";
+
+		status << "Test Benchmark Passed\n";
+
+		return true;
+	}
+
+	bool TestChannel::doTest()
+	{
+		values = std::max( values, 1u );
+		batch = std::max( batch, 1u );
+		threads = std::max( threads, 1u );
+
+		return testSingle() && testMultiple() && testTry() && testPipeline()
+			&& testBenchmark();
+	}
+
+	TestChannel::TestChannel()
+	{
+		name = "TestChannel";
+		description = "A unit test and benchmark for Channel. Test Points: ";
+		description += "1) Send values through a single producer single ";
+		description += "consumer channel with single sends and batches and ";
+		description += "check that they arrive in order. 2) Send and ";
+		description += "receive with several threads on a multiple ";
+		description += "producer multiple consumer channel and check that ";
+		description += "every value arrives once and in order per sender. ";
+		description += "3) Check try_send and try_receive on full, empty, ";
+		description += "and closed channels, and that copies that throw ";
+		description += "leave a channel working. 4) Sum squares with a ";
+		description += "pipeline of PipelineThreads. 5) Time Thread messages ";
+		description += "against a channel with single items and with ";
+		description += "batches.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestChannel test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-n", "--values", test.values, 100000,
+		"The number of values that each sender sends." );
+	parser.parse( "-c", "--capacity", test.capacity, 64,
+		"The capacity of each channel." );
+	parser.parse( "-b", "--batch", test.batch, 32,
+		"The largest batch to send or receive." );
+	parser.parse( "-t", "--threads", test.threads, 4,
+		"The number of senders, receivers, and pipeline stage threads." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
@@ -0,0 +1,176 @@
+/*!
+	\file TestChannel.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestChannel class.
+*/
+
+#ifndef TEST_CHANNEL_H_INCLUDED
+#define TEST_CHANNEL_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/interface/Channel.h>
+#include <hydrazine/interface/PipelineThread.h>
+
+#include <vector>
+
+namespace test
+{
+
+	typedef hydrazine::Channel< unsigned long long,
+		hydrazine::SingleProducerSingleConsumer > SpscChannel;
+	typedef hydrazine::Channel< unsigned long long > MpmcChannel;
+
+	/*! \brief An item whose copies throw while it is armed */
+	class ThrowingItem
+	{
+		public:
+			static bool armed;
+
+		public:
+			unsigned int value;
+
+		public:
+			ThrowingItem( unsigned int v = 0 ) : value( v ) {}
+
+			ThrowingItem( const ThrowingItem& i ) : value( i.value )
+			{
+				if( armed )
+				{
+					throw hydrazine::Exception( "Copied an armed item." );
+				}
+			}
+
+			ThrowingItem( ThrowingItem&& i ) noexcept : value( i.value ) {}
+
+			ThrowingItem& operator=( ThrowingItem&& i ) noexcept
+			{
+				value = i.value;
+				return *this;
+			}
+	};
+
+	/*! \brief Send a range of values to a channel, alternating between
+		single sends and batches of random sizes */
+	template< typename Channel >
+	class SenderThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+
+		public:
+			Channel* channel;
+			unsigned long long begin;
+			unsigned long long end;
+			unsigned int batch;
+			unsigned int seed;
+	};
+
+	/*! \brief Receive from a channel until it closes, checking that the
+		values from each sender arrive in order */
+	template< typename Channel >
+	class ReceiverThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+
+		public:
+			Channel* channel;
+			unsigned int batch;
+			/*! \brief The size of the range of each sender */
+			unsigned long long range;
+			unsigned long long received;
+			unsigned long long sum;
+			bool ordered;
+	};
+
+	/*! \brief Square every value */
+	class SquareThread : public hydrazine::PipelineThread< MpmcChannel,
+		MpmcChannel >
+	{
+		protected:
+			void process( InputVector& inputs, OutputVector& outputs );
+	};
+
+	/*! \brief Sum every value at the end of a pipeline */
+	class SumThread : public hydrazine::PipelineThread< MpmcChannel,
+		MpmcChannel >
+	{
+		protected:
+			void process( InputVector& inputs, OutputVector& outputs );
+
+		public:
+			unsigned long long sum;
+
+		public:
+			SumThread();
+	};
+
+	/*! \brief Receive a number of Thread messages */
+	class MessageThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+
+		public:
+			unsigned int messages;
+	};
+
+	/*!
+		\brief A unit test and benchmark for Channel.
+
+		Test Points:
+
+			1) Send a range of values through a small single producer
+				single consumer channel with single sends and random
+				batches, receiving with single receives and random batches.
+				Assert that every value arrives in order.
+
+			2) Start several senders and receivers on a small multiple
+				producer multiple consumer channel.  Assert that every
+				value is received once, and that each receiver sees the
+				values of each sender in order.
+
+			3) Fill a channel of strings with try_send until it fails,
+				and assert that it held exactly its capacity and that a
+				failed try_send leaves its item alone.  Assert that
+				try_receive fails on an empty channel, that a closed
+				channel refuses sends and is drained before receives fail,
+				and that items left in a channel are destroyed with it.
+				Send copies of items that throw and assert that the
+				channel still delivers the others in order.
+
+			4) Run a pipeline of PipelineThreads that square values in
+				several threads and sum them in another, and assert that
+				the sum is correct.
+
+			5) Time sending values as Thread messages against sending
+				them through a channel one at a time and in batches.
+	*/
+	class TestChannel : public Test
+	{
+		private:
+			bool testSingle();
+			bool testMultiple();
+			bool testTry();
+			bool testPipeline();
+			bool testBenchmark();
+			bool doTest();
+
+		public:
+			unsigned int values;
+			unsigned int capacity;
+			unsigned int batch;
+			unsigned int threads;
+
+		public:
+			TestChannel();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
@@ -0,0 +1,551 @@
+/*!
+	\file TestConcurrentBTree.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestConcurrentBTree class.
+*/
+
+#ifndef TEST_CONCURRENT_B_TREE_CPP_INCLUDED
+#define TEST_CONCURRENT_B_TREE_CPP_INCLUDED
+
+#include <hydrazine/test/TestConcurrentBTree.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <hydrazine/interface/SystemCompatibility.h>
+#include <algorithm>
+
+namespace test
+{
+
+	std::atomic< long long > LiveCounter::live( 0 );
+
+	/*! \brief Check that a scan hands out strictly increasing keys */
+	class OrderCheck
+	{
+		public:
+			unsigned int* last;
+			bool* ordered;
+			bool* first;
+
+		public:
+			void operator()( unsigned int key, unsigned int )
+			{
+				if( !*first && key <= *last )
+				{
+					*ordered = false;
+				}
+				*first = false;
+				*last = key;
+			}
+	};
+
+	unsigned int TreeThread::_random()
+	{
+		// xorshift, random() takes a lock
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	void TreeThread::_insert()
+	{
+		for( unsigned int i = index; i < elements; i += threads )
+		{
+			if( !tree->insert( std::make_pair( i, i ) ) )
+			{
+				failed = true;
+			}
+			unsigned int value = 0;
+			if( !tree->find( i, value ) || value != i )
+			{
+				failed = true;
+			}
+		}
+	}
+
+	void TreeThread::_mixed()
+	{
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int key = _random() % elements;
+			key = key - key % threads + index;
+
+			if( _random() % 2 )
+			{
+				bool inserted = tree->insert( std::make_pair( key, i ) );
+				if( inserted != expected.insert(
+					std::make_pair( key, i ) ).second )
+				{
+					failed = true;
+				}
+			}
+			else
+			{
+				if( tree->erase( key ) != ( expected.erase( key ) == 1 ) )
+				{
+					failed = true;
+				}
+			}
+		}
+	}
+
+	template< typename Tree >
+	void TreeThread::_scan( Tree& tree )
+	{
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int last = 0;
+			bool ordered = true;
+			bool first = true;
+			OrderCheck check = { &last, &ordered, &first };
+
+			unsigned int lower = _random() % elements;
+			found += tree.scan( lower, lower + elements / 8, check );
+			if( !ordered || ( !first && last < lower ) )
+			{
+				failed = true;
+			}
+		}
+	}
+
+	void TreeThread::_lookup()
+	{
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int value;
+			found += tree->find( _random() % elements, value );
+		}
+	}
+
+	void TreeThread::_lockedLookup()
+	{
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int key = _random() % elements;
+			boost::mutex::scoped_lock lock( locked->mutex );
+			found += locked->tree.find( key ) != locked->tree.end();
+		}
+	}
+
+	void TreeThread::_window()
+	{
+		for( unsigned int i = index; i < elements; i += threads )
+		{
+			if( !live->insert( std::make_pair( i, i ) ) )
+			{
+				failed = true;
+			}
+			// window is a multiple of threads, this thread owns the key
+			if( i >= window && !live->erase( i - window ) )
+			{
+				failed = true;
+			}
+		}
+	}
+
+	void TreeThread::execute()
+	{
+		switch( mode )
+		{
+			case Insert: _insert(); break;
+			case Mixed: _mixed(); break;
+			case Scan: _scan( *tree ); break;
+			case Lookup: _lookup(); break;
+			case LockedLookup: _lockedLookup(); break;
+			case Window: _window(); break;
+			case WindowScan: _scan( *live ); break;
+		}
+	}
+
+	static void initialize( TreeThread* workers, unsigned int threads,
+		TreeThread::Mode mode, ConcurrentTree* tree, unsigned int elements,
+		unsigned int iterations )
+	{
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			workers[ i ].mode = mode;
+			workers[ i ].tree = tree;
+			workers[ i ].locked = 0;
+			workers[ i ].live = 0;
+			workers[ i ].index = i;
+			workers[ i ].threads = threads;
+			workers[ i ].elements = elements;
+			workers[ i ].iterations = iterations;
+			workers[ i ].window = 0;
+			workers[ i ].state = random() | 1;
+			workers[ i ].failed = false;
+			workers[ i ].found = 0;
+		}
+	}
+
+	bool TestConcurrentBTree::testInsert()
+	{
+		status << "Running Test Insert\n";
+
+		ConcurrentTree tree;
+		TreeThread* workers = new TreeThread[ threads ];
+		initialize( workers, threads, TreeThread::Insert, &tree, elements,
+			iterations );
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			workers[ i ].start();
+		}
+
+		bool pass = true;
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			workers[ i ].join();
+			if( workers[ i ].failed )
+			{
+				status << " Thread " << i << " could not find a key it "
+					<< "inserted.\n";
+				pass = false;
+			}
+		}
+
+		delete[] workers;
+
+		if( tree.size() != elements )
+		{
+			status << " Tree size " << tree.size() << " does not match "
+				<< elements << " inserted elements.\n";
+			pass = false;
+		}
+
+		unsigned int last = 0;
+		bool ordered = true;
+		bool first = true;
+		OrderCheck check = { &last, &ordered, &first };
+
+		unsigned int scanned = tree.scan( 0, elements, check );
+
+		if( scanned != elements || !ordered )
+		{
+			status << " Scanned " << scanned << " of " << elements
+				<< " elements, in order " << std::boolalpha << ordered
+				<< ".\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			status << "Test Insert Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestConcurrentBTree::testMixed()
+	{
+		status << "Running Test Mixed\n";
+
+		ConcurrentTree tree;
+		TreeThread* writers = new TreeThread[ threads ];
+		TreeThread* scanners = new TreeThread[ threads ];
+		initialize( writers, threads, TreeThread::Mixed, &tree, elements,
+			iterations );
+		initialize( scanners, threads, TreeThread::Scan, &tree, elements,
+			iterations / 64 + 1 );
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			writers[ i ].start();
+			scanners[ i ].start();
+		}
+
+		bool pass = true;
+		TreeThread::Map expected;
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			writers[ i ].join();
+			scanners[ i ].join();
+			if( writers[ i ].failed )
+			{
+				status << " Writer " << i << " saw an insert or erase "
+					<< "disagree with its own std::map.\n";
+				pass = false;
+			}
+			if( scanners[ i ].failed )
+			{
+				status << " Scanner " << i << " saw keys out of order.\n";
+				pass = false;
+			}
+			expected.insert( writers[ i ].expected.begin(),
+				writers[ i ].expected.end() );
+		}
+
+		delete[] writers;
+		delete[] scanners;
+
+		if( tree.size() != expected.size() )
+		{
+			status << " Tree size " << tree.size() << " does not match "
+				<< "map size " << expected.size() << ".\n";
+			pass = false;
+		}
+
+		for( TreeThread::Map::iterator fi = expected.begin();
+			fi != expected.end() && pass; ++fi )
+		{
+			unsigned int value = 0;
+			if( !tree.find( fi->first, value ) || value != fi->second )
+			{
+				status << " Key " << fi->first << " with value "
+					<< fi->second << " is missing from the tree.\n";
+				pass = false;
+			}
+		}
+
+		if( pass )
+		{
+			status << "Test Mixed Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestConcurrentBTree::testScaling()
+	{
+		status << "Running Test Scaling\n";
+
+		ConcurrentTree tree;
+		LockedTree locked;
+
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			tree.insert( std::make_pair( i, i ) );
+			locked.tree.insert( std::make_pair( i, i ) );
+		}
+
+		unsigned int maximum = hydrazine::getHardwareThreadCount();
+		bool pass = true;
+
+		for( unsigned int count = 1; ;
+			count = std::min( 2 * count, maximum ) )
+		{
+			hydrazine::Timer::Second seconds[ 2 ];
+			TreeThread::Mode modes[ 2 ] = { TreeThread::Lookup,
+				TreeThread::LockedLookup };
+
+			for( unsigned int m = 0; m < 2; ++m )
+			{
+				TreeThread* workers = new TreeThread[ count ];
+				initialize( workers, count, modes[ m ], &tree, elements,
+					lookups );
+
+				hydrazine::Timer timer;
+				timer.start();
+
+				for( unsigned int i = 0; i < count; ++i )
+				{
+					workers[ i ].locked = &locked;
+					workers[ i ].start();
+				}
+
+				for( unsigned int i = 0; i < count; ++i )
+				{
+					workers[ i ].join();
+					if( workers[ i ].found != lookups )
+					{
+						status << " Thread " << i << " only found "
+							<< workers[ i ].found << " of " << lookups
+							<< " keys.\n";
+						pass = false;
+					}
+				}
+
+				timer.stop();
+				seconds[ m ] = timer.seconds();
+				delete[] workers;
+			}
+
+			status << " " << count << " threads: concurrent "
+				<< ( count * lookups / seconds[ 0 ] / 1.0e6 )
+				<< " Mops/s, locked "
+				<< ( count * lookups / seconds[ 1 ] / 1.0e6 )
+				<< " Mops/s\n";
+
+			if( count >= maximum )
+			{
+				break;
+			}
+		}
+
+		if( pass )
+		{
+			status << "Test Scaling Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestConcurrentBTree::testReclaim()
+	{
+		status << "Running Test Reclaim\n";
+
+		unsigned int window = std::max( elements / 16 / threads, 1u )
+			* threads;
+		bool pass = true;
+
+		long long empty = LiveCounter::live;
+
+		LiveTree fresh;
+		for( unsigned int i = 0; i < window; ++i )
+		{
+			fresh.insert( std::make_pair( i, i ) );
+		}
+
+		long long needed = LiveCounter::live - empty;
+
+		LiveTree tree;
+		long long before = LiveCounter::live;
+
+		TreeThread* writers = new TreeThread[ threads ];
+		TreeThread* scanners = new TreeThread[ threads ];
+		initialize( writers, threads, TreeThread::Window, 0, elements,
+			iterations );
+		initialize( scanners, threads, TreeThread::WindowScan, 0, elements,
+			iterations / 64 + 1 );
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			writers[ i ].live = &tree;
+			writers[ i ].window = window;
+			scanners[ i ].live = &tree;
+			writers[ i ].start();
+			scanners[ i ].start();
+		}
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			writers[ i ].join();
+			scanners[ i ].join();
+			if( writers[ i ].failed )
+			{
+				status << " Writer " << i << " could not insert a new key "
+					<< "or erase an aged one.\n";
+				pass = false;
+			}
+			if( scanners[ i ].failed )
+			{
+				status << " Scanner " << i << " saw keys out of order.\n";
+				pass = false;
+			}
+		}
+
+		delete[] writers;
+		delete[] scanners;
+
+		// once nobody else is running, the next leaf that is emptied
+		//  releases everything retired before it
+		unsigned int end = elements + window;
+		for( unsigned int i = elements; i < end; ++i )
+		{
+			tree.insert( std::make_pair( i, i ) );
+			tree.erase( i - window );
+		}
+
+		long long held = LiveCounter::live - before;
+
+		status << " Moving a window of " << window << " over " << end
+			<< " keys from " << threads << " threads held " << held
+			<< " blocks, a fresh tree of the window holds " << needed
+			<< ".\n";
+
+		if( held > 2 * needed + 2 )
+		{
+			status << " The emptied leaves were not released.\n";
+			pass = false;
+		}
+
+		if( tree.size() != window )
+		{
+			status << " Tree size " << tree.size() << ", expected "
+				<< window << ".\n";
+			pass = false;
+		}
+
+		for( unsigned int i = end - window; i < end && pass; ++i )
+		{
+			unsigned int value = 0;
+			if( !tree.find( i, value ) || value != i )
+			{
+				status << " Key " << i << " is missing.\n";
+				pass = false;
+			}
+		}
+
+		unsigned int last = 0;
+		bool ordered = true;
+		bool first = true;
+		OrderCheck check = { &last, &ordered, &first };
+
+		if( tree.scan( 0, end, check ) != tree.size() || !ordered )
+		{
+			status << " A scan of the window missed keys.\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			status << "Test Reclaim Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestConcurrentBTree::doTest()
+	{
+		return testInsert() && testMixed() && testScaling() && testReclaim();
+	}
+
+	TestConcurrentBTree::TestConcurrentBTree()
+	{
+		name = "TestConcurrentBTree";
+		description = "A unit test and benchmark for ConcurrentBTree. ";
+		description += "Test Points: 1) Insert disjoint keys from several ";
+		description += "threads and assert that all are found and scanned ";
+		description += "in order. 2) Randomly insert and erase from several ";
+		description += "threads while others scan, assert that scans are ";
+		description += "ordered and the final tree matches a std::map. 3) ";
+		description += "Time random lookups from 1 up to the number of ";
+		description += "hardware threads against a BTree behind one mutex. ";
+		description += "4) Erase keys as they age behind a window moved by ";
+		description += "several threads while others scan, assert that ";
+		description += "emptied leaves are released and the blocks held ";
+		description += "stay near what a fresh tree of the window needs.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestConcurrentBTree test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-t", "--threads", test.threads, 4,
+		"The number of threads to run the correctness tests with." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys to insert into each tree." );
+	parser.parse( "-i", "--iterations", test.iterations, 100000,
+		"The number of random operations done by each thread." );
+	parser.parse( "-l", "--lookups", test.lookups, 1000000,
+		"The number of lookups to time in each benchmark thread." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
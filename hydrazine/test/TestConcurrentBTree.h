@@ -0,0 +1,182 @@
+/*!
+	\file TestConcurrentBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestConcurrentBTree class.
+*/
+
+#ifndef TEST_CONCURRENT_B_TREE_H_INCLUDED
+#define TEST_CONCURRENT_B_TREE_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/Thread.h>
+#include <hydrazine/interface/ConcurrentBTree.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+#include <atomic>
+
+namespace test
+{
+
+	typedef hydrazine::ConcurrentBTree< unsigned int, unsigned int >
+		ConcurrentTree;
+
+	/*! \brief The blocks held by every LiveAllocator */
+	class LiveCounter
+	{
+		public:
+			static std::atomic< long long > live;
+	};
+
+	/*! \brief An allocator that counts the blocks that are allocated */
+	template< typename T >
+	class LiveAllocator : public std::allocator< T >, public LiveCounter
+	{
+		public:
+			template< typename NewT >
+			struct rebind
+			{
+				typedef LiveAllocator< NewT > other;
+			};
+
+		public:
+			LiveAllocator() {}
+
+			template< typename SomeT >
+			LiveAllocator( const LiveAllocator< SomeT >& ) {}
+
+			T* allocate( size_t n, const void* = 0 )
+			{
+				++live;
+				return std::allocator< T >::allocate( n );
+			}
+
+			void deallocate( T* pointer, size_t n )
+			{
+				--live;
+				std::allocator< T >::deallocate( pointer, n );
+			}
+	};
+
+	typedef hydrazine::ConcurrentBTree< unsigned int, unsigned int,
+		std::less< unsigned int >, LiveAllocator< std::pair<
+		const unsigned int, unsigned int > > > LiveTree;
+
+	/*!
+		\brief A BTree shared by all threads behind a single mutex, the
+			baseline for the benchmark.
+	*/
+	class LockedTree
+	{
+		public:
+			typedef hydrazine::BTree< unsigned int, unsigned int > Tree;
+
+		public:
+			boost::mutex mutex;
+			Tree tree;
+	};
+
+	/*!
+		\brief A worker that operates on a shared tree.
+	*/
+	class TreeThread : public hydrazine::Thread
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+
+			enum Mode
+			{
+				Insert,
+				Mixed,
+				Scan,
+				Lookup,
+				LockedLookup,
+				Window,
+				WindowScan
+			};
+
+		protected:
+			void execute();
+
+		private:
+			unsigned int _random();
+			void _insert();
+			void _mixed();
+			template< typename Tree >
+			void _scan( Tree& tree );
+			void _lookup();
+			void _lockedLookup();
+			void _window();
+
+		public:
+			Mode mode;
+			ConcurrentTree* tree;
+			LockedTree* locked;
+			LiveTree* live;
+			unsigned int index;
+			unsigned int threads;
+			unsigned int elements;
+			unsigned int iterations;
+			unsigned int window;
+			unsigned int state;
+
+		public:
+			/*! \brief The keys this thread expects to be in the tree */
+			Map expected;
+			/*! \brief Set if the thread saw something out of order */
+			bool failed;
+			/*! \brief How many operations hit */
+			unsigned int found;
+	};
+
+	/*!
+		\brief A unit test and benchmark for ConcurrentBTree.
+
+		Test Points:
+
+			1) Insert disjoint sets of keys from several threads at once and
+				assert that all of them can be found and are scanned in
+				order afterwards.
+
+			2) Randomly insert and erase from several threads, each owning
+				the keys that are equal to its index modulo the thread
+				count, while other threads scan and assert that every scan
+				is ordered.  Assert that the final contents match the union
+				of the std::maps kept by each thread.
+
+			3) Time random lookups from 1 up to getHardwareThreadCount()
+				threads in a ConcurrentBTree and in a BTree guarded by one
+				mutex.  Report the throughput of each.
+
+			4) Insert keys that keep moving forward from several threads and
+				erase them as they age, so that only a window of them is
+				live, while other threads scan.  Assert that the emptied
+				leaves are released without stopping the threads, so that
+				the blocks held stay at about what a tree of the window
+				needs, and that the live keys are all found and scanned.
+	*/
+	class TestConcurrentBTree : public Test
+	{
+		private:
+			bool testInsert();
+			bool testMixed();
+			bool testScaling();
+			bool testReclaim();
+			bool doTest();
+
+		public:
+			unsigned int threads;
+			unsigned int elements;
+			unsigned int iterations;
+			unsigned int lookups;
+
+		public:
+			TestConcurrentBTree();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
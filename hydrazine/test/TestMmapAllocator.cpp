@@ -0,0 +1,366 @@
+/*!
+	\file TestMmapAllocator.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestMmapAllocator class.
+*/
+
+#ifndef TEST_MMAP_ALLOCATOR_CPP_INCLUDED
+#define TEST_MMAP_ALLOCATOR_CPP_INCLUDED
+
+#include <hydrazine/test/TestMmapAllocator.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <vector>
+#include <stdint.h>
+
+namespace test
+{
+
+	static const char* pageSizes[] = { "small pages",
+		"transparent huge pages", "huge pages" };
+	static const char* placements[] = { "default placement",
+		"interleaved", "local node" };
+
+	/*! \brief Does a report account for every mapping of a policy? */
+	static bool accounted( hydrazine::MmapPolicy& policy,
+		size_t mappings )
+	{
+		hydrazine::MmapPolicy::Report report = policy.obtained();
+
+		if( report.mappings != mappings )
+		{
+			return false;
+		}
+
+		if( policy.pageSize() == hydrazine::MmapPolicy::HugePages
+			&& report.hugePages + report.hugePageFallbacks != mappings )
+		{
+			return false;
+		}
+
+		if( policy.pageSize() == hydrazine::MmapPolicy::TransparentHugePages
+			&& report.advised + report.adviceFallbacks != mappings )
+		{
+			return false;
+		}
+
+		if( policy.placement() != hydrazine::MmapPolicy::DefaultPlacement
+			&& report.placed + report.placementFallbacks != mappings )
+		{
+			return false;
+		}
+
+		if( hydrazine::MmapPolicy::nodes() == 1 && report.placed != 0 )
+		{
+			return false;
+		}
+
+		return report.populated == ( policy.populate() ? mappings : 0 );
+	}
+
+	bool TestMmapAllocator::testPolicies()
+	{
+		status << "Running Test Policies\n";
+
+		size_t sizes[] = { 1, 4097, 3 << 20 };
+		size_t alignments[] = { 0, 64 << 10 };
+		bool pass = true;
+
+		for( unsigned int p = 0; p < 3 * 3 * 2 && pass; ++p )
+		{
+			hydrazine::MmapPolicy policy(
+				static_cast< hydrazine::MmapPolicy::PageSize >( p % 3 ),
+				static_cast< hydrazine::MmapPolicy::Placement >( p / 3 % 3 ),
+				p / 9 != 0 );
+			size_t mappings = 0;
+
+			for( unsigned int s = 0; s < 3 && pass; ++s )
+			{
+				for( unsigned int a = 0; a < 2 && pass; ++a )
+				{
+					size_t bytes = sizes[ s ];
+					char* block = static_cast< char* >(
+						policy.map( bytes, alignments[ a ] ) );
+					++mappings;
+
+					if( alignments[ a ] != 0 && reinterpret_cast<
+						uintptr_t >( block ) % alignments[ a ] != 0 )
+					{
+						status << " Block of " << bytes << " bytes at "
+							<< ( void* ) block << " is not aligned to "
+							<< alignments[ a ] << ".\n";
+						pass = false;
+					}
+
+					for( size_t i = 0; i < bytes; i += 4096 )
+					{
+						block[ i ] = i / 4096 + s;
+					}
+					block[ bytes - 1 ] = 7;
+
+					for( size_t i = 0; i + 1 < bytes && pass; i += 4096 )
+					{
+						if( block[ i ] != char( i / 4096 + s ) )
+						{
+							status << " Page " << i / 4096 << " of a block "
+								<< "of " << bytes << " bytes lost a write.\n";
+							pass = false;
+						}
+					}
+
+					policy.unmap( block, bytes );
+				}
+			}
+
+			if( pass && !accounted( policy, mappings ) )
+			{
+				status << " Report of a policy with " << pageSizes[ p % 3 ]
+					<< ", " << placements[ p / 3 % 3 ] << " does not account"
+					<< " for " << mappings << " mappings: "
+					<< policy.obtained().toString() << "\n";
+				pass = false;
+			}
+
+			status << " " << pageSizes[ p % 3 ] << ", "
+				<< placements[ p / 3 % 3 ]
+				<< ( policy.populate() ? ", populated: " : ": " )
+				<< policy.obtained().toString() << "\n";
+		}
+
+		if( pass )
+		{
+			status << "Test Policies Passed\n";
+		}
+
+		return pass;
+	}
+
+	/*! \brief Randomly modify a map and a tree, do they still match? */
+	template< typename Tree, typename Random >
+	static bool modify( TestMmapAllocator::Map& map, Tree& tree,
+		Random& random, unsigned int elements,
+		unsigned int iterations )
+	{
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			unsigned int key = random() % ( 2 * elements );
+
+			if( random() % 3 )
+			{
+				map.insert( std::make_pair( key, i ) );
+				tree.insert( std::make_pair( key, i ) );
+			}
+			else
+			{
+				map.erase( key );
+				tree.erase( key );
+			}
+		}
+
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+
+		typename Tree::iterator element = tree.begin();
+		for( TestMmapAllocator::Map::iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool TestMmapAllocator::testTrees()
+	{
+		status << "Running Test Trees\n";
+
+		bool pass = true;
+
+		for( unsigned int p = 0; p < 3 && pass; ++p )
+		{
+			hydrazine::MmapPolicy policy(
+				static_cast< hydrazine::MmapPolicy::PageSize >( p ),
+				hydrazine::MmapPolicy::LocalNode, p == 0 );
+			PooledTree::allocator_type allocator( policy );
+
+			Map map;
+			PooledTree tree( std::less< unsigned int >(), allocator );
+
+			if( !modify( map, tree, random, elements, iterations ) )
+			{
+				status << " Tree drawing from a pool with "
+					<< pageSizes[ p ] << " does not match std::map.\n";
+				pass = false;
+			}
+
+			hydrazine::MmapPool& pool = *tree.get_allocator().pool();
+
+			if( pass && pool.policy().obtained().mappings < pool.regions() )
+			{
+				status << " The pool with " << pageSizes[ p ]
+					<< " has " << pool.regions() << " regions, but its "
+					<< "policy only made " << pool.policy().obtained().mappings
+					<< " mappings.\n";
+				pass = false;
+			}
+
+			status << " Pool with " << pageSizes[ p ] << ": "
+				<< pool.policy().obtained().toString() << "\n";
+		}
+
+		if( pass )
+		{
+			hydrazine::MmapPolicy policy(
+				hydrazine::MmapPolicy::SmallPages,
+				hydrazine::MmapPolicy::Interleave, true );
+
+			PlainTree::allocator_type allocator( policy );
+
+			Map map;
+			PlainTree tree( std::less< unsigned int >(), allocator );
+
+			if( !modify( map, tree, random, elements, iterations ) )
+			{
+				status << " Tree mapping each node with a policy does not "
+					<< "match std::map.\n";
+				pass = false;
+			}
+
+			PlainTree::allocator_type::rebind< double >::other rebound(
+				tree.get_allocator() );
+
+			if( rebound.policy() != tree.get_allocator().policy()
+				|| rebound.policy() == 0 )
+			{
+				status << " A rebound allocator does not share its "
+					<< "policy.\n";
+				pass = false;
+			}
+
+			status << " Plain mappings: "
+				<< rebound.policy()->obtained().toString() << "\n";
+		}
+
+		if( pass )
+		{
+			status << "Test Trees Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestMmapAllocator::testRandomReads()
+	{
+		status << "Running Test Random Reads\n";
+
+		size_t words = size_t( megabytes ) * ( 1 << 20 ) / sizeof( size_t );
+		bool pass = true;
+
+		for( unsigned int p = 0; p < 3 && pass; ++p )
+		{
+			hydrazine::MmapPolicy policy(
+				static_cast< hydrazine::MmapPolicy::PageSize >( p ) );
+			typedef hydrazine::MmapAllocator< size_t > Allocator;
+			Allocator allocator( policy );
+
+			size_t* array = allocator.allocate( words );
+			for( size_t i = 0; i < words; ++i )
+			{
+				array[ i ] = i;
+			}
+
+			hydrazine::Timer timer;
+			timer.start();
+
+			size_t sum = 0;
+			size_t expected = 0;
+			for( unsigned int i = 0; i < iterations; ++i )
+			{
+				size_t index = ( size_t( random() ) << 16 ^ random() )
+					% words;
+				sum += array[ index ];
+				expected += index;
+			}
+
+			timer.stop();
+
+			status << " " << ( timer.seconds() * 1.0e9 / iterations )
+				<< " ns per random read from " << megabytes << " MB with "
+				<< pageSizes[ p ] << ", "
+				<< hydrazine::MmapPolicy::hugePageBytes( array,
+				words * sizeof( size_t ) ) << " bytes backed by huge pages"
+				<< ": " << allocator.policy()->obtained().toString() << "\n";
+
+			if( sum != expected )
+			{
+				status << " Read back the wrong values with "
+					<< pageSizes[ p ] << ".\n";
+				pass = false;
+			}
+
+			allocator.deallocate( array, words );
+		}
+
+		if( pass )
+		{
+			status << "Test Random Reads Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestMmapAllocator::doTest()
+	{
+		return testPolicies() && testTrees() && testRandomReads();
+	}
+
+	TestMmapAllocator::TestMmapAllocator()
+	{
+		name = "TestMmapAllocator";
+		description = "A unit test and benchmark for the policies of ";
+		description += "MmapAllocator. Test Points: 1) Map blocks with every ";
+		description += "combination of page size, placement, and ";
+		description += "pre-faulting, write and read every page, and assert ";
+		description += "that they are aligned and that every request is ";
+		description += "reported as obtained or as a fallback. 2) Randomly ";
+		description += "modify BTrees that draw from pooled and plain ";
+		description += "allocators with policies and assert that they match ";
+		description += "a std::map. 3) Time random reads from an array ";
+		description += "mapped with each page size and print what each ";
+		description += "policy obtained.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestMmapAllocator test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-e", "--elements", test.elements, 10000,
+		"The number of keys in each tree." );
+	parser.parse( "-i", "--iterations", test.iterations, 1000000,
+		"The number of operations on each tree and reads from each array." );
+	parser.parse( "-m", "--megabytes", test.megabytes, 256,
+		"The size of the array for random reads." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
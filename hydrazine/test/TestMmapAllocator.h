@@ -0,0 +1,71 @@
+/*!
+	\file TestMmapAllocator.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestMmapAllocator class.
+*/
+
+#ifndef TEST_MMAP_ALLOCATOR_H_INCLUDED
+#define TEST_MMAP_ALLOCATOR_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/MmapAllocator.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for the policies of MmapAllocator.
+
+		Test Points:
+
+			1) Map blocks of several sizes and alignments with every
+				combination of page size, placement, and pre-faulting.
+				Write and read back every page and assert that each block
+				is aligned and that the report accounts for every request,
+				either as obtained or as a fallback.
+
+			2) Randomly modify a std::map and BTrees drawing nodes from
+				pooled and plain allocators with each page size.  Assert
+				that they match and that the policies of the pools mapped
+				every region.
+
+			3) Randomly read an array mapped with each page size and time
+				it.  Print what each policy obtained, including the bytes
+				that the kernel backed with huge pages.
+	*/
+	class TestMmapAllocator : public Test
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+			typedef std::pair< const unsigned int, unsigned int > Pair;
+			typedef hydrazine::BTree< unsigned int, unsigned int,
+				std::less< unsigned int >,
+				hydrazine::MmapAllocator< Pair, true > > PooledTree;
+			typedef hydrazine::BTree< unsigned int, unsigned int,
+				std::less< unsigned int >,
+				hydrazine::MmapAllocator< Pair > > PlainTree;
+
+		private:
+			bool testPolicies();
+			bool testTrees();
+			bool testRandomReads();
+			bool doTest();
+
+		public:
+			unsigned int elements;
+			unsigned int iterations;
+			unsigned int megabytes;
+
+		public:
+			TestMmapAllocator();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
@@ -0,0 +1,234 @@
+/*!
+	\file TestNodeSearch.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestNodeSearch class.
+*/
+
+#ifndef TEST_NODE_SEARCH_CPP_INCLUDED
+#define TEST_NODE_SEARCH_CPP_INCLUDED
+
+#include <hydrazine/test/TestNodeSearch.h>
+#include <hydrazine/implementation/BTree.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <algorithm>
+
+namespace test
+{
+
+	template< typename Key, typename Compare >
+	bool TestNodeSearch::_testKernel( const std::string& name )
+	{
+		typedef hydrazine::NodeSearch< Key, Compare > Search;
+		typedef std::pair< Key, unsigned int > Pair;
+		typedef std::vector< Key > KeyVector;
+		typedef std::vector< Pair > PairVector;
+
+		Compare compare;
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			KeyVector keys( random() % ( elements + 1 ) );
+			for( typename KeyVector::iterator key = keys.begin();
+				key != keys.end(); ++key )
+			{
+				*key = ( Key )( random() % ( 4 * elements + 1 ) )
+					- ( Key )( 2 * elements );
+			}
+			std::sort( keys.begin(), keys.end(), compare );
+			keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+
+			PairVector pairs;
+			for( typename KeyVector::iterator key = keys.begin();
+				key != keys.end(); ++key )
+			{
+				pairs.push_back( Pair( *key, i ) );
+			}
+
+			const Key* begin = keys.empty() ? 0 : &keys[ 0 ];
+			const Pair* pairBegin = pairs.empty() ? 0 : &pairs[ 0 ];
+
+			for( unsigned int j = 0; j < 8 * elements + 2; ++j )
+			{
+				Key key = ( Key )( j / 2 ) - ( Key )( 2 * elements );
+
+				size_t lower = std::lower_bound( keys.begin(), keys.end(),
+					key, compare ) - keys.begin();
+				size_t upper = std::upper_bound( keys.begin(), keys.end(),
+					key, compare ) - keys.begin();
+
+				if( Search::lowerBound( begin, keys.size(), key, compare )
+					!= lower
+					|| Search::lowerBound( pairBegin, pairs.size(), key,
+					compare ) != lower )
+				{
+					status << name << " lower bound of " << key << " in "
+						<< keys.size() << " keys did not match index "
+						<< lower << "\n";
+					return false;
+				}
+
+				if( Search::upperBound( begin, keys.size(), key, compare )
+					!= upper
+					|| Search::upperBound( pairBegin, pairs.size(), key,
+					compare ) != upper )
+				{
+					status << name << " upper bound of " << key << " in "
+						<< keys.size() << " keys did not match index "
+						<< upper << "\n";
+					return false;
+				}
+			}
+		}
+
+		status << " " << name << " passed.\n";
+		return true;
+	}
+
+	template< typename Tree >
+	double TestNodeSearch::_benchmark(
+		const std::vector< unsigned int >& keys )
+	{
+		Tree tree;
+
+		for( std::vector< unsigned int >::const_iterator key = keys.begin();
+			key != keys.end(); ++key )
+		{
+			tree.insert( std::make_pair( *key, *key ) );
+		}
+
+		hydrazine::Timer timer;
+		unsigned int found = 0;
+
+		timer.start();
+		for( unsigned int i = 0; i < lookups; ++i )
+		{
+			found += tree.find( keys[ i % keys.size() ] ) != tree.end();
+		}
+		timer.stop();
+
+		if( found != lookups )
+		{
+			status << " Only found " << found << " of " << lookups
+				<< " keys.\n";
+			return -1.0;
+		}
+
+		return timer.seconds() * 1.0e9 / lookups;
+	}
+
+	bool TestNodeSearch::testKernels()
+	{
+		status << "Running Test Kernels\n";
+
+		bool pass = _testKernel< unsigned int, std::less< unsigned int > >(
+			"unsigned less" )
+			&& _testKernel< unsigned int, std::greater< unsigned int > >(
+			"unsigned greater" )
+			&& _testKernel< int, std::less< int > >( "int less" )
+			&& _testKernel< int, std::greater< int > >( "int greater" )
+			&& _testKernel< long long, std::less< long long > >(
+			"long long less" )
+			&& _testKernel< double, std::less< double > >( "double less" )
+			&& _testKernel< unsigned int, GenericLess< unsigned int > >(
+			"generic less" );
+
+		if( pass )
+		{
+			status << "Test Kernels Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestNodeSearch::testLookup()
+	{
+		status << "Running Test Lookup\n";
+
+		typedef hydrazine::BTree< unsigned int, unsigned int > FastTree;
+		typedef hydrazine::BTree< unsigned int, unsigned int,
+			GenericLess< unsigned int > > GenericTree;
+		typedef hydrazine::BTree< unsigned int, unsigned int,
+			std::less< unsigned int >, 
+			std::allocator< std::pair< const unsigned int, unsigned int > >,
+			1024, hydrazine::SplitLeafLayout > SplitTree;
+
+		std::vector< unsigned int > keys( treeElements );
+		for( std::vector< unsigned int >::iterator key = keys.begin();
+			key != keys.end(); ++key )
+		{
+			*key = random();
+		}
+
+		std::sort( keys.begin(), keys.end() );
+		keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+		std::random_shuffle( keys.begin(), keys.end() );
+
+		if( keys.empty() )
+		{
+			status << "Test Lookup Passed\n";
+			return true;
+		}
+
+		double generic = _benchmark< GenericTree >( keys );
+		double fast = _benchmark< FastTree >( keys );
+		double split = _benchmark< SplitTree >( keys );
+
+		if( generic < 0.0 || fast < 0.0 || split < 0.0 )
+		{
+			return false;
+		}
+
+		status << " Generic kernel: " << generic << " ns/op\n";
+		status << " Fast kernel: " << fast << " ns/op\n";
+		status << " Fast kernel, split leaves: " << split << " ns/op\n";
+		status << "Test Lookup Passed\n";
+		return true;
+	}
+
+	bool TestNodeSearch::doTest()
+	{
+		return testKernels() && testLookup();
+	}
+
+	TestNodeSearch::TestNodeSearch()
+	{
+		name = "TestNodeSearch";
+		description = "A unit test and benchmark for the BTree node search ";
+		description += "kernels. Test Points: 1) Assert that every kernel ";
+		description += "matches std::lower_bound and std::upper_bound on ";
+		description += "sorted arrays of keys and key/value pairs. 2) Time ";
+		description += "random lookups in a BTree using the fast kernel ";
+		description += "against one forced onto the generic kernel.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestNodeSearch test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-e", "--elements", test.elements, 100,
+		"The maximum number of keys in each random array." );
+	parser.parse( "-i", "--iterations", test.iterations, 100,
+		"The number of random arrays to check." );
+	parser.parse( "-t", "--tree-elements", test.treeElements, 1000000,
+		"The number of keys to insert into each tree." );
+	parser.parse( "-l", "--lookups", test.lookups, 1000000,
+		"The number of lookups to time in each tree." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
@@ -0,0 +1,74 @@
+/*!
+	\file TestNodeSearch.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestNodeSearch class.
+*/
+
+#ifndef TEST_NODE_SEARCH_H_INCLUDED
+#define TEST_NODE_SEARCH_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/NodeSearch.h>
+#include <vector>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for the BTree node search kernels.
+
+		Test Points:
+
+			1) Fill sorted arrays of random keys, bare and paired with
+				values and straddling zero so that unsigned keys wrap, and
+				assert that every kernel returns the same index
+				as std::lower_bound and std::upper_bound for keys inside
+				and outside of the array.
+
+			2) Build BTrees with the same random keys, one that uses the
+				fast kernel and one that is forced onto the generic kernel,
+				and time random lookups in each, including a tree that
+				splits the keys of each leaf from the values.  Report ns/op.
+	*/
+	class TestNodeSearch : public Test
+	{
+		public:
+			/*! \brief A comparison that is opaque to NodeSearch */
+			template< typename T >
+			class GenericLess
+			{
+				public:
+					bool operator()( const T& one, const T& two ) const
+					{
+						return one < two;
+					}
+			};
+
+		private:
+			template< typename Key, typename Compare >
+			bool _testKernel( const std::string& name );
+			template< typename Tree >
+			double _benchmark( const std::vector< unsigned int >& keys );
+
+		private:
+			bool testKernels();
+			bool testLookup();
+			bool doTest();
+
+		public:
+			unsigned int elements;
+			unsigned int iterations;
+			unsigned int treeElements;
+			unsigned int lookups;
+
+		public:
+			TestNodeSearch();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
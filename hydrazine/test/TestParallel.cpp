@@ -0,0 +1,543 @@
+/*!
+	\file TestParallel.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestParallel class.
+*/
+
+#ifndef TEST_PARALLEL_CPP_INCLUDED
+#define TEST_PARALLEL_CPP_INCLUDED
+
+#include <hydrazine/test/TestParallel.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/implementation/BTree.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+namespace test
+{
+
+	typedef hydrazine::BTree< unsigned int, unsigned int > Tree;
+
+	/*! \brief Write the square of every index, counting writes */
+	class Square
+	{
+		public:
+			std::vector< unsigned long long >* squares;
+			std::vector< std::atomic< unsigned int > >* writes;
+
+		public:
+			void operator()( size_t i ) const
+			{
+				( *squares )[ i ] = ( unsigned long long ) i * i;
+				( *writes )[ i ].fetch_add( 1, std::memory_order_relaxed );
+			}
+	};
+
+	/*! \brief Sum the values of a BTree through its iterators */
+	class SumValues
+	{
+		public:
+			std::atomic< unsigned long long >* sum;
+
+		public:
+			void operator()( Tree::const_iterator i ) const
+			{
+				sum->fetch_add( i->second, std::memory_order_relaxed );
+			}
+
+			unsigned long long operator()( unsigned long long left,
+				unsigned long long right ) const
+			{
+				return left + right;
+			}
+
+			unsigned long long operator()( unsigned long long left,
+				const Tree::value_type& right ) const
+			{
+				return left + right.second;
+			}
+	};
+
+	/*! \brief Throw at one index */
+	class FailAt
+	{
+		public:
+			size_t index;
+
+		public:
+			void operator()( size_t i ) const
+			{
+				if( i == index )
+				{
+					throw hydrazine::Exception( "Thrown from parallel_for." );
+				}
+			}
+	};
+
+	/*! \brief The function x -> a * x + b, modulo 2^32 */
+	class Affine
+	{
+		public:
+			unsigned int a;
+			unsigned int b;
+
+		public:
+			Affine( unsigned int _a = 1, unsigned int _b = 0 ) : a( _a ),
+				b( _b ) {}
+
+		public:
+			bool operator==( const Affine& f ) const
+			{
+				return a == f.a && b == f.b;
+			}
+
+			bool operator!=( const Affine& f ) const
+			{
+				return !( *this == f );
+			}
+	};
+
+	/*! \brief Apply one affine function and then another */
+	class Compose
+	{
+		public:
+			Affine operator()( const Affine& first,
+				const Affine& second ) const
+			{
+				return Affine( second.a * first.a, second.a * first.b
+					+ second.b );
+			}
+	};
+
+	TestParallel::Vector TestParallel::_randomVector( size_t size,
+		unsigned int range )
+	{
+		Vector vector( size );
+
+		for( Vector::iterator element = vector.begin();
+			element != vector.end(); ++element )
+		{
+			*element = random() % range;
+		}
+
+		return vector;
+	}
+
+	bool TestParallel::testFor()
+	{
+		status << "Running Test For\n";
+
+		hydrazine::ThreadPool pool( workers );
+
+		std::vector< unsigned long long > squares( elements );
+		std::vector< std::atomic< unsigned int > > writes( elements );
+
+		Square square;
+		square.squares = &squares;
+		square.writes = &writes;
+
+		size_t grains[] = { 0, 1, 7, 1000, elements };
+
+		for( unsigned int g = 0; g < sizeof( grains ) / sizeof( size_t );
+			++g )
+		{
+			for( size_t i = 0; i < elements; ++i )
+			{
+				writes[ i ].store( 0 );
+			}
+
+			hydrazine::parallel_for( ( size_t ) 0, ( size_t ) elements,
+				square, grains[ g ], pool );
+
+			for( size_t i = 0; i < elements; ++i )
+			{
+				if( writes[ i ].load() != 1
+					|| squares[ i ] != ( unsigned long long ) i * i )
+				{
+					status << " With a grain of " << grains[ g ] << ", index "
+						<< i << " was written " << writes[ i ].load()
+						<< " times with " << squares[ i ] << ".\n";
+					return false;
+				}
+			}
+		}
+
+		Tree tree;
+		unsigned long long expected = 0;
+
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			unsigned int value = random() % 1000;
+
+			if( tree.insert( std::make_pair( random(), value ) ).second )
+			{
+				expected += value;
+			}
+		}
+
+		std::atomic< unsigned long long > sum( 0 );
+		SumValues values;
+		values.sum = &sum;
+
+		const Tree& constTree = tree;
+
+		hydrazine::parallel_for( constTree.begin(), constTree.end(), values,
+			100, pool );
+
+		if( sum.load() != expected )
+		{
+			status << " The values of a BTree summed to " << sum.load()
+				<< ", expected " << expected << ".\n";
+			return false;
+		}
+
+		FailAt fail;
+		fail.index = random() % elements;
+
+		try
+		{
+			hydrazine::parallel_for( ( size_t ) 0, ( size_t ) elements,
+				fail, 16, pool );
+
+			status << " An exception thrown at index " << fail.index
+				<< " was not rethrown.\n";
+			return false;
+		}
+		catch( const hydrazine::Exception& )
+		{
+
+		}
+
+		status << "Test For Passed\n";
+
+		return true;
+	}
+
+	bool TestParallel::testReduce()
+	{
+		status << "Running Test Reduce\n";
+
+		hydrazine::ThreadPool pool( workers );
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t size = random() % elements;
+			Vector vector = _randomVector( size, 1000 );
+
+			unsigned long long sum = hydrazine::parallel_reduce(
+				vector.begin(), vector.end(), 0ULL,
+				std::plus< unsigned long long >(), random() % 2000, pool );
+			unsigned long long expected = std::accumulate( vector.begin(),
+				vector.end(), 0ULL );
+
+			if( sum != expected )
+			{
+				status << " Iteration " << i << " summed " << size
+					<< " elements to " << sum << ", expected " << expected
+					<< ".\n";
+				return false;
+			}
+
+			std::vector< Affine > functions( size );
+
+			for( size_t f = 0; f < size; ++f )
+			{
+				functions[ f ] = Affine( random() | 1, random() );
+			}
+
+			Affine composed = hydrazine::parallel_reduce( functions.begin(),
+				functions.end(), Affine(), Compose(), random() % 2000, pool );
+			Affine serial = std::accumulate( functions.begin(),
+				functions.end(), Affine(), Compose() );
+
+			if( composed != serial )
+			{
+				status << " Iteration " << i << " composed " << size
+					<< " functions to " << composed.a << "x + " << composed.b
+					<< ", expected " << serial.a << "x + " << serial.b
+					<< ".\n";
+				return false;
+			}
+		}
+
+		Tree tree;
+
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			tree.insert( std::make_pair( random(), random() % 1000 ) );
+		}
+
+		unsigned long long expected = 0;
+
+		for( Tree::const_iterator i = tree.begin(); i != tree.end(); ++i )
+		{
+			expected += i->second;
+		}
+
+		const Tree& constTree = tree;
+
+		unsigned long long sum = hydrazine::parallel_reduce(
+			constTree.begin(), constTree.end(), 0ULL, SumValues(), 100, pool );
+
+		if( sum != expected )
+		{
+			status << " The values of a BTree reduced to " << sum
+				<< ", expected " << expected << ".\n";
+			return false;
+		}
+
+		status << "Test Reduce Passed\n";
+
+		return true;
+	}
+
+	bool TestParallel::testScan()
+	{
+		status << "Running Test Scan\n";
+
+		hydrazine::ThreadPool pool( workers );
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			size_t size = random() % elements;
+			Vector vector = _randomVector( size, 1000 );
+			Vector expected( size );
+			Vector scanned( size );
+
+			std::partial_sum( vector.begin(), vector.end(),
+				expected.begin() );
+
+			size_t grain = random() % 2000;
+
+			hydrazine::parallel_scan( vector.begin(), vector.end(),
+				scanned.begin(), std::plus< unsigned int >(), grain, pool );
+
+			if( scanned != expected )
+			{
+				status << " Iteration " << i << " scanned " << size
+					<< " elements with a grain of " << grain
+					<< " incorrectly.\n";
+				return false;
+			}
+
+			hydrazine::parallel_scan( vector.begin(), vector.end(),
+				vector.begin(), std::plus< unsigned int >(), grain, pool );
+
+			if( vector != expected )
+			{
+				status << " Iteration " << i << " scanned " << size
+					<< " elements in place with a grain of " << grain
+					<< " incorrectly.\n";
+				return false;
+			}
+
+			std::vector< Affine > functions( size );
+
+			for( size_t f = 0; f < size; ++f )
+			{
+				functions[ f ] = Affine( random() | 1, random() );
+			}
+
+			std::vector< Affine > composed( size );
+			std::vector< Affine > serial( size );
+
+			hydrazine::parallel_scan( functions.begin(), functions.end(),
+				composed.begin(), Compose(), grain, pool );
+			std::partial_sum( functions.begin(), functions.end(),
+				serial.begin(), Compose() );
+
+			if( composed != serial )
+			{
+				status << " Iteration " << i << " composed " << size
+					<< " functions with a grain of " << grain
+					<< " incorrectly.\n";
+				return false;
+			}
+		}
+
+		status << "Test Scan Passed\n";
+
+		return true;
+	}
+
+	bool TestParallel::testSort()
+	{
+		status << "Running Test Sort\n";
+
+		hydrazine::ThreadPool pool( workers );
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			// Every few iterations sort a short range in the smallest
+			//  pieces that there are
+			bool small = i % 4 == 0;
+			size_t size = random() % ( small ? 256 : elements );
+			Vector vector = _randomVector( size, size / 4 + 1 );
+			Vector expected = vector;
+			size_t grain = small ? 1 + i % 3 : random() % 2000;
+
+			std::sort( expected.begin(), expected.end() );
+			hydrazine::parallel_sort( vector.begin(), vector.end(),
+				std::less< unsigned int >(), grain, pool );
+
+			if( vector != expected )
+			{
+				status << " Iteration " << i << " sorted " << size
+					<< " elements with a grain of " << grain
+					<< " incorrectly.\n";
+				return false;
+			}
+
+			std::sort( expected.begin(), expected.end(),
+				std::greater< unsigned int >() );
+			hydrazine::parallel_sort( vector.begin(), vector.end(),
+				std::greater< unsigned int >(), grain, pool );
+
+			if( vector != expected )
+			{
+				status << " Iteration " << i << " sorted " << size
+					<< " elements in reverse with a grain of " << grain
+					<< " incorrectly.\n";
+				return false;
+			}
+		}
+
+		status << "Test Sort Passed\n";
+
+		return true;
+	}
+
+	bool TestParallel::testBenchmark()
+	{
+		status << "Running Test Benchmark\n";
+
+		hydrazine::ThreadPool& pool = hydrazine::parallelPool();
+		hydrazine::Timer timer;
+
+		status << " The shared pool has " << pool.size() << " workers.\n";
+
+		for( size_t size = 1 << 20; size <= maximum; size *= 4 )
+		{
+			Vector vector = _randomVector( size, 1000 );
+			Vector sorted = vector;
+			Vector serial( size );
+			Vector scanned( size );
+
+			timer.start();
+			unsigned long long expected = std::accumulate( vector.begin(),
+				vector.end(), 0ULL );
+			timer.stop();
+			hydrazine::Timer::Second accumulate = timer.seconds();
+
+			timer.start();
+			unsigned long long sum = hydrazine::parallel_reduce(
+				vector.begin(), vector.end(), 0ULL );
+			timer.stop();
+			hydrazine::Timer::Second reduce = timer.seconds();
+
+			timer.start();
+			std::partial_sum( vector.begin(), vector.end(), serial.begin() );
+			timer.stop();
+			hydrazine::Timer::Second partialSum = timer.seconds();
+
+			timer.start();
+			hydrazine::parallel_scan( vector.begin(), vector.end(),
+				scanned.begin() );
+			timer.stop();
+			hydrazine::Timer::Second scan = timer.seconds();
+
+			timer.start();
+			std::sort( sorted.begin(), sorted.end() );
+			timer.stop();
+			hydrazine::Timer::Second sort = timer.seconds();
+
+			timer.start();
+			hydrazine::parallel_sort( vector.begin(), vector.end() );
+			timer.stop();
+			hydrazine::Timer::Second parallelSort = timer.seconds();
+
+			if( sum != expected || scanned != serial || vector != sorted )
+			{
+				status << " The parallel algorithms disagreed with the "
+					<< "serial ones on " << size << " elements.\n";
+				return false;
+			}
+
+			status << " " << size << " elements:\n";
+			status << "  std::accumulate " << accumulate
+				<< "s, parallel_reduce " << reduce << "s, speedup "
+				<< ( accumulate / reduce ) << "\n";
+			status << "  std::partial_sum " << partialSum
+				<< "s, parallel_scan " << scan << "s, speedup "
+				<< ( partialSum / scan ) << "\n";
+			status << "  std::sort " << sort << "s, parallel_sort "
+				<< parallelSort << "s, speedup " << ( sort / parallelSort )
+				<< "\n";
+		}
+
+		status << "Test Benchmark Passed\n";
+
+		return true;
+	}
+
+	bool TestParallel::doTest()
+	{
+		elements = std::max( elements, 1u );
+
+		return testFor() && testReduce() && testScan() && testSort()
+			&& testBenchmark();
+	}
+
+	TestParallel::TestParallel()
+	{
+		name = "TestParallel";
+		description = "A unit test and benchmark for the parallel ";
+		description += "algorithms. Test Points: 1) Square every index of ";
+		description += "a range with parallel_for and sum the values of a ";
+		description += "BTree through its iterators. 2) Reduce random ";
+		description += "vectors with sums and with affine functions, which ";
+		description += "do not commute, and compare against ";
+		description += "std::accumulate. 3) Scan random vectors, also in ";
+		description += "place, and compare against std::partial_sum. 4) ";
+		description += "Sort random vectors with duplicates in both orders, ";
+		description += "also in pieces of a single element, and compare ";
+		description += "against std::sort. 5) Time the serial ";
+		description += "and parallel algorithms on the shared pool for ";
+		description += "vectors from 1M elements up to a maximum.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestParallel test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-w", "--workers", test.workers, 4,
+		"The workers in the pool for the unit tests, 0 implies one per "
+		"hardware thread." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The largest range for the unit tests." );
+	parser.parse( "-i", "--iterations", test.iterations, 20,
+		"The number of random ranges for the unit tests." );
+	parser.parse( "-m", "--maximum", test.maximum, 1 << 24,
+		"The largest vector to benchmark, up to 100M elements." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
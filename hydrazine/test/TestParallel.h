@@ -0,0 +1,77 @@
+/*!
+	\file TestParallel.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestParallel class.
+*/
+
+#ifndef TEST_PARALLEL_H_INCLUDED
+#define TEST_PARALLEL_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/Parallel.h>
+#include <vector>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for the parallel algorithms.
+
+		Test Points:
+
+			1) Square every index of a range of integers with parallel_for
+				for several grains, and sum the values of a BTree through
+				its iterators.  Assert that every index was written once,
+				that the BTree sum matches a serial one, and that an
+				exception thrown by the function is rethrown.
+
+			2) Sum random vectors of random sizes with parallel_reduce and
+				compose random affine functions, which is not commutative.
+				Assert that both match std::accumulate.  Reduce a BTree to
+				the sum of its values.
+
+			3) Scan random vectors with sums and with affine functions,
+				into another vector and in place.  Assert that both match
+				std::partial_sum.
+
+			4) Sort random vectors of random sizes with many duplicates,
+				in both orders and with grains down to a single element,
+				and assert that they match std::sort.
+
+			5) Time std::accumulate, std::partial_sum and std::sort against
+				their parallel versions on the shared pool, for vectors
+				from 1M elements up to a maximum, growing by 4x.
+	*/
+	class TestParallel : public Test
+	{
+		private:
+			typedef std::vector< unsigned int > Vector;
+
+		private:
+			Vector _randomVector( size_t size, unsigned int range );
+
+		private:
+			bool testFor();
+			bool testReduce();
+			bool testScan();
+			bool testSort();
+			bool testBenchmark();
+			bool doTest();
+
+		public:
+			unsigned int workers;
+			unsigned int elements;
+			unsigned int iterations;
+			unsigned int maximum;
+
+		public:
+			TestParallel();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
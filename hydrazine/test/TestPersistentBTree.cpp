@@ -0,0 +1,344 @@
+/*!
+	\file TestPersistentBTree.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestPersistentBTree class.
+*/
+
+#ifndef TEST_PERSISTENT_B_TREE_CPP_INCLUDED
+#define TEST_PERSISTENT_B_TREE_CPP_INCLUDED
+
+#include <hydrazine/test/TestPersistentBTree.h>
+#include <hydrazine/implementation/Timer.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <fstream>
+#include <cstdio>
+
+namespace test
+{
+
+	/*! \brief Do a tree and a map hold the same elements, in both
+		directions? */
+	template< typename Tree >
+	static bool matches( const TestPersistentBTree::Map& map,
+		const Tree& tree )
+	{
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+
+		typename Tree::const_iterator element = tree.begin();
+		for( TestPersistentBTree::Map::const_iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element == tree.end() || element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		if( element != tree.end() )
+		{
+			return false;
+		}
+
+		typename Tree::const_reverse_iterator reverse = tree.rbegin();
+		for( TestPersistentBTree::Map::const_reverse_iterator
+			fi = map.rbegin(); fi != map.rend(); ++fi, ++reverse )
+		{
+			if( reverse == tree.rend() || reverse->first != fi->first )
+			{
+				return false;
+			}
+		}
+
+		return reverse == tree.rend();
+	}
+
+	bool TestPersistentBTree::testRandom()
+	{
+		status << "Running Test Random\n";
+
+		std::remove( file.c_str() );
+
+		Map map;
+		SmallTree* tree = new SmallTree( file );
+		bool pass = true;
+
+		for( unsigned int i = 0; i < iterations && pass; ++i )
+		{
+			unsigned int key = random() % elements;
+
+			switch( random() % 3 )
+			{
+				case 0:
+				{
+					bool inserted = tree->insert(
+						std::make_pair( key, i ) ).second;
+					if( inserted != map.insert(
+						std::make_pair( key, i ) ).second )
+					{
+						status << " Insert of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+				case 1:
+				{
+					if( tree->erase( key ) != map.erase( key ) )
+					{
+						status << " Erase of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+				case 2:
+				{
+					SmallTree::iterator element = tree->find( key );
+					Map::iterator expected = map.find( key );
+					if( ( element == tree->end() )
+						!= ( expected == map.end() ) || ( element
+						!= tree->end() && element->second
+						!= expected->second ) )
+					{
+						status << " Find of key " << key
+							<< " disagreed with std::map.\n";
+						pass = false;
+					}
+					break;
+				}
+			}
+
+			if( ( i + 1 ) % ( iterations / 4 + 1 ) == 0 )
+			{
+				delete tree;
+				tree = new SmallTree( file );
+
+				if( !matches( map, *tree ) )
+				{
+					status << " Reopened index does not match std::map after "
+						<< ( i + 1 ) << " operations.\n";
+					pass = false;
+				}
+			}
+		}
+
+		if( pass && !matches( map, *tree ) )
+		{
+			status << " Final index does not match std::map.\n";
+			pass = false;
+		}
+
+		tree->clear();
+
+		if( pass && ( !tree->empty() || tree->pages() != 1
+			|| tree->begin() != tree->end() ) )
+		{
+			status << " Cleared index is not empty.\n";
+			pass = false;
+		}
+
+		delete tree;
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Random Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestPersistentBTree::testReopen()
+	{
+		status << "Running Test Reopen\n";
+
+		std::remove( file.c_str() );
+
+		std::vector< unsigned int > keys( elements );
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			*fi = random();
+		}
+
+		Map map;
+
+		{
+			Tree tree( file );
+			for( std::vector< unsigned int >::iterator fi = keys.begin();
+				fi != keys.end(); ++fi )
+			{
+				tree.insert( std::make_pair( *fi, *fi / 2 ) );
+				map.insert( std::make_pair( *fi, *fi / 2 ) );
+			}
+			tree.sync();
+		}
+
+		hydrazine::Timer timer;
+		timer.start();
+
+		Tree tree( file );
+		unsigned int found = 0;
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			found += tree.count( *fi );
+		}
+
+		timer.stop();
+		hydrazine::Timer::Second reopen = timer.seconds();
+
+		timer.start();
+
+		MemoryTree memory;
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			memory.insert( std::make_pair( *fi, *fi / 2 ) );
+		}
+		for( std::vector< unsigned int >::iterator fi = keys.begin();
+			fi != keys.end(); ++fi )
+		{
+			found += memory.count( *fi );
+		}
+
+		timer.stop();
+		hydrazine::Timer::Second rebuild = timer.seconds();
+
+		status << " Reopening " << tree.size() << " elements in "
+			<< tree.pages() << " pages and finding each took "
+			<< ( reopen * 1000.0 ) << " ms, rebuilding a BTree took "
+			<< ( rebuild * 1000.0 ) << " ms\n";
+
+		bool pass = true;
+
+		if( found != 2 * elements )
+		{
+			status << " Only found " << found << " of " << 2 * elements
+				<< " keys.\n";
+			pass = false;
+		}
+
+		if( !matches( map, tree ) )
+		{
+			status << " Reopened index does not match std::map.\n";
+			pass = false;
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Reopen Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestPersistentBTree::testInvalid()
+	{
+		status << "Running Test Invalid\n";
+
+		bool pass = true;
+
+		std::remove( file.c_str() );
+
+		{
+			Tree tree( file );
+			tree.insert( std::make_pair( 1, 1 ) );
+		}
+
+		try
+		{
+			SmallTree tree( file );
+			status << " Opened an index with the wrong page size.\n";
+			pass = false;
+		}
+		catch( const hydrazine::Exception& e )
+		{
+			status << " Wrong page size: " << e.what() << "\n";
+		}
+
+		std::remove( file.c_str() );
+
+		{
+			std::ofstream out( file.c_str() );
+			for( unsigned int i = 0; i < 256; ++i )
+			{
+				out << "not an index";
+			}
+		}
+
+		try
+		{
+			SmallTree tree( file );
+			status << " Opened a file that is not an index.\n";
+			pass = false;
+		}
+		catch( const hydrazine::Exception& e )
+		{
+			status << " Not an index: " << e.what() << "\n";
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Invalid Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestPersistentBTree::doTest()
+	{
+		return testRandom() && testReopen() && testInvalid();
+	}
+
+	TestPersistentBTree::TestPersistentBTree()
+	{
+		name = "TestPersistentBTree";
+		description = "A unit test and benchmark for PersistentBTree. ";
+		description += "Test Points: 1) Randomly insert, erase, and find ";
+		description += "in an index with small pages and a std::map, ";
+		description += "reopening the index along the way, assert that they ";
+		description += "always match. 2) Fill, sync, and close an index, ";
+		description += "time reopening it and finding every key against ";
+		description += "building a BTree, assert nothing was lost. 3) ";
+		description += "Assert that opening an index with another page size ";
+		description += "or a file that is not an index throws.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestPersistentBTree test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-f", "--file", test.file, "TestPersistentBTree.index",
+		"The file to create indexes in, it is removed afterwards." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys in each index." );
+	parser.parse( "-i", "--iterations", test.iterations, 100000,
+		"The number of random operations in the random test." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
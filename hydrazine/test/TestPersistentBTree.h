@@ -0,0 +1,66 @@
+/*!
+	\file TestPersistentBTree.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestPersistentBTree class.
+*/
+
+#ifndef TEST_PERSISTENT_B_TREE_H_INCLUDED
+#define TEST_PERSISTENT_B_TREE_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/PersistentBTree.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test and benchmark for PersistentBTree.
+
+		Test Points:
+
+			1) Randomly insert, erase, and look up keys in an index with
+				small pages and in a std::map.  Close and reopen the index
+				several times along the way.  Assert that the contents
+				always match, forwards and backwards.
+
+			2) Fill an index, sync it, and close it.  Time reopening it
+				and finding every key against building a BTree with the
+				same keys.  Assert that nothing was lost.
+
+			3) Assert that opening an index with a different page size,
+				and opening a file that is not an index, both throw.
+	*/
+	class TestPersistentBTree : public Test
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+			typedef hydrazine::PersistentBTree< unsigned int, unsigned int,
+				std::less< unsigned int >, 256 > SmallTree;
+			typedef hydrazine::PersistentBTree< unsigned int, unsigned int >
+				Tree;
+			typedef hydrazine::BTree< unsigned int, unsigned int > MemoryTree;
+
+		private:
+			bool testRandom();
+			bool testReopen();
+			bool testInvalid();
+			bool doTest();
+
+		public:
+			std::string file;
+			unsigned int elements;
+			unsigned int iterations;
+
+		public:
+			TestPersistentBTree();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
@@ -0,0 +1,342 @@
+/*!
+	\file TestSharedSegment.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestSharedSegment class.
+*/
+
+#ifndef TEST_SHARED_SEGMENT_CPP_INCLUDED
+#define TEST_SHARED_SEGMENT_CPP_INCLUDED
+
+#include <hydrazine/test/TestSharedSegment.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace test
+{
+
+	/*! \brief A node of a list that lives in a segment */
+	class Node
+	{
+		public:
+			hydrazine::OffsetPointer< Node > next;
+			unsigned int value;
+	};
+
+	/*! \brief Does a tree hold exactly the elements of a map? */
+	static bool matches( const TestSharedSegment::Map& map,
+		const TestSharedSegment::Tree& tree )
+	{
+		if( map.size() != tree.size() )
+		{
+			return false;
+		}
+
+		TestSharedSegment::Tree::const_iterator element = tree.begin();
+		for( TestSharedSegment::Map::const_iterator fi = map.begin();
+			fi != map.end(); ++fi, ++element )
+		{
+			if( element->first != fi->first
+				|| element->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		for( TestSharedSegment::Map::const_iterator fi = map.begin();
+			fi != map.end(); ++fi )
+		{
+			TestSharedSegment::Tree::const_iterator found =
+				tree.find( fi->first );
+			if( found == tree.end() || found->second != fi->second )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/*! \brief Walk a list and check that it counts down from size */
+	static bool walk( const Node* node, unsigned int size )
+	{
+		for( ; node != 0; node = node->next.get() )
+		{
+			if( node->value != --size )
+			{
+				return false;
+			}
+		}
+
+		return size == 0;
+	}
+
+	bool TestSharedSegment::testBlocks()
+	{
+		status << "Running Test Blocks\n";
+
+		typedef std::vector< std::pair< unsigned char*, size_t > > Blocks;
+
+		hydrazine::SharedSegment segment( 4096 );
+		void* base = segment.base();
+		Blocks blocks;
+		bool pass = true;
+
+		for( unsigned int i = 0; i < iterations; ++i )
+		{
+			if( blocks.empty() || random() % 3 != 0 )
+			{
+				size_t bytes = 1 + random() % ( random() % 8 == 0
+					? 1 << 16 : 256 );
+				unsigned char* block = static_cast< unsigned char* >(
+					segment.allocate( bytes ) );
+
+				if( segment.offset( block ) % 16 != 0 )
+				{
+					status << " Block at offset " << segment.offset( block )
+						<< " is not aligned.\n";
+					pass = false;
+					break;
+				}
+
+				std::memset( block, bytes & 0xff, bytes );
+				blocks.push_back( std::make_pair( block, bytes ) );
+			}
+			else
+			{
+				size_t index = random() % blocks.size();
+				segment.deallocate( blocks[ index ].first,
+					blocks[ index ].second );
+				blocks[ index ] = blocks.back();
+				blocks.pop_back();
+			}
+		}
+
+		for( Blocks::iterator block = blocks.begin();
+			block != blocks.end() && pass; ++block )
+		{
+			for( size_t i = 0; i < block->second; ++i )
+			{
+				if( block->first[ i ] != ( block->second & 0xff ) )
+				{
+					status << " Block of " << block->second
+						<< " bytes at offset "
+						<< segment.offset( block->first )
+						<< " was overwritten.\n";
+					pass = false;
+					break;
+				}
+			}
+		}
+
+		if( segment.base() != base || segment.size() <= 4096 )
+		{
+			status << " Segment of " << segment.size() << " bytes did not "
+				<< "grow in place.\n";
+			pass = false;
+		}
+
+		status << " " << blocks.size() << " blocks in a segment of "
+			<< segment.size() << " bytes, " << segment.used()
+			<< " used.\n";
+
+		if( pass )
+		{
+			status << "Test Blocks Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestSharedSegment::testTree()
+	{
+		status << "Running Test Tree\n";
+
+		std::remove( file.c_str() );
+
+		Map map;
+
+		{
+			hydrazine::SharedSegment segment( file, 4096 );
+			Tree::allocator_type allocator( segment );
+
+			Tree* tree = new ( segment.allocate( sizeof( Tree ) ) )
+				Tree( std::less< unsigned int >(), allocator );
+			segment.root( 0 ) = segment.offset( tree );
+
+			for( unsigned int i = 0; i < elements; ++i )
+			{
+				unsigned int key = random() % ( 4 * elements );
+				map.insert( std::make_pair( key, i ) );
+				tree->insert( std::make_pair( key, i ) );
+			}
+
+			segment.flush();
+		}
+
+		bool pass = true;
+
+		// Only read the tree after attaching, its allocator refers to the
+		//  segment object that is gone
+		pid_t child = fork();
+
+		if( child == 0 )
+		{
+			hydrazine::SharedSegment segment( file );
+			const Tree* tree = static_cast< const Tree* >(
+				segment.address( segment.root( 0 ) ) );
+			_exit( !segment.relocated() && matches( map, *tree ) ? 0 : 1 );
+		}
+
+		int code = 1;
+		if( child < 0 || waitpid( child, &code, 0 ) != child
+			|| !WIFEXITED( code ) || WEXITSTATUS( code ) != 0 )
+		{
+			status << " A child process could not read the tree.\n";
+			pass = false;
+		}
+
+		{
+			hydrazine::SharedSegment segment( file );
+			const Tree* tree = static_cast< const Tree* >(
+				segment.address( segment.root( 0 ) ) );
+
+			if( segment.relocated() )
+			{
+				status << " Could not attach at " << segment.base()
+					<< " again, skipping the tree.\n";
+			}
+			else if( !matches( map, *tree ) )
+			{
+				status << " Tree read back from the file does not match "
+					<< "std::map.\n";
+				pass = false;
+			}
+		}
+
+		std::remove( file.c_str() );
+
+		if( pass )
+		{
+			status << "Test Tree Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestSharedSegment::testOffsetPointers()
+	{
+		status << "Running Test Offset Pointers\n";
+
+		hydrazine::SharedSegment segment( 4096 );
+		Node* head = 0;
+
+		for( unsigned int i = 0; i < elements; ++i )
+		{
+			Node* node = new ( segment.allocate( sizeof( Node ) ) ) Node;
+			node->value = i;
+			node->next = head;
+			head = node;
+		}
+
+		segment.root( 0 ) = segment.offset( head );
+
+		bool pass = true;
+
+		hydrazine::SharedSegment view( segment.descriptorPath() );
+
+		if( !view.relocated() )
+		{
+			status << " Second mapping was not relocated.\n";
+			pass = false;
+		}
+
+		if( pass && !walk( static_cast< Node* >(
+			view.address( view.root( 0 ) ) ), elements ) )
+		{
+			status << " List read through a second mapping is wrong.\n";
+			pass = false;
+		}
+
+		if( pass )
+		{
+			size_t size = segment.size();
+			for( unsigned int i = elements; segment.size() == size; ++i )
+			{
+				Node* node = new ( segment.allocate( sizeof( Node ) ) ) Node;
+				node->value = i;
+				node->next = head;
+				head = node;
+				segment.root( 0 ) = segment.offset( head );
+			}
+
+			view.remap();
+
+			unsigned int total = head->value + 1;
+			if( !walk( static_cast< Node* >(
+				view.address( view.root( 0 ) ) ), total ) )
+			{
+				status << " List grown through the first mapping is wrong "
+					<< "in the second.\n";
+				pass = false;
+			}
+		}
+
+		if( pass )
+		{
+			status << "Test Offset Pointers Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestSharedSegment::doTest()
+	{
+		return testBlocks() && testTree() && testOffsetPointers();
+	}
+
+	TestSharedSegment::TestSharedSegment()
+	{
+		name = "TestSharedSegment";
+		description = "A unit test for SharedSegment and SharedAllocator. ";
+		description += "Test Points: 1) Randomly allocate and free blocks ";
+		description += "in a small segment and assert that it grew in place ";
+		description += "and kept every block. 2) Build a BTree in a segment ";
+		description += "backed by a file, attach to it from a child process ";
+		description += "and from this one, and assert that it matches a ";
+		description += "std::map. 3) Read a list linked by OffsetPointers ";
+		description += "through a second mapping at another address, before ";
+		description += "and after growing the segment.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestSharedSegment test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-f", "--file", test.file, "TestSharedSegment.segment",
+		"The file to map, it is removed afterwards." );
+	parser.parse( "-e", "--elements", test.elements, 100000,
+		"The number of keys in the tree and nodes in the list." );
+	parser.parse( "-i", "--iterations", test.iterations, 100000,
+		"The number of random allocations and frees." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
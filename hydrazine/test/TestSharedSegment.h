@@ -0,0 +1,70 @@
+/*!
+	\file TestSharedSegment.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestSharedSegment class.
+*/
+
+#ifndef TEST_SHARED_SEGMENT_H_INCLUDED
+#define TEST_SHARED_SEGMENT_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/SharedSegment.h>
+#include <hydrazine/interface/SharedAllocator.h>
+#include <hydrazine/interface/OffsetPointer.h>
+#include <hydrazine/implementation/BTree.h>
+#include <map>
+
+namespace test
+{
+
+	/*!
+		\brief A unit test for SharedSegment and SharedAllocator.
+
+		Test Points:
+
+			1) Randomly allocate and free blocks of random sizes in a small
+				anonymous segment, filling each with a pattern.  Assert
+				that the segment grew without moving and that every block
+				still holds its pattern.
+
+			2) Build a BTree with a SharedAllocator, in a segment backed by
+				a file, and flush it.  Unmap the segment, then attach to it
+				from a child process and from this one, and assert that
+				the tree found through a root slot matches a std::map.
+
+			3) Build a list linked by OffsetPointers in an anonymous
+				segment.  Attach to it a second time through its
+				descriptor, at a different address, and assert that the
+				list reads back.  Grow the segment from the first mapping
+				and assert that the second sees the growth after remap.
+	*/
+	class TestSharedSegment : public Test
+	{
+		public:
+			typedef std::map< unsigned int, unsigned int > Map;
+			typedef hydrazine::BTree< unsigned int, unsigned int,
+				std::less< unsigned int >, hydrazine::SharedAllocator<
+				std::pair< const unsigned int, unsigned int > > > Tree;
+
+		private:
+			bool testBlocks();
+			bool testTree();
+			bool testOffsetPointers();
+			bool doTest();
+
+		public:
+			std::string file;
+			unsigned int elements;
+			unsigned int iterations;
+
+		public:
+			TestSharedSegment();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+
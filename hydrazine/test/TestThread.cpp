@@ -3,6 +3,8 @@
 
 #include "TestThread.h"
 #include <hydrazine/implementation/debug.h>
+#include <hydrazine/implementation/Timer.h>
+#include <algorithm>
 
 #ifdef REPORT_BASE
 #undef REPORT_BASE
@@ -81,6 +83,91 @@ namespace test
 		report( "Thread " << id() << " is done, returning." );	
 	}
 
+	void ProducerThread::execute()
+	{
+		// Payloads count up from 1 so the receiver can check the order
+		for( size_t i = 1; i <= messages; ++i )
+		{
+			threadSend( reinterpret_cast< void* >( i ), destination );
+		}
+	}
+
+	void ConsumerThread::execute()
+	{
+		std::map< Id, size_t > last;
+		ordered = true;
+		
+		for( unsigned int i = 0; i < messages * sources.size(); ++i )
+		{
+			void* data = 0;
+			Id source = THREAD_ANY_ID;
+			
+			if( bySource )
+			{
+				source = sources[ i % sources.size() ];
+			}
+			
+			source = threadReceive( data, source );
+			
+			size_t value = reinterpret_cast< size_t >( data );
+			
+			if( value != ++last[ source ] )
+			{
+				ordered = false;
+			}
+		}
+		
+		threadSend( this );
+	}
+
+	void BarrierThread::execute()
+	{
+		correct = true;
+		
+		if( hold )
+		{
+			void* data = 0;
+			threadReceive( data, THREAD_CONTROLLER_ID );
+		}
+		
+		for( unsigned int episode = 0; episode < barriers; ++episode )
+		{
+			unsigned int half = ( episode % 2 ) * members;
+			
+			if( index < members )
+			{
+				(*slots)[ half + index ] = episode;
+			}
+			
+			barrier();
+			
+			if( index >= members )
+			{
+				continue;
+			}
+			
+			// Every member must have written before anyone gets here
+			for( unsigned int i = 0; i < members; ++i )
+			{
+				if( i == leaver && episode >= leaverBarriers )
+				{
+					continue;
+				}
+				
+				if( (*slots)[ half + i ] != episode )
+				{
+					correct = false;
+				}
+			}
+		}
+		
+		if( index == leaver )
+		{
+			report( "Thread " << id() << " leaving the group." );
+			remove();
+		}
+	}
+
 	RingThread* startRing( unsigned int threads, unsigned int loops )
 	{
 	
@@ -169,13 +256,240 @@ namespace test
 		return pass;
 	}
 	
+	bool TestThread::testThroughput( bool bySource )
+	{
+		ConsumerThread consumer;
+		std::vector< ProducerThread > senders( producers );
+		
+		consumer.messages = messages;
+		consumer.bySource = bySource;
+		
+		for( std::vector< ProducerThread >::iterator 
+			sender = senders.begin(); sender != senders.end(); ++sender )
+		{
+			sender->associate( &consumer );
+			sender->destination = consumer.id();
+			sender->messages = messages;
+			consumer.sources.push_back( sender->id() );
+		}
+		
+		hydrazine::Timer timer;
+		timer.start();
+		
+		consumer.start();
+		for( std::vector< ProducerThread >::iterator 
+			sender = senders.begin(); sender != senders.end(); ++sender )
+		{
+			sender->start();
+		}
+		
+		ConsumerThread* done = 0;
+		consumer.receive( done );
+		
+		timer.stop();
+		
+		for( std::vector< ProducerThread >::iterator 
+			sender = senders.begin(); sender != senders.end(); ++sender )
+		{
+			sender->join();
+		}
+		consumer.join();
+
+		status << " " << producers << " threads sent " << messages
+			<< " messages each to one thread receiving from "
+			<< ( bySource ? "each source in turn" : "any source" ) << " at "
+			<< ( producers * messages / timer.seconds() ) 
+			<< " messages per second.\n";
+		
+		if( !done->ordered )
+		{
+			status << "Messages from one source arrived out of order.\n";
+			return false;
+		}
+		
+		return true;
+	}
+	
+	bool TestThread::testBacklog( )
+	{
+		// Far more messages than a queue holds before anyone receives
+		ConsumerThread consumer;
+		
+		consumer.messages = messages;
+		consumer.bySource = true;
+		consumer.sources.push_back( THREAD_CONTROLLER_ID );
+		
+		for( size_t i = 1; i <= messages; ++i )
+		{
+			consumer.send( reinterpret_cast< void* >( i ) );
+		}
+		
+		consumer.start();
+		
+		ConsumerThread* done = 0;
+		consumer.receive( done );
+		consumer.join();
+		
+		if( !done->ordered )
+		{
+			status << "Messages sent before a thread started arrived out "
+				<< "of order.\n";
+			return false;
+		}
+		
+		ProducerThread producer;
+		
+		producer.destination = THREAD_CONTROLLER_ID;
+		producer.messages = messages;
+		
+		producer.start();
+		producer.join();
+		
+		for( size_t i = 1; i <= messages; ++i )
+		{
+			void* data = 0;
+			producer.receive( data );
+			
+			if( reinterpret_cast< size_t >( data ) != i )
+			{
+				status << "Messages sent to a controller that was not "
+					<< "receiving arrived out of order.\n";
+				return false;
+			}
+		}
+		
+		status << " " << messages << " messages were sent both ways "
+			<< "before they were received.\n";
+		
+		return true;
+	}
+	
+	bool TestThread::testBarrier( unsigned int size )
+	{
+		std::vector< unsigned int > slots( 2 * size );
+		std::vector< BarrierThread > members( size );
+		
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			if( i > 0 )
+			{
+				members[ i ].associate( &members[ 0 ] );
+			}
+			
+			members[ i ].slots = &slots;
+			members[ i ].index = i;
+			members[ i ].members = size;
+			members[ i ].barriers = barriers;
+			members[ i ].leaver = size;
+			members[ i ].leaverBarriers = 0;
+			members[ i ].hold = false;
+		}
+		
+		hydrazine::Timer timer;
+		timer.start();
+		
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			members[ i ].start();
+		}
+		
+		bool pass = true;
+		
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			members[ i ].join();
+			pass &= members[ i ].correct;
+		}
+		
+		timer.stop();
+		
+		status << " " << size << " threads waited at " << barriers 
+			<< " barriers, " << ( timer.seconds() * 1.0e6 / barriers ) 
+			<< " microseconds per barrier.\n";
+		
+		if( !pass )
+		{
+			status << "A thread left a barrier before every thread in the "
+				<< "group of " << size << " reached it.\n";
+		}
+		
+		return pass;
+	}
+	
+	bool TestThread::testMembership( )
+	{
+		unsigned int size = std::max( group, 2u );
+		std::vector< unsigned int > slots( 2 * size );
+		std::vector< BarrierThread > members( size );
+		BarrierThread joiner;
+		
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			if( i > 0 )
+			{
+				members[ i ].associate( &members[ 0 ] );
+			}
+			
+			members[ i ].slots = &slots;
+			members[ i ].index = i;
+			members[ i ].members = size;
+			members[ i ].barriers = i == 0 ? barriers / 2 : barriers;
+			members[ i ].leaver = 0;
+			members[ i ].leaverBarriers = barriers / 2;
+			members[ i ].hold = i == 0;
+		}
+		
+		// The first thread holds the others at the first barrier, so the
+		//  joining thread takes part from the first or second barrier
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			members[ i ].start();
+		}
+		
+		joiner.associate( &members[ 1 ] );
+		joiner.slots = &slots;
+		joiner.index = size;
+		joiner.members = size;
+		joiner.barriers = barriers / 4;
+		joiner.leaver = size;
+		joiner.leaverBarriers = 0;
+		joiner.hold = false;
+		joiner.start();
+		
+		members[ 0 ].send( 0 );
+		
+		bool pass = true;
+		
+		for( unsigned int i = 0; i < size; ++i )
+		{
+			members[ i ].join();
+			pass &= members[ i ].correct;
+		}
+		
+		joiner.join();
+		
+		if( !pass )
+		{
+			status << "A thread left a barrier early while threads joined "
+				<< "and left the group.\n";
+		}
+		
+		return pass;
+	}
+	
 	bool TestThread::doTest()
 	{
 		bool pass = true;
 
+		hydrazine::Timer timer;
+		timer.start();
+
 		if( testMessage() )
 		{
-			status << "Test message passed.\n";
+			timer.stop();
+			status << "Test message passed, the ring passed "
+				<< ( threads * loops / timer.seconds() ) 
+				<< " messages per second.\n";
 		}
 		else
 		{
@@ -183,6 +497,32 @@ namespace test
 			pass = false;
 		}
 		
+		if( pass && testThroughput( false ) && testThroughput( true ) 
+			&& testBacklog() )
+		{
+			status << "Test throughput passed.\n";
+		}
+		else
+		{
+			status << "Test throughput failed.\n";
+			pass = false;
+		}
+		
+		for( unsigned int size = 1; pass && size < 2 * group; size *= 2 )
+		{
+			pass = testBarrier( std::min( size, group ) );
+		}
+		
+		if( pass && testMembership() )
+		{
+			status << "Test barrier passed.\n";
+		}
+		else
+		{
+			status << "Test barrier failed.\n";
+			pass = false;
+		}
+		
 		return pass;
 	}
 	
@@ -191,7 +531,16 @@ namespace test
 		name = "TestThread";
 		
 		description = "A test program to test the basic communication ";
-		description += "functions in the thread wrapper class.";
+		description += "functions in the thread wrapper class, and a ";
+		description += "benchmark of the messages per second that many ";
+		description += "threads can send to one thread receiving from any ";
+		description += "source or from each source in turn, and of the ";
+		description += "latency of a barrier as the group grows.  Threads ";
+		description += "join and leave a group while it waits at barriers ";
+		description += "to test that the barrier follows the group.  ";
+		description += "Messages are sent to a thread before it starts ";
+		description += "and to the controller before it receives, to test ";
+		description += "that sends never wait for the receiver.";
 	}
 	
 }
@@ -205,6 +554,14 @@ int main( int argc, char* argv[] )
 
 	parser.parse( "-t", test.threads, 20, "The number of threads to use." );
 	parser.parse( "-l", test.loops, 200, "Number of times to loop." );
+	parser.parse( "-p", test.producers, 8, 
+		"The number of threads sending to one thread." );
+	parser.parse( "-m", test.messages, 100000, 
+		"The number of messages sent by each of those threads." );
+	parser.parse( "-g", test.group, 16, 
+		"The largest group of threads to time barriers for." );
+	parser.parse( "-b", test.barriers, 2000, 
+		"The number of barriers each thread waits at, at least 4." );
 	
 	parser.parse( "-v", test.verbose, false, "Print out status information." );
 	parser.parse( "-s", test.seed, 0, "Random seed." );
@@ -6,6 +6,7 @@
 #include <hydrazine/interface/Test.h>
 #include <iostream>
 #include <map>
+#include <vector>
 
 namespace test
 {
@@ -24,16 +25,66 @@ namespace test
 	
 	RingThread* startRing( unsigned int threads, unsigned int loops );
 	
+	class ProducerThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+			
+		public:
+			Id destination;
+			unsigned int messages;
+	};
+	
+	class ConsumerThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+			
+		public:
+			std::vector< Id > sources;
+			unsigned int messages;
+			bool bySource;
+			bool ordered;
+	};
+	
+	class BarrierThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+			
+		public:
+			/*! \brief A value per member written before each barrier, in
+				two halves used by turns */
+			std::vector< unsigned int >* slots;
+			unsigned int index;
+			unsigned int members;
+			unsigned int barriers;
+			/*! \brief The member that leaves and the barriers it hits */
+			unsigned int leaver;
+			unsigned int leaverBarriers;
+			/*! \brief Wait for a message before the first barrier */
+			bool hold;
+			bool correct;
+	};
+	
 	class TestThread : public Test
 	{
 		private:
 			bool testMessage( );
+			bool testThroughput( bool bySource );
+			bool testBacklog( );
+			bool testBarrier( unsigned int size );
+			bool testMembership( );
 			bool doTest( );
 			
 		public:
 			TestThread();			
 			unsigned int threads;
 			unsigned int loops;
+			unsigned int producers;
+			unsigned int messages;
+			unsigned int group;
+			unsigned int barriers;
 	
 	};
 
@@ -0,0 +1,468 @@
+/*!
+	\file TestThreadPool.cpp
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The source file for the TestThreadPool class.
+*/
+
+#ifndef TEST_THREAD_POOL_CPP_INCLUDED
+#define TEST_THREAD_POOL_CPP_INCLUDED
+
+#include <hydrazine/test/TestThreadPool.h>
+#include <hydrazine/implementation/ArgumentParser.h>
+#include <hydrazine/interface/Exception.h>
+#include <hydrazine/implementation/Timer.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace test
+{
+
+	/*! \brief Fibonacci numbers below this are not split */
+	static const unsigned int Cutoff = 16;
+
+	/*! \brief Count the times that it is called */
+	class Count
+	{
+		public:
+			std::atomic< unsigned int >* counter;
+
+		public:
+			void operator()() const
+			{
+				counter->fetch_add( 1 );
+			}
+	};
+
+	/*! \brief Always throw */
+	class Fail
+	{
+		public:
+			int operator()() const
+			{
+				throw hydrazine::Exception( "Thrown in the pool." );
+			}
+	};
+
+	static unsigned long long fibonacci( unsigned int n )
+	{
+		return n < 2 ? n : fibonacci( n - 1 ) + fibonacci( n - 2 );
+	}
+
+	Sum::Sum( const std::vector< unsigned int >* d, size_t b, size_t e ) :
+		data( d ), begin( b ), end( e )
+	{
+
+	}
+
+	unsigned long long Sum::operator()() const
+	{
+		unsigned long long sum = 0;
+
+		for( size_t i = begin; i < end; ++i )
+		{
+			sum += ( *data )[ i ];
+		}
+
+		return sum;
+	}
+
+	Fibonacci::Fibonacci( hydrazine::ThreadPool* p, unsigned int i ) :
+		pool( p ), n( i )
+	{
+
+	}
+
+	unsigned long long Fibonacci::operator()() const
+	{
+		if( n < Cutoff )
+		{
+			return fibonacci( n );
+		}
+
+		hydrazine::ThreadPool::Future< unsigned long long > first =
+			pool->submit( Fibonacci( pool, n - 1 ) );
+		unsigned long long second = Fibonacci( pool, n - 2 )();
+
+		return first.get() + second;
+	}
+
+	void SubmitterThread::execute()
+	{
+		typedef hydrazine::ThreadPool::Future< unsigned long long > Future;
+		typedef std::vector< Future > FutureVector;
+
+		FutureVector futures;
+		size_t size = data->size();
+
+		for( unsigned int c = 0; c < chunks; ++c )
+		{
+			futures.push_back( pool->submit( Sum( data, c * size / chunks,
+				( c + 1 ) * size / chunks ) ) );
+		}
+
+		sum = 0;
+
+		for( FutureVector::iterator future = futures.begin();
+			future != futures.end(); ++future )
+		{
+			sum += future->get();
+		}
+
+		threadSend( this );
+	}
+
+	void SumThread::execute()
+	{
+		result = sum();
+	}
+
+	unsigned long long TestThreadPool::serial( size_t begin,
+		size_t end ) const
+	{
+		return Sum( &_data, begin, end )();
+	}
+
+	bool TestThreadPool::testSubmit()
+	{
+		status << "Running Test Submit\n";
+
+		typedef hydrazine::ThreadPool::Future< unsigned long long > Future;
+		typedef hydrazine::ThreadPool::Future< void > VoidFuture;
+
+		hydrazine::ThreadPool pool( workers );
+		std::vector< Future > sums;
+		std::vector< VoidFuture > counts;
+		std::atomic< unsigned int > counter( 0 );
+
+		Count count;
+		count.counter = &counter;
+
+		for( unsigned int c = 0; c < chunks; ++c )
+		{
+			sums.push_back( pool.submit( Sum( &_data, c * elements / chunks,
+				( c + 1 ) * elements / chunks ) ) );
+			counts.push_back( pool.submit( count ) );
+		}
+
+		bool pass = true;
+
+		for( unsigned int c = 0; c < chunks; ++c )
+		{
+			unsigned long long expected = serial( c * elements / chunks,
+				( c + 1 ) * elements / chunks );
+
+			if( sums[ c ].get() != expected )
+			{
+				status << " Chunk " << c << " summed to " << sums[ c ].get()
+					<< ", expected " << expected << ".\n";
+				pass = false;
+			}
+
+			counts[ c ].get();
+		}
+
+		if( counter != chunks )
+		{
+			status << " Only " << counter << " of " << chunks
+				<< " functions that return nothing ran.\n";
+			pass = false;
+		}
+
+		status << " " << pool.size() << " workers summed " << chunks
+			<< " chunks.\n";
+
+		if( pass )
+		{
+			status << "Test Submit Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestThreadPool::testNested()
+	{
+		status << "Running Test Nested\n";
+
+		hydrazine::ThreadPool pool( workers );
+		unsigned long long expected = test::fibonacci( fibonacci );
+		bool pass = true;
+
+		hydrazine::Timer timer;
+		timer.start();
+
+		unsigned long long submitted =
+			pool.submit( Fibonacci( &pool, fibonacci ) ).get();
+
+		timer.stop();
+
+		if( submitted != expected )
+		{
+			status << " Fibonacci " << fibonacci << " computed in the pool "
+				<< "is " << submitted << ", expected " << expected << ".\n";
+			pass = false;
+		}
+
+		// Outside of the pool the main thread submits to the shared queue
+		//  and helps while it waits
+		unsigned long long helped = Fibonacci( &pool, fibonacci )();
+
+		if( helped != expected )
+		{
+			status << " Fibonacci " << fibonacci << " computed from the "
+				<< "main thread is " << helped << ", expected " << expected
+				<< ".\n";
+			pass = false;
+		}
+
+		status << " Fibonacci " << fibonacci << " took " << timer.seconds()
+			<< " seconds.\n";
+
+		if( pass )
+		{
+			status << "Test Nested Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestThreadPool::testThreads()
+	{
+		status << "Running Test Threads\n";
+
+		hydrazine::ThreadPool pool( workers );
+		std::vector< SubmitterThread > submitters( threads );
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			if( i > 0 )
+			{
+				submitters[ i ].associate( &submitters[ 0 ] );
+			}
+
+			submitters[ i ].pool = &pool;
+			submitters[ i ].data = &_data;
+			submitters[ i ].chunks = chunks;
+		}
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			submitters[ i ].start();
+		}
+
+		unsigned long long expected = serial( 0, elements );
+		bool pass = true;
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			SubmitterThread* done = 0;
+			submitters[ 0 ].receive( done );
+
+			if( done->sum != expected )
+			{
+				status << " Thread " << done->id() << " summed to "
+					<< done->sum << ", expected " << expected << ".\n";
+				pass = false;
+			}
+		}
+
+		for( unsigned int i = 0; i < threads; ++i )
+		{
+			submitters[ i ].join();
+		}
+
+		if( pass )
+		{
+			status << "Test Threads Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestThreadPool::testExceptions()
+	{
+		status << "Running Test Exceptions\n";
+
+		hydrazine::ThreadPool pool( workers );
+		std::vector< hydrazine::ThreadPool::Future< int > > futures;
+
+		for( unsigned int c = 0; c < chunks; ++c )
+		{
+			futures.push_back( pool.submit( Fail() ) );
+		}
+
+		unsigned int caught = 0;
+
+		for( unsigned int c = 0; c < chunks; ++c )
+		{
+			try
+			{
+				futures[ c ].get();
+			}
+			catch( const hydrazine::Exception& )
+			{
+				++caught;
+			}
+		}
+
+		bool pass = caught == chunks;
+
+		if( !pass )
+		{
+			status << " Only " << caught << " of " << chunks
+				<< " exceptions were rethrown.\n";
+		}
+		else
+		{
+			status << "Test Exceptions Passed\n";
+		}
+
+		return pass;
+	}
+
+	bool TestThreadPool::testLoops()
+	{
+		status << "Running Test Loops\n";
+
+		typedef hydrazine::ThreadPool::Future< unsigned long long > Future;
+
+		hydrazine::ThreadPool pool( workers );
+		unsigned int pieces = pool.size();
+		unsigned long long expected = serial( 0, elements );
+		bool pass = true;
+
+		hydrazine::Timer timer;
+		timer.start();
+
+		for( unsigned int l = 0; l < loops && pass; ++l )
+		{
+			std::vector< Future > futures;
+
+			for( unsigned int p = 0; p < pieces; ++p )
+			{
+				futures.push_back( pool.submit( Sum( &_data,
+					p * elements / pieces, ( p + 1 ) * elements / pieces ) ) );
+			}
+
+			unsigned long long sum = 0;
+
+			for( unsigned int p = 0; p < pieces; ++p )
+			{
+				sum += futures[ p ].get();
+			}
+
+			pass = sum == expected;
+		}
+
+		timer.stop();
+		hydrazine::Timer::Second pooled = timer.seconds();
+
+		timer.start();
+
+		for( unsigned int l = 0; l < loops && pass; ++l )
+		{
+			SumThread* summers = new SumThread[ pieces ];
+
+			for( unsigned int p = 0; p < pieces; ++p )
+			{
+				summers[ p ].sum = Sum( &_data, p * elements / pieces,
+					( p + 1 ) * elements / pieces );
+				summers[ p ].start();
+			}
+
+			unsigned long long sum = 0;
+
+			for( unsigned int p = 0; p < pieces; ++p )
+			{
+				summers[ p ].join();
+				sum += summers[ p ].result;
+			}
+
+			delete[] summers;
+
+			pass = sum == expected;
+		}
+
+		timer.stop();
+
+		if( !pass )
+		{
+			status << " A parallel loop summed to the wrong value.\n";
+			return false;
+		}
+
+		status << " " << loops << " loops over " << elements
+			<< " elements in " << pieces << " pieces took "
+			<< ( pooled * 1.0e6 / loops ) << " microseconds each in the pool "
+			<< "and " << ( timer.seconds() * 1.0e6 / loops )
+			<< " microseconds each starting Threads.\n";
+
+		status << "Test Loops Passed\n";
+
+		return true;
+	}
+
+	bool TestThreadPool::doTest()
+	{
+		_data.resize( elements );
+
+		for( Vector::iterator element = _data.begin();
+			element != _data.end(); ++element )
+		{
+			*element = random() % 1000;
+		}
+
+		chunks = std::max( chunks, 1u );
+
+		return testSubmit() && testNested() && testThreads()
+			&& testExceptions() && testLoops();
+	}
+
+	TestThreadPool::TestThreadPool()
+	{
+		name = "TestThreadPool";
+		description = "A unit test and benchmark for ThreadPool. ";
+		description += "Test Points: 1) Sum chunks of a vector in the pool ";
+		description += "and check against a serial sum. 2) Compute a ";
+		description += "fibonacci number with functions that submit and ";
+		description += "wait on more functions. 3) Submit from the ";
+		description += "execute() of a group of Threads that send their ";
+		description += "sums to the main thread. 4) Rethrow exceptions ";
+		description += "from functions in the pool. 5) Time parallel loops ";
+		description += "in the pool against starting a Thread per chunk.";
+	}
+
+}
+
+int main( int argc, char** argv )
+{
+	hydrazine::ArgumentParser parser( argc, argv );
+	test::TestThreadPool test;
+	parser.description( test.testDescription() );
+
+	parser.parse( "-s", "--seed", test.seed, 0,
+		"Seed for random tests, 0 implies seed with time." );
+	parser.parse( "-v", "--verbose", test.verbose, false,
+		"Print out info after the test." );
+	parser.parse( "-w", "--workers", test.workers, 0,
+		"The workers in each pool, 0 implies one per hardware thread." );
+	parser.parse( "-e", "--elements", test.elements, 1 << 20,
+		"The number of elements in the vector to sum." );
+	parser.parse( "-c", "--chunks", test.chunks, 64,
+		"The number of functions to split a sum into." );
+	parser.parse( "-t", "--threads", test.threads, 4,
+		"The number of Threads submitting to the pool." );
+	parser.parse( "-f", "--fibonacci", test.fibonacci, 30,
+		"The fibonacci number to compute." );
+	parser.parse( "-l", "--loops", test.loops, 200,
+		"The number of parallel loops to time." );
+	parser.parse();
+
+	test.test();
+
+	return test.passed();
+}
+
+#endif
+
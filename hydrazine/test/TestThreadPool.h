@@ -0,0 +1,134 @@
+/*!
+	\file TestThreadPool.h
+	\date Saturday October 17, 2026
+	\author Gregory Diamos <gregory.diamos@gatech.edu>
+	\brief The header file for the TestThreadPool class.
+*/
+
+#ifndef TEST_THREAD_POOL_H_INCLUDED
+#define TEST_THREAD_POOL_H_INCLUDED
+
+#include <hydrazine/interface/Test.h>
+#include <hydrazine/interface/ThreadPool.h>
+#include <vector>
+
+namespace test
+{
+
+	/*! \brief Sum a range of a vector */
+	class Sum
+	{
+		public:
+			const std::vector< unsigned int >* data;
+			size_t begin;
+			size_t end;
+
+		public:
+			Sum( const std::vector< unsigned int >* d = 0, size_t b = 0,
+				size_t e = 0 );
+
+		public:
+			unsigned long long operator()() const;
+	};
+
+	/*! \brief Compute a fibonacci number, submitting one of the two
+		halves of every step above a cutoff to the pool */
+	class Fibonacci
+	{
+		public:
+			hydrazine::ThreadPool* pool;
+			unsigned int n;
+
+		public:
+			Fibonacci( hydrazine::ThreadPool* p, unsigned int n );
+
+		public:
+			unsigned long long operator()() const;
+	};
+
+	/*! \brief A thread that passes messages and submits to a pool */
+	class SubmitterThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+
+		public:
+			hydrazine::ThreadPool* pool;
+			const std::vector< unsigned int >* data;
+			unsigned int chunks;
+			unsigned long long sum;
+	};
+
+	/*! \brief A thread that sums one chunk of a loop */
+	class SumThread : public hydrazine::Thread
+	{
+		protected:
+			void execute();
+
+		public:
+			Sum sum;
+			unsigned long long result;
+	};
+
+	/*!
+		\brief A unit test and benchmark for ThreadPool.
+
+		Test Points:
+
+			1) Submit functions that sum chunks of a random vector and
+				functions that return nothing from the main thread.  Assert
+				that every result matches a serial sum and that every
+				function ran.
+
+			2) Compute a fibonacci number with functions that submit and
+				wait on more functions.  Assert that it matches a serial
+				computation.
+
+			3) Start a group of Threads that submit functions to the pool
+				from execute() and send their sums to the main thread as
+				messages.  Assert that every sum is correct.
+
+			4) Submit functions that throw and assert that waiting on them
+				rethrows.
+
+			5) Time parallel loops over the vector done by submitting a
+				function per chunk to the pool and by starting a Thread per
+				chunk.
+	*/
+	class TestThreadPool : public Test
+	{
+		private:
+			typedef std::vector< unsigned int > Vector;
+
+		private:
+			Vector _data;
+
+		private:
+			unsigned long long serial( size_t begin, size_t end ) const;
+
+		private:
+			bool testSubmit();
+			bool testNested();
+			bool testThreads();
+			bool testExceptions();
+			bool testLoops();
+			bool doTest();
+
+		public:
+			unsigned int workers;
+			unsigned int elements;
+			unsigned int chunks;
+			unsigned int threads;
+			unsigned int fibonacci;
+			unsigned int loops;
+
+		public:
+			TestThreadPool();
+	};
+
+}
+
+int main( int argc, char** argv );
+
+#endif
+